@@ -20,7 +20,7 @@ layout (std140) uniform DirectionalLightArray {
 
 // Per vertex data
 layout(location = 0) in vec3 vertex_position;
-layout(location = 1) in vec3 normal;
+layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec2 texture_coordinate;
 layout(location = 3) in vec4 bone_weights;
 layout(location = 4) in uvec4 bone_indices;
@@ -38,6 +38,11 @@ out VertexOut {
 
 } vertex_out;
 
+// Vertex decode, see VertexFormat
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform bool octahedral_normals;
+
 // Per instance data
 uniform mat4 model_matrix;
 uniform mat3 normal_matrix;
@@ -58,8 +63,6 @@ uniform mat4 bone_transforms[BONE_TRANSFORMS];
 uniform vec3 ws_view_position;
 uniform mat4 projection_view_matrix;
 
-uniform sampler2D specular_map_texture;
-
 #if SHADER_MODE == 1
 LightingResult resolveVertexLighting(vec3 ws_position, vec3 ws_normal){
     // Per vertex lighting
@@ -80,6 +83,10 @@ LightingResult resolveVertexLighting(vec3 ws_position, vec3 ws_normal){
 #endif
 
 void main() {
+    // Decode the vertex
+    vec3 position = position_offset + position_scale * vertex_position;
+    vec3 normal = octahedral_normals ? decode_octahedral(vertex_normal.xy) : vertex_normal;
+
     // Transform vertices
     float sum = dot(bone_weights, vec4(1.0f));
 
@@ -93,7 +100,7 @@ void main() {
     mat4 animation_matrix = model_matrix * bone_transform;
     mat3 normal_matrix = cofactor(animation_matrix);
 
-    vec3 ws_position = (animation_matrix * vec4(vertex_position, 1.0f)).xyz;
+    vec3 ws_position = (animation_matrix * vec4(position, 1.0f)).xyz;
     vertex_out.ws_position = ws_position;
     vec3 ws_normal = normalize(normal_matrix * normal);
     vertex_out.ws_normal = ws_normal;
@@ -125,10 +125,7 @@ LightingResult total_light_calculation(LightCalculatioData light_calculation_dat
     return LightingResult(total_diffuse, total_specular, total_ambient);
 }
 
-vec3 resolve_textured_light_calculation(LightingResult result, sampler2D diffuse_texture, sampler2D specular_map, vec2 texture_coordinate) {
-    vec3 texture_colour = texture(diffuse_texture, texture_coordinate).rgb;
-    vec3 specular_map_sample = texture(specular_map, texture_coordinate).rgb;
-
+vec3 resolve_textured_light_calculation(LightingResult result, vec3 texture_colour, vec3 specular_map_sample) {
     vec3 textured_diffuse = result.total_diffuse * texture_colour;
     vec3 sampled_specular = result.total_specular * specular_map_sample;
     vec3 textured_ambient = result.total_ambient * texture_colour;
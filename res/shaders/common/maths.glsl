@@ -7,4 +7,14 @@ mat3 cofactor(mat4 mat) {
         cross(vec3(mat[2]), vec3(mat[0])),
         cross(vec3(mat[0]), vec3(mat[1]))
     );
+}
+
+// Decode a normal stored with an octahedral mapping, the inverse of VertexPacking::encode_octahedral
+// See: https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+vec3 decode_octahedral(vec2 encoded) {
+    vec3 normal = vec3(encoded, 1.0f - abs(encoded.x) - abs(encoded.y));
+    float fold = max(-normal.z, 0.0f);
+    normal.x += normal.x >= 0.0f ? -fold : fold;
+    normal.y += normal.y >= 0.0f ? -fold : fold;
+    return normalize(normal);
 }
\ No newline at end of file
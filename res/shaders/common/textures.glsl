@@ -0,0 +1,47 @@
+#ifndef TEXTURE_ARRAYS
+#define TEXTURE_ARRAYS 1
+#endif
+
+#ifndef MIP_DEBUG
+#define MIP_DEBUG 0
+#endif
+
+#if MIP_DEBUG
+// rgb is the tint for how many of the texture's mips are resident, and a how much of it to mix in
+uniform vec4 mip_debug_colour;
+#endif
+
+// With TEXTURE_ARRAYS, textures are sampled from the TexturePool: each is either a whole layer of an array,
+// or a rect within an atlas layer. Otherwise each texture is bound on its own, and the layer and rect are ignored.
+#if TEXTURE_ARRAYS
+#define pooled_sampler sampler2DArray
+#else
+#define pooled_sampler sampler2D
+#endif
+
+// rect.xy scales and rect.zw offsets the texture coordinate into the texture's rect of the layer
+vec4 sample_pooled(pooled_sampler pooled_texture, float layer, vec4 rect, vec2 texture_coordinate) {
+    #if TEXTURE_ARRAYS
+    if (rect.xy == vec2(1.0f)) {
+        return texture(pooled_texture, vec3(texture_coordinate, layer));
+    }
+
+    // The sampler can't wrap within a rect, so wrap here, keeping half a texel in from the edges so that nothing bleeds in from neighbouring tiles.
+    // The gradients are taken before wrapping, otherwise the jump at each wrap would select the smallest mip along it.
+    vec2 half_texel = 0.5f / vec2(textureSize(pooled_texture, 0).xy);
+    vec2 wrapped = clamp(fract(texture_coordinate) * rect.xy, half_texel, rect.xy - half_texel) + rect.zw;
+    vec2 scaled_coordinate = texture_coordinate * rect.xy;
+    return textureGrad(pooled_texture, vec3(wrapped, layer), dFdx(scaled_coordinate), dFdy(scaled_coordinate));
+    #else
+    return texture(pooled_texture, texture_coordinate);
+    #endif
+}
+
+// With MIP_DEBUG, tints a sampled colour by how many of its texture's mips are resident, see BaseEntityShader::set_mip_debug_colour()
+vec3 apply_mip_debug(vec3 colour) {
+    #if MIP_DEBUG
+    return mix(colour, mip_debug_colour.rgb, mip_debug_colour.a);
+    #else
+    return colour;
+    #endif
+}
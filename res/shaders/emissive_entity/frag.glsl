@@ -1,4 +1,5 @@
 #version 410 core
+#include "../common/textures.glsl"
 
 in VertexOut {
     vec3 ws_position;
@@ -13,10 +14,13 @@ uniform vec3 emissive_tint;
 // Global Data
 uniform float inverse_gamma;
 
-uniform sampler2D emissive_texture;
+// See common/textures.glsl
+uniform pooled_sampler emissive_texture;
+uniform float emissive_texture_layer;
+uniform vec4 emissive_texture_rect;
 
 void main() {
-    vec3 texture_colour = texture(emissive_texture, frag_in.texture_coordinate).rgb;
+    vec3 texture_colour = apply_mip_debug(sample_pooled(emissive_texture, emissive_texture_layer, emissive_texture_rect, frag_in.texture_coordinate).rgb);
     vec3 emissive_colour = emissive_tint * texture_colour;
 
     out_colour = vec4(emissive_colour, 1.0f);
@@ -9,6 +9,10 @@ out VertexOut {
     vec2 texture_coordinate;
 } vertex_out;
 
+// Vertex decode, see VertexFormat
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+
 // Per instance data
 uniform mat4 model_matrix;
 
@@ -16,7 +20,9 @@ uniform mat4 model_matrix;
 uniform mat4 projection_view_matrix;
 
 void main() {
-    vertex_out.ws_position = (model_matrix * vec4(vertex_position, 1.0f)).xyz;
+    vec3 position = position_offset + position_scale * vertex_position;
+
+    vertex_out.ws_position = (model_matrix * vec4(position, 1.0f)).xyz;
     vertex_out.texture_coordinate = texture_coordinate;
 
     gl_Position = projection_view_matrix * vec4(vertex_out.ws_position, 1.0f);
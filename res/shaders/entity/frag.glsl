@@ -1,5 +1,6 @@
 #version 410 core
 #include "../common/lights.glsl"
+#include "../common/textures.glsl"
 
 //get light pipeline mode
 uniform int shader_mode;
@@ -34,9 +35,13 @@ uniform vec3 specular_tint;
 uniform vec3 ambient_tint;
 uniform float shininess;
 
-//texture properties
-uniform sampler2D diffuse_texture;
-uniform sampler2D specular_map_texture;
+//texture properties, see common/textures.glsl
+uniform pooled_sampler diffuse_texture;
+uniform float diffuse_texture_layer;
+uniform vec4 diffuse_texture_rect;
+uniform pooled_sampler specular_map_texture;
+uniform float specular_map_texture_layer;
+uniform vec4 specular_map_texture_rect;
 
 // Global data
 uniform vec3 ws_view_position;
@@ -73,7 +78,9 @@ vec3 resolveFragmentLighting(){
     #endif
 
     //resolve vertex lighting with frag texture sampling
-    return resolve_textured_light_calculation(lighting_result, diffuse_texture, specular_map_texture, frag_in.texture_coordinate);
+    vec3 texture_colour = apply_mip_debug(sample_pooled(diffuse_texture, diffuse_texture_layer, diffuse_texture_rect, frag_in.texture_coordinate).rgb);
+    vec3 specular_map_sample = sample_pooled(specular_map_texture, specular_map_texture_layer, specular_map_texture_rect, frag_in.texture_coordinate).rgb;
+    return resolve_textured_light_calculation(lighting_result, texture_colour, specular_map_sample);
 }
 
 void main() {
@@ -1,9 +1,10 @@
 #version 410 core
 #include "../common/lights.glsl"
+#include "../common/maths.glsl"
 
 // Per vertex data
 layout(location = 0) in vec3 vertex_position;
-layout(location = 1) in vec3 normal;
+layout(location = 1) in vec3 vertex_normal;
 layout(location = 2) in vec2 texture_coordinate;
 
 // Get Light Data
@@ -37,6 +38,11 @@ out VertexOut {
 
 } vertex_out;
 
+// Vertex decode, see VertexFormat
+uniform vec3 position_offset;
+uniform vec3 position_scale;
+uniform bool octahedral_normals;
+
 // Per instance data
 uniform mat4 model_matrix;
 uniform mat3 normal_matrix;
@@ -74,9 +80,12 @@ LightingResult resolveVertexLighting(vec3 ws_position, vec3 ws_normal){
 #endif
 
 void main() {
+    // Decode the vertex
+    vec3 position = position_offset + position_scale * vertex_position;
+    vec3 normal = octahedral_normals ? decode_octahedral(vertex_normal.xy) : vertex_normal;
 
     // Transform vertices
-    vec3 ws_position = (model_matrix * vec4(vertex_position, 1.0f)).xyz;
+    vec3 ws_position = (model_matrix * vec4(position, 1.0f)).xyz;
     vertex_out.ws_position = ws_position;
     vec3 ws_normal = normalize(normal_matrix * normal);
     vertex_out.ws_normal = ws_normal;
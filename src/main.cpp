@@ -4,6 +4,8 @@
 #include "utility/PerformanceCounter.h"
 #include "rendering/resources/ModelLoader.h"
 #include "rendering/resources/TextureLoader.h"
+#include "rendering/resources/ResidencyManager.h"
+#include "utility/FileWatcher.h"
 #include "rendering/renders/MasterRenderer.h"
 #include "scene/SceneManager.h"
 #include "scene/SceneInterface.h"
@@ -40,9 +42,17 @@ int main() {
         // Create an instance of the MasterRenderer which controls all the rendering
         MasterRenderer master_renderer{};
 
+        // Watch the asset directories, so that changed files can be hot reloaded.
+        FileWatcher file_watcher{{"res/models", "res/textures", "res/shaders"}};
+        // Shaders are reloaded at most once a frame, however many of their files changed
+        bool shaders_changed = false;
+        file_watcher.subscribe("res/shaders", [&shaders_changed](const FileWatcher::Change&) { shaders_changed = true; });
+
         // Set up the model and texture loads, pointing them to a relative path to look in for files.
-        ModelLoader model_loader{"res/models"};
-        TextureLoader texture_loader{"res/textures"};
+        // Both share a residency manager, which keeps recently released assets loaded within a GPU memory budget.
+        ResidencyManager residency_manager{};
+        ModelLoader model_loader{"res/models", "cache/models", residency_manager, file_watcher};
+        TextureLoader texture_loader{"res/textures", "cache/textures", residency_manager, file_watcher};
 
         // Create a scene manager and give it two scene constructors, one for the editor scene,
         // and another for an example second scene, this one just being a simple static scene.
@@ -85,6 +95,17 @@ int main() {
             }
             // Tell the MasterRenderer that we are staring a new frame
             master_renderer.update(window);
+            // Hot reload any assets whose files have changed
+            file_watcher.update();
+            if (shaders_changed) {
+                shaders_changed = false;
+                master_renderer.refresh_shaders();
+            }
+            // Finish off any models and textures that have been loading in the background
+            model_loader.update();
+            texture_loader.update();
+            // Then free any released assets that no longer fit in the budget
+            residency_manager.update();
 
             if (scene_context.imgui_enabled) {
                 // Create an ImGUI window for global options, that are independent of the scene
@@ -92,14 +113,24 @@ int main() {
                     scene_manager.add_imgui_options_section(scene_context);
                     master_renderer.add_imgui_options_section(window_manager);
                     performance_counter.add_imgui_options_section((float) window_manager.get_delta_time());
+                    model_loader.add_imgui_options_section();
+                    texture_loader.add_imgui_options_section();
+                    residency_manager.add_imgui_options_section();
+                    file_watcher.add_imgui_options_section();
                 }
                 ImGui::End();
             }
 
             // Tick the scene, so it can do per-frame logic
-            scene_manager.tick_scene(scene_context);
+            performance_counter.time_stage("Scene Tick", [&scene_manager, &scene_context]() {
+                scene_manager.tick_scene(scene_context);
+            });
+            // Advance the scene's animations and pose its animated entities, across every core, so they are ready before anything is drawn
+            master_renderer.update_animation(scene_manager.get_current_scene()->get_render_scene(), scene_context, performance_counter);
             // Tell the MasterRenderer to use render the current scene to the window
-            master_renderer.render_scene(scene_manager.get_current_scene()->get_render_scene(), scene_context);
+            performance_counter.time_stage("Render Submission", [&master_renderer, &scene_manager, &scene_context]() {
+                master_renderer.render_scene(scene_manager.get_current_scene()->get_render_scene(), scene_context);
+            });
 
             if (scene_context.imgui_enabled) {
                 // Tell ImGUI to now render itself onto the frame
@@ -116,6 +147,7 @@ int main() {
         // Cleanup some resources now that the program is closing
         scene_manager.cleanup(scene_context);
 
+        residency_manager.cleanup();
         texture_loader.cleanup();
         model_loader.cleanup();
 
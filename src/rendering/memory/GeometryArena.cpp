@@ -0,0 +1,357 @@
+#include "GeometryArena.h"
+
+#include <algorithm>
+#include <vector>
+
+FreeList::FreeList(size_t capacity) : capacity(capacity) {
+    if (capacity > 0) free_blocks.emplace(0, capacity);
+}
+
+std::optional<size_t> FreeList::allocate(size_t count, size_t alignment) {
+    if (count == 0) return 0;
+
+    for (auto it = free_blocks.begin(); it != free_blocks.end(); ++it) {
+        auto [offset, block_count] = *it;
+        auto aligned_offset = (offset + alignment - 1) / alignment * alignment;
+        if (aligned_offset + count > offset + block_count) continue;
+
+        // Any padding before the aligned offset stays free
+        free_blocks.erase(it);
+        if (aligned_offset > offset) {
+            free_blocks.emplace(offset, aligned_offset - offset);
+        }
+        if (offset + block_count > aligned_offset + count) {
+            free_blocks.emplace(aligned_offset + count, offset + block_count - aligned_offset - count);
+        }
+        return aligned_offset;
+    }
+    return std::nullopt;
+}
+
+void FreeList::free(size_t offset, size_t count) {
+    if (count == 0) return;
+
+    auto next = free_blocks.lower_bound(offset);
+    // Merge with the following block
+    if (next != free_blocks.end() && offset + count == next->first) {
+        count += next->second;
+        next = free_blocks.erase(next);
+    }
+    // Merge with the preceding block
+    if (next != free_blocks.begin()) {
+        auto previous = std::prev(next);
+        if (previous->first + previous->second == offset) {
+            previous->second += count;
+            return;
+        }
+    }
+    free_blocks.emplace_hint(next, offset, count);
+}
+
+void FreeList::grow(size_t new_capacity) {
+    if (new_capacity <= capacity) return;
+    auto old_capacity = capacity;
+    capacity = new_capacity;
+    free(old_capacity, new_capacity - old_capacity);
+}
+
+void FreeList::reset(size_t used) {
+    free_blocks.clear();
+    if (used < capacity) free_blocks.emplace(used, capacity - used);
+}
+
+size_t FreeList::get_capacity() const {
+    return capacity;
+}
+
+size_t FreeList::get_free() const {
+    size_t total = 0;
+    for (const auto& [offset, count]: free_blocks) total += count;
+    return total;
+}
+
+size_t FreeList::get_largest_free_block() const {
+    size_t largest = 0;
+    for (const auto& [offset, count]: free_blocks) largest = std::max(largest, count);
+    return largest;
+}
+
+size_t FreeList::get_free_block_count() const {
+    return free_blocks.size();
+}
+
+size_t FreeList::get_tail_free() const {
+    if (free_blocks.empty()) return 0;
+    const auto& [offset, count] = *free_blocks.rbegin();
+    return offset + count == capacity ? count : 0;
+}
+
+size_t FreeList::get_hole_space() const {
+    return get_free() - get_tail_free();
+}
+
+size_t GeometryArena::Allocation::get_index_size() const {
+    return index_type == GL_UNSIGNED_SHORT ? sizeof(uint16_t) : sizeof(uint32_t);
+}
+
+size_t GeometryArena::Allocation::get_index_slots() const {
+    return index_count * get_index_size() / INDEX_SLOT_SIZE;
+}
+
+/// Split the triangles into runs that each reference a range of at most 65536 vertices, so they can use 16 bit indices relative to a base vertex.
+/// Vertex fetch ordering (see MeshOptimizer) means most meshes need only a few runs. Returns nullopt if there would be too many.
+static std::optional<std::vector<GeometryArena::SubMesh>> split_for_16_bit_indices(const uint* indices, size_t index_count) {
+    std::vector<GeometryArena::SubMesh> sub_meshes{};
+    if (index_count % 3 != 0) return std::nullopt;
+
+    size_t run_start = 0;
+    uint run_min = UINT32_MAX;
+    uint run_max = 0;
+    for (size_t i = 0; i < index_count; i += 3) {
+        auto triangle_min = std::min({indices[i], indices[i + 1], indices[i + 2]});
+        auto triangle_max = std::max({indices[i], indices[i + 1], indices[i + 2]});
+        if (triangle_max - triangle_min > UINT16_MAX) return std::nullopt;
+
+        if (std::max(run_max, triangle_max) - std::min(run_min, triangle_min) > UINT16_MAX) {
+            sub_meshes.push_back({run_start, i - run_start, run_min});
+            if (sub_meshes.size() >= GeometryArena::MAX_SUB_MESHES) return std::nullopt;
+            run_start = i;
+            run_min = triangle_min;
+            run_max = triangle_max;
+        } else {
+            run_min = std::min(run_min, triangle_min);
+            run_max = std::max(run_max, triangle_max);
+        }
+    }
+    sub_meshes.push_back({run_start, index_count - run_start, index_count > 0 ? run_min : 0});
+    return sub_meshes;
+}
+
+GeometryArena::GeometryArena(std::string name, size_t vertex_size, void (* setup_attrib_pointers)())
+    : name(std::move(name)), vertex_size(vertex_size), setup_attrib_pointers(setup_attrib_pointers) {
+    glGenVertexArrays(1, &vao);
+
+    glGenBuffers(1, &vertex_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (long) (vertex_free_list.get_capacity() * vertex_size), nullptr, GL_STATIC_DRAW);
+
+    glGenBuffers(1, &index_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (long) (index_free_list.get_capacity() * INDEX_SLOT_SIZE), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    bind_buffers();
+}
+
+void GeometryArena::bind_buffers() {
+    glBindVertexArray(vao);
+    glBindBuffer(GL_ARRAY_BUFFER, vertex_buffer);
+    setup_attrib_pointers();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_buffer);
+    glBindVertexArray(0);
+}
+
+/// Create a new buffer of new_size bytes, copying copy_size bytes across from the old buffer, which is then deleted.
+static uint replace_buffer(uint old_buffer, size_t copy_size, size_t new_size) {
+    uint new_buffer;
+    glGenBuffers(1, &new_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (long) new_size, nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, old_buffer);
+    glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, 0, 0, (long) copy_size);
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &old_buffer);
+    return new_buffer;
+}
+
+void GeometryArena::grow(size_t vertex_capacity, size_t index_capacity) {
+    bool grow_vertices = vertex_capacity > vertex_free_list.get_capacity();
+    bool grow_indices = index_capacity > index_free_list.get_capacity();
+    // Nothing reallocated, so the VAO still points at the right buffers
+    if (!grow_vertices && !grow_indices) return;
+
+    if (grow_vertices) {
+        vertex_buffer = replace_buffer(vertex_buffer, vertex_free_list.get_capacity() * vertex_size, vertex_capacity * vertex_size);
+        vertex_free_list.grow(vertex_capacity);
+    }
+    if (grow_indices) {
+        index_buffer = replace_buffer(index_buffer, index_free_list.get_capacity() * INDEX_SLOT_SIZE, index_capacity * INDEX_SLOT_SIZE);
+        index_free_list.grow(index_capacity);
+    }
+    grow_count++;
+    bind_buffers();
+}
+
+std::shared_ptr<GeometryArena::Allocation> GeometryArena::allocate(const void* vertices, size_t vertex_count, const uint* indices, size_t index_count) {
+    auto allocation = std::make_shared<Allocation>(Allocation{0, vertex_count, 0, index_count, GL_UNSIGNED_INT, {}});
+
+    std::vector<uint16_t> narrow_indices{};
+    auto sub_meshes = split_for_16_bit_indices(indices, index_count);
+    if (sub_meshes.has_value()) {
+        allocation->index_type = GL_UNSIGNED_SHORT;
+        allocation->sub_meshes = std::move(sub_meshes.value());
+        narrow_indices.reserve(index_count);
+        for (const auto& sub_mesh: allocation->sub_meshes) {
+            for (auto i = sub_mesh.first_index; i < sub_mesh.first_index + sub_mesh.index_count; ++i) {
+                narrow_indices.push_back((uint16_t) (indices[i] - sub_mesh.base_vertex));
+            }
+        }
+    } else {
+        allocation->sub_meshes = {SubMesh{0, index_count, 0}};
+    }
+    const void* index_data = allocation->index_type == GL_UNSIGNED_SHORT ? (const void*) narrow_indices.data() : (const void*) indices;
+    auto index_slots = allocation->get_index_slots();
+    // glDrawElements requires the offset to be a multiple of the index size
+    auto index_alignment = allocation->get_index_size() / INDEX_SLOT_SIZE;
+
+    auto first_vertex = vertex_free_list.allocate(vertex_count);
+    auto first_index_slot = index_free_list.allocate(index_slots, index_alignment);
+
+    if (!first_vertex.has_value() || !first_index_slot.has_value()) {
+        // Give back whichever half succeeded, then grow (at least doubling) so that both fit at the end
+        if (first_vertex.has_value()) vertex_free_list.free(first_vertex.value(), vertex_count);
+        if (first_index_slot.has_value()) index_free_list.free(first_index_slot.value(), index_slots);
+
+        auto grown_capacity = [](const FreeList& free_list, size_t count) {
+            auto capacity = free_list.get_capacity();
+            while (free_list.get_tail_free() + (capacity - free_list.get_capacity()) < count) capacity *= 2;
+            return capacity;
+        };
+        // One extra slot allows for aligning the tail
+        grow(grown_capacity(vertex_free_list, vertex_count), grown_capacity(index_free_list, index_slots + 1));
+
+        first_vertex = vertex_free_list.allocate(vertex_count);
+        first_index_slot = index_free_list.allocate(index_slots, index_alignment);
+        if (!first_vertex.has_value() || !first_index_slot.has_value()) {
+            throw std::runtime_error(Formatter() << "Failed to allocate " << vertex_count << " vertices and " << index_count << " indices in geometry arena (" << name << ")");
+        }
+    }
+    allocation->first_vertex = first_vertex.value();
+    allocation->first_index_slot = first_index_slot.value();
+
+    glBindBuffer(GL_COPY_WRITE_BUFFER, vertex_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (long) (allocation->first_vertex * vertex_size), (long) (vertex_count * vertex_size), vertices);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, index_buffer);
+    glBufferSubData(GL_COPY_WRITE_BUFFER, (long) (allocation->first_index_slot * INDEX_SLOT_SIZE), (long) (index_slots * INDEX_SLOT_SIZE), index_data);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+
+    allocations.insert(allocation);
+    return allocation;
+}
+
+void GeometryArena::free(const std::shared_ptr<Allocation>& allocation) {
+    if (allocations.erase(allocation) == 0) return;
+    vertex_free_list.free(allocation->first_vertex, allocation->vertex_count);
+    index_free_list.free(allocation->first_index_slot, allocation->get_index_slots());
+}
+
+bool GeometryArena::defragment_if_needed() {
+    auto needs_defragment = [](const FreeList& free_list) {
+        auto hole_space = free_list.get_hole_space();
+        auto used_extent = free_list.get_capacity() - free_list.get_tail_free();
+        return hole_space > 0 && (float) hole_space >= DEFRAGMENT_THRESHOLD * (float) used_extent;
+    };
+
+    if (!needs_defragment(vertex_free_list) && !needs_defragment(index_free_list)) return false;
+
+    defragment();
+    return true;
+}
+
+void GeometryArena::defragment() {
+    // Copy every allocation, in order, into fresh buffers of the same capacity, so that they are packed at the start.
+    std::vector<Allocation*> ordered{};
+    ordered.reserve(allocations.size());
+    for (const auto& allocation: allocations) ordered.push_back(allocation.get());
+
+    uint new_vertex_buffer;
+    glGenBuffers(1, &new_vertex_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_vertex_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (long) (vertex_free_list.get_capacity() * vertex_size), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, vertex_buffer);
+
+    std::sort(ordered.begin(), ordered.end(), [](const Allocation* a, const Allocation* b) { return a->first_vertex < b->first_vertex; });
+    size_t next_vertex = 0;
+    for (auto* allocation: ordered) {
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (long) (allocation->first_vertex * vertex_size), (long) (next_vertex * vertex_size), (long) (allocation->vertex_count * vertex_size));
+        allocation->first_vertex = next_vertex;
+        next_vertex += allocation->vertex_count;
+    }
+
+    uint new_index_buffer;
+    glGenBuffers(1, &new_index_buffer);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, new_index_buffer);
+    glBufferData(GL_COPY_WRITE_BUFFER, (long) (index_free_list.get_capacity() * INDEX_SLOT_SIZE), nullptr, GL_STATIC_DRAW);
+    glBindBuffer(GL_COPY_READ_BUFFER, index_buffer);
+
+    std::sort(ordered.begin(), ordered.end(), [](const Allocation* a, const Allocation* b) { return a->first_index_slot < b->first_index_slot; });
+    size_t next_index_slot = 0;
+    for (auto* allocation: ordered) {
+        // Keep 32 bit indices aligned
+        auto alignment = allocation->get_index_size() / INDEX_SLOT_SIZE;
+        next_index_slot = (next_index_slot + alignment - 1) / alignment * alignment;
+        glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (long) (allocation->first_index_slot * INDEX_SLOT_SIZE), (long) (next_index_slot * INDEX_SLOT_SIZE), (long) (allocation->get_index_slots() * INDEX_SLOT_SIZE));
+        allocation->first_index_slot = next_index_slot;
+        next_index_slot += allocation->get_index_slots();
+    }
+
+    glBindBuffer(GL_COPY_READ_BUFFER, 0);
+    glBindBuffer(GL_COPY_WRITE_BUFFER, 0);
+    glDeleteBuffers(1, &vertex_buffer);
+    glDeleteBuffers(1, &index_buffer);
+    vertex_buffer = new_vertex_buffer;
+    index_buffer = new_index_buffer;
+
+    vertex_free_list.reset(next_vertex);
+    index_free_list.reset(next_index_slot);
+    defragment_count++;
+    bind_buffers();
+}
+
+const std::string& GeometryArena::get_name() const {
+    return name;
+}
+
+uint GeometryArena::get_vao() const {
+    return vao;
+}
+
+uint GeometryArena::get_vertex_buffer() const {
+    return vertex_buffer;
+}
+
+uint GeometryArena::get_index_buffer() const {
+    return index_buffer;
+}
+
+GeometryArena::Stats GeometryArena::get_stats() const {
+    auto fragmentation = [](const FreeList& free_list) {
+        auto free = free_list.get_free();
+        return free == 0 ? 0.0f : 1.0f - (float) free_list.get_largest_free_block() / (float) free;
+    };
+
+    size_t index_bytes_saved = 0;
+    for (const auto& allocation: allocations) {
+        index_bytes_saved += allocation->index_count * (sizeof(uint32_t) - allocation->get_index_size());
+    }
+
+    return Stats{
+        allocations.size(),
+        (vertex_free_list.get_capacity() - vertex_free_list.get_free()) * vertex_size,
+        vertex_free_list.get_capacity() * vertex_size,
+        (index_free_list.get_capacity() - index_free_list.get_free()) * INDEX_SLOT_SIZE,
+        index_free_list.get_capacity() * INDEX_SLOT_SIZE,
+        fragmentation(vertex_free_list),
+        fragmentation(index_free_list),
+        index_bytes_saved,
+        grow_count,
+        defragment_count,
+    };
+}
+
+GeometryArena::~GeometryArena() {
+    glDeleteVertexArrays(1, &vao);
+    glDeleteBuffers(1, &vertex_buffer);
+    glDeleteBuffers(1, &index_buffer);
+}
@@ -0,0 +1,138 @@
+#ifndef GEOMETRY_ARENA_H
+#define GEOMETRY_ARENA_H
+
+#include <map>
+#include <memory>
+#include <optional>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include <glad/gl.h>
+
+#include "utility/HelperTypes.h"
+
+/// A free list over a range of elements, allocating first fit and coalescing neighbouring free blocks.
+class FreeList {
+    // { offset } -> { count }
+    std::map<size_t, size_t> free_blocks{};
+    size_t capacity = 0;
+public:
+    explicit FreeList(size_t capacity);
+
+    /// Returns the offset of the allocated block, which is a multiple of alignment, or nullopt if no free block is large enough.
+    std::optional<size_t> allocate(size_t count, size_t alignment = 1);
+    void free(size_t offset, size_t count);
+    /// Add space to the end of the list.
+    void grow(size_t new_capacity);
+    /// Reset to a single allocated block of used elements, followed by free space.
+    void reset(size_t used);
+
+    [[nodiscard]] size_t get_capacity() const;
+    [[nodiscard]] size_t get_free() const;
+    [[nodiscard]] size_t get_largest_free_block() const;
+    [[nodiscard]] size_t get_free_block_count() const;
+    /// The free space at the end of the list, which grows along with the capacity.
+    [[nodiscard]] size_t get_tail_free() const;
+    /// The free space that is not at the end of the list, so can't be used by a large allocation.
+    [[nodiscard]] size_t get_hole_space() const;
+};
+
+/// A pair of large vertex and index buffers, with a single VAO over them, that many models of the same vertex format are sub-allocated from.
+/// This means consecutive draws of models in the same arena don't need to change VAO.
+/// Models are drawn by passing their first index (as a byte offset) and vertex offset (as the base vertex) to glDrawElementsBaseVertex.
+/// Indices are stored as 16 bit wherever possible, splitting a model into sub-meshes if each of them then spans few enough vertices,
+/// so the index buffer is allocated in 16 bit slots, with 32 bit indices taking two.
+class GeometryArena : private NonCopyable {
+public:
+    /// A range of a model that is drawn with one call, with 16 bit indices it spans at most 65536 vertices from its base vertex.
+    struct SubMesh {
+        // Relative to the allocation's first index
+        size_t first_index;
+        size_t index_count;
+        // Relative to the allocation's first vertex
+        size_t base_vertex;
+    };
+
+    /// The ranges of one model in the arena, updated in place if the arena is defragmented.
+    struct Allocation {
+        size_t first_vertex;
+        size_t vertex_count;
+        size_t first_index_slot;
+        size_t index_count;
+        // GL_UNSIGNED_SHORT or GL_UNSIGNED_INT
+        GLenum index_type;
+        std::vector<SubMesh> sub_meshes;
+
+        [[nodiscard]] size_t get_index_size() const;
+        [[nodiscard]] size_t get_index_slots() const;
+    };
+
+    struct Stats {
+        size_t allocations;
+        size_t vertex_bytes_used;
+        size_t vertex_bytes_capacity;
+        size_t index_bytes_used;
+        size_t index_bytes_capacity;
+        // 0 when all of the free space is contiguous, approaching 1 as it is split into many small blocks
+        float vertex_fragmentation;
+        float index_fragmentation;
+        // Compared to storing every index as 32 bit
+        size_t index_bytes_saved;
+        uint grow_count;
+        uint defragment_count;
+    };
+
+    static constexpr size_t INDEX_SLOT_SIZE = sizeof(uint16_t);
+    static constexpr size_t INITIAL_VERTEX_CAPACITY = 1 << 16;
+    // In index slots
+    static constexpr size_t INITIAL_INDEX_CAPACITY = 1 << 19;
+    // Beyond this many sub-meshes, the extra draw calls aren't worth the saving, so 32 bit indices are used instead
+    static constexpr size_t MAX_SUB_MESHES = 16;
+    // Defragment once the holes make up this fraction of the used part of either buffer
+    static constexpr float DEFRAGMENT_THRESHOLD = 0.25f;
+private:
+    std::string name;
+    size_t vertex_size;
+    void (* setup_attrib_pointers)();
+
+    uint vao = 0;
+    uint vertex_buffer = 0;
+    uint index_buffer = 0;
+    FreeList vertex_free_list{INITIAL_VERTEX_CAPACITY};
+    FreeList index_free_list{INITIAL_INDEX_CAPACITY};
+
+    // Every live allocation, so they can be moved when defragmenting
+    std::unordered_set<std::shared_ptr<Allocation>> allocations{};
+    uint grow_count = 0;
+    uint defragment_count = 0;
+
+    /// (Re)bind the buffers to the VAO, needed whenever they are replaced
+    void bind_buffers();
+    /// Replace the buffers with larger ones, copying the existing data across, if either capacity is more than the buffer has
+    void grow(size_t vertex_capacity, size_t index_capacity);
+public:
+    GeometryArena(std::string name, size_t vertex_size, void (* setup_attrib_pointers)());
+
+    /// Copy the vertices and indices into the arena, growing it if needed, and narrowing the indices to 16 bit if possible.
+    /// The indices are relative to the first vertex, as glDrawElementsBaseVertex adds the vertex offset.
+    std::shared_ptr<Allocation> allocate(const void* vertices, size_t vertex_count, const uint* indices, size_t index_count);
+    /// Return an allocation's ranges to the free lists.
+    void free(const std::shared_ptr<Allocation>& allocation);
+
+    /// Pack every allocation to the start of the buffers, if the free space has become too fragmented.
+    /// Returns true if the arena was defragmented.
+    bool defragment_if_needed();
+    /// Pack every allocation to the start of the buffers, removing all the holes.
+    void defragment();
+
+    [[nodiscard]] const std::string& get_name() const;
+    [[nodiscard]] uint get_vao() const;
+    [[nodiscard]] uint get_vertex_buffer() const;
+    [[nodiscard]] uint get_index_buffer() const;
+    [[nodiscard]] Stats get_stats() const;
+
+    ~GeometryArena();
+};
+
+#endif //GEOMETRY_ARENA_H
@@ -15,16 +15,20 @@ void AnimatedEntityRenderer::AnimatedEntityShader::set_model_matrix(const glm::m
     glProgramUniformMatrix4fv(id(), model_matrix_location, 1, GL_FALSE, &model_matrix[0][0]);
 }
 
-void AnimatedEntityRenderer::AnimatedEntityShader::set_bone_transforms(const std::vector<glm::mat4>& bone_transforms) {
-    glProgramUniformMatrix4fv(id(), bone_transforms_location, std::min(BONE_TRANSFORMS, (int) bone_transforms.size()), GL_FALSE, &bone_transforms[0][0][0]);
+void AnimatedEntityRenderer::AnimatedEntityShader::set_bone_transforms(const glm::mat4* bone_transforms, uint count) {
+    glProgramUniformMatrix4fv(id(), bone_transforms_location, std::min(BONE_TRANSFORMS, (int) count), GL_FALSE, &bone_transforms[0][0][0]);
 }
 
 AnimatedEntityRenderer::AnimatedEntityRenderer::AnimatedEntityRenderer() : shader() {}
 
-void AnimatedEntityRenderer::AnimatedEntityRenderer::render(const RenderScene& render_scene, const LightScene& light_scene) {
+void AnimatedEntityRenderer::AnimatedEntityRenderer::render(const RenderScene& render_scene, const LightScene& light_scene, TexturePool& texture_pool) {
+    shader.set_texture_arrays(texture_pool.is_enabled());
     shader.use();
     shader.set_global_data(render_scene.global_data);
+    texture_pool.reset_bindings();
 
+    // Models of the same vertex format share a GeometryArena, and so a VAO, so only rebind when it changes
+    uint bound_vao = 0;
     for (const auto& entity: render_scene.entities) {
         shader.set_instance_data(entity->instance_data);
 
@@ -38,23 +42,37 @@ void AnimatedEntityRenderer::AnimatedEntityRenderer::render(const RenderScene& r
         shader.set_point_lights(light_scene.get_nearest_point_lights(position, BaseLitEntityShader::MAX_PL, 5));
         shader.set_directional_lights(light_scene.get_nearest_directional_lights(position, BaseLitEntityShader::MAX_DL, 5));
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, entity->render_data.diffuse_texture->get_texture_id());
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, entity->render_data.specular_map_texture->get_texture_id());
-
-        entity->mesh_hierarchy->calculate_animation(entity->animation_id, entity->animation_time_seconds);
-        entity->mesh_hierarchy->visit_nodes([this, &entity](const MeshHierarchyNode& node, glm::mat4 accumulated_transformation) {
-            for (const auto& mesh_id: node.meshes) {
-                const auto& mesh = entity->mesh_hierarchy->meshes[mesh_id];
+        // Pooled textures mostly share a few arrays, so the binds are usually skipped, and only the layers change
+        auto diffuse = texture_pool.resolve(entity->render_data.diffuse_texture);
+        auto specular_map = texture_pool.resolve(entity->render_data.specular_map_texture);
+        texture_pool.bind(0, diffuse);
+        texture_pool.bind(1, specular_map);
+        shader.set_texture_slots(diffuse, specular_map);
+        if (mip_debug) shader.set_mip_debug_colour(*entity->render_data.diffuse_texture);
+
+        const auto& pose = entity->drawn_pose != nullptr ? *entity->drawn_pose : entity->pose;
+        for (const auto& mesh_binding: entity->mesh_hierarchy->flat.meshes) {
+            const auto& mesh = entity->mesh_hierarchy->meshes[mesh_binding.mesh];
+            auto model_matrix = entity->instance_data.model_matrix * mesh_binding.transformation;
+
+            // So that the TextureLoader can stream in the mips the textures need at the size they are drawn, from the (bind pose) bounds of each mesh
+            auto screen_size = render_scene.global_data.projected_size(model_matrix, mesh.model->get_bounding_sphere());
+            entity->render_data.diffuse_texture->request_size(screen_size);
+            entity->render_data.specular_map_texture->request_size(screen_size);
+
+            shader.set_model_matrix(model_matrix);
+            if (mesh_binding.bone_count > 0 && mesh_binding.first_bone + mesh_binding.bone_count <= pose.bone_palette.size()) {
+                shader.set_bone_transforms(&pose.bone_palette[mesh_binding.first_bone], mesh_binding.bone_count);
+            }
 
-                shader.set_model_matrix(entity->instance_data.model_matrix * accumulated_transformation);
-                if (!mesh.bone_transforms.empty()) shader.set_bone_transforms(mesh.bone_transforms);
+            shader.set_vertex_decode(mesh.model->get_vertex_decode());
 
-                glBindVertexArray(mesh.model->get_vao());
-                glDrawElementsBaseVertex(GL_TRIANGLES, mesh.model->get_index_count(), GL_UNSIGNED_INT, nullptr, mesh.model->get_vertex_offset());
+            if (mesh.model->get_vao() != bound_vao) {
+                bound_vao = mesh.model->get_vao();
+                glBindVertexArray(bound_vao);
             }
-        });
+            mesh.model->draw();
+        }
     }
 }
 
@@ -62,6 +80,11 @@ bool AnimatedEntityRenderer::AnimatedEntityRenderer::refresh_shaders() {
     return shader.reload_files();
 }
 
+void AnimatedEntityRenderer::AnimatedEntityRenderer::set_mip_debug(bool set_mip_debug) {
+    mip_debug = set_mip_debug;
+    shader.set_mip_debug(mip_debug);
+}
+
 void AnimatedEntityRenderer::VertexData::from_mesh(const VertexCollection& vertex_collection, std::vector<VertexData>& out_vertices) {
     out_vertices.reserve(out_vertices.size() + vertex_collection.positions.size());
 
@@ -99,4 +122,39 @@ void AnimatedEntityRenderer::VertexData::setup_attrib_pointers() {
     glEnableVertexAttribArray(2);
     glEnableVertexAttribArray(3);
     glEnableVertexAttribArray(4);
+}
+
+AnimatedEntityRenderer::CompactVertexData AnimatedEntityRenderer::CompactVertexData::from_vertex(const VertexData& vertex, const VertexDecode& decode) {
+    static_assert(BONE_TRANSFORMS <= UINT8_MAX + 1, "Bone indices must fit in a byte");
+    return CompactVertexData{
+        VertexPacking::quantise_position(vertex.position, decode),
+        VertexPacking::encode_octahedral(vertex.normal),
+        VertexPacking::to_half(vertex.texture_coordinate),
+        VertexPacking::quantise_weights(vertex.bone_weights),
+        VertexPacking::narrow_indices(vertex.bone_indices)
+    };
+}
+
+void AnimatedEntityRenderer::CompactVertexData::from_mesh(const VertexCollection& vertex_collection, const VertexDecode& decode, std::vector<CompactVertexData>& out_vertices) {
+    std::vector<VertexData> vertices{};
+    VertexData::from_mesh(vertex_collection, vertices);
+
+    out_vertices.reserve(out_vertices.size() + vertices.size());
+    for (const auto& vertex: vertices) {
+        out_vertices.push_back(from_vertex(vertex, decode));
+    }
+}
+
+void AnimatedEntityRenderer::CompactVertexData::setup_attrib_pointers() {
+    // Same shader inputs as VertexData, see EntityRenderer::CompactVertexData::setup_attrib_pointers
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, position));
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, normal));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, texture_coordinate));
+    glVertexAttribPointer(3, 4, GL_UNSIGNED_BYTE, GL_TRUE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, bone_weights));
+    glVertexAttribIPointer(4, 4, GL_UNSIGNED_BYTE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, bone_indices));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
+    glEnableVertexAttribArray(3);
+    glEnableVertexAttribArray(4);
 }
\ No newline at end of file
@@ -22,7 +22,12 @@
 #define BONE_TRANSFORMS_STR "64"
 
 namespace AnimatedEntityRenderer {
+    struct CompactVertexData;
+
     struct VertexData {
+        using Compact = CompactVertexData;
+
+
         glm::vec3 position;
         glm::vec3 normal;
         glm::vec2 texture_coordinate;
@@ -33,6 +38,24 @@ namespace AnimatedEntityRenderer {
         static void setup_attrib_pointers();
     };
 
+    /// A 24 byte alternative to VertexData (which is 64), decoded in the vertex shader with a VertexDecode.
+    struct CompactVertexData {
+        // Normalised against the model bounds, with w as padding
+        glm::i16vec4 position;
+        // Octahedral encoded
+        glm::i16vec2 normal;
+        // Half floats
+        glm::u16vec2 texture_coordinate;
+        // Normalised unsigned bytes
+        glm::u8vec4 bone_weights;
+        // Fine as bytes since there are only BONE_TRANSFORMS bones
+        glm::u8vec4 bone_indices;
+
+        static CompactVertexData from_vertex(const VertexData& vertex, const VertexDecode& decode);
+        static void from_mesh(const VertexCollection& vertex_collection, const VertexDecode& decode, std::vector<CompactVertexData>& out_vertices);
+        static void setup_attrib_pointers();
+    };
+
     using EntityMaterial = BaseLitEntityMaterial;
     using InstanceData = BaseLitEntityInstanceData;
     using GlobalData = BaseLitEntityGlobalData;
@@ -50,7 +73,7 @@ namespace AnimatedEntityRenderer {
 
         void set_model_matrix(const glm::mat4& model_matrix);
 
-        void set_bone_transforms(const std::vector<glm::mat4>& bone_transforms);
+        void set_bone_transforms(const glm::mat4* bone_transforms, uint count);
     private:
         // Override get_uniforms_set_bindings to get the extra uniform for bone transforms
         void get_uniforms_set_bindings() override;
@@ -58,13 +81,18 @@ namespace AnimatedEntityRenderer {
 
     class AnimatedEntityRenderer {
         AnimatedEntityShader shader;
+        bool mip_debug = false;
 
     public:
         AnimatedEntityRenderer();
 
-        void render(const RenderScene& render_scene, const LightScene& light_scene);
+        /// Draw each entity in its drawn_pose, so the PoseEvaluator must have evaluated them first
+        void render(const RenderScene& render_scene, const LightScene& light_scene, TexturePool& texture_pool);
 
         bool refresh_shaders();
+
+        /// Tint textures by how many of their mips are resident, see BaseEntityShader::set_mip_debug_colour()
+        void set_mip_debug(bool set_mip_debug);
     };
 }
 
@@ -8,6 +8,8 @@ EmissiveEntityRenderer::EmissiveEntityShader::EmissiveEntityShader() :
 void EmissiveEntityRenderer::EmissiveEntityShader::get_uniforms_set_bindings() {
     // Material
     emission_tint_location = get_uniform_location("emissive_tint");
+    emissive_texture_layer_location = get_uniform_location("emissive_texture_layer");
+    emissive_texture_rect_location = get_uniform_location("emissive_texture_rect");
     // Texture sampler bindings
     set_binding("emissive_texture", 0);
 }
@@ -22,23 +24,50 @@ void EmissiveEntityRenderer::EmissiveEntityShader::set_instance_data(const Insta
     glProgramUniform3fv(id(), emission_tint_location, 1, &scaled_diffuse_tint[0]);
 }
 
+void EmissiveEntityRenderer::EmissiveEntityShader::set_texture_slot(const TexturePool::Slot& emission) {
+    glProgramUniform1f(id(), emissive_texture_layer_location, emission.layer);
+    glProgramUniform4fv(id(), emissive_texture_rect_location, 1, &emission.rect[0]);
+}
+
 EmissiveEntityRenderer::EmissiveEntityRenderer::EmissiveEntityRenderer() : shader() {}
 
-void EmissiveEntityRenderer::EmissiveEntityRenderer::render(const RenderScene& render_scene) {
+void EmissiveEntityRenderer::EmissiveEntityRenderer::render(const RenderScene& render_scene, TexturePool& texture_pool, MeshletCuller& meshlet_culler, LodSelector& lod_selector) {
+    shader.set_texture_arrays(texture_pool.is_enabled());
     shader.use();
     shader.set_global_data(render_scene.global_data);
+    texture_pool.reset_bindings();
+    meshlet_culler.set_camera(render_scene.global_data.projection_view_matrix, render_scene.global_data.camera_position);
 
+    // Models of the same vertex format share a GeometryArena, and so a VAO, so only rebind when it changes
+    uint bound_vao = 0;
     for (const auto& entity: render_scene.entities) {
         shader.set_instance_data(entity->instance_data);
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, entity->render_data.emission_texture->get_texture_id());
+        auto emission = texture_pool.resolve(entity->render_data.emission_texture);
+        texture_pool.bind(0, emission);
+        shader.set_texture_slot(emission);
+        if (mip_debug) shader.set_mip_debug_colour(*entity->render_data.emission_texture);
+
+        // So that the TextureLoader can stream in the mips the texture needs at the size it is drawn, and the model is drawn in only as much detail as shows
+        auto screen_size = render_scene.global_data.projected_size(entity->instance_data.model_matrix, entity->model->get_bounding_sphere());
+        entity->render_data.emission_texture->request_size(screen_size);
+        entity->lod = lod_selector.select(*entity->model, screen_size, entity->lod);
 
-        glBindVertexArray(entity->model->get_vao());
-        glDrawElementsBaseVertex(GL_TRIANGLES, entity->model->get_index_count(), GL_UNSIGNED_INT, nullptr, entity->model->get_vertex_offset());
+        shader.set_vertex_decode(entity->model->get_vertex_decode());
+
+        if (entity->model->get_vao() != bound_vao) {
+            bound_vao = entity->model->get_vao();
+            glBindVertexArray(bound_vao);
+        }
+        meshlet_culler.draw(*entity->model, entity->instance_data.model_matrix, entity->lod);
     }
 }
 
 bool EmissiveEntityRenderer::EmissiveEntityRenderer::refresh_shaders() {
     return shader.reload_files();
 }
+
+void EmissiveEntityRenderer::EmissiveEntityRenderer::set_mip_debug(bool set_mip_debug) {
+    mip_debug = set_mip_debug;
+    shader.set_mip_debug(mip_debug);
+}
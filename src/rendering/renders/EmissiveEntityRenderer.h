@@ -51,23 +51,33 @@ namespace EmissiveEntityRenderer {
     class EmissiveEntityShader : public BaseEntityShader {
         // Material
         int emission_tint_location{};
+        // Where in the TexturePool the emission texture is, see common/textures.glsl
+        int emissive_texture_layer_location{};
+        int emissive_texture_rect_location{};
     public:
         EmissiveEntityShader();
 
         void set_instance_data(const InstanceData& instance_data);
+
+        /// Set where in its (already bound) texture the emission texture is sampled from
+        void set_texture_slot(const TexturePool::Slot& emission);
     private:
         void get_uniforms_set_bindings() override;
     };
 
     class EmissiveEntityRenderer {
         EmissiveEntityShader shader;
+        bool mip_debug = false;
 
     public:
         EmissiveEntityRenderer();
 
-        void render(const RenderScene& render_scene);
+        void render(const RenderScene& render_scene, TexturePool& texture_pool, MeshletCuller& meshlet_culler, LodSelector& lod_selector);
 
         bool refresh_shaders();
+
+        /// Tint textures by how many of their mips are resident, see BaseEntityShader::set_mip_debug_colour()
+        void set_mip_debug(bool set_mip_debug);
     };
 }
 
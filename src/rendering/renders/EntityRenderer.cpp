@@ -28,10 +28,15 @@ void EntityRenderer::EntityShader::set_instance_data(const BaseLitEntityInstance
 
 EntityRenderer::EntityRenderer::EntityRenderer() : shader() {}
 
-void EntityRenderer::EntityRenderer::render(const RenderScene& render_scene, const LightScene& light_scene) {
+void EntityRenderer::EntityRenderer::render(const RenderScene& render_scene, const LightScene& light_scene, TexturePool& texture_pool, MeshletCuller& meshlet_culler, LodSelector& lod_selector) {
+    shader.set_texture_arrays(texture_pool.is_enabled());
     shader.use();
     shader.set_global_data(render_scene.global_data);
+    texture_pool.reset_bindings();
+    meshlet_culler.set_camera(render_scene.global_data.projection_view_matrix, render_scene.global_data.camera_position);
 
+    // Models of the same vertex format share a GeometryArena, and so a VAO, so only rebind when it changes
+    uint bound_vao = 0;
     for (const auto& entity: render_scene.entities) {
         shader.set_instance_data(entity->instance_data);
 
@@ -45,13 +50,27 @@ void EntityRenderer::EntityRenderer::render(const RenderScene& render_scene, con
         shader.set_point_lights(light_scene.get_nearest_point_lights(position, BaseLitEntityShader::MAX_PL, 5));
         shader.set_directional_lights(light_scene.get_nearest_directional_lights(position, BaseLitEntityShader::MAX_DL, 5));
 
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, entity->render_data.diffuse_texture->get_texture_id());
-        glActiveTexture(GL_TEXTURE1);
-        glBindTexture(GL_TEXTURE_2D, entity->render_data.specular_map_texture->get_texture_id());
-
-        glBindVertexArray(entity->model->get_vao());
-        glDrawElementsBaseVertex(GL_TRIANGLES, entity->model->get_index_count(), GL_UNSIGNED_INT, nullptr, entity->model->get_vertex_offset());
+        // Pooled textures mostly share a few arrays, so the binds are usually skipped, and only the layers change
+        auto diffuse = texture_pool.resolve(entity->render_data.diffuse_texture);
+        auto specular_map = texture_pool.resolve(entity->render_data.specular_map_texture);
+        texture_pool.bind(0, diffuse);
+        texture_pool.bind(1, specular_map);
+        shader.set_texture_slots(diffuse, specular_map);
+        if (mip_debug) shader.set_mip_debug_colour(*entity->render_data.diffuse_texture);
+
+        // So that the TextureLoader can stream in the mips the textures need at the size they are drawn
+        auto screen_size = render_scene.global_data.projected_size(entity->instance_data.model_matrix, entity->model->get_bounding_sphere());
+        entity->render_data.diffuse_texture->request_size(screen_size);
+        entity->render_data.specular_map_texture->request_size(screen_size);
+        entity->lod = lod_selector.select(*entity->model, screen_size, entity->lod);
+
+        shader.set_vertex_decode(entity->model->get_vertex_decode());
+
+        if (entity->model->get_vao() != bound_vao) {
+            bound_vao = entity->model->get_vao();
+            glBindVertexArray(bound_vao);
+        }
+        meshlet_culler.draw(*entity->model, entity->instance_data.model_matrix, entity->lod);
     }
 }
 
@@ -65,6 +84,11 @@ bool EntityRenderer::EntityRenderer::refresh_shaders() {
     return shader.reload_files();
 }
 
+void EntityRenderer::EntityRenderer::set_mip_debug(bool set_mip_debug) {
+    mip_debug = set_mip_debug;
+    shader.set_mip_debug(mip_debug);
+}
+
 void EntityRenderer::VertexData::from_mesh(const VertexCollection& vertex_collection, std::vector<VertexData>& out_vertices) {
     out_vertices.reserve(out_vertices.size() + vertex_collection.positions.size());
 
@@ -93,4 +117,33 @@ void EntityRenderer::VertexData::setup_attrib_pointers() {
     glEnableVertexAttribArray(0);
     glEnableVertexAttribArray(1);
     glEnableVertexAttribArray(2);
+}
+
+EntityRenderer::CompactVertexData EntityRenderer::CompactVertexData::from_vertex(const VertexData& vertex, const VertexDecode& decode) {
+    return CompactVertexData{
+        VertexPacking::quantise_position(vertex.position, decode),
+        VertexPacking::encode_octahedral(vertex.normal),
+        VertexPacking::to_half(vertex.texture_coordinate)
+    };
+}
+
+void EntityRenderer::CompactVertexData::from_mesh(const VertexCollection& vertex_collection, const VertexDecode& decode, std::vector<CompactVertexData>& out_vertices) {
+    std::vector<VertexData> vertices{};
+    VertexData::from_mesh(vertex_collection, vertices);
+
+    out_vertices.reserve(out_vertices.size() + vertices.size());
+    for (const auto& vertex: vertices) {
+        out_vertices.push_back(from_vertex(vertex, decode));
+    }
+}
+
+void EntityRenderer::CompactVertexData::setup_attrib_pointers() {
+    // The vertex shader reads the same vec3/vec3/vec2 inputs as with VertexData, with GL doing the normalisation,
+    // and the VertexDecode uniforms mapping the results back. The missing z of the normal is filled in as 0.
+    glVertexAttribPointer(0, 3, GL_SHORT, GL_TRUE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, position));
+    glVertexAttribPointer(1, 2, GL_SHORT, GL_TRUE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, normal));
+    glVertexAttribPointer(2, 2, GL_HALF_FLOAT, GL_FALSE, sizeof(CompactVertexData), (void*) offsetof(CompactVertexData, texture_coordinate));
+    glEnableVertexAttribArray(0);
+    glEnableVertexAttribArray(1);
+    glEnableVertexAttribArray(2);
 }
\ No newline at end of file
@@ -15,11 +15,18 @@
 #include "rendering/resources/ModelLoader.h"
 #include "rendering/resources/TextureHandle.h"
 #include "rendering/memory/UniformBufferArray.h"
+#include "rendering/renders/MeshletCuller.h"
+#include "rendering/renders/LodSelector.h"
 
 #include "rendering/renders/shaders/BaseLitEntityShader.h"
 
 namespace EntityRenderer {
+    struct CompactVertexData;
+
     struct VertexData {
+        using Compact = CompactVertexData;
+
+
         glm::vec3 position;
         glm::vec3 normal;
         glm::vec2 texture_coordinate;
@@ -28,6 +35,20 @@ namespace EntityRenderer {
         static void setup_attrib_pointers();
     };
 
+    /// A 16 byte alternative to VertexData (which is 32), decoded in the vertex shader with a VertexDecode.
+    struct CompactVertexData {
+        // Normalised against the model bounds, with w as padding
+        glm::i16vec4 position;
+        // Octahedral encoded
+        glm::i16vec2 normal;
+        // Half floats
+        glm::u16vec2 texture_coordinate;
+
+        static CompactVertexData from_vertex(const VertexData& vertex, const VertexDecode& decode);
+        static void from_mesh(const VertexCollection& vertex_collection, const VertexDecode& decode, std::vector<CompactVertexData>& out_vertices);
+        static void setup_attrib_pointers();
+    };
+
     using EntityMaterial = BaseLitEntityMaterial;
     using InstanceData = BaseLitEntityInstanceData;
     using GlobalData = BaseLitEntityGlobalData;
@@ -49,14 +70,18 @@ namespace EntityRenderer {
 
     class EntityRenderer {
         EntityShader shader;
+        bool mip_debug = false;
 
     public:
         EntityRenderer();
 
-        void render(const RenderScene& render_scene, const LightScene& light_scene);
+        void render(const RenderScene& render_scene, const LightScene& light_scene, TexturePool& texture_pool, MeshletCuller& meshlet_culler, LodSelector& lod_selector);
 
         bool refresh_shaders();
 
+        /// Tint textures by how many of their mips are resident, see BaseEntityShader::set_mip_debug_colour()
+        void set_mip_debug(bool set_mip_debug);
+
         void swap_mode(int shader_mode);
     };
 }
@@ -0,0 +1,33 @@
+#include "LodSelector.h"
+
+#include <imgui/imgui.h>
+
+void LodSelector::update() {
+    last_frame_stats = frame_stats;
+    frame_stats = {};
+}
+
+const LodSelector::Stats& LodSelector::get_last_frame_stats() const {
+    return last_frame_stats;
+}
+
+void LodSelector::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Levels of Detail")) {
+        ImGui::Checkbox("Select By Screen Size", &enabled);
+        ImGui::SliderFloat("Max Error (pixels)", &max_pixel_error, 0.1f, 16.0f, "%.2f", ImGuiSliderFlags_Logarithmic);
+        ImGui::SliderFloat("Hysteresis", &hysteresis, 0.0f, 0.9f);
+        ImGui::Checkbox("Force Level", &force_lod);
+        if (force_lod) {
+            ImGui::SliderInt("Level", &forced_lod, 0, (int) MeshSimplifier::MAX_LODS - 1);
+        }
+
+        const auto& stats = last_frame_stats;
+        ImGui::Text("Entities per level last frame:");
+        for (auto level = 0u; level < stats.entities.size(); ++level) {
+            ImGui::SameLine();
+            ImGui::Text("%u: %zu", level, stats.entities[level]);
+        }
+        ImGui::Text("Triangles: %zu / %zu at full detail (%.0f%%)", stats.triangles, stats.full_detail_triangles,
+                    stats.full_detail_triangles > 0 ? 100.0 * (double) stats.triangles / (double) stats.full_detail_triangles : 100.0);
+    }
+}
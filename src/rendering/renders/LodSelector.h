@@ -0,0 +1,75 @@
+#ifndef LOD_SELECTOR_H
+#define LOD_SELECTOR_H
+
+#include <array>
+#include <algorithm>
+
+#include "rendering/resources/ModelHandle.h"
+#include "rendering/resources/MeshSimplifier.h"
+#include "utility/HelperTypes.h"
+
+/// Chooses which level of detail (see MeshSimplifier) each entity is drawn at, the coarsest whose error covers at most max_pixel_error pixels on screen.
+///
+/// Each entity keeps the level it was last drawn at until the error is clearly past the threshold (by the hysteresis fraction),
+/// so entities sitting near a threshold, or with a slightly moving camera, don't pop back and forth between levels.
+class LodSelector : private NonCopyable {
+public:
+    struct Stats {
+        // [level] -> entities drawn at it
+        std::array<size_t, MeshSimplifier::MAX_LODS> entities{};
+        size_t triangles = 0;
+        size_t full_detail_triangles = 0;
+    };
+
+private:
+    bool enabled = true;
+    // The largest error, in pixels, a simplified level may show on screen
+    float max_pixel_error = 1.0f;
+    // A level is only switched away from once its error is this fraction past max_pixel_error
+    float hysteresis = 0.25f;
+    // Every entity is drawn at this level (or its coarsest, if it has fewer) if set, for comparing them
+    bool force_lod = false;
+    int forced_lod = 0;
+
+    Stats frame_stats{};
+    Stats last_frame_stats{};
+public:
+    LodSelector() = default;
+
+    /// Start a new frame, moving the stats gathered so far to get_last_frame_stats()
+    void update();
+
+    /// The level to draw the model at, given its size on screen (see BaseEntityGlobalData::projected_size()) and the level it was last drawn at
+    template<typename VertexData>
+    uint select(const ModelHandle<VertexData>& model, float projected_size, uint last_lod);
+
+    [[nodiscard]] const Stats& get_last_frame_stats() const;
+
+    void add_imgui_options_section();
+};
+
+template<typename VertexData>
+uint LodSelector::select(const ModelHandle<VertexData>& model, float projected_size, uint last_lod) {
+    const auto& lods = model.get_lods();
+    uint lod = 0;
+    if (lods != nullptr && force_lod) {
+        lod = std::min((uint) forced_lod, (uint) lods->size() - 1);
+    } else if (lods != nullptr && enabled) {
+        // The projected size spans the bounding sphere's diameter, which gives the pixels each model unit of error covers
+        auto radius = model.get_bounding_sphere().w;
+        auto pixels_per_unit = radius > 0.0f ? projected_size / (2.0f * radius) : 0.0f;
+        auto pixel_error = [&lods, pixels_per_unit](uint level) { return (*lods)[level].error * pixels_per_unit; };
+
+        // Move to finer levels while this one is clearly too coarse, then to coarser ones while they are clearly fine enough
+        lod = std::min(last_lod, (uint) lods->size() - 1);
+        while (lod > 0 && pixel_error(lod) > max_pixel_error * (1.0f + hysteresis)) --lod;
+        while (lod + 1 < lods->size() && pixel_error(lod + 1) <= max_pixel_error * (1.0f - hysteresis)) ++lod;
+    }
+
+    frame_stats.entities[std::min<size_t>(lod, frame_stats.entities.size() - 1)]++;
+    frame_stats.triangles += (size_t) model.get_index_count(lod) / 3;
+    frame_stats.full_detail_triangles += (size_t) model.get_index_count() / 3;
+    return lod;
+}
+
+#endif //LOD_SELECTOR_H
@@ -1,10 +1,13 @@
 #include "MasterRenderer.h"
 #include <glad/gl.h>
 
+#include <chrono>
+#include <iostream>
+
 #include "rendering/imgui/ImGuiManager.h"
 #include "scene/SceneContext.h"
 
-MasterRenderer::MasterRenderer() : entity_renderer(), animated_entity_renderer(), emissive_entity_renderer(), render_settings() {
+MasterRenderer::MasterRenderer() : entity_renderer(), animated_entity_renderer(), emissive_entity_renderer(), texture_pool(), meshlet_culler(), lod_selector(), pose_evaluator(), job_system(), render_settings() {
     glEnable(GL_DEPTH_TEST);
     glPolygonMode(GL_FRONT_AND_BACK, GL_FILL);
     glEnable(GL_CULL_FACE);
@@ -16,13 +19,48 @@ MasterRenderer::MasterRenderer() : entity_renderer(), animated_entity_renderer()
 void MasterRenderer::update(const Window& window) {
     glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT | GL_STENCIL_BUFFER_BIT);
     glViewport(0, 0, (int) window.get_framebuffer_width(), (int) window.get_framebuffer_height());
+    viewport_height = (float) window.get_framebuffer_height();
+    texture_pool.update();
+    meshlet_culler.update();
+    lod_selector.update();
 }
 
-void MasterRenderer::render_scene(MasterRenderScene& render_scene, const SceneContext& scene_context) {
-    render_scene.animator.animate(scene_context.window_manager.get_delta_time());
-    entity_renderer.render(render_scene.entity_scene, render_scene.light_scene);
-    animated_entity_renderer.render(render_scene.animated_entity_scene, render_scene.light_scene);
-    emissive_entity_renderer.render(render_scene.emissive_entity_scene);
+void MasterRenderer::update_animation(MasterRenderScene& render_scene, const SceneContext& scene_context, PerformanceCounter& performance_counter) {
+    performance_counter.time_stage("Animation Clocks", [this, &render_scene, &scene_context]() {
+        render_scene.animator.animate(scene_context.window_manager.get_delta_time(), job_system);
+    });
+    performance_counter.time_stage("Animation Poses", [this, &render_scene]() {
+        pose_evaluator.evaluate(render_scene.animated_entity_scene.entities, job_system);
+    });
+
+    if (performance_counter.take_thread_scaling_request()) {
+        // Pose evaluation is the stage that scales, the clocks are too quick to measure, so the poses are evaluated again with each thread count
+        constexpr int REPEATS = 20;
+        const auto& entities = render_scene.animated_entity_scene.entities;
+        auto thread_limit = job_system.get_thread_limit();
+        std::vector<float> times{};
+        for (auto threads = 1u; threads <= job_system.get_thread_count(); ++threads) {
+            job_system.set_thread_limit(threads);
+            auto start = std::chrono::steady_clock::now();
+            for (auto i = 0; i < REPEATS; ++i) {
+                pose_evaluator.evaluate(entities, job_system);
+            }
+            times.push_back(std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count() / (float) REPEATS);
+            std::cout << "Posed " << entities.size() << " animated entities (" << pose_evaluator.get_last_frame_stats().poses_evaluated << " poses) with "
+                      << threads << " threads: " << times.back() * 1000.0f << " ms" << std::endl;
+        }
+        job_system.set_thread_limit(thread_limit);
+        performance_counter.set_thread_scaling("Animation Poses", std::move(times));
+    }
+}
+
+void MasterRenderer::render_scene(MasterRenderScene& render_scene, const SceneContext& /*scene_context*/) {
+    render_scene.entity_scene.global_data.viewport_height = viewport_height;
+    render_scene.animated_entity_scene.global_data.viewport_height = viewport_height;
+    render_scene.emissive_entity_scene.global_data.viewport_height = viewport_height;
+    entity_renderer.render(render_scene.entity_scene, render_scene.light_scene, texture_pool, meshlet_culler, lod_selector);
+    animated_entity_renderer.render(render_scene.animated_entity_scene, render_scene.light_scene, texture_pool);
+    emissive_entity_renderer.render(render_scene.emissive_entity_scene, texture_pool, meshlet_culler, lod_selector);
 }
 
 void MasterRenderer::sync() {
@@ -31,6 +69,14 @@ void MasterRenderer::sync() {
     }
 }
 
+int MasterRenderer::refresh_shaders() {
+    int failures = 0;
+    failures += entity_renderer.refresh_shaders() ? 0 : 1;
+    failures += animated_entity_renderer.refresh_shaders() ? 0 : 1;
+    failures += emissive_entity_renderer.refresh_shaders() ? 0 : 1;
+    return failures;
+}
+
 void MasterRenderer::add_imgui_options_section(WindowManager& window_manager) {
     if (ImGui::CollapsingHeader("Render Settings")) {
         if (ImGui::Checkbox("Show Wireframe", &render_settings.show_wireframe)) {
@@ -51,6 +97,7 @@ void MasterRenderer::add_imgui_options_section(WindowManager& window_manager) {
             } else {
                 glDisable(GL_CULL_FACE);
             }
+            meshlet_culler.set_back_faces_culled(render_settings.cull_back_face);
         }
 
         if (ImGui::Checkbox("V-Sync", &render_settings.v_sync)) {
@@ -59,13 +106,30 @@ void MasterRenderer::add_imgui_options_section(WindowManager& window_manager) {
 
         ImGui::Checkbox("Enable FPS Cap", &render_settings.enable_fps_cap);
 
+        int animation_threads = (int) job_system.get_thread_limit();
+        if (ImGui::SliderInt("Animation Threads", &animation_threads, 1, (int) job_system.get_thread_count())) {
+            job_system.set_thread_limit((uint) animation_threads);
+        }
+
         if (ImGui::SliderFloat("FPS Cap", &render_settings.fps_cap, 24.0f, 240.0f)) {
             if (render_settings.fps_cap < 24.0f) {
                 render_settings.fps_cap = 24.0f;
             }
         }
+
+        // Green is fully resident, through yellow and orange to red as more of the largest mips are missing
+        if (ImGui::Checkbox("Colour By Resident Mip", &render_settings.mip_debug)) {
+            entity_renderer.set_mip_debug(render_settings.mip_debug);
+            animated_entity_renderer.set_mip_debug(render_settings.mip_debug);
+            emissive_entity_renderer.set_mip_debug(render_settings.mip_debug);
+        }
     }
 
+    texture_pool.add_imgui_options_section();
+    meshlet_culler.add_imgui_options_section();
+    lod_selector.add_imgui_options_section();
+    pose_evaluator.add_imgui_options_section();
+
     static int shader_mode = 0;
 
     if (ImGui::CollapsingHeader("Shader Options")) {
@@ -74,10 +138,7 @@ void MasterRenderer::add_imgui_options_section(WindowManager& window_manager) {
         if (ImGui::Button("Reload Shader Files")) {
             entity_renderer.swap_mode(shader_mode);
             last_time = glfwGetTime();
-            failures = 0;
-            failures += entity_renderer.refresh_shaders() ? 0 : 1;
-            failures += animated_entity_renderer.refresh_shaders() ? 0 : 1;
-            failures += emissive_entity_renderer.refresh_shaders() ? 0 : 1;
+            failures = refresh_shaders();
         }
         if (glfwGetTime() - 2.0 <= last_time) {
             ImGui::SameLine();
@@ -2,8 +2,11 @@
 #define MASTER_RENDERER_H
 
 #include "utility/SyncManager.h"
+#include "utility/JobSystem.h"
+#include "utility/PerformanceCounter.h"
 #include "EntityRenderer.h"
 #include "EmissiveEntityRenderer.h"
+#include "PoseEvaluator.h"
 #include "rendering/scene/MasterRenderScene.h"
 #include "system_interfaces/WindowManager.h"
 #include "scene/SceneInterface.h"
@@ -14,7 +17,19 @@ class MasterRenderer {
     EntityRenderer::EntityRenderer entity_renderer;
     AnimatedEntityRenderer::AnimatedEntityRenderer animated_entity_renderer;
     EmissiveEntityRenderer::EmissiveEntityRenderer emissive_entity_renderer;
+    // Entity textures are packed into shared arrays, so that drawing doesn't need to rebind between entities
+    TexturePool texture_pool;
+    // Static models are culled on the CPU, a meshlet at a time, before they are drawn
+    MeshletCuller meshlet_culler;
+    // Static models are drawn at the coarsest level of detail that still looks the same at their size on screen
+    LodSelector lod_selector;
+    // Animated entities are posed before any are drawn, with entities in identical poses sharing one
+    PoseEvaluator pose_evaluator;
+    // Animation is updated across every core, with the main thread working alongside the workers
+    JobSystem job_system;
     SyncManager sync_manager;
+    // Of the framebuffer, so renderers can estimate how large entities are on screen
+    float viewport_height = 1.0f;
 
     struct RenderSettings {
         bool show_wireframe = false;
@@ -23,17 +38,23 @@ class MasterRenderer {
         bool v_sync = false;
         bool enable_fps_cap = true;
         float fps_cap = 240.0f;
+        bool mip_debug = false;
     } render_settings;
 public:
     MasterRenderer();
 
     /// Prepare the master renderer for a new frame
     void update(const Window& window);
-    /// Render the provided MasterRenderScene with the provided SceneContext
+    /// Advance the animations of the provided MasterRenderScene, and pose its animated entities ready to render, timing each stage
+    void update_animation(MasterRenderScene& render_scene, const SceneContext& scene_context, PerformanceCounter& performance_counter);
+    /// Render the provided MasterRenderScene with the provided SceneContext, once its animation has been updated
     void render_scene(MasterRenderScene& render_scene, const SceneContext& scene_context);
     /// Synchronise the framerate if enabled.
     void sync();
 
+    /// Reload every renderer's shaders from disk, returning how many failed (in which case they keep their previous version)
+    int refresh_shaders();
+
     /// Adds a control for editing the RenderSettings
     void add_imgui_options_section(WindowManager& window_manager);
 };
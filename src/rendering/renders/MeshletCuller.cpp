@@ -0,0 +1,60 @@
+#include "MeshletCuller.h"
+
+#include <imgui/imgui.h>
+
+bool MeshletCuller::outside_frustum(const std::array<glm::vec4, 6>& planes, const glm::vec4& sphere, float scale) {
+    glm::vec4 centre{glm::vec3(sphere), 1.0f};
+    float radius = sphere.w * scale;
+    for (const auto& plane: planes) {
+        if (glm::dot(plane, centre) < -radius) return true;
+    }
+    return false;
+}
+
+void MeshletCuller::update() {
+    last_frame_stats = frame_stats;
+    frame_stats = {};
+}
+
+void MeshletCuller::set_camera(const glm::mat4& projection_view_matrix, const glm::vec3& set_camera_position) {
+    camera_position = set_camera_position;
+
+    // Gribb and Hartmann's method, each plane is the sum or difference of the last row of the matrix and another row
+    // See: https://www.gamedevs.org/uploads/fast-extraction-viewing-frustum-planes-from-world-view-projection-matrix.pdf
+    auto row = [&projection_view_matrix](int i) {
+        return glm::vec4{projection_view_matrix[0][i], projection_view_matrix[1][i], projection_view_matrix[2][i], projection_view_matrix[3][i]};
+    };
+    for (auto axis = 0; axis < 3; ++axis) {
+        frustum_planes[axis * 2] = row(3) + row(axis);
+        frustum_planes[axis * 2 + 1] = row(3) - row(axis);
+    }
+    for (auto& plane: frustum_planes) {
+        auto length = glm::length(glm::vec3(plane));
+        if (length > 0.0f) plane /= length;
+    }
+}
+
+void MeshletCuller::set_back_faces_culled(bool culled) {
+    back_faces_culled = culled;
+}
+
+const MeshletCuller::Stats& MeshletCuller::get_last_frame_stats() const {
+    return last_frame_stats;
+}
+
+void MeshletCuller::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Meshlet Culling")) {
+        ImGui::Checkbox("Cull On CPU", &enabled);
+        ImGui::Checkbox("Frustum Culling", &frustum_culling);
+        ImGui::Checkbox("Normal Cone Culling", &cone_culling);
+        if (!back_faces_culled) {
+            ImGui::TextDisabled("Normal cones only cull while back faces are culled");
+        }
+
+        const auto& stats = last_frame_stats;
+        ImGui::Text("Models last frame: %zu, %zu culled whole", stats.models, stats.models_culled);
+        ImGui::Text("Meshlets: %zu, %zu outside the frustum, %zu facing away", stats.meshlets, stats.frustum_culled, stats.cone_culled);
+        ImGui::Text("Triangles: %zu / %zu drawn (%.0f%%) in %zu draws", stats.triangles_drawn, stats.triangles,
+                    stats.triangles > 0 ? 100.0 * (double) stats.triangles_drawn / (double) stats.triangles : 100.0, stats.draws);
+    }
+}
@@ -0,0 +1,140 @@
+#ifndef MESHLET_CULLER_H
+#define MESHLET_CULLER_H
+
+#include <array>
+#include <cmath>
+#include <vector>
+#include <utility>
+#include <algorithm>
+
+#include <glm/glm.hpp>
+
+#include "rendering/resources/Meshlets.h"
+#include "rendering/resources/ModelHandle.h"
+#include "utility/HelperTypes.h"
+
+/// Culls static models, and the meshlets they are split into (see Meshlets), on the CPU before they are drawn,
+/// so that only the parts of a model in the view frustum, and not facing away from the camera, are submitted.
+///
+/// Each model's bounding sphere is tested against the frustum first, then each of its meshlets' bounding spheres and normal cones.
+/// The tests are done in model space, against the frustum planes and camera position transformed into it, so no meshlet data is transformed.
+/// The visible meshlets are merged into runs of consecutive indices, and drawn with one glMultiDrawElementsBaseVertex.
+/// Meshlets only cover a model's full detail triangles, so simplified levels of detail (see LodSelector) are only culled whole.
+class MeshletCuller : private NonCopyable {
+public:
+    struct Stats {
+        size_t models = 0;
+        size_t models_culled = 0;
+        size_t meshlets = 0;
+        size_t frustum_culled = 0;
+        size_t cone_culled = 0;
+        size_t triangles = 0;
+        size_t triangles_drawn = 0;
+        size_t draws = 0;
+    };
+
+private:
+    bool enabled = true;
+    bool frustum_culling = true;
+    bool cone_culling = true;
+    // Normal cones can only cull when back faces are culled, so this follows the MasterRenderer's setting
+    bool back_faces_culled = true;
+
+    // World space, normalised, so distances from them are in world units
+    std::array<glm::vec4, 6> frustum_planes{};
+    glm::vec3 camera_position{};
+
+    Stats frame_stats{};
+    Stats last_frame_stats{};
+
+    // Kept between draws so that culling doesn't allocate
+    std::vector<std::pair<uint, uint>> visible_ranges{};
+    MultiDraw multi_draw{};
+
+    /// True if the sphere (as (centre, radius), in model space) is entirely outside one of the planes (in model space), with the radius scaled by scale
+    static bool outside_frustum(const std::array<glm::vec4, 6>& planes, const glm::vec4& sphere, float scale);
+public:
+    MeshletCuller() = default;
+
+    /// Start a new frame, moving the stats gathered so far to get_last_frame_stats()
+    void update();
+
+    /// Set the camera that draws are culled against until it is next set, each renderer should call this before drawing
+    void set_camera(const glm::mat4& projection_view_matrix, const glm::vec3& camera_position);
+    void set_back_faces_culled(bool culled);
+
+    /// Draw the model at the given level of detail, with its VAO already bound, leaving out whatever can be culled
+    template<typename VertexData>
+    void draw(const ModelHandle<VertexData>& model, const glm::mat4& model_matrix, uint lod = 0);
+
+    [[nodiscard]] const Stats& get_last_frame_stats() const;
+
+    void add_imgui_options_section();
+};
+
+template<typename VertexData>
+void MeshletCuller::draw(const ModelHandle<VertexData>& model, const glm::mat4& model_matrix, uint lod) {
+    const auto* meshlets = lod == 0 ? model.get_meshlets().get() : nullptr;
+    frame_stats.models++;
+    frame_stats.triangles += (size_t) model.get_index_count(lod) / 3;
+    if (meshlets != nullptr) frame_stats.meshlets += meshlets->size();
+
+    if (!enabled) {
+        model.draw(lod);
+        frame_stats.triangles_drawn += (size_t) model.get_index_count(lod) / 3;
+        frame_stats.draws += model.get_sub_mesh_count();
+        return;
+    }
+
+    // A world space plane p becomes p * M in model space, keeping the same (world space) distances
+    std::array<glm::vec4, 6> model_planes{};
+    for (auto i = 0u; i < frustum_planes.size(); ++i) {
+        model_planes[i] = frustum_planes[i] * model_matrix;
+    }
+    float scale = std::max({glm::length(glm::vec3(model_matrix[0])), glm::length(glm::vec3(model_matrix[1])), glm::length(glm::vec3(model_matrix[2]))});
+
+    if (frustum_culling && outside_frustum(model_planes, model.get_bounding_sphere(), scale)) {
+        frame_stats.models_culled++;
+        if (meshlets != nullptr) frame_stats.frustum_culled += meshlets->size();
+        return;
+    }
+
+    if (meshlets == nullptr) {
+        model.draw(lod);
+        frame_stats.triangles_drawn += (size_t) model.get_index_count(lod) / 3;
+        frame_stats.draws += model.get_sub_mesh_count();
+        return;
+    }
+
+    // Mirroring transforms flip the winding, and so which side is the back, so the cones can't be used
+    bool test_cones = cone_culling && back_faces_culled && glm::determinant(glm::mat3(model_matrix)) > 0.0f;
+    glm::vec3 model_camera = glm::inverse(model_matrix) * glm::vec4(camera_position, 1.0f);
+
+    visible_ranges.clear();
+    for (const auto& meshlet: *meshlets) {
+        if (frustum_culling && outside_frustum(model_planes, meshlet.bounding_sphere, scale)) {
+            frame_stats.frustum_culled++;
+            continue;
+        }
+        if (test_cones && meshlet.cone_cutoff <= 1.0f) {
+            auto view = meshlet.cone_apex - model_camera;
+            auto distance = glm::length(view);
+            if (distance > 0.0f && glm::dot(view / distance, meshlet.cone_axis) >= meshlet.cone_cutoff) {
+                frame_stats.cone_culled++;
+                continue;
+            }
+        }
+
+        frame_stats.triangles_drawn += meshlet.index_count / 3;
+        if (!visible_ranges.empty() && visible_ranges.back().second == meshlet.first_index) {
+            visible_ranges.back().second += meshlet.index_count;
+        } else {
+            visible_ranges.emplace_back(meshlet.first_index, meshlet.first_index + meshlet.index_count);
+        }
+    }
+
+    model.draw(visible_ranges, multi_draw);
+    frame_stats.draws += multi_draw.counts.empty() ? 0 : 1;
+}
+
+#endif //MESHLET_CULLER_H
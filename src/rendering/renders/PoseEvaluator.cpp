@@ -0,0 +1,24 @@
+#include "PoseEvaluator.h"
+
+#include <algorithm>
+
+#include <imgui/imgui.h>
+
+const PoseEvaluator::Stats& PoseEvaluator::get_last_frame_stats() const {
+    return last_frame_stats;
+}
+
+void PoseEvaluator::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Animation Poses")) {
+        ImGui::Checkbox("Share Identical Poses", &share_poses);
+        if (share_poses) {
+            float time_step_ms = time_step * 1000.0f;
+            if (ImGui::SliderFloat("Time Step (ms)", &time_step_ms, 0.1f, 100.0f, "%.1f", ImGuiSliderFlags_Logarithmic)) {
+                time_step = std::max(time_step_ms, 0.1f) / 1000.0f;
+            }
+        }
+
+        const auto& stats = last_frame_stats;
+        ImGui::Text("Poses evaluated last frame: %zu for %zu entities", stats.poses_evaluated, stats.entities);
+    }
+}
@@ -0,0 +1,88 @@
+#ifndef POSE_EVALUATOR_H
+#define POSE_EVALUATOR_H
+
+#include <cmath>
+#include <memory>
+#include <tuple>
+#include <cstdint>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "rendering/resources/MeshHierarchy.h"
+#include "utility/HelperTypes.h"
+#include "utility/JobSystem.h"
+
+/// Evaluates the pose of each animated entity before they are drawn, into the entity's own Pose (see AnimatedRenderedEntity).
+///
+/// Entities with the same MeshHierarchy, playing the same animation at the same time (rounded to time_step) share a pose,
+/// which is only evaluated for the first of them, so a crowd of one character playing one animation costs one evaluation.
+/// The poses are found serially, then evaluated across the threads of a JobSystem, since each only writes to its own entity.
+class PoseEvaluator : private NonCopyable {
+public:
+    struct Stats {
+        size_t entities = 0;
+        size_t poses_evaluated = 0;
+    };
+
+private:
+    bool share_poses = true;
+    // In seconds, while sharing poses, animation times are rounded to a multiple of this, so entities only just apart still share one
+    float time_step = 1.0f / 240.0f;
+
+    // { (mesh_hierarchy, animation_id, time_step) } -> { the entity pose evaluated for it }
+    // Cleared each frame, but kept so that its buckets are reused
+    std::unordered_map<std::tuple<const void*, uint, int64_t>, const Pose*, TripleHash> frame_poses{};
+
+    Stats last_frame_stats{};
+public:
+    PoseEvaluator() = default;
+
+    /// Evaluate the pose of every entity, setting each entity's drawn_pose to its own pose, or the one it shares.
+    /// Shared poses belong to another of the entities, so are only valid until the entities next change.
+    template<typename Entity>
+    void evaluate(const std::unordered_set<std::shared_ptr<Entity>>& entities, JobSystem& job_system);
+
+    [[nodiscard]] const Stats& get_last_frame_stats() const;
+
+    void add_imgui_options_section();
+};
+
+template<typename Entity>
+void PoseEvaluator::evaluate(const std::unordered_set<std::shared_ptr<Entity>>& entities, JobSystem& job_system) {
+    Stats stats{};
+    frame_poses.clear();
+
+    // Every time is the same pose without an animation
+    auto time_step_of = [this](const Entity& entity) {
+        return entity.animation_id == NONE_ANIMATION ? 0 : (int64_t) std::llround(entity.animation_time_seconds / (double) time_step);
+    };
+
+    for (const auto& entity: entities) {
+        stats.entities++;
+        if (share_poses) {
+            auto [shared_pose, first] = frame_poses.try_emplace({entity->mesh_hierarchy.get(), entity->animation_id, time_step_of(*entity)}, &entity->pose);
+            entity->drawn_pose = shared_pose->second;
+        } else {
+            entity->drawn_pose = &entity->pose;
+        }
+        if (entity->drawn_pose == &entity->pose) stats.poses_evaluated++;
+    }
+
+    // Only the entities drawn with their own pose evaluate it, and they only write to themselves, so the set's buckets are split between the threads
+    auto rounded = share_poses;
+    job_system.parallel_for(entities.bucket_count(), 16, [this, &entities, &time_step_of, rounded](size_t begin, size_t end) {
+        for (auto bucket = begin; bucket < end; ++bucket) {
+            for (auto item = entities.begin(bucket); item != entities.end(bucket); ++item) {
+                auto& entity = **item;
+                if (entity.drawn_pose != &entity.pose) continue;
+
+                auto time_seconds = rounded ? (double) time_step_of(entity) * (double) time_step : entity.animation_time_seconds;
+                entity.mesh_hierarchy->calculate_animation(entity.animation_id, time_seconds, entity.animation_cursors, entity.pose);
+            }
+        }
+    });
+
+    last_frame_stats = stats;
+}
+
+#endif //POSE_EVALUATOR_H
@@ -17,6 +17,12 @@ void BaseEntityShader::get_uniforms_set_bindings() {
     // Global
     ws_view_position_location = get_uniform_location("ws_view_position");
     inverse_gamma_location = get_uniform_location("inverse_gamma");
+    // Vertex Decode
+    position_offset_location = get_uniform_location("position_offset");
+    position_scale_location = get_uniform_location("position_scale");
+    octahedral_normals_location = get_uniform_location("octahedral_normals");
+    // Debug
+    mip_debug_colour_location = get_uniform_location("mip_debug_colour");
 }
 
 void BaseEntityShader::set_instance_data(const BaseEntityInstanceData& instance_data) {
@@ -28,4 +34,28 @@ void BaseEntityShader::set_global_data(const BaseEntityGlobalData& global_data)
     glProgramUniformMatrix4fv(id(), projection_view_matrix_location, 1, GL_FALSE, &global_data.projection_view_matrix[0][0]);
     glProgramUniform3fv(id(), ws_view_position_location, 1, &global_data.camera_position[0]);
     glProgramUniform1f(id(), inverse_gamma_location, 1.0f / global_data.gamma);
-}
\ No newline at end of file
+}
+
+void BaseEntityShader::set_vertex_decode(const VertexDecode& vertex_decode) {
+    glProgramUniform3fv(id(), position_offset_location, 1, &vertex_decode.position_offset[0]);
+    glProgramUniform3fv(id(), position_scale_location, 1, &vertex_decode.position_scale[0]);
+    glProgramUniform1i(id(), octahedral_normals_location, vertex_decode.octahedral_normals);
+}
+
+void BaseEntityShader::set_texture_arrays(bool texture_arrays) {
+    set_frag_define("TEXTURE_ARRAYS", texture_arrays ? "1" : "0");
+}
+
+void BaseEntityShader::set_mip_debug(bool mip_debug) {
+    set_frag_define("MIP_DEBUG", mip_debug ? "1" : "0");
+}
+
+void BaseEntityShader::set_mip_debug_colour(const TextureHandle& texture) {
+    static const glm::vec3 colours[] = {{0.0f, 1.0f, 0.0f}, {1.0f, 1.0f, 0.0f}, {1.0f, 0.5f, 0.0f}, {1.0f, 0.0f, 0.0f}};
+    // The alpha is how much of the tint to mix in
+    glm::vec4 colour{0.0f};
+    if (texture.is_streamed()) {
+        colour = glm::vec4(colours[std::min(texture.get_resident_level(), 3u)], 0.5f);
+    }
+    glProgramUniform4fv(id(), mip_debug_colour_location, 1, &colour[0]);
+}
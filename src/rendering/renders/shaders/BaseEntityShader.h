@@ -3,6 +3,7 @@
 
 #include <utility>
 #include <vector>
+#include <algorithm>
 #include <unordered_set>
 
 #include "glm/glm.hpp"
@@ -14,6 +15,7 @@
 #include "rendering/scene/RenderedEntity.h"
 #include "rendering/resources/ModelLoader.h"
 #include "rendering/resources/TextureHandle.h"
+#include "rendering/resources/TexturePool.h"
 #include "rendering/memory/UniformBufferArray.h"
 
 struct BaseEntityInstanceData {
@@ -30,12 +32,29 @@ struct BaseEntityGlobalData : public GlobalDataCameraInterface {
     glm::mat4 projection_view_matrix{};
     glm::vec3 camera_position{};
     float gamma = 1.0f;
+    // Of the framebuffer, set by the MasterRenderer each frame
+    float viewport_height = 1.0f;
 
     void use_camera(const CameraInterface& camera_interface) override {
         projection_view_matrix = camera_interface.get_projection_matrix() * camera_interface.get_view_matrix();
         camera_position = camera_interface.get_position();
         gamma = camera_interface.get_gamma();
     }
+
+    /// Roughly how many pixels across a bounding sphere (as (centre, radius), in model space) is on screen, when drawn with the model matrix.
+    /// Assumes a perspective projection, and returns 0 if the sphere is entirely behind the camera.
+    [[nodiscard]] float projected_size(const glm::mat4& model_matrix, const glm::vec4& bounding_sphere) const {
+        glm::vec4 centre = model_matrix * glm::vec4(glm::vec3(bounding_sphere), 1.0f);
+        float scale = std::max({glm::length(glm::vec3(model_matrix[0])), glm::length(glm::vec3(model_matrix[1])), glm::length(glm::vec3(model_matrix[2]))});
+        float radius = bounding_sphere.w * scale;
+
+        // Clip space w is the depth in front of the camera, and since the view matrix only rotates, the length of the y row is the focal length
+        float depth = (projection_view_matrix * centre).w;
+        if (depth + radius <= 0.0f) return 0.0f;
+        float focal_length = glm::length(glm::vec3(projection_view_matrix[0][1], projection_view_matrix[1][1], projection_view_matrix[2][1]));
+        // Clamped, since the camera may be inside the sphere
+        return radius * focal_length * viewport_height / std::max(depth, 0.01f);
+    }
 };
 
 class BaseEntityShader : public ShaderInterface {
@@ -45,6 +64,12 @@ protected:
     // Global Data
     int ws_view_position_location{};
     int inverse_gamma_location{};
+    // Vertex Decode
+    int position_offset_location{};
+    int position_scale_location{};
+    int octahedral_normals_location{};
+    // Debug
+    int mip_debug_colour_location{};
 public:
     BaseEntityShader(std::string name, const std::string& vertex_path, const std::string& fragment_path,
                      std::unordered_map<std::string, std::string> vert_defines = {},
@@ -53,6 +78,18 @@ public:
     void set_instance_data(const BaseEntityInstanceData& instance_data);
 
     void set_global_data(const BaseEntityGlobalData& global_data);
+
+    /// Set how the vertices of the model about to be drawn are decoded, see VertexFormat.
+    void set_vertex_decode(const VertexDecode& vertex_decode);
+
+    /// Switch between sampling textures as layers of the TexturePool's arrays, or as individual textures, recompiling on a change.
+    void set_texture_arrays(bool texture_arrays);
+
+    /// Switch on tinting textures by how many of their mips are resident (see TextureLoader), recompiling on a change.
+    void set_mip_debug(bool mip_debug);
+    /// Set the tint for the texture about to be drawn: green when it is fully resident, through yellow and orange to red as more of its largest mips are missing.
+    /// Textures that aren't streamed are left untinted.
+    void set_mip_debug_colour(const TextureHandle& texture);
 protected:
     virtual void get_uniforms_set_bindings();
 };
@@ -20,6 +20,10 @@ void BaseLitEntityShader::get_uniforms_set_bindings() {
     ambient_tint_location = get_uniform_location("ambient_tint");
     shininess_location = get_uniform_location("shininess");
     texture_scale_location = get_uniform_location("texture_scale");
+    diffuse_texture_layer_location = get_uniform_location("diffuse_texture_layer");
+    diffuse_texture_rect_location = get_uniform_location("diffuse_texture_rect");
+    specular_map_texture_layer_location = get_uniform_location("specular_map_texture_layer");
+    specular_map_texture_rect_location = get_uniform_location("specular_map_texture_rect");
     // Texture sampler bindings
     set_binding("diffuse_texture", 0);
     set_binding("specular_map_texture", 1);
@@ -49,6 +53,13 @@ void BaseLitEntityShader::set_instance_data(const BaseLitEntityInstanceData& ins
     glProgramUniform2fv(id(), texture_scale_location, 1, &entity_material.texture_scale[0]);
 }
 
+void BaseLitEntityShader::set_texture_slots(const TexturePool::Slot& diffuse, const TexturePool::Slot& specular_map) {
+    glProgramUniform1f(id(), diffuse_texture_layer_location, diffuse.layer);
+    glProgramUniform4fv(id(), diffuse_texture_rect_location, 1, &diffuse.rect[0]);
+    glProgramUniform1f(id(), specular_map_texture_layer_location, specular_map.layer);
+    glProgramUniform4fv(id(), specular_map_texture_rect_location, 1, &specular_map.rect[0]);
+}
+
 void BaseLitEntityShader::set_point_lights(const std::vector<PointLight>& point_lights) {
     uint count = std::min(MAX_PL, (uint) point_lights.size());
 
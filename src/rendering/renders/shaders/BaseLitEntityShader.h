@@ -56,6 +56,11 @@ protected:
     int ambient_tint_location{};
     int shininess_location{};
     int texture_scale_location{};
+    // Where in the TexturePool each texture is, see common/textures.glsl
+    int diffuse_texture_layer_location{};
+    int diffuse_texture_rect_location{};
+    int specular_map_texture_layer_location{};
+    int specular_map_texture_rect_location{};
 
     uint POINT_LIGHT_BINDING = 0;
     uint DIRECTIONAL_LIGHT_BINDING = 1;
@@ -74,6 +79,9 @@ public:
 
     void set_directional_lights(const std::vector<DirectionalLight>& directional_lights);
 
+    /// Set where in their (already bound) textures the diffuse and specular map are sampled from
+    void set_texture_slots(const TexturePool::Slot& diffuse, const TexturePool::Slot& specular_map);
+
 protected:
     void get_uniforms_set_bindings() override; // Query uniform locations and potentially set UBO bindings
 };
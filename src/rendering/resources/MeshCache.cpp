@@ -0,0 +1,211 @@
+#include "MeshCache.h"
+
+#include <thread>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+void BinaryWriter::write_string(const std::string& string) {
+    write<uint32_t>((uint32_t) string.size());
+    buffer.insert(buffer.end(), string.begin(), string.end());
+}
+
+void BinaryWriter::align(size_t alignment) {
+    auto padding = (alignment - buffer.size() % alignment) % alignment;
+    buffer.insert(buffer.end(), padding, 0);
+}
+
+void BinaryWriter::write_file(const std::filesystem::path& path, const void* header, size_t header_size) const {
+    // Entries are keyed on content, so loads of identical files write the same path at the same time, and must not share a temporary file
+    static std::atomic<uint64_t> next_temp_id{0};
+    auto temp_path = path;
+    temp_path += Formatter() << "." << std::this_thread::get_id() << "-" << next_temp_id++ << ".tmp";
+    {
+        std::ofstream stream{temp_path, std::ios::binary | std::ios::trunc};
+        stream.write(reinterpret_cast<const char*>(header), (std::streamsize) header_size);
+        stream.write(buffer.data(), (std::streamsize) buffer.size());
+        if (!stream) {
+            std::error_code error;
+            std::filesystem::remove(temp_path, error);
+            throw std::runtime_error(Formatter() << "Failed to write (" << temp_path.string() << ")");
+        }
+    }
+
+    std::error_code error;
+    std::filesystem::rename(temp_path, path, error);
+    if (error) {
+        std::error_code remove_error;
+        std::filesystem::remove(temp_path, remove_error);
+        // Another writer got there first with the same contents, which a reader may already have mapped (so can't be replaced on Windows)
+        if (std::filesystem::exists(path, remove_error)) return;
+        throw std::runtime_error(Formatter() << "Failed to move (" << temp_path.string() << ") into place: " << error.message());
+    }
+}
+
+void BinaryReader::require(size_t bytes) const {
+    if (bytes > size - offset) {
+        throw std::runtime_error(Formatter() << "Unexpected end of data, needed " << bytes << " bytes at offset " << offset << " of " << size);
+    }
+}
+
+std::string BinaryReader::read_string() {
+    auto length = read<uint32_t>();
+    require(length);
+    std::string string{reinterpret_cast<const char*>(data + offset), length};
+    offset += length;
+    return string;
+}
+
+void BinaryReader::align(size_t alignment) {
+    auto padding = (alignment - offset % alignment) % alignment;
+    require(padding);
+    offset += padding;
+}
+
+MeshCache::MeshCache(std::filesystem::path cache_path) : cache_path(std::move(cache_path)) {}
+
+void MeshCache::clear() const {
+    std::error_code error;
+    std::filesystem::remove_all(cache_path, error);
+    if (error) {
+        std::cerr << "Failed to clear mesh cache (" << cache_path.string() << "): " << error.message() << std::endl;
+    }
+}
+
+std::filesystem::path MeshCache::entry_path(uint64_t content_hash, Kind kind, uint64_t type_hash) const {
+    // The type hash allows the same model to be cached for multiple vertex formats
+    std::stringstream name{};
+    name << std::hex << std::setw(16) << std::setfill('0') << content_hash
+         << "-" << std::hex << std::setw(16) << std::setfill('0') << type_hash
+         << (kind == Kind::Model ? ".mesh" : ".hier");
+    return cache_path / name.str();
+}
+
+std::optional<std::pair<MappedFile, size_t>> MeshCache::open_entry(const std::string& file, uint64_t content_hash, Kind kind, uint64_t type_hash, uint32_t vertex_size) const {
+    if (!enabled) return std::nullopt;
+
+    auto path = entry_path(content_hash, kind, type_hash);
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) return std::nullopt;
+
+    try {
+        MappedFile mapped_file{path.string()};
+        BinaryReader reader{mapped_file.data(), mapped_file.size()};
+        auto header = reader.read<Header>();
+
+        bool valid = std::memcmp(header.magic, "C3MC", sizeof(header.magic)) == 0
+                     && header.version == FORMAT_VERSION
+                     && header.kind == (uint32_t) kind
+                     && header.vertex_size == vertex_size
+                     && header.vertex_type_hash == type_hash
+                     && header.content_hash == content_hash
+                     && header.processing_flags == processing_flags.load();
+        if (!valid) return std::nullopt;
+
+        return std::pair<MappedFile, size_t>{std::move(mapped_file), sizeof(Header)};
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to read mesh cache entry for (" << file << "): " << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
+
+void MeshCache::write_entry(const std::string& file, uint64_t content_hash, Kind kind, uint64_t type_hash, uint32_t vertex_size, const BinaryWriter& body) const {
+    if (!enabled) return;
+
+    try {
+        Header header{
+            {'C', '3', 'M', 'C'},
+            FORMAT_VERSION,
+            (uint32_t) kind,
+            vertex_size,
+            type_hash,
+            content_hash,
+            processing_flags.load(),
+            0,
+        };
+        static_assert(sizeof(Header) % BinaryWriter::ARRAY_ALIGNMENT == 0, "Header must keep the body aligned");
+
+        std::filesystem::create_directories(cache_path);
+        body.write_file(entry_path(content_hash, kind, type_hash), &header, sizeof(Header));
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to write mesh cache entry for (" << file << "): " << e.what() << std::endl;
+    }
+}
+
+void MeshCache::write_bones(BinaryWriter& writer, const std::vector<std::tuple<uint, uint, glm::mat4>>& bones) {
+    writer.write<uint32_t>((uint32_t) bones.size());
+    for (const auto& [mesh_index, bone_id, offset_matrix]: bones) {
+        writer.write<uint>(mesh_index);
+        writer.write<uint>(bone_id);
+        writer.write<glm::mat4>(offset_matrix);
+    }
+}
+
+std::vector<std::tuple<uint, uint, glm::mat4>> MeshCache::read_bones(BinaryReader& reader) {
+    std::vector<std::tuple<uint, uint, glm::mat4>> bones{};
+    auto count = reader.read<uint32_t>();
+    for (auto i = 0u; i < count; ++i) {
+        auto mesh_index = reader.read<uint>();
+        auto bone_id = reader.read<uint>();
+        auto offset_matrix = reader.read<glm::mat4>();
+        bones.emplace_back(mesh_index, bone_id, offset_matrix);
+    }
+    return bones;
+}
+
+template<typename T>
+static void write_keys(BinaryWriter& writer, const KeyframeTrack<T>& keys) {
+    writer.write_vector(keys.times);
+    writer.write_vector(keys.values);
+}
+
+template<typename T>
+static void read_keys(BinaryReader& reader, KeyframeTrack<T>& keys) {
+    keys.times = reader.read_vector<double>();
+    keys.values = reader.read_vector<T>();
+    if (keys.times.size() != keys.values.size()) {
+        throw std::runtime_error(Formatter() << "Mismatched key counts: " << keys.times.size() << " times, " << keys.values.size() << " values");
+    }
+}
+
+void MeshCache::write_node(BinaryWriter& writer, const MeshHierarchyNode& node) {
+    writer.write_vector(node.meshes);
+    writer.write<glm::mat4>(node.transformation);
+    write_bones(writer, node.bones);
+
+    writer.write<uint32_t>((uint32_t) node.animation_data.size());
+    for (const auto& [animation_id, animation_data]: node.animation_data) {
+        writer.write<int>(animation_id);
+        write_keys(writer, animation_data.positions);
+        write_keys(writer, animation_data.rotations);
+        write_keys(writer, animation_data.scalings);
+    }
+
+    writer.write<uint32_t>((uint32_t) node.children.size());
+    for (const auto& child: node.children) {
+        write_node(writer, child);
+    }
+}
+
+void MeshCache::read_node(BinaryReader& reader, MeshHierarchyNode& node) {
+    node.meshes = reader.read_vector<uint>();
+    node.transformation = reader.read<glm::mat4>();
+    node.bones = read_bones(reader);
+
+    auto animation_count = reader.read<uint32_t>();
+    for (auto i = 0u; i < animation_count; ++i) {
+        auto& animation_data = node.animation_data[reader.read<int>()];
+        read_keys(reader, animation_data.positions);
+        read_keys(reader, animation_data.rotations);
+        read_keys(reader, animation_data.scalings);
+    }
+
+    auto child_count = reader.read<uint32_t>();
+    if (child_count > reader.remaining()) {
+        throw std::runtime_error(Formatter() << "Invalid child count: " << child_count);
+    }
+    node.children.resize(child_count);
+    for (auto& child: node.children) {
+        read_node(reader, child);
+    }
+}
@@ -0,0 +1,340 @@
+#ifndef MESH_CACHE_H
+#define MESH_CACHE_H
+
+#include <atomic>
+#include <string>
+#include <vector>
+#include <memory>
+#include <cstring>
+#include <cstdint>
+#include <optional>
+#include <iostream>
+#include <tuple>
+#include <unordered_map>
+#include <typeinfo>
+#include <filesystem>
+#include <type_traits>
+
+#include "utility/Hash.h"
+#include "utility/MappedFile.h"
+#include "utility/HelperTypes.h"
+#include "ModelHandle.h"
+#include "MeshHierarchy.h"
+
+/// A helper for building up a binary blob, used to write the mesh cache files.
+/// Arrays are aligned so that they can be used in place once the file is memory-mapped.
+class BinaryWriter {
+    std::vector<char> buffer{};
+public:
+    static constexpr size_t ARRAY_ALIGNMENT = 16;
+
+    template<typename T>
+    void write(const T& value);
+
+    void write_string(const std::string& string);
+
+    /// Writes the count, then pads to ARRAY_ALIGNMENT, then the raw array data
+    template<typename T>
+    void write_array(const T* data, size_t count);
+
+    template<typename T>
+    void write_vector(const std::vector<T>& vector) { write_array(vector.data(), vector.size()); }
+
+    void align(size_t alignment);
+
+    [[nodiscard]] const std::vector<char>& data() const { return buffer; }
+
+    /// Write header_size bytes of header, then the data, to a temporary file unique to this write, and rename it into place,
+    /// so that a partially written file is never read, even with several writers of the same path at once.
+    /// If the rename fails because another writer already put the file in place (and it is held open), that counts as success.
+    void write_file(const std::filesystem::path& path, const void* header, size_t header_size) const;
+};
+
+/// The reading counterpart to BinaryWriter, over a (typically memory-mapped) block of memory.
+/// Throws if a read would go past the end of the data, so truncated or corrupt files are detected.
+class BinaryReader {
+    const std::byte* data;
+    size_t size;
+    size_t offset = 0;
+
+    void require(size_t bytes) const;
+public:
+    BinaryReader(const std::byte* data, size_t size, size_t offset = 0) : data(data), size(size), offset(offset) {}
+
+    template<typename T>
+    T read();
+
+    std::string read_string();
+
+    /// Returns a pointer directly into the underlying data, so no copy is made
+    template<typename T>
+    std::pair<const T*, size_t> read_array();
+
+    template<typename T>
+    std::vector<T> read_vector();
+
+    void align(size_t alignment);
+
+    [[nodiscard]] size_t remaining() const { return size - offset; }
+};
+
+/// A model loaded from the mesh cache, the vertex and index pointers point directly into the memory-mapped file.
+template<typename VertexData>
+struct CachedModel {
+    MappedFile file;
+    const VertexData* vertices = nullptr;
+    size_t vertex_count = 0;
+    const uint* indices = nullptr;
+    size_t index_count = 0;
+    // Empty if the model wasn't split into meshlets
+    const Meshlets::Meshlet* meshlets = nullptr;
+    size_t meshlet_count = 0;
+    // Empty if no simplified levels of detail were generated
+    const MeshSimplifier::Lod* lods = nullptr;
+    size_t lod_count = 0;
+};
+
+/// A versioned on-disk cache of fully processed models, so that warm loads can skip Assimp completely.
+///
+/// Each entry is keyed on the hash of the source file's contents (see ContentHashes) and the VertexData type,
+/// so an entry is only used if the source is unchanged, and files with the same contents share entries.
+/// The final interleaved vertex and index arrays are stored in a layout that can be memory-mapped and uploaded straight to the GPU.
+class MeshCache {
+    std::filesystem::path cache_path;
+    // Atomic since these are read by loads running on worker threads
+    std::atomic<bool> enabled = true;
+    // Flags for any optional processing applied to the meshes, entries written with different flags are ignored
+    std::atomic<uint64_t> processing_flags = 0;
+
+public:
+    /// Bump this whenever the layout of the cache files, or how the data in them is produced, changes.
+    static constexpr uint32_t FORMAT_VERSION = 5;
+
+    enum class Kind : uint32_t {
+        Model = 0,
+        Hierarchy = 1,
+    };
+
+    explicit MeshCache(std::filesystem::path cache_path);
+
+    /// Try to read a flat model from the cache, returns nullopt if there is no valid entry. The file is only used to name the model and report errors.
+    template<typename VertexData>
+    std::optional<CachedModel<VertexData>> read_model(const std::string& file, uint64_t content_hash) const;
+
+    /// Write a flat model (and the meshlets and levels of detail its indices are split into, if any) to the cache,
+    /// failures are reported but otherwise ignored since the cache is only an optimisation.
+    template<typename VertexData>
+    void write_model(const std::string& file, uint64_t content_hash, const std::vector<VertexData>& vertices, const std::vector<uint>& indices,
+                     const std::vector<Meshlets::Meshlet>& meshlets, const std::vector<MeshSimplifier::Lod>& lods) const;
+
+    /// Try to read a mesh hierarchy from the cache, returns nullptr if there is no valid entry.
+    /// `upload(vertices, vertex_count, indices, index_count)` is called for each mesh, and should return a ModelHandle.
+    template<typename VertexData, typename Upload>
+    std::shared_ptr<MeshHierarchy<VertexData>> read_hierarchy(const std::string& file, uint64_t content_hash, Upload&& upload) const;
+
+    /// Write a mesh hierarchy to the cache, mesh_data holds the CPU side (vertices, indices) for each of mesh_hierarchy.meshes
+    template<typename VertexData>
+    void write_hierarchy(const std::string& file, uint64_t content_hash, const MeshHierarchy<VertexData>& mesh_hierarchy,
+                         const std::vector<std::pair<std::vector<VertexData>, std::vector<uint>>>& mesh_data) const;
+
+    /// Delete every entry in the cache
+    void clear() const;
+
+    [[nodiscard]] bool is_enabled() const { return enabled; }
+    void set_enabled(bool set_enabled) { enabled = set_enabled; }
+
+    [[nodiscard]] uint64_t get_processing_flags() const { return processing_flags; }
+    void set_processing_flags(uint64_t flags) { processing_flags = flags; }
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t kind;
+        uint32_t vertex_size;
+        uint64_t vertex_type_hash;
+        uint64_t content_hash;
+        uint64_t processing_flags;
+        uint64_t reserved;
+    };
+
+    template<typename VertexData>
+    static uint64_t vertex_type_hash();
+
+    [[nodiscard]] std::filesystem::path entry_path(uint64_t content_hash, Kind kind, uint64_t type_hash) const;
+
+    /// Map and validate an entry, returning the mapping and a reader positioned just after the header
+    [[nodiscard]] std::optional<std::pair<MappedFile, size_t>> open_entry(const std::string& file, uint64_t content_hash, Kind kind, uint64_t type_hash, uint32_t vertex_size) const;
+    void write_entry(const std::string& file, uint64_t content_hash, Kind kind, uint64_t type_hash, uint32_t vertex_size, const BinaryWriter& body) const;
+
+    static void write_bones(BinaryWriter& writer, const std::vector<std::tuple<uint, uint, glm::mat4>>& bones);
+    static std::vector<std::tuple<uint, uint, glm::mat4>> read_bones(BinaryReader& reader);
+    static void write_node(BinaryWriter& writer, const MeshHierarchyNode& node);
+    static void read_node(BinaryReader& reader, MeshHierarchyNode& node);
+};
+
+template<typename T>
+void BinaryWriter::write(const T& value) {
+    static_assert(std::is_trivially_copyable_v<T>, "BinaryWriter can only write trivially copyable types");
+    const auto* bytes = reinterpret_cast<const char*>(&value);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T));
+}
+
+template<typename T>
+void BinaryWriter::write_array(const T* data, size_t count) {
+    static_assert(std::is_trivially_copyable_v<T>, "BinaryWriter can only write trivially copyable types");
+    write<uint64_t>(count);
+    align(ARRAY_ALIGNMENT);
+    const auto* bytes = reinterpret_cast<const char*>(data);
+    buffer.insert(buffer.end(), bytes, bytes + sizeof(T) * count);
+}
+
+template<typename T>
+T BinaryReader::read() {
+    static_assert(std::is_trivially_copyable_v<T>, "BinaryReader can only read trivially copyable types");
+    require(sizeof(T));
+    T value;
+    std::memcpy(&value, data + offset, sizeof(T));
+    offset += sizeof(T);
+    return value;
+}
+
+template<typename T>
+std::pair<const T*, size_t> BinaryReader::read_array() {
+    static_assert(std::is_trivially_copyable_v<T>, "BinaryReader can only read trivially copyable types");
+    auto count = (size_t) read<uint64_t>();
+    align(BinaryWriter::ARRAY_ALIGNMENT);
+    if (count > (size - offset) / sizeof(T)) {
+        throw std::runtime_error("Unexpected end of data while reading array");
+    }
+    const auto* array = reinterpret_cast<const T*>(data + offset);
+    offset += sizeof(T) * count;
+    return {array, count};
+}
+
+template<typename T>
+std::vector<T> BinaryReader::read_vector() {
+    auto [array, count] = read_array<T>();
+    return std::vector<T>{array, array + count};
+}
+
+template<typename VertexData>
+uint64_t MeshCache::vertex_type_hash() {
+    // The mangled name is stable for a given compiler, which is all that is needed since the cache is local to the machine
+    return Hash::fnv1a(typeid(VertexData).name());
+}
+
+template<typename VertexData>
+std::optional<CachedModel<VertexData>> MeshCache::read_model(const std::string& file, uint64_t content_hash) const {
+    auto entry = open_entry(file, content_hash, Kind::Model, vertex_type_hash<VertexData>(), sizeof(VertexData));
+    if (!entry.has_value()) return std::nullopt;
+
+    try {
+        CachedModel<VertexData> cached_model{std::move(entry->first)};
+        BinaryReader reader{cached_model.file.data(), cached_model.file.size(), entry->second};
+        std::tie(cached_model.vertices, cached_model.vertex_count) = reader.read_array<VertexData>();
+        std::tie(cached_model.indices, cached_model.index_count) = reader.read_array<uint>();
+        std::tie(cached_model.meshlets, cached_model.meshlet_count) = reader.read_array<Meshlets::Meshlet>();
+        std::tie(cached_model.lods, cached_model.lod_count) = reader.read_array<MeshSimplifier::Lod>();
+        return cached_model;
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring corrupt mesh cache entry for (" << file << "): " << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
+
+template<typename VertexData>
+void MeshCache::write_model(const std::string& file, uint64_t content_hash, const std::vector<VertexData>& vertices, const std::vector<uint>& indices,
+                            const std::vector<Meshlets::Meshlet>& meshlets, const std::vector<MeshSimplifier::Lod>& lods) const {
+    BinaryWriter body{};
+    body.write_vector(vertices);
+    body.write_vector(indices);
+    body.write_vector(meshlets);
+    body.write_vector(lods);
+    write_entry(file, content_hash, Kind::Model, vertex_type_hash<VertexData>(), sizeof(VertexData), body);
+}
+
+template<typename VertexData, typename Upload>
+std::shared_ptr<MeshHierarchy<VertexData>> MeshCache::read_hierarchy(const std::string& file, uint64_t content_hash, Upload&& upload) const {
+    auto entry = open_entry(file, content_hash, Kind::Hierarchy, vertex_type_hash<VertexData>(), sizeof(VertexData));
+    if (!entry.has_value()) return nullptr;
+
+    try {
+        const auto& mapped_file = entry->first;
+        BinaryReader reader{mapped_file.data(), mapped_file.size(), entry->second};
+
+        auto mesh_hierarchy = std::make_shared<MeshHierarchy<VertexData>>(file);
+
+        auto mesh_count = reader.read<uint32_t>();
+        for (auto mesh_i = 0u; mesh_i < mesh_count; ++mesh_i) {
+            std::unordered_map<std::string, uint> bone_names{};
+            auto bone_count = reader.read<uint32_t>();
+            for (auto bone_i = 0u; bone_i < bone_count; ++bone_i) {
+                auto name = reader.read_string();
+                bone_names[name] = reader.read<uint>();
+            }
+            auto [vertices, vertex_count] = reader.read_array<VertexData>();
+            auto [indices, index_count] = reader.read_array<uint>();
+            mesh_hierarchy->meshes.emplace_back(upload(vertices, vertex_count, indices, index_count), bone_names);
+        }
+
+        auto total_bone_count = reader.read<uint32_t>();
+        for (auto i = 0u; i < total_bone_count; ++i) {
+            auto name = reader.read_string();
+            mesh_hierarchy->total_bones[name] = read_bones(reader);
+        }
+
+        auto animation_count = reader.read<uint32_t>();
+        for (auto i = 0u; i < animation_count; ++i) {
+            auto name = reader.read_string();
+            auto ticks_per_second = reader.read<double>();
+            auto duration_ticks = reader.read<double>();
+            mesh_hierarchy->animations.emplace_back(name, ticks_per_second, duration_ticks);
+        }
+
+        read_node(reader, mesh_hierarchy->root_node);
+        mesh_hierarchy->flatten();
+
+        return mesh_hierarchy;
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring corrupt mesh cache entry for (" << file << "): " << e.what() << std::endl;
+        return nullptr;
+    }
+}
+
+template<typename VertexData>
+void MeshCache::write_hierarchy(const std::string& file, uint64_t content_hash, const MeshHierarchy<VertexData>& mesh_hierarchy,
+                                const std::vector<std::pair<std::vector<VertexData>, std::vector<uint>>>& mesh_data) const {
+    BinaryWriter body{};
+
+    body.write<uint32_t>((uint32_t) mesh_hierarchy.meshes.size());
+    for (auto mesh_i = 0u; mesh_i < mesh_hierarchy.meshes.size(); ++mesh_i) {
+        const auto& bones = mesh_hierarchy.meshes[mesh_i].bones;
+        body.write<uint32_t>((uint32_t) bones.size());
+        for (const auto& [name, bone_id]: bones) {
+            body.write_string(name);
+            body.write<uint>(bone_id);
+        }
+        body.write_vector(mesh_data[mesh_i].first);
+        body.write_vector(mesh_data[mesh_i].second);
+    }
+
+    body.write<uint32_t>((uint32_t) mesh_hierarchy.total_bones.size());
+    for (const auto& [name, bones]: mesh_hierarchy.total_bones) {
+        body.write_string(name);
+        write_bones(body, bones);
+    }
+
+    body.write<uint32_t>((uint32_t) mesh_hierarchy.animations.size());
+    for (const auto& [name, ticks_per_second, duration_ticks]: mesh_hierarchy.animations) {
+        body.write_string(name);
+        body.write<double>(ticks_per_second);
+        body.write<double>(duration_ticks);
+    }
+
+    write_node(body, mesh_hierarchy.root_node);
+
+    write_entry(file, content_hash, Kind::Hierarchy, vertex_type_hash<VertexData>(), sizeof(VertexData), body);
+}
+
+#endif //MESH_CACHE_H
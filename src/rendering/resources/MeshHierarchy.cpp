@@ -1,50 +1,142 @@
 #include "MeshHierarchy.h"
 
+#include <map>
+#include <cmath>
+#include <chrono>
+#include <random>
+#include <climits>
+#include <cstring>
+#include <iostream>
+
+static glm::vec3 mix_vec3(const glm::vec3& a, const glm::vec3& b, float t) {
+    return glm::mix(a, b, t);
+}
+
+static glm::quat slerp_quat(const glm::quat& a, const glm::quat& b, float t) {
+    return glm::slerp(a, b, t);
+}
+
+glm::mat4 AnimationData::sample(double time, Cursor& cursor) const {
+    auto position = positions.sample(time, cursor.position, glm::vec3{0.0f}, mix_vec3);
+    auto rotation = rotations.sample(time, cursor.rotation, glm::quat{1.0f, 0.0f, 0.0f, 0.0f}, slerp_quat);
+    auto scaling = scalings.sample(time, cursor.scaling, glm::vec3{1.0f}, mix_vec3);
+
+    return glm::translate(position) * glm::toMat4(rotation) * glm::scale(scaling);
+}
+
 glm::mat4 AnimationData::sample(double time) const {
-    glm::vec3 position{0.0f};
-    if (!positions.empty()) {
-        auto next_key = positions.lower_bound(time);
-        if (next_key == positions.end()) {
-            position = positions.rbegin()->second;
-        } else if (next_key->first == time || next_key == positions.begin()) {
-            position = next_key->second;
-        } else {
+    // Past the end of every track, so each search is a binary search
+    Cursor cursor{UINT_MAX, UINT_MAX, UINT_MAX};
+    return sample(time, cursor);
+}
+
+namespace {
+    /// How AnimationData stored and sampled its keys before KeyframeTrack, kept to compare against
+    struct MapAnimationData {
+        std::map<double, glm::vec3> positions{};
+        std::map<double, glm::quat> rotations{};
+        std::map<double, glm::vec3> scalings{};
+
+        template<typename T, typename Mix>
+        static T sample_keys(const std::map<double, T>& keys, double time, const T& default_value, Mix&& mix) {
+            if (keys.empty()) return default_value;
+
+            auto next_key = keys.lower_bound(time);
+            if (next_key == keys.end()) return keys.rbegin()->second;
+            if (next_key->first == time || next_key == keys.begin()) return next_key->second;
+
             auto next = *next_key;
             auto prev = *(--next_key);
+            return mix(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+        }
 
-            position = glm::mix(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+        [[nodiscard]] glm::mat4 sample(double time) const {
+            auto position = sample_keys(positions, time, glm::vec3{0.0f}, mix_vec3);
+            auto rotation = sample_keys(rotations, time, glm::quat{1.0f, 0.0f, 0.0f, 0.0f}, slerp_quat);
+            auto scaling = sample_keys(scalings, time, glm::vec3{1.0f}, mix_vec3);
+            return glm::translate(position) * glm::toMat4(rotation) * glm::scale(scaling);
         }
-    }
+    };
+}
 
-    glm::quat rotation{1.0f, 0.0f, 0.0f, 0.0f};
-    if (!rotations.empty()) {
-        auto next_key = rotations.lower_bound(time);
-        if (next_key == rotations.end()) {
-            rotation = rotations.rbegin()->second;
-        } else if (next_key->first == time || next_key == rotations.begin()) {
-            rotation = next_key->second;
-        } else {
-            auto next = *next_key;
-            auto prev = *(--next_key);
+AnimationSampling::BenchmarkResult AnimationSampling::run_benchmark(uint channel_count, uint keys_per_track, uint frames) {
+    BenchmarkResult result{};
+    result.channels = channel_count;
+    result.keys_per_track = keys_per_track;
+    result.frames = frames;
 
-            rotation = glm::slerp(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+    // Keys one tick apart, with some jitter, so the tracks don't all line up
+    std::mt19937 random{42};
+    std::uniform_real_distribution<float> value(-1.0f, 1.0f);
+    std::uniform_real_distribution<double> jitter(0.0, 0.5);
+
+    std::vector<MapAnimationData> map_channels(channel_count);
+    std::vector<AnimationData> track_channels(channel_count);
+    for (auto channel = 0u; channel < channel_count; ++channel) {
+        for (auto key = 0u; key < keys_per_track; ++key) {
+            auto time = (double) key + (key == 0 ? 0.0 : jitter(random));
+            glm::vec3 position{value(random), value(random), value(random)};
+            auto rotation = glm::normalize(glm::quat{value(random), value(random), value(random), value(random)});
+            glm::vec3 scaling{1.0f + value(random) * 0.1f};
+
+            map_channels[channel].positions[time] = position;
+            map_channels[channel].rotations[time] = rotation;
+            map_channels[channel].scalings[time] = scaling;
+            track_channels[channel].positions.add_key(time, position);
+            track_channels[channel].rotations.add_key(time, rotation);
+            track_channels[channel].scalings.add_key(time, scaling);
         }
     }
 
-    glm::vec3 scaling{1.0f};
-    if (!scalings.empty()) {
-        auto next_key = scalings.lower_bound(time);
-        if (next_key == scalings.end()) {
-            scaling = scalings.rbegin()->second;
-        } else if (next_key->first == time || next_key == scalings.begin()) {
-            scaling = next_key->second;
-        } else {
-            auto next = *next_key;
-            auto prev = *(--next_key);
+    // Playing at 60 frames per second, with 30 ticks per second, looping over the keys
+    auto duration = (double) keys_per_track;
+    auto frame_time = [duration](uint frame) { return std::fmod((double) frame * 0.5, duration); };
 
-            scaling = glm::mix(prev.second, next.second, (float) ((time - prev.first) / (next.first - prev.first)));
+    // Each method writes a frame's samples over the last, so only the final frame is compared
+    std::vector<glm::mat4> map_samples(channel_count);
+    std::vector<glm::mat4> search_samples(channel_count);
+    std::vector<glm::mat4> cursor_samples(channel_count);
+
+    auto time_ms = [](auto&& fn) {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    result.map_ms = time_ms([&]() {
+        for (auto frame = 0u; frame < frames; ++frame) {
+            auto time = frame_time(frame);
+            for (auto channel = 0u; channel < channel_count; ++channel) {
+                map_samples[channel] = map_channels[channel].sample(time);
+            }
         }
-    }
+    });
 
-    return glm::translate(position) * glm::toMat4(rotation) * glm::scale(scaling);
-}
\ No newline at end of file
+    result.search_ms = time_ms([&]() {
+        for (auto frame = 0u; frame < frames; ++frame) {
+            auto time = frame_time(frame);
+            for (auto channel = 0u; channel < channel_count; ++channel) {
+                search_samples[channel] = track_channels[channel].sample(time);
+            }
+        }
+    });
+
+    std::vector<AnimationData::Cursor> cursors(channel_count);
+    result.cursor_ms = time_ms([&]() {
+        for (auto frame = 0u; frame < frames; ++frame) {
+            auto time = frame_time(frame);
+            for (auto channel = 0u; channel < channel_count; ++channel) {
+                cursor_samples[channel] = track_channels[channel].sample(time, cursors[channel]);
+            }
+        }
+    });
+
+    auto bytes = channel_count * sizeof(glm::mat4);
+    result.identical = std::memcmp(map_samples.data(), search_samples.data(), bytes) == 0
+                       && std::memcmp(map_samples.data(), cursor_samples.data(), bytes) == 0;
+
+    std::cout << "Sampled " << channel_count << " channels of " << keys_per_track << " keys for " << frames << " frames: std::map " << result.map_ms
+              << " ms, binary search " << result.search_ms << " ms, cursors " << result.cursor_ms << " ms ("
+              << (result.identical ? "identical" : "different") << " poses)" << std::endl;
+    return result;
+}
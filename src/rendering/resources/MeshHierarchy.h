@@ -2,8 +2,9 @@
 #define MESH_HIERARCHY_H
 
 #include <vector>
-#include <map>
+#include <climits>
 #include <memory>
+#include <algorithm>
 #include <functional>
 #include <unordered_map>
 
@@ -15,14 +16,118 @@
 
 #define NONE_ANIMATION UINT_MAX
 
+/// The keyframes of one animated property, as parallel arrays of times (in ticks, ascending) and values, so sampling walks contiguous memory
+template<typename T>
+struct KeyframeTrack {
+    std::vector<double> times{};
+    std::vector<T> values{};
+
+    /// Add a key, replacing any at the same time. Keys are expected in time order, which appends them, but are sorted in otherwise.
+    void add_key(double time, const T& value);
+
+    /// The index of the last key at or before time (or 0 if time is before every key), the track must not be empty.
+    /// The search starts from cursor (the key found by the previous call), so playing forwards is amortised O(1),
+    /// and only seeks (including looping back to the start) need a binary search. Cursor is set to the result.
+    [[nodiscard]] uint find_key(double time, uint& cursor) const;
+
+    /// The value at time, interpolated with mix between the keys either side, or default_value if the track is empty
+    template<typename Mix>
+    [[nodiscard]] T sample(double time, uint& cursor, const T& default_value, Mix&& mix) const;
+};
+
 struct AnimationData {
-    std::map<double, glm::vec3> positions{};
-    std::map<double, glm::quat> rotations{};
-    std::map<double, glm::vec3> scalings{};
+    KeyframeTrack<glm::vec3> positions{};
+    KeyframeTrack<glm::quat> rotations{};
+    KeyframeTrack<glm::vec3> scalings{};
 
+    /// Where each track's keys were last found, kept per entity, since each plays from its own time
+    struct Cursor {
+        uint position = 0;
+        uint rotation = 0;
+        uint scaling = 0;
+    };
+
+    /// Sample the transformation at time (in ticks), continuing each track's search from where cursor left it
+    [[nodiscard]] glm::mat4 sample(double time, Cursor& cursor) const;
+    /// Sample the transformation at time (in ticks), with a binary search of each track
     [[nodiscard]] glm::mat4 sample(double time) const;
 };
 
+/// Timing sampling keyframes stored in std::maps (as AnimationData used to), against KeyframeTracks with and without cursors
+namespace AnimationSampling {
+    struct BenchmarkResult {
+        uint channels = 0;
+        uint keys_per_track = 0;
+        uint frames = 0;
+        double map_ms = 0.0;
+        double search_ms = 0.0;
+        double cursor_ms = 0.0;
+        bool identical = false;
+    };
+
+    /// Generate channel_count looping channels, with keys_per_track keys in each of their tracks,
+    /// then sample every channel at frames successive times, as entities playing them forwards would
+    BenchmarkResult run_benchmark(uint channel_count = 10000, uint keys_per_track = 60, uint frames = 240);
+}
+
+template<typename T>
+void KeyframeTrack<T>::add_key(double time, const T& value) {
+    if (times.empty() || times.back() < time) {
+        times.push_back(time);
+        values.push_back(value);
+        return;
+    }
+
+    auto position = std::lower_bound(times.begin(), times.end(), time);
+    auto index = position - times.begin();
+    if (*position == time) {
+        values[index] = value;
+    } else {
+        times.insert(position, time);
+        values.insert(values.begin() + index, value);
+    }
+}
+
+template<typename T>
+uint KeyframeTrack<T>::find_key(double time, uint& cursor) const {
+    // Most frames move on by less than a key, so a few steps forward are tried before searching
+    constexpr uint MAX_STEPS = 4;
+
+    auto last = (uint) times.size() - 1;
+    auto key = std::min(cursor, last);
+    auto search = [this, time](size_t first, size_t end) {
+        auto next = std::upper_bound(times.begin() + (long) first, times.begin() + (long) end, time);
+        return next == times.begin() ? 0u : (uint) (next - times.begin()) - 1;
+    };
+
+    if (times[key] > time) {
+        key = search(0, key);
+    } else {
+        uint steps = 0;
+        while (key < last && times[key + 1] <= time) {
+            if (++steps > MAX_STEPS) {
+                key = search(key, times.size());
+                break;
+            }
+            ++key;
+        }
+    }
+
+    cursor = key;
+    return key;
+}
+
+template<typename T>
+template<typename Mix>
+T KeyframeTrack<T>::sample(double time, uint& cursor, const T& default_value, Mix&& mix) const {
+    if (times.empty()) return default_value;
+
+    auto key = find_key(time, cursor);
+    // Clamped to the first and last keys, like the animation's own start and end
+    if (key + 1 >= times.size() || times[key] >= time) return values[key];
+    return mix(values[key], values[key + 1], (float) ((time - times[key]) / (times[key + 1] - times[key])));
+}
+
 struct MeshHierarchyNode {
     std::vector<uint> meshes{};
     glm::mat4 transformation{1.0f};
@@ -33,25 +138,86 @@ struct MeshHierarchyNode {
     std::vector<MeshHierarchyNode> children{};
 };
 
+/// A MeshHierarchy's node tree flattened into arrays in parent first order (see MeshHierarchy::flatten()),
+/// so that a pose is evaluated by a single loop over the nodes, with each node's parent already evaluated before it.
+struct FlatHierarchy {
+    static constexpr uint NO_PARENT = UINT_MAX;
+    static constexpr uint NO_CHANNEL = UINT_MAX;
+
+    struct BoneBinding {
+        uint node;
+        // Into Pose::bone_palette
+        uint palette_index;
+        glm::mat4 offset_matrix;
+    };
+
+    struct MeshBinding {
+        uint node;
+        uint mesh;
+        // The mesh's bones are Pose::bone_palette[first_bone, first_bone + bone_count)
+        uint first_bone;
+        uint bone_count;
+        // The node's transformation relative to the root, meshes are placed by their bind pose, and only animate through their bones
+        glm::mat4 transformation;
+    };
+
+    // [node] -> parent node, always an earlier one, or NO_PARENT for the root (node 0)
+    std::vector<uint> parents{};
+    // [node] -> transformation relative to the parent while the animation doesn't move the node,
+    // which is the identity for nodes above the skeleton (no bones at or above them), so they don't move the bones
+    std::vector<glm::mat4> rest_transformations{};
+    // In node order, so they are set as the loop reaches their node
+    std::vector<BoneBinding> bones{};
+    // In node order, the order meshes are drawn in
+    std::vector<MeshBinding> meshes{};
+    // [animation_id * node_count() + node] -> index into channels, or NO_CHANNEL if the animation doesn't move the node
+    std::vector<uint> animation_channels{};
+    // [channel] -> keyframes, still owned by the node tree. Each entity keeps a Cursor per channel.
+    std::vector<const AnimationData*> channels{};
+    // The bones of every mesh, one after the other
+    uint bone_count = 0;
+
+    [[nodiscard]] uint node_count() const {
+        return (uint) parents.size();
+    }
+};
+
+/// The result of animating a MeshHierarchy at some time, kept by each entity (see AnimatedRenderedEntity) so the hierarchy itself is never written to,
+/// and sized on first use, so evaluating it again doesn't allocate
+struct Pose {
+    // [node] -> the node's transformation relative to the root
+    std::vector<glm::mat4> node_transforms{};
+    // [bone] -> the transformation of each bone of each mesh, see FlatHierarchy::MeshBinding for which are whose
+    std::vector<glm::mat4> bone_palette{};
+};
+
 template<typename VertexData>
 struct ModelInfo {
     std::shared_ptr<ModelHandle<VertexData>> model{};
     // { bone_name } -> { bone_id }
     std::unordered_map<std::string, uint> bones{};
-    // Computed based on an input time
-    std::vector<glm::mat4> bone_transforms{};
 
-    ModelInfo(const std::shared_ptr<ModelHandle<VertexData>>& model, const std::unordered_map<std::string, uint>& bones) : model(model), bones(bones) {
-        bone_transforms.resize(bones.size(), glm::mat4{1.0f});
-    }
+    ModelInfo(const std::shared_ptr<ModelHandle<VertexData>>& model, const std::unordered_map<std::string, uint>& bones) : model(model), bones(bones) {}
 };
 
 class BaseMeshHierarchy : private NonCopyable {
 public:
+    /// Call fn with the model of each mesh in the hierarchy
+    virtual void visit_models(const std::function<void(const BaseModelHandle& model)>& fn) const = 0;
+
+    /// The GPU memory used by all the meshes in the hierarchy
+    [[nodiscard]] size_t get_gpu_bytes() const {
+        size_t bytes = 0;
+        visit_models([&bytes](const BaseModelHandle& model) { bytes += model.get_gpu_bytes(); });
+        return bytes;
+    }
+
     virtual ~BaseMeshHierarchy() = default;
 };
 
 /// A struct representing a hierarchy of meshes, for use in animation.
+/// The node tree is how the hierarchy is loaded and cached, animating and drawing it uses the flattened copy of it in flat.
+/// Once loaded the hierarchy doesn't change, so it can be shared between any number of entities, each animating it into their own Pose.
 template<typename VertexData>
 struct MeshHierarchy : public BaseMeshHierarchy {
     std::vector<ModelInfo<VertexData>> meshes{};
@@ -62,65 +228,123 @@ struct MeshHierarchy : public BaseMeshHierarchy {
     // The name of the file the MeshHierarchy was loaded from, if any
     std::optional<std::string> filename{};
     MeshHierarchyNode root_node{};
+    FlatHierarchy flat{};
 
     explicit MeshHierarchy(const std::optional<std::string>& filename = std::nullopt) : filename(filename) {}
 
-    /// Set the transformation field of each node to the correct state for the given time
-    void calculate_animation(uint animation_id, double time_seconds);
-    /// Recursively iterator over node tree
-    void visit_nodes(std::function<void(const MeshHierarchyNode& node, glm::mat4 accumulated_transformation)> fn);
+    /// Build flat from the node tree, once the hierarchy (including its meshes and animations) is fully loaded.
+    /// The tree must not change afterwards, since flat refers to its AnimationData.
+    void flatten();
+    /// Set pose to the hierarchy's pose at the given time, resizing it to fit if needed.
+    /// Cursors (see AnimationData::Cursor) are kept by the caller between calls, and are resized to one per channel if needed.
+    void calculate_animation(uint animation_id, double time_seconds, std::vector<AnimationData::Cursor>& cursors, Pose& pose) const;
+
+    void visit_models(const std::function<void(const BaseModelHandle& model)>& fn) const override;
 };
 
+
 template<typename VertexData>
-void MeshHierarchy<VertexData>::calculate_animation(uint animation_id, double time_seconds) {
-    if (animation_id == NONE_ANIMATION) {
-        for (auto& mesh: meshes) {
-            std::fill(mesh.bone_transforms.begin(), mesh.bone_transforms.end(), glm::mat4{1.0f});
-        }
-        return;
-    }
+void MeshHierarchy<VertexData>::flatten() {
+    flat = {};
 
-    if (animation_id >= animations.size()) {
-        throw std::runtime_error(Formatter() << "Invalid animation id: " << animation_id);
+    struct PendingNode {
+        const MeshHierarchyNode* node;
+        uint parent;
+        bool in_skeleton;
+        glm::mat4 parent_transformation;
+    };
+    // Depth first, so every node comes after its parent
+    std::vector<PendingNode> pending{{&root_node, FlatHierarchy::NO_PARENT, false, glm::mat4{1.0f}}};
+    std::vector<const MeshHierarchyNode*> nodes{};
+
+    // [mesh] -> its first bone in the palette
+    std::vector<uint> first_bones{};
+    for (const auto& mesh: meshes) {
+        first_bones.push_back(flat.bone_count);
+        flat.bone_count += (uint) mesh.bones.size();
     }
 
-    std::function<void(const MeshHierarchyNode& node, glm::mat4 accumulated_transformation, bool is_skeleton)> animate;
-    double time_ticks = time_seconds * std::get<1>(animations[animation_id]);
+    while (!pending.empty()) {
+        auto [node, parent, in_skeleton, parent_transformation] = pending.back();
+        pending.pop_back();
 
-    animate = [&animate, this, animation_id, time_ticks](const MeshHierarchyNode& node, glm::mat4 accumulated_transformation, bool is_skeleton) {
-        is_skeleton |= !node.bones.empty();
-        glm::mat4 transform = is_skeleton ? node.transformation : glm::mat4{1.0f};
-        const auto animation = node.animation_data.find(animation_id);
-        if (animation != node.animation_data.end()) {
-            transform = animation->second.sample(time_ticks);
-        }
-        accumulated_transformation = accumulated_transformation * transform;
+        auto index = (uint) nodes.size();
+        nodes.push_back(node);
+        in_skeleton |= !node->bones.empty();
+        auto transformation = parent_transformation * node->transformation;
 
-        for (const auto& [mesh_id, bone_id, offset_matrix]: node.bones) {
-            meshes[mesh_id].bone_transforms[bone_id] = accumulated_transformation * offset_matrix;
+        flat.parents.push_back(parent);
+        flat.rest_transformations.push_back(in_skeleton ? node->transformation : glm::mat4{1.0f});
+        for (const auto& [mesh_id, bone_id, offset_matrix]: node->bones) {
+            if (mesh_id < meshes.size() && bone_id < meshes[mesh_id].bones.size()) {
+                flat.bones.push_back({index, first_bones[mesh_id] + bone_id, offset_matrix});
+            }
+        }
+        for (auto mesh_id: node->meshes) {
+            flat.meshes.push_back({index, mesh_id, first_bones[mesh_id], (uint) meshes[mesh_id].bones.size(), transformation});
         }
 
-        for (const auto& child: node.children) {
-            animate(child, accumulated_transformation, is_skeleton);
+        for (auto child = node->children.rbegin(); child != node->children.rend(); ++child) {
+            pending.push_back({&*child, index, in_skeleton, transformation});
         }
-    };
+    }
 
-    animate(root_node, glm::mat4{1.0f}, false);
+    auto node_count = flat.node_count();
+    flat.animation_channels.assign(animations.size() * node_count, FlatHierarchy::NO_CHANNEL);
+    for (auto node = 0u; node < node_count; ++node) {
+        for (const auto& [animation_id, animation_data]: nodes[node]->animation_data) {
+            if (animation_id < 0 || (size_t) animation_id >= animations.size()) continue;
+            flat.animation_channels[(size_t) animation_id * node_count + node] = (uint) flat.channels.size();
+            flat.channels.push_back(&animation_data);
+        }
+    }
 }
 
 template<typename VertexData>
-void MeshHierarchy<VertexData>::visit_nodes(std::function<void(const MeshHierarchyNode&, glm::mat4)> fn) {
-    std::function<void(const MeshHierarchyNode& node, glm::mat4 accumulated_transformation)> visit;
-
-    visit = [&visit, &fn](const MeshHierarchyNode& node, glm::mat4 accumulated_transformation) {
-        accumulated_transformation = accumulated_transformation * node.transformation;
-        fn(node, accumulated_transformation);
-        for (const auto& child: node.children) {
-            visit(child, accumulated_transformation);
+void MeshHierarchy<VertexData>::calculate_animation(uint animation_id, double time_seconds, std::vector<AnimationData::Cursor>& cursors, Pose& pose) const {
+    if (animation_id != NONE_ANIMATION && animation_id >= animations.size()) {
+        throw std::runtime_error(Formatter() << "Invalid animation id: " << animation_id);
+    }
+
+    if (cursors.size() != flat.channels.size()) {
+        cursors.resize(flat.channels.size());
+    }
+
+    auto node_count = flat.node_count();
+    if (pose.node_transforms.size() != node_count || pose.bone_palette.size() != flat.bone_count) {
+        pose.node_transforms.resize(node_count);
+        // Bones without a node in the hierarchy are never set, so stay as modelled
+        pose.bone_palette.assign(flat.bone_count, glm::mat4{1.0f});
+    }
+
+    const uint* channels = animation_id == NONE_ANIMATION ? nullptr : flat.animation_channels.data() + (size_t) animation_id * node_count;
+    double time_ticks = animation_id == NONE_ANIMATION ? 0.0 : time_seconds * std::get<1>(animations[animation_id]);
+
+    auto bone = flat.bones.begin();
+    for (auto node = 0u; node < node_count; ++node) {
+        auto channel = channels != nullptr ? channels[node] : FlatHierarchy::NO_CHANNEL;
+        auto parent = flat.parents[node];
+
+        if (channel == FlatHierarchy::NO_CHANNEL) {
+            pose.node_transforms[node] = parent == FlatHierarchy::NO_PARENT ? flat.rest_transformations[node] : pose.node_transforms[parent] * flat.rest_transformations[node];
+        } else {
+            auto transform = flat.channels[channel]->sample(time_ticks, cursors[channel]);
+            pose.node_transforms[node] = parent == FlatHierarchy::NO_PARENT ? transform : pose.node_transforms[parent] * transform;
         }
-    };
 
-    visit(root_node, glm::mat4{1.0f});
+        for (; bone != flat.bones.end() && bone->node == node; ++bone) {
+            // Without an animation, meshes are drawn as modelled
+            pose.bone_palette[bone->palette_index] = channels != nullptr ? pose.node_transforms[node] * bone->offset_matrix : glm::mat4{1.0f};
+        }
+    }
+}
+
+template<typename VertexData>
+void MeshHierarchy<VertexData>::visit_models(const std::function<void(const BaseModelHandle& model)>& fn) const {
+    for (const auto& mesh: meshes) {
+        // Null until the hierarchy has been uploaded
+        if (mesh.model != nullptr) fn(*mesh.model);
+    }
 }
 
 #endif //MESH_HIERARCHY_H
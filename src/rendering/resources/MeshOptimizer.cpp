@@ -0,0 +1,200 @@
+#include "MeshOptimizer.h"
+
+#include <algorithm>
+
+MeshOptimizer::CacheStatistics MeshOptimizer::analyse_vertex_cache(const std::vector<uint>& indices, size_t vertex_count, uint cache_size) {
+    // The time each vertex last entered the cache, it is still in the cache if that was within cache_size misses ago
+    std::vector<size_t> entered(vertex_count, 0);
+    std::vector<bool> referenced(vertex_count, false);
+    size_t misses = 0;
+    size_t unique_vertices = 0;
+
+    for (auto index: indices) {
+        if (!referenced[index]) {
+            referenced[index] = true;
+            unique_vertices++;
+        }
+        if (entered[index] == 0 || misses + 1 - entered[index] >= cache_size + 1) {
+            misses++;
+            entered[index] = misses;
+        }
+    }
+
+    auto triangles = indices.size() / 3;
+    return {
+        triangles == 0 ? 0.0f : (float) misses / (float) triangles,
+        unique_vertices == 0 ? 0.0f : (float) misses / (float) unique_vertices,
+    };
+}
+
+std::vector<uint> MeshOptimizer::optimise_vertex_cache(std::vector<uint>& indices, size_t vertex_count, uint cache_size) {
+    auto triangle_count = indices.size() / 3;
+    std::vector<uint> clusters{};
+    if (triangle_count == 0) return clusters;
+
+    // Build the vertex -> triangle adjacency, in compressed form
+    std::vector<uint> live_triangles(vertex_count, 0);
+    for (auto index: indices) {
+        live_triangles[index]++;
+    }
+    std::vector<uint> adjacency_offsets(vertex_count + 1, 0);
+    std::partial_sum(live_triangles.begin(), live_triangles.end(), adjacency_offsets.begin() + 1);
+    std::vector<uint> adjacency(indices.size());
+    {
+        auto fill = adjacency_offsets;
+        for (auto i = 0u; i < indices.size(); ++i) {
+            adjacency[fill[indices[i]]++] = i / 3;
+        }
+    }
+
+    std::vector<size_t> cache_time(vertex_count, 0);
+    std::vector<bool> emitted(triangle_count, false);
+    std::vector<uint> dead_end_stack{};
+    std::vector<uint> candidates{};
+    std::vector<uint> output{};
+    output.reserve(indices.size());
+
+    size_t time = cache_size + 1;
+    size_t cursor = 0;
+
+    // Find the next vertex to fan around once the candidates are exhausted, which is where the cache is effectively flushed
+    auto skip_dead_end = [&]() -> long {
+        while (!dead_end_stack.empty()) {
+            auto vertex = dead_end_stack.back();
+            dead_end_stack.pop_back();
+            if (live_triangles[vertex] > 0) return vertex;
+        }
+        while (cursor < vertex_count) {
+            if (live_triangles[cursor] > 0) return (long) cursor;
+            cursor++;
+        }
+        return -1;
+    };
+
+    long fanning_vertex = skip_dead_end();
+    clusters.push_back(0);
+    while (fanning_vertex >= 0) {
+        candidates.clear();
+
+        for (auto i = adjacency_offsets[fanning_vertex]; i < adjacency_offsets[fanning_vertex + 1]; ++i) {
+            auto triangle = adjacency[i];
+            if (emitted[triangle]) continue;
+
+            for (auto corner = 0; corner < 3; ++corner) {
+                auto vertex = indices[triangle * 3 + corner];
+                output.push_back(vertex);
+                dead_end_stack.push_back(vertex);
+                candidates.push_back(vertex);
+                live_triangles[vertex]--;
+                if (time - cache_time[vertex] > cache_size) {
+                    cache_time[vertex] = time;
+                    time++;
+                }
+            }
+            emitted[triangle] = true;
+        }
+
+        // Pick the candidate that will still be in the cache, and that has the most to gain from it
+        long next_vertex = -1;
+        long best_priority = -1;
+        for (auto vertex: candidates) {
+            if (live_triangles[vertex] == 0) continue;
+            long priority = 0;
+            if (time - cache_time[vertex] + 2 * live_triangles[vertex] <= cache_size) {
+                priority = (long) (time - cache_time[vertex]);
+            }
+            if (priority > best_priority) {
+                best_priority = priority;
+                next_vertex = vertex;
+            }
+        }
+
+        if (next_vertex == -1) {
+            next_vertex = skip_dead_end();
+            if (next_vertex >= 0 && output.size() / 3 != clusters.back()) {
+                clusters.push_back((uint) output.size() / 3);
+            }
+        }
+        fanning_vertex = next_vertex;
+    }
+
+    indices = std::move(output);
+    return clusters;
+}
+
+void MeshOptimizer::optimise_overdraw(std::vector<uint>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint>& clusters,
+                                      size_t vertex_count, float threshold) {
+    auto triangle_count = (uint) (indices.size() / 3);
+    if (clusters.size() < 2) return;
+
+    glm::vec3 mesh_centroid{0.0f};
+    for (const auto& position: positions) {
+        mesh_centroid += position;
+    }
+    mesh_centroid /= (float) std::max(positions.size(), (size_t) 1);
+
+    // [cluster] -> (sort_key, cluster_index)
+    std::vector<std::pair<float, uint>> sort_keys{};
+    sort_keys.reserve(clusters.size());
+    for (auto cluster_i = 0u; cluster_i < clusters.size(); ++cluster_i) {
+        auto begin = clusters[cluster_i];
+        auto end = cluster_i + 1 < clusters.size() ? clusters[cluster_i + 1] : triangle_count;
+
+        glm::vec3 centroid{0.0f};
+        glm::vec3 normal{0.0f};
+        float area = 0.0f;
+        for (auto triangle = begin; triangle < end; ++triangle) {
+            const auto& a = positions[indices[triangle * 3 + 0]];
+            const auto& b = positions[indices[triangle * 3 + 1]];
+            const auto& c = positions[indices[triangle * 3 + 2]];
+            // Area weighted, so tiny triangles don't skew the cluster
+            auto cross = glm::cross(b - a, c - a);
+            auto triangle_area = glm::length(cross);
+            centroid += (a + b + c) * (triangle_area / 3.0f);
+            normal += cross;
+            area += triangle_area;
+        }
+        if (area > 0.0f) centroid /= area;
+        auto normal_length = glm::length(normal);
+        if (normal_length > 0.0f) normal /= normal_length;
+
+        sort_keys.emplace_back(glm::dot(centroid - mesh_centroid, normal), cluster_i);
+    }
+
+    std::stable_sort(sort_keys.begin(), sort_keys.end(), [](const auto& a, const auto& b) { return a.first > b.first; });
+
+    std::vector<uint> reordered{};
+    reordered.reserve(indices.size());
+    for (const auto& [key, cluster_i]: sort_keys) {
+        auto begin = clusters[cluster_i];
+        auto end = cluster_i + 1 < clusters.size() ? clusters[cluster_i + 1] : triangle_count;
+        reordered.insert(reordered.end(), indices.begin() + begin * 3, indices.begin() + end * 3);
+    }
+
+    auto acmr_before = analyse_vertex_cache(indices, vertex_count).acmr;
+    auto acmr_after = analyse_vertex_cache(reordered, vertex_count).acmr;
+    if (acmr_after <= acmr_before * threshold) {
+        indices = std::move(reordered);
+    }
+}
+
+std::pair<std::vector<uint>, uint> MeshOptimizer::weld_positions(const std::vector<glm::vec3>& positions) {
+    std::vector<uint> position_ids(positions.size());
+    uint position_count = 0;
+
+    // { position bits } -> [(position, position id)]
+    std::unordered_map<uint64_t, std::vector<std::pair<glm::vec3, uint>>> lookup{};
+    lookup.reserve(positions.size());
+    for (auto vertex = 0u; vertex < positions.size(); ++vertex) {
+        const auto& position = positions[vertex];
+        auto& bucket = lookup[Hash::fnv1a(&position, sizeof(glm::vec3))];
+        auto existing = std::find_if(bucket.begin(), bucket.end(), [&position](const auto& entry) { return std::memcmp(&entry.first, &position, sizeof(glm::vec3)) == 0; });
+        if (existing != bucket.end()) {
+            position_ids[vertex] = existing->second;
+        } else {
+            bucket.emplace_back(position, position_count);
+            position_ids[vertex] = position_count++;
+        }
+    }
+    return {std::move(position_ids), position_count};
+}
@@ -0,0 +1,156 @@
+#ifndef MESH_OPTIMIZER_H
+#define MESH_OPTIMIZER_H
+
+#include <chrono>
+#include <vector>
+#include <climits>
+#include <cstring>
+#include <numeric>
+#include <utility>
+#include <unordered_map>
+#include <type_traits>
+
+#include <glm/glm.hpp>
+
+#include "utility/Hash.h"
+#include "utility/HelperTypes.h"
+
+/// Index and vertex buffer optimisations, run on models before they are uploaded, so that the GPU does less work drawing them.
+/// See: "Fast Triangle Reordering for Vertex Locality and Reduced Overdraw" (Sander, Nehab and Barczak, 2007)
+/// and: https://tomforsyth1000.github.io/papers/fast_vert_cache_opt.html
+namespace MeshOptimizer {
+    /// The number of entries in the simulated FIFO post-transform cache, used for both optimising and measuring
+    constexpr uint CACHE_SIZE = 16;
+    /// How much worse (as a ratio) the ACMR is allowed to get, to gain a better draw order for overdraw
+    constexpr float OVERDRAW_THRESHOLD = 1.05f;
+
+    struct CacheStatistics {
+        // Average Cache Miss Ratio, vertex shader invocations per triangle (0.5 is the best possible, 3 the worst)
+        float acmr = 0.0f;
+        // Average Transformed Vertex Ratio, vertex shader invocations per vertex (1 is the best possible)
+        float atvr = 0.0f;
+    };
+
+    struct Report {
+        uint vertices_before = 0;
+        uint vertices_after = 0;
+        uint triangles = 0;
+        CacheStatistics before{};
+        CacheStatistics after{};
+        double optimise_ms = 0.0;
+    };
+
+    /// Simulate a FIFO post-transform cache over the index buffer
+    CacheStatistics analyse_vertex_cache(const std::vector<uint>& indices, size_t vertex_count, uint cache_size = CACHE_SIZE);
+
+    /// Reorder the triangles for post-transform cache locality (Tipsify), returns the start triangle of each cluster,
+    /// where a cluster is split wherever the cache had to be flushed, so they can be reordered freely with little ACMR cost.
+    std::vector<uint> optimise_vertex_cache(std::vector<uint>& indices, size_t vertex_count, uint cache_size = CACHE_SIZE);
+
+    /// Reorder the clusters so that those on the outside of the mesh, and facing away from its center, are drawn first.
+    /// This reduces overdraw from most view directions. The reordering is undone if it would make the ACMR worse than threshold allows.
+    void optimise_overdraw(std::vector<uint>& indices, const std::vector<glm::vec3>& positions, const std::vector<uint>& clusters,
+                           size_t vertex_count, float threshold = OVERDRAW_THRESHOLD);
+
+    /// Give each vertex the id of its position, so that vertices split only by their normals or texture coordinates share one.
+    /// Returns [vertex] -> position id, and the number of distinct positions, with ids numbered in order of first appearance.
+    std::pair<std::vector<uint>, uint> weld_positions(const std::vector<glm::vec3>& positions);
+
+    /// Merge vertices that are bitwise identical, updating the indices to match
+    template<typename VertexData>
+    void weld_vertices(std::vector<VertexData>& vertices, std::vector<uint>& indices);
+
+    /// Reorder the vertices into the order they are first referenced by the indices, so vertex fetches are more sequential.
+    /// Any vertices which are never referenced are removed.
+    template<typename VertexData>
+    void optimise_vertex_fetch(std::vector<VertexData>& vertices, std::vector<uint>& indices);
+
+    /// Run every optimisation, in order, reporting the before and after statistics.
+    template<typename VertexData>
+    Report optimise(std::vector<VertexData>& vertices, std::vector<uint>& indices);
+}
+
+template<typename VertexData>
+void MeshOptimizer::weld_vertices(std::vector<VertexData>& vertices, std::vector<uint>& indices) {
+    static_assert(std::is_trivially_copyable_v<VertexData>, "Vertices are compared bitwise, so must be trivially copyable");
+
+    std::vector<uint> remap(vertices.size());
+    std::vector<VertexData> welded{};
+    welded.reserve(vertices.size());
+    // { hash of vertex bytes } -> [index into welded]
+    std::unordered_multimap<uint64_t, uint> lookup{};
+    lookup.reserve(vertices.size());
+
+    for (auto i = 0u; i < vertices.size(); ++i) {
+        const auto& vertex = vertices[i];
+        auto hash = Hash::fnv1a(&vertex, sizeof(VertexData));
+
+        bool found = false;
+        auto [begin, end] = lookup.equal_range(hash);
+        for (auto iter = begin; iter != end; ++iter) {
+            if (std::memcmp(&welded[iter->second], &vertex, sizeof(VertexData)) == 0) {
+                remap[i] = iter->second;
+                found = true;
+                break;
+            }
+        }
+
+        if (!found) {
+            remap[i] = (uint) welded.size();
+            lookup.emplace(hash, remap[i]);
+            welded.push_back(vertex);
+        }
+    }
+
+    for (auto& index: indices) {
+        index = remap[index];
+    }
+    vertices = std::move(welded);
+}
+
+template<typename VertexData>
+void MeshOptimizer::optimise_vertex_fetch(std::vector<VertexData>& vertices, std::vector<uint>& indices) {
+    constexpr uint UNASSIGNED = UINT_MAX;
+
+    std::vector<uint> remap(vertices.size(), UNASSIGNED);
+    std::vector<VertexData> reordered{};
+    reordered.reserve(vertices.size());
+
+    for (auto& index: indices) {
+        if (remap[index] == UNASSIGNED) {
+            remap[index] = (uint) reordered.size();
+            reordered.push_back(vertices[index]);
+        }
+        index = remap[index];
+    }
+    vertices = std::move(reordered);
+}
+
+template<typename VertexData>
+MeshOptimizer::Report MeshOptimizer::optimise(std::vector<VertexData>& vertices, std::vector<uint>& indices) {
+    auto start = std::chrono::steady_clock::now();
+
+    Report report{};
+    report.vertices_before = (uint) vertices.size();
+    report.triangles = (uint) indices.size() / 3;
+    report.before = analyse_vertex_cache(indices, vertices.size());
+
+    weld_vertices(vertices, indices);
+    auto clusters = optimise_vertex_cache(indices, vertices.size());
+
+    std::vector<glm::vec3> positions{};
+    positions.reserve(vertices.size());
+    for (const auto& vertex: vertices) {
+        positions.push_back(vertex.position);
+    }
+    optimise_overdraw(indices, positions, clusters, vertices.size());
+
+    optimise_vertex_fetch(vertices, indices);
+
+    report.vertices_after = (uint) vertices.size();
+    report.after = analyse_vertex_cache(indices, vertices.size());
+    report.optimise_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    return report;
+}
+
+#endif //MESH_OPTIMIZER_H
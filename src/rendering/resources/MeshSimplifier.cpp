@@ -0,0 +1,319 @@
+#include "MeshSimplifier.h"
+
+#include <array>
+#include <cmath>
+#include <tuple>
+#include <limits>
+#include <climits>
+#include <cstdint>
+#include <numeric>
+#include <algorithm>
+#include <unordered_map>
+#include <unordered_set>
+
+#include "MeshOptimizer.h"
+
+namespace {
+    /// The sum of squared distances from a point to a set of planes, each weighted by the area of its triangle, as a symmetric 4x4 matrix
+    struct Quadric {
+        double a00 = 0.0, a01 = 0.0, a02 = 0.0, a03 = 0.0;
+        double a11 = 0.0, a12 = 0.0, a13 = 0.0;
+        double a22 = 0.0, a23 = 0.0;
+        double a33 = 0.0;
+        double weight = 0.0;
+
+        /// Add the plane dot(normal, p) + d = 0, where normal is normalised
+        void add_plane(const glm::vec3& normal, float d, double plane_weight) {
+            double x = normal.x, y = normal.y, z = normal.z, w = d;
+            a00 += plane_weight * x * x; a01 += plane_weight * x * y; a02 += plane_weight * x * z; a03 += plane_weight * x * w;
+            a11 += plane_weight * y * y; a12 += plane_weight * y * z; a13 += plane_weight * y * w;
+            a22 += plane_weight * z * z; a23 += plane_weight * z * w;
+            a33 += plane_weight * w * w;
+            weight += plane_weight;
+        }
+
+        Quadric& operator+=(const Quadric& other) {
+            a00 += other.a00; a01 += other.a01; a02 += other.a02; a03 += other.a03;
+            a11 += other.a11; a12 += other.a12; a13 += other.a13;
+            a22 += other.a22; a23 += other.a23;
+            a33 += other.a33;
+            weight += other.weight;
+            return *this;
+        }
+
+        /// The area weighted average of the squared distances from point to the planes
+        [[nodiscard]] double error(const glm::vec3& point) const {
+            if (weight <= 0.0) return 0.0;
+            double x = point.x, y = point.y, z = point.z;
+            auto sum = a00 * x * x + 2.0 * a01 * x * y + 2.0 * a02 * x * z + 2.0 * a03 * x
+                       + a11 * y * y + 2.0 * a12 * y * z + 2.0 * a13 * y
+                       + a22 * z * z + 2.0 * a23 * z
+                       + a33;
+            return std::max(sum, 0.0) / weight;
+        }
+    };
+
+    enum class PositionKind : uint8_t {
+        // Every triangle around the position uses the same vertex, so it can collapse onto any neighbour
+        Manifold,
+        // Two vertices share the position, on either side of a texture or normal seam, so they can only collapse together, along the seam
+        Seam,
+        // On the border of the mesh, or the corner of a seam, so it never moves
+        Locked,
+    };
+
+    struct Collapse {
+        uint from;
+        uint to;
+        double cost;
+    };
+
+    uint64_t edge_key(uint a, uint b) {
+        return a < b ? ((uint64_t) a << 32) | b : ((uint64_t) b << 32) | a;
+    }
+}
+
+std::vector<uint> MeshSimplifier::simplify(const std::vector<uint>& source_indices, const std::vector<glm::vec3>& positions,
+                                           size_t target_index_count, float max_error, float& result_error) {
+    result_error = 0.0f;
+    std::vector<uint> position_ids{};
+    uint position_count = 0;
+    std::tie(position_ids, position_count) = MeshOptimizer::weld_positions(positions);
+
+    // Triangles that are already degenerate would only get in the way of classifying the edges
+    std::vector<uint> indices{};
+    indices.reserve(source_indices.size());
+    for (size_t i = 0; i + 2 < source_indices.size(); i += 3) {
+        auto a = position_ids[source_indices[i]], b = position_ids[source_indices[i + 1]], c = position_ids[source_indices[i + 2]];
+        if (a == b || b == c || c == a) continue;
+        indices.insert(indices.end(), source_indices.begin() + (long) i, source_indices.begin() + (long) i + 3);
+    }
+    if (indices.size() <= target_index_count) return indices;
+
+    // The vertices referenced at each position, only two are needed since positions with more are locked
+    std::vector<uint> first_vertex(position_count, UINT_MAX);
+    std::vector<uint> second_vertex(position_count, UINT_MAX);
+    std::vector<PositionKind> kinds(position_count, PositionKind::Manifold);
+    for (auto vertex: indices) {
+        auto position = position_ids[vertex];
+        if (first_vertex[position] == UINT_MAX) {
+            first_vertex[position] = vertex;
+        } else if (first_vertex[position] == vertex) {
+            continue;
+        } else if (second_vertex[position] == UINT_MAX) {
+            second_vertex[position] = vertex;
+            kinds[position] = PositionKind::Seam;
+        } else if (second_vertex[position] != vertex) {
+            kinds[position] = PositionKind::Locked;
+        }
+    }
+    auto twin = [&first_vertex, &second_vertex, &position_ids](uint vertex) {
+        auto position = position_ids[vertex];
+        return first_vertex[position] == vertex ? second_vertex[position] : first_vertex[position];
+    };
+
+    // Edges without exactly two triangles are on the border (or are non-manifold), and moving their ends would open holes in the mesh
+    {
+        std::unordered_map<uint64_t, uint> edge_triangles{};
+        edge_triangles.reserve(indices.size());
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (auto corner = 0u; corner < 3; ++corner) {
+                edge_triangles[edge_key(position_ids[indices[i + corner]], position_ids[indices[i + (corner + 1) % 3]])]++;
+            }
+        }
+        for (const auto& [key, count]: edge_triangles) {
+            if (count == 2) continue;
+            kinds[(uint) (key >> 32)] = PositionKind::Locked;
+            kinds[(uint) (key & UINT32_MAX)] = PositionKind::Locked;
+        }
+    }
+
+    std::vector<Quadric> quadrics(position_count);
+    for (size_t i = 0; i < indices.size(); i += 3) {
+        const auto& a = positions[indices[i]];
+        auto normal = glm::cross(positions[indices[i + 1]] - a, positions[indices[i + 2]] - a);
+        auto length = glm::length(normal);
+        if (length <= 0.0f) continue;
+        normal /= length;
+        for (auto corner = 0u; corner < 3; ++corner) {
+            quadrics[position_ids[indices[i + corner]]].add_plane(normal, -glm::dot(normal, a), 0.5 * length);
+        }
+    }
+
+    auto triangle_count = indices.size() / 3;
+    auto target_triangles = target_index_count / 3;
+    auto max_cost = (double) max_error * (double) max_error;
+    double worst_cost = 0.0;
+
+    std::vector<uint> remap(positions.size());
+    // Stamped with the pass a position was last moved or had its neighbourhood changed in, after which it can't collapse again until the next pass
+    std::vector<uint> touched(position_count, UINT_MAX);
+    std::vector<uint> adjacency_offsets{};
+    std::vector<uint> adjacency{};
+    std::unordered_set<uint64_t> vertex_edges{};
+    std::vector<Collapse> best_collapses{};
+    std::vector<Collapse> candidates{};
+
+    // Each pass collapses the cheapest edges that don't overlap, then rebuilds the triangles, until the target is met or nothing more can collapse
+    for (uint pass = 0; triangle_count > target_triangles; ++pass) {
+        // [position] -> [adjacent triangles], flattened
+        adjacency_offsets.assign(position_count + 1, 0);
+        for (auto vertex: indices) {
+            adjacency_offsets[position_ids[vertex] + 1]++;
+        }
+        std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+        adjacency.resize(indices.size());
+        {
+            auto next = adjacency_offsets;
+            for (auto i = 0u; i < indices.size(); ++i) {
+                adjacency[next[position_ids[indices[i]]]++] = i / 3;
+            }
+        }
+
+        vertex_edges.clear();
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (auto corner = 0u; corner < 3; ++corner) {
+                vertex_edges.insert(edge_key(indices[i + corner], indices[i + (corner + 1) % 3]));
+            }
+        }
+
+        auto can_collapse = [&](uint from, uint to) {
+            auto from_position = position_ids[from];
+            auto to_position = position_ids[to];
+            switch (kinds[from_position]) {
+                case PositionKind::Manifold:
+                    return true;
+                case PositionKind::Seam:
+                    // Both ends must be on the seam, with the edge on its other side too, so both sides move along it together
+                    return kinds[to_position] == PositionKind::Seam && vertex_edges.count(edge_key(twin(from), twin(to))) > 0;
+                default:
+                    return false;
+            }
+        };
+
+        // Only the cheapest collapse of each position is kept, since a position can only collapse once per pass anyway
+        best_collapses.assign(position_count, Collapse{UINT_MAX, UINT_MAX, std::numeric_limits<double>::max()});
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            for (auto corner = 0u; corner < 3; ++corner) {
+                auto a = indices[i + corner];
+                auto b = indices[i + (corner + 1) % 3];
+                for (auto [from, to]: {std::pair{a, b}, std::pair{b, a}}) {
+                    if (!can_collapse(from, to)) continue;
+                    auto quadric = quadrics[position_ids[from]];
+                    quadric += quadrics[position_ids[to]];
+                    auto cost = quadric.error(positions[to]);
+                    auto& best = best_collapses[position_ids[from]];
+                    if (cost < best.cost) best = {from, to, cost};
+                }
+            }
+        }
+        candidates.clear();
+        for (const auto& collapse: best_collapses) {
+            if (collapse.from != UINT_MAX) candidates.push_back(collapse);
+        }
+        std::sort(candidates.begin(), candidates.end(), [](const Collapse& lhs, const Collapse& rhs) {
+            return std::tie(lhs.cost, lhs.from, lhs.to) < std::tie(rhs.cost, rhs.from, rhs.to);
+        });
+
+        std::iota(remap.begin(), remap.end(), 0u);
+        size_t removed = 0;
+        bool collapsed = false;
+        for (const auto& collapse: candidates) {
+            if (collapse.cost > max_cost || triangle_count - removed <= target_triangles) break;
+
+            auto from_position = position_ids[collapse.from];
+            auto to_position = position_ids[collapse.to];
+            if (touched[from_position] == pass || touched[to_position] == pass) continue;
+
+            // The triangles around the moving position must not flip, or turn too far, or the surface folds over itself
+            const auto& target = positions[collapse.to];
+            bool flips = false;
+            size_t shared = 0;
+            for (auto i = adjacency_offsets[from_position]; i < adjacency_offsets[from_position + 1] && !flips; ++i) {
+                auto triangle = adjacency[i] * 3;
+                std::array<glm::vec3, 3> corners{};
+                bool has_target = false;
+                for (auto corner = 0u; corner < 3; ++corner) {
+                    auto position = position_ids[indices[triangle + corner]];
+                    has_target |= position == to_position;
+                    corners[corner] = positions[indices[triangle + corner]];
+                }
+                // These triangles become degenerate, and are removed
+                if (has_target) {
+                    shared++;
+                    continue;
+                }
+
+                auto before = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                for (auto corner = 0u; corner < 3; ++corner) {
+                    if (position_ids[indices[triangle + corner]] == from_position) corners[corner] = target;
+                }
+                auto after = glm::cross(corners[1] - corners[0], corners[2] - corners[0]);
+                auto before_length = glm::length(before);
+                if (before_length <= 0.0f) continue;
+                flips = glm::dot(before, after) <= 0.1f * before_length * glm::length(after);
+            }
+            if (flips) continue;
+
+            remap[collapse.from] = collapse.to;
+            if (kinds[from_position] == PositionKind::Seam) {
+                remap[twin(collapse.from)] = twin(collapse.to);
+            }
+            quadrics[to_position] += quadrics[from_position];
+            worst_cost = std::max(worst_cost, collapse.cost);
+            removed += shared;
+            collapsed = true;
+
+            for (auto i = adjacency_offsets[from_position]; i < adjacency_offsets[from_position + 1]; ++i) {
+                for (auto corner = 0u; corner < 3; ++corner) {
+                    touched[position_ids[indices[adjacency[i] * 3 + corner]]] = pass;
+                }
+            }
+        }
+        if (!collapsed) break;
+
+        size_t kept = 0;
+        for (size_t i = 0; i < indices.size(); i += 3) {
+            auto a = remap[indices[i]], b = remap[indices[i + 1]], c = remap[indices[i + 2]];
+            if (position_ids[a] == position_ids[b] || position_ids[b] == position_ids[c] || position_ids[c] == position_ids[a]) continue;
+            indices[kept++] = a;
+            indices[kept++] = b;
+            indices[kept++] = c;
+        }
+        indices.resize(kept);
+        triangle_count = kept / 3;
+    }
+
+    result_error = (float) std::sqrt(worst_cost);
+    return indices;
+}
+
+std::vector<MeshSimplifier::Lod> MeshSimplifier::build_lods(std::vector<uint>& indices, const std::vector<glm::vec3>& positions, uint max_lods) {
+    std::vector<Lod> lods{{0, (uint) indices.size(), 0.0f}};
+    if (indices.empty()) return lods;
+
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+    for (auto index: indices) {
+        min = glm::min(min, positions[index]);
+        max = glm::max(max, positions[index]);
+    }
+    auto max_error = glm::length(max - min) * 0.5f * MAX_ERROR;
+
+    std::vector<uint> previous = indices;
+    while (lods.size() < max_lods) {
+        auto target_triangles = (size_t) ((float) (previous.size() / 3) * LOD_REDUCTION);
+        if (target_triangles < MIN_LOD_TRIANGLES) break;
+
+        float error = 0.0f;
+        auto simplified = simplify(previous, positions, target_triangles * 3, std::max(max_error - lods.back().error, 0.0f), error);
+        if ((float) simplified.size() > (float) previous.size() * MIN_REDUCTION) break;
+
+        MeshOptimizer::optimise_vertex_cache(simplified, positions.size());
+        // Each level is simplified from the one before, so their errors add up
+        lods.push_back({(uint) indices.size(), (uint) simplified.size(), lods.back().error + error});
+        indices.insert(indices.end(), simplified.begin(), simplified.end());
+        previous = std::move(simplified);
+    }
+    return lods;
+}
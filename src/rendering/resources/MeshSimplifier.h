@@ -0,0 +1,48 @@
+#ifndef MESH_SIMPLIFIER_H
+#define MESH_SIMPLIFIER_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utility/HelperTypes.h"
+
+/// Generating simplified levels of detail (LODs) of a model, so that models covering few pixels can be drawn with fewer triangles.
+/// Simplification is by quadric error edge collapse, always collapsing onto an existing vertex, so every level shares the model's vertex buffer
+/// and only needs its own range of indices.
+/// See: "Surface Simplification Using Quadric Error Metrics" (Garland and Heckbert, 1997)
+/// and: https://github.com/zeux/meshoptimizer#simplification
+namespace MeshSimplifier {
+    /// The most levels a model can have, including the full detail one
+    constexpr uint MAX_LODS = 5;
+    /// Each level aims for this fraction of the previous level's triangles
+    constexpr float LOD_REDUCTION = 0.5f;
+    /// Levels stop being generated once one keeps more than this fraction of the previous level's triangles, since the mesh can't simplify further
+    constexpr float MIN_REDUCTION = 0.8f;
+    /// Levels stop being generated once they would have fewer triangles than this, since drawing them costs little anyway
+    constexpr uint MIN_LOD_TRIANGLES = 64;
+    /// The largest error a level may have, as a fraction of the radius of the model
+    constexpr float MAX_ERROR = 0.25f;
+
+    struct Lod {
+        // The level's range of the model's indices
+        uint first_index;
+        uint index_count;
+        // Roughly the furthest (in model units) the level's surface is from the full detail one
+        float error;
+    };
+
+    /// Simplify the triangles to at most target_index_count indices, referencing the same vertices, stopping early if that would need an error over max_error.
+    /// Result_error is set to the error of the simplified triangles, in the same units as the positions.
+    ///
+    /// Vertices on the border of the mesh, or where more than two vertices share a position (corners of texture or normal seams) never move.
+    /// Vertices on a seam only move along it, together with their twin on the other side, so the seam stays closed.
+    std::vector<uint> simplify(const std::vector<uint>& indices, const std::vector<glm::vec3>& positions,
+                               size_t target_index_count, float max_error, float& result_error);
+
+    /// Append up to max_lods - 1 simplified levels to the model's indices, each with about LOD_REDUCTION of the triangles of the one before.
+    /// Returns every level in order, starting with the full detail one, which keeps its indices unchanged.
+    std::vector<Lod> build_lods(std::vector<uint>& indices, const std::vector<glm::vec3>& positions, uint max_lods = MAX_LODS);
+}
+
+#endif //MESH_SIMPLIFIER_H
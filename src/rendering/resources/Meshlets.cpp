@@ -0,0 +1,202 @@
+#include "Meshlets.h"
+
+#include <cmath>
+#include <limits>
+#include <climits>
+#include <numeric>
+#include <tuple>
+#include <algorithm>
+
+#include "MeshOptimizer.h"
+
+std::vector<Meshlets::Meshlet> Meshlets::build(std::vector<uint>& indices, const std::vector<glm::vec3>& positions, uint max_triangles, uint max_vertices) {
+    auto triangle_count = (uint) (indices.size() / 3);
+
+    // Vertices are often split where normals or texture coordinates change (every corner of a flat shaded model is its own vertex),
+    // so neighbours are found through their positions, welding vertices at the same position together
+    std::vector<uint> position_ids{};
+    uint position_count = 0;
+    std::tie(position_ids, position_count) = MeshOptimizer::weld_positions(positions);
+
+    // [position] -> [adjacent triangles], flattened, so growing a meshlet can find its neighbours
+    std::vector<uint> adjacency_offsets(position_count + 1, 0);
+    for (auto i = 0u; i < triangle_count * 3; ++i) {
+        adjacency_offsets[position_ids[indices[i]] + 1]++;
+    }
+    std::partial_sum(adjacency_offsets.begin(), adjacency_offsets.end(), adjacency_offsets.begin());
+    std::vector<uint> adjacency(triangle_count * 3);
+    {
+        auto next = adjacency_offsets;
+        for (auto i = 0u; i < triangle_count * 3; ++i) {
+            adjacency[next[position_ids[indices[i]]]++] = i / 3;
+        }
+    }
+
+    std::vector<glm::vec3> centroids(triangle_count);
+    std::vector<glm::vec3> normals(triangle_count);
+    for (auto triangle = 0u; triangle < triangle_count; ++triangle) {
+        const auto& a = positions[indices[triangle * 3]];
+        const auto& b = positions[indices[triangle * 3 + 1]];
+        const auto& c = positions[indices[triangle * 3 + 2]];
+        centroids[triangle] = (a + b + c) / 3.0f;
+        auto normal = glm::cross(b - a, c - a);
+        auto length = glm::length(normal);
+        normals[triangle] = length > 0.0f ? normal / length : glm::vec3{0.0f};
+    }
+
+    std::vector<bool> emitted(triangle_count, false);
+    // Stamped with the meshlet a vertex, position or candidate triangle was last added to, so they never need clearing between meshlets
+    std::vector<uint> vertex_meshlet(positions.size(), UINT_MAX);
+    std::vector<uint> position_meshlet(position_count, UINT_MAX);
+    std::vector<uint> candidate_meshlet(triangle_count, UINT_MAX);
+
+    std::vector<uint> reordered{};
+    reordered.reserve(triangle_count * 3);
+    std::vector<Meshlet> meshlets{};
+    std::vector<uint> candidates{};
+
+    uint seed = 0;
+    while (true) {
+        // Seeding in index order keeps to the locality the vertex cache optimisation already gave the triangles
+        while (seed < triangle_count && emitted[seed]) ++seed;
+        if (seed >= triangle_count) break;
+
+        auto meshlet_i = (uint) meshlets.size();
+        auto first_index = (uint) reordered.size();
+        uint meshlet_vertices = 0;
+        uint meshlet_triangles = 0;
+        glm::vec3 centroid_sum{0.0f};
+        glm::vec3 normal_sum{0.0f};
+        candidates.clear();
+
+        auto add_triangle = [&](uint triangle) {
+            emitted[triangle] = true;
+            for (auto corner = 0u; corner < 3; ++corner) {
+                auto vertex = indices[triangle * 3 + corner];
+                reordered.push_back(vertex);
+                if (vertex_meshlet[vertex] != meshlet_i) {
+                    vertex_meshlet[vertex] = meshlet_i;
+                    ++meshlet_vertices;
+                }
+
+                auto position = position_ids[vertex];
+                if (position_meshlet[position] == meshlet_i) continue;
+                position_meshlet[position] = meshlet_i;
+                for (auto i = adjacency_offsets[position]; i < adjacency_offsets[position + 1]; ++i) {
+                    auto neighbour = adjacency[i];
+                    if (emitted[neighbour] || candidate_meshlet[neighbour] == meshlet_i) continue;
+                    candidate_meshlet[neighbour] = meshlet_i;
+                    candidates.push_back(neighbour);
+                }
+            }
+            ++meshlet_triangles;
+            centroid_sum += centroids[triangle];
+            normal_sum += normals[triangle];
+        };
+
+        add_triangle(seed);
+        while (meshlet_triangles < max_triangles) {
+            auto centroid = centroid_sum / (float) meshlet_triangles;
+            auto normal_length = glm::length(normal_sum);
+            auto axis = normal_length > 0.0f ? normal_sum / normal_length : glm::vec3{0.0f};
+
+            auto best = UINT_MAX;
+            uint best_new_positions = UINT_MAX;
+            float best_cost = std::numeric_limits<float>::max();
+            for (size_t i = 0; i < candidates.size();) {
+                auto triangle = candidates[i];
+                if (emitted[triangle]) {
+                    candidates[i] = candidates.back();
+                    candidates.pop_back();
+                    continue;
+                }
+                ++i;
+
+                uint new_vertices = 0;
+                uint new_positions = 0;
+                for (auto corner = 0u; corner < 3; ++corner) {
+                    auto vertex = indices[triangle * 3 + corner];
+                    new_vertices += vertex_meshlet[vertex] != meshlet_i ? 1 : 0;
+                    new_positions += position_meshlet[position_ids[vertex]] != meshlet_i ? 1 : 0;
+                }
+                if (meshlet_vertices + new_vertices > max_vertices) continue;
+
+                // Closer is better, and facing away from the rest of the meshlet up to doubles the cost, since it widens the normal cone
+                auto cost = glm::length(centroids[triangle] - centroid) * (2.0f - glm::dot(normals[triangle], axis));
+                if (new_positions < best_new_positions || (new_positions == best_new_positions && cost < best_cost)) {
+                    best = triangle;
+                    best_new_positions = new_positions;
+                    best_cost = cost;
+                }
+            }
+            // Either the meshlet has run out of neighbours, or every one of them would go over the vertex limit
+            if (best == UINT_MAX) break;
+            add_triangle(best);
+        }
+
+        meshlets.push_back(compute_bounds(reordered, first_index, (uint) reordered.size() - first_index, positions));
+    }
+
+    indices = std::move(reordered);
+    return meshlets;
+}
+
+Meshlets::Meshlet Meshlets::compute_bounds(const std::vector<uint>& indices, uint first_index, uint index_count, const std::vector<glm::vec3>& positions) {
+    Meshlet meshlet{};
+    meshlet.first_index = first_index;
+    meshlet.index_count = index_count;
+
+    // Around the centre of the bounding box, which is close enough to the smallest sphere for culling
+    glm::vec3 min{std::numeric_limits<float>::max()};
+    glm::vec3 max{std::numeric_limits<float>::lowest()};
+    for (auto i = first_index; i < first_index + index_count; ++i) {
+        min = glm::min(min, positions[indices[i]]);
+        max = glm::max(max, positions[indices[i]]);
+    }
+    auto centre = (min + max) * 0.5f;
+    float radius = 0.0f;
+    for (auto i = first_index; i < first_index + index_count; ++i) {
+        radius = std::max(radius, glm::length(positions[indices[i]] - centre));
+    }
+    meshlet.bounding_sphere = glm::vec4{centre, radius};
+
+    // The normal cone's axis is the average of the triangles' normals, and its angle covers all of them
+    meshlet.cone_apex = centre;
+    meshlet.cone_axis = glm::vec3{0.0f, 0.0f, 1.0f};
+    meshlet.cone_cutoff = NO_CONE;
+
+    auto triangle_normal = [&indices, &positions](uint i) {
+        auto normal = glm::cross(positions[indices[i + 1]] - positions[indices[i]], positions[indices[i + 2]] - positions[indices[i]]);
+        auto length = glm::length(normal);
+        return length > 0.0f ? normal / length : glm::vec3{0.0f};
+    };
+
+    glm::vec3 normal_sum{0.0f};
+    for (auto i = first_index; i < first_index + index_count; i += 3) {
+        normal_sum += triangle_normal(i);
+    }
+    auto axis_length = glm::length(normal_sum);
+    if (axis_length <= 0.0f) return meshlet;
+    auto axis = normal_sum / axis_length;
+
+    // The apex is moved back along the axis until it is behind every triangle's plane, so the test holds from any point in the cone
+    float min_dot = 1.0f;
+    float max_t = 0.0f;
+    for (auto i = first_index; i < first_index + index_count; i += 3) {
+        auto normal = triangle_normal(i);
+        if (normal == glm::vec3{0.0f}) continue;
+
+        auto normal_dot = glm::dot(normal, axis);
+        min_dot = std::min(min_dot, normal_dot);
+        if (normal_dot > 0.0f) {
+            max_t = std::max(max_t, glm::dot(centre - positions[indices[i]], normal) / normal_dot);
+        }
+    }
+    // Past about 84 degrees from the axis, the cone is too wide to ever cull anything worth the test
+    if (min_dot <= 0.1f) return meshlet;
+
+    meshlet.cone_apex = centre - axis * max_t;
+    meshlet.cone_axis = axis;
+    meshlet.cone_cutoff = std::sqrt(1.0f - min_dot * min_dot);
+    return meshlet;
+}
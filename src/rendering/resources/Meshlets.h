@@ -0,0 +1,46 @@
+#ifndef MESHLETS_H
+#define MESHLETS_H
+
+#include <vector>
+
+#include <glm/glm.hpp>
+
+#include "utility/HelperTypes.h"
+
+/// Splitting models into small clusters of neighbouring triangles (meshlets), each with bounds that let it be culled on its own,
+/// so that a model that is mostly off screen, or facing away, only has its visible parts drawn. See MeshletCuller.
+/// See: https://zeux.io/2023/01/16/meshlet-size-tradeoffs/
+/// and: "Optimizing the Graphics Pipeline with Compute" (Wihlidal, 2016)
+namespace Meshlets {
+    /// Limits on the size of each meshlet, small enough to cull finely, large enough that each costs little to test and draw.
+    /// The vertex limit is loose, so that flat shaded meshes (with 3 vertices per triangle) still fill their meshlets.
+    constexpr uint MAX_TRIANGLES = 124;
+    constexpr uint MAX_VERTICES = 255;
+    /// Models with fewer triangles than this are drawn whole, since culling parts of them wouldn't save enough to be worth it
+    constexpr uint MIN_MODEL_TRIANGLES = 4 * MAX_TRIANGLES;
+    /// Set as the cone_cutoff of meshlets whose triangles face too many ways to be culled by their normal cone, so the test never passes
+    constexpr float NO_CONE = 2.0f;
+
+    struct Meshlet {
+        // (centre, radius) in model space
+        glm::vec4 bounding_sphere;
+        // Every triangle faces away from a camera at position p if dot(normalize(cone_apex - p), cone_axis) >= cone_cutoff
+        glm::vec3 cone_apex;
+        float cone_cutoff;
+        glm::vec3 cone_axis;
+        // The meshlet's range of the model's indices
+        uint first_index;
+        uint index_count;
+    };
+
+    /// Reorder the triangles so that each meshlet's are contiguous, returning the meshlets in index order.
+    /// Meshlets are grown greedily from a seed triangle through its neighbours (triangles sharing a position), preferring those that add the fewest new positions,
+    /// then those closest to the meshlet and facing the same way, so that the bounds (and normal cones) stay tight.
+    std::vector<Meshlet> build(std::vector<uint>& indices, const std::vector<glm::vec3>& positions,
+                               uint max_triangles = MAX_TRIANGLES, uint max_vertices = MAX_VERTICES);
+
+    /// The bounding sphere and normal cone of the triangles in indices[first_index, first_index + index_count)
+    Meshlet compute_bounds(const std::vector<uint>& indices, uint first_index, uint index_count, const std::vector<glm::vec3>& positions);
+}
+
+#endif //MESHLETS_H
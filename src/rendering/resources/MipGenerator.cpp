@@ -0,0 +1,366 @@
+#include "MipGenerator.h"
+
+#include <cmath>
+#include <array>
+#include <chrono>
+#include <limits>
+#include <vector>
+#include <algorithm>
+#include <stdexcept>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define MIP_GENERATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+#if defined(MIP_GENERATOR_SSE2) && (defined(__GNUC__) || defined(__clang__))
+// The AVX2 path is compiled with a target attribute and picked at runtime, so the build doesn't need -mavx2
+#define MIP_GENERATOR_AVX2
+#include <immintrin.h>
+#endif
+
+std::string to_string(MipFilter filter) {
+    switch (filter) {
+        case MipFilter::Box:
+            return "Box";
+        case MipFilter::Kaiser:
+            return "Kaiser";
+        case MipFilter::Lanczos:
+            return "Lanczos";
+    }
+    return "Unknown";
+}
+
+namespace MipGenerator {
+    // Every texel is filtered as 4 floats, RGB padded out with alpha, so that it fills an SSE register
+    static constexpr uint FLOAT_CHANNELS = 4;
+    // Resolution of the linear to sRGB table, fine enough that even the darkest values round to the right 8 bit value
+    static constexpr uint LINEAR_TO_SRGB_STEPS = 16384;
+
+    static constexpr double PI = 3.14159265358979323846;
+    static constexpr double KAISER_ALPHA = 4.0;
+    // In destination texels, so the windowed sinc filters cover 12 source texels along each axis
+    static constexpr double SINC_RADIUS = 3.0;
+
+    enum class SimdLevel {
+        Scalar,
+        SSE2,
+        AVX2,
+    };
+
+    static SimdLevel detect_simd_level() {
+#ifdef MIP_GENERATOR_AVX2
+        if (__builtin_cpu_supports("avx2")) return SimdLevel::AVX2;
+#endif
+#ifdef MIP_GENERATOR_SSE2
+        return SimdLevel::SSE2;
+#else
+        return SimdLevel::Scalar;
+#endif
+    }
+
+    static SimdLevel get_simd_level() {
+        static const SimdLevel simd_level = detect_simd_level();
+        return simd_level;
+    }
+
+    std::string simd_level() {
+        switch (get_simd_level()) {
+            case SimdLevel::AVX2:
+                return "AVX2";
+            case SimdLevel::SSE2:
+                return "SSE2";
+            default:
+                return "Scalar";
+        }
+    }
+
+    /// Weights for halving one axis of a level. Destination texel i is filtered from source texels [first[i], first[i] + taps) (wrapping around),
+    /// with the weights [i * taps, (i + 1) * taps).
+    /// Halving an even size is exactly 2:1, so every destination texel has the same weights. An odd size is a little more than 2:1,
+    /// so the footprint is widened to match, rather than the last source texel being dropped.
+    struct Kernel {
+        uint taps;
+        std::vector<int> first;
+        std::vector<float> weights;
+    };
+
+    static double sinc(double x) {
+        if (std::abs(x) < 1e-9) return 1.0;
+        return std::sin(PI * x) / (PI * x);
+    }
+
+    /// The zeroth order modified Bessel function of the first kind, which the Kaiser window is built from
+    static double bessel_i0(double x) {
+        double sum = 1.0;
+        double term = 1.0;
+        for (auto k = 1; term > sum * 1e-12; ++k) {
+            auto half_x_over_k = x / (2.0 * k);
+            term *= half_x_over_k * half_x_over_k;
+            sum += term;
+        }
+        return sum;
+    }
+
+    static Kernel make_kernel(MipFilter filter, uint source_size) {
+        auto destination_size = std::max(source_size / 2, 1u);
+        auto radius = filter == MipFilter::Box ? 0.5 : SINC_RADIUS;
+        // Source texels per destination texel, and so how far the filter reaches in source texels
+        auto scale = (double) source_size / destination_size;
+        auto support = radius * scale;
+
+        Kernel kernel{0, std::vector<int>(destination_size), {}};
+        for (auto i = 0u; i < destination_size; ++i) {
+            auto centre = (i + 0.5) * scale;
+            kernel.first[i] = (int) std::floor(centre - support);
+            kernel.taps = std::max(kernel.taps, (uint) ((int) std::ceil(centre + support) - kernel.first[i]));
+        }
+
+        kernel.weights.resize((size_t) destination_size * kernel.taps);
+        for (auto i = 0u; i < destination_size; ++i) {
+            auto centre = (i + 0.5) * scale;
+            auto* weights = kernel.weights.data() + (size_t) i * kernel.taps;
+
+            double total = 0.0;
+            for (auto k = 0u; k < kernel.taps; ++k) {
+                auto texel = (double) (kernel.first[i] + (int) k);
+                // Offset of the source texel's centre from the destination texel's centre, in destination texels
+                auto x = (texel + 0.5 - centre) / scale;
+                double weight = 0.0;
+                switch (filter) {
+                    case MipFilter::Kaiser: {
+                        auto t = x / radius;
+                        if (std::abs(t) < 1.0) weight = sinc(x) * bessel_i0(KAISER_ALPHA * std::sqrt(1.0 - t * t)) / bessel_i0(KAISER_ALPHA);
+                        break;
+                    }
+                    case MipFilter::Lanczos:
+                        if (std::abs(x) < radius) weight = sinc(x) * sinc(x / radius);
+                        break;
+                    default:
+                        // How much of the source texel the destination texel covers, which is only ever partial for odd sizes
+                        weight = std::max(std::min(texel + 1.0, centre + support) - std::max(texel, centre - support), 0.0);
+                        break;
+                }
+                weights[k] = (float) weight;
+                total += weight;
+            }
+            for (auto k = 0u; k < kernel.taps; ++k) weights[k] = (float) (weights[k] / total);
+        }
+
+        return kernel;
+    }
+
+    static const std::array<float, 256>& srgb_to_linear_table() {
+        static const auto table = []() {
+            std::array<float, 256> values{};
+            for (auto i = 0u; i < values.size(); ++i) {
+                auto c = (double) i / 255.0;
+                values[i] = (float) (c <= 0.04045 ? c / 12.92 : std::pow((c + 0.055) / 1.055, 2.4));
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    static const std::vector<uint8_t>& linear_to_srgb_table() {
+        static const auto table = []() {
+            std::vector<uint8_t> values(LINEAR_TO_SRGB_STEPS + 1);
+            for (auto i = 0u; i < values.size(); ++i) {
+                auto l = (double) i / LINEAR_TO_SRGB_STEPS;
+                auto s = l <= 0.0031308 ? l * 12.92 : 1.055 * std::pow(l, 1.0 / 2.4) - 0.055;
+                values[i] = (uint8_t) std::lround(s * 255.0);
+            }
+            return values;
+        }();
+        return table;
+    }
+
+    static std::vector<float> to_linear(const uint8_t* texels, size_t texel_count, uint channels, bool srgb) {
+        const auto& srgb_table = srgb_to_linear_table();
+        std::vector<float> linear(texel_count * FLOAT_CHANNELS);
+        for (size_t i = 0; i < texel_count; ++i) {
+            const auto* texel = texels + i * channels;
+            auto* out = linear.data() + i * FLOAT_CHANNELS;
+            out[3] = channels == 4 ? (float) texel[3] / 255.0f : 1.0f;
+            // Weighted by alpha, so that the colour of transparent texels (often black) doesn't bleed into their neighbours as dark fringes
+            for (auto c = 0u; c < 3; ++c) {
+                out[c] = c >= channels ? 0.0f : (srgb ? srgb_table[texel[c]] : (float) texel[c] / 255.0f) * out[3];
+            }
+        }
+        return linear;
+    }
+
+    static void to_texels(const float* linear, size_t texel_count, uint channels, bool srgb, uint8_t* texels) {
+        const auto& srgb_table = linear_to_srgb_table();
+        for (size_t i = 0; i < texel_count; ++i) {
+            const auto* in = linear + i * FLOAT_CHANNELS;
+            auto* texel = texels + i * channels;
+            // Undo the weighting by alpha from to_linear, leaving fully transparent texels black. Without alpha it is always 1 (give or take rounding).
+            auto unweight = channels < 4 ? 1.0f : in[3] > 0.0f ? 1.0f / in[3] : 0.0f;
+            for (auto c = 0u; c < channels; ++c) {
+                // The sinc filters overshoot a little around sharp edges
+                auto value = std::clamp(c < 3 ? in[c] * unweight : in[c], 0.0f, 1.0f);
+                texel[c] = srgb && c < 3 ? srgb_table[(size_t) std::lround(value * LINEAR_TO_SRGB_STEPS)] : (uint8_t) std::lround(value * 255.0f);
+            }
+        }
+    }
+
+    static int wrap(int index, int size) {
+        index %= size;
+        return index < 0 ? index + size : index;
+    }
+
+    /// Halve the width, with the source texel of each tap for every destination column precomputed, since they are the same for every row
+    static void filter_rows(const float* source, uint width, uint height, float* destination, const Kernel& kernel, bool simd) {
+        auto destination_width = (uint) kernel.first.size();
+        auto taps = kernel.taps;
+
+        std::vector<uint> tap_offsets(destination_width * taps);
+        for (auto x = 0u; x < destination_width; ++x) {
+            for (auto k = 0u; k < taps; ++k) {
+                tap_offsets[x * taps + k] = (uint) wrap(kernel.first[x] + (int) k, (int) width) * FLOAT_CHANNELS;
+            }
+        }
+
+        for (auto y = 0u; y < height; ++y) {
+            const auto* source_row = source + (size_t) y * width * FLOAT_CHANNELS;
+            auto* destination_row = destination + (size_t) y * destination_width * FLOAT_CHANNELS;
+            for (auto x = 0u; x < destination_width; ++x) {
+                const auto* offsets = tap_offsets.data() + x * taps;
+                const auto* weights = kernel.weights.data() + (size_t) x * taps;
+#ifdef MIP_GENERATOR_SSE2
+                if (simd) {
+                    // A whole RGBA texel at once
+                    auto sum = _mm_setzero_ps();
+                    for (auto k = 0u; k < taps; ++k) {
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(source_row + offsets[k])));
+                    }
+                    _mm_storeu_ps(destination_row + x * FLOAT_CHANNELS, sum);
+                    continue;
+                }
+#endif
+                float sum[FLOAT_CHANNELS] = {};
+                for (auto k = 0u; k < taps; ++k) {
+                    for (auto c = 0u; c < FLOAT_CHANNELS; ++c) {
+                        sum[c] += weights[k] * source_row[offsets[k] + c];
+                    }
+                }
+                std::copy_n(sum, FLOAT_CHANNELS, destination_row + x * FLOAT_CHANNELS);
+            }
+        }
+    }
+
+#ifdef MIP_GENERATOR_AVX2
+    /// Two whole texels at once, returning how many floats of the row were filtered so the rest can be finished off with SSE2
+    __attribute__((target("avx2")))
+    static size_t filter_column_avx2(const float* const* rows, size_t row_floats, float* destination_row, const float* weights, uint taps) {
+        size_t i = 0;
+        for (; i + 8 <= row_floats; i += 8) {
+            auto sum = _mm256_setzero_ps();
+            for (auto k = 0u; k < taps; ++k) {
+                // Multiply then add rather than fused, so the result is identical to the other paths
+                sum = _mm256_add_ps(sum, _mm256_mul_ps(_mm256_set1_ps(weights[k]), _mm256_loadu_ps(rows[k] + i)));
+            }
+            _mm256_storeu_ps(destination_row + i, sum);
+        }
+        return i;
+    }
+#endif
+
+    /// Halve the height. Each destination row is a weighted sum of whole source rows, so this vectorises across the row.
+    static void filter_columns(const float* source, uint width, uint height, float* destination, const Kernel& kernel, bool simd) {
+        auto destination_height = (uint) kernel.first.size();
+        auto taps = kernel.taps;
+        auto row_floats = (size_t) width * FLOAT_CHANNELS;
+        auto simd_level = simd ? get_simd_level() : SimdLevel::Scalar;
+
+        std::vector<const float*> rows(taps);
+        for (auto y = 0u; y < destination_height; ++y) {
+            for (auto k = 0u; k < taps; ++k) {
+                rows[k] = source + (size_t) wrap(kernel.first[y] + (int) k, (int) height) * row_floats;
+            }
+            const auto* weights = kernel.weights.data() + (size_t) y * taps;
+            auto* destination_row = destination + (size_t) y * row_floats;
+
+            size_t i = 0;
+#ifdef MIP_GENERATOR_AVX2
+            if (simd_level == SimdLevel::AVX2) {
+                i = filter_column_avx2(rows.data(), row_floats, destination_row, weights, taps);
+            }
+#endif
+#ifdef MIP_GENERATOR_SSE2
+            if (simd_level != SimdLevel::Scalar) {
+                for (; i + 4 <= row_floats; i += 4) {
+                    auto sum = _mm_setzero_ps();
+                    for (auto k = 0u; k < taps; ++k) {
+                        sum = _mm_add_ps(sum, _mm_mul_ps(_mm_set1_ps(weights[k]), _mm_loadu_ps(rows[k] + i)));
+                    }
+                    _mm_storeu_ps(destination_row + i, sum);
+                }
+            }
+#endif
+            for (; i < row_floats; ++i) {
+                auto sum = 0.0f;
+                for (auto k = 0u; k < taps; ++k) {
+                    sum += weights[k] * rows[k][i];
+                }
+                destination_row[i] = sum;
+            }
+        }
+    }
+
+    MipChain generate(const uint8_t* texels, uint width, uint height, uint channels, bool srgb, MipFilter filter, bool simd) {
+        if (channels < 1 || channels > 4) {
+            throw std::runtime_error(Formatter() << "Can not generate mips for " << channels << " channel texels");
+        }
+        if (srgb && channels < 3) {
+            throw std::runtime_error(Formatter() << "There are no sRGB formats with " << channels << " channels, so the texels must be linear");
+        }
+        auto start = std::chrono::steady_clock::now();
+
+        MipChain chain{TextureCompression::None, width, height, channels, srgb};
+        chain.psnr = std::numeric_limits<float>::infinity();
+
+        // The top level is kept exactly as it was, rather than round tripping through linear
+        auto top_size = (size_t) width * height * channels;
+        chain.mips.push_back({width, height, 0, top_size});
+        chain.data.assign(texels, texels + top_size);
+
+        auto level = to_linear(texels, (size_t) width * height, channels, srgb);
+        std::vector<float> half_width_level{};
+        std::vector<float> next_level{};
+
+        auto level_width = width;
+        auto level_height = height;
+        while (level_width > 1 || level_height > 1) {
+            auto next_width = std::max(level_width / 2, 1u);
+            auto next_height = std::max(level_height / 2, 1u);
+
+            // Each axis is halved separately, skipping an axis that is already down to 1 texel
+            const float* current = level.data();
+            if (level_width > 1) {
+                half_width_level.resize((size_t) next_width * level_height * FLOAT_CHANNELS);
+                filter_rows(current, level_width, level_height, half_width_level.data(), make_kernel(filter, level_width), simd);
+                current = half_width_level.data();
+            }
+            if (level_height > 1) {
+                next_level.resize((size_t) next_width * next_height * FLOAT_CHANNELS);
+                filter_columns(current, next_width, level_height, next_level.data(), make_kernel(filter, level_height), simd);
+                current = next_level.data();
+            }
+            // Filtering the next level from this unquantised one avoids compounding rounding errors down the chain
+            level.assign(current, current + (size_t) next_width * next_height * FLOAT_CHANNELS);
+
+            auto size = (size_t) next_width * next_height * channels;
+            chain.mips.push_back({next_width, next_height, chain.data.size(), size});
+            chain.data.resize(chain.data.size() + size);
+            to_texels(level.data(), (size_t) next_width * next_height, channels, srgb, chain.data.data() + chain.mips.back().offset);
+
+            level_width = next_width;
+            level_height = next_height;
+        }
+
+        chain.mip_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+        return chain;
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef MIP_GENERATOR_H
+#define MIP_GENERATOR_H
+
+#include <string>
+#include <cstdint>
+
+#include "TextureCompression.h"
+#include "utility/HelperTypes.h"
+
+/// The filter each mip level is downsampled from the one above with
+enum class MipFilter : uint32_t {
+    // A 2x2 average, the same as glGenerateMipmap typically does (but gamma correct)
+    Box = 0,
+    // A Kaiser windowed sinc, sharper than a box without much ringing
+    Kaiser = 1,
+    // A 3 lobe Lanczos windowed sinc, the sharpest, but can ring around high contrast edges
+    Lanczos = 2,
+};
+
+std::string to_string(MipFilter filter);
+
+/// Builds whole mip chains on the CPU, so they can be generated on worker threads and stored in the texture cache,
+/// rather than generated by the driver (with glGenerateMipmap) on every load.
+///
+/// Filtering is done in linear space, so sRGB textures are decoded before and re-encoded after, keeping the average brightness of each level correct.
+/// The filters are separable, and run with SSE2 (or AVX2, where the CPU supports it) on x86, falling back to scalar code elsewhere.
+/// Texels past the edges wrap around, matching the repeat wrapping textures are sampled with.
+/// Odd sizes are downsampled with a footprint widened to match, so every texel contributes to the level below,
+/// and colour is weighted by alpha while filtering, so transparent texels don't darken the edges of cutouts.
+namespace MipGenerator {
+    /// Generate the full mip chain (down to 1x1) of an image of 8 bit texels with 1 (R) to 4 (RGBA) channels.
+    /// Alpha is always treated as linear, and srgb can only be set with at least 3 channels. If simd is false, the scalar path is used, for benchmarking.
+    MipChain generate(const uint8_t* texels, uint width, uint height, uint channels, bool srgb, MipFilter filter, bool simd = true);
+
+    /// The instruction set generate() will use when simd is set, eg. "AVX2"
+    std::string simd_level();
+}
+
+#endif //MIP_GENERATOR_H
@@ -2,67 +2,241 @@
 #define MODEL_HANDLE_H
 
 #include <string>
+#include <vector>
+#include <memory>
+#include <cstdint>
 #include <optional>
+#include <algorithm>
 
 #include <glad/gl.h>
 #include "utility/HelperTypes.h"
+#include "rendering/memory/GeometryArena.h"
+#include "VertexFormat.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+
+/// The arguments of a glMultiDrawElementsBaseVertex call drawing parts of a model, kept between draws so that building them doesn't allocate
+struct MultiDraw {
+    std::vector<GLsizei> counts{};
+    std::vector<const void*> offsets{};
+    std::vector<GLint> base_vertices{};
+};
 
 /// A type-erased version of ModelHandle for polymorphic usages
 class BaseModelHandle : private NonCopyable {
 public:
+    /// The size of the vertex buffer on the GPU
+    [[nodiscard]] virtual size_t get_vertex_bytes() const = 0;
+    /// The size the vertex buffer would be if stored in VertexFormat::Full
+    [[nodiscard]] virtual size_t get_full_vertex_bytes() const = 0;
+    /// The GPU memory owned by the handle (so 0 while it is using the placeholder, or sharing another's allocation)
+    [[nodiscard]] virtual size_t get_gpu_bytes() const = 0;
+    /// The handle whose allocation this one draws, since their files have the same contents, or nullptr if it has its own
+    [[nodiscard]] virtual const BaseModelHandle* get_shared_model() const = 0;
+
     virtual ~BaseModelHandle() = default;
 };
 
 /// A class representing a handle to a loaded model, also storing some of its configuration data.
+/// The model's vertices and indices are a sub-allocation of a GeometryArena, shared with other models of the same vertex format.
+/// A handle returned by an asynchronous load starts out drawing a shared placeholder mesh,
+/// and is updated in place by the ModelLoader once the real mesh has been uploaded.
+/// A handle can also share another's allocation, when their files have the same contents, in which case the other is kept alive and drawn in its place.
 template<typename VertexData>
 class ModelHandle : public BaseModelHandle {
-    uint vertex_vbo;
-    uint index_vbo;
-    uint vao;
-    int index_count;
-    int vertex_offset;
+    friend class ModelLoader;
+
+    std::shared_ptr<GeometryArena> arena;
+    std::shared_ptr<GeometryArena::Allocation> allocation;
+
+    // How the vertices are stored on the GPU, and how the shaders need to decode them
+    VertexFormat vertex_format = VertexFormat::Full;
+    VertexDecode vertex_decode{};
+    size_t vertex_count = 0;
+    // (centre, radius) in model space
+    glm::vec4 bounding_sphere{0.0f, 0.0f, 0.0f, 1.0f};
+    // The clusters the model's triangles are ordered into, for culling parts of it, or nullptr if it is always drawn whole
+    std::shared_ptr<const std::vector<Meshlets::Meshlet>> meshlets{};
+    // The model's levels of detail, starting with the full detail one, or nullptr if it only has that
+    std::shared_ptr<const std::vector<MeshSimplifier::Lod>> lods{};
 
     std::optional<std::string> filename{};
+
+    // False while this handle is standing in for a model that is still loading
+    bool ready = true;
+    // False if the allocation belongs to another handle (eg. the placeholder), so must not be freed by this one
+    bool owns_allocation = true;
+    // Set if the allocation is shared from another handle, which is drawn (and queried) in place of this one's own
+    std::shared_ptr<ModelHandle> shared_with{};
+    // Identifies the contents of the file and the vertex format the model was uploaded with, so the ModelLoader can find models to share. 0 if unknown.
+    uint64_t content_key = 0;
+
+    /// Take over the allocation of other, marking this handle as ready.
+    void fulfill(ModelHandle& other);
+    /// Release this handle's allocation and draw other's (which must own its allocation) instead, marking this handle as ready.
+    void share(const std::shared_ptr<ModelHandle>& other);
+    void release_allocation();
+    /// The handle whose allocation is drawn, so this one unless it is shared
+    [[nodiscard]] const ModelHandle& source() const;
 public:
-    ModelHandle(uint vertex_vbo, uint index_vbo, uint vao, int index_count, int vertex_offset, std::optional<std::string> filename = {});
+    ModelHandle(std::shared_ptr<GeometryArena> arena, std::shared_ptr<GeometryArena::Allocation> allocation, std::optional<std::string> filename = {});
+
+    /// Create a handle that draws with placeholder's allocation (without owning it) until it is fulfilled.
+    static std::shared_ptr<ModelHandle> make_pending(const ModelHandle& placeholder, std::optional<std::string> filename);
+
+    /// Returns false while the model is still loading, during which time a placeholder mesh is used.
+    /// If the load fails, this becomes true with the placeholder mesh left in place.
+    [[nodiscard]] bool is_ready() const;
 
     [[nodiscard]] uint get_vertex_vbo() const;
     [[nodiscard]] uint get_index_vbo() const;
     [[nodiscard]] uint get_vao() const;
-    [[nodiscard]] int get_index_count() const;
+    /// The number of indices drawn at the given level of detail (clamped like draw()), the simplified levels follow the full detail indices in the index buffer
+    [[nodiscard]] int get_index_count(uint lod = 0) const;
     [[nodiscard]] int get_vertex_offset() const;
+    /// GL_UNSIGNED_SHORT or GL_UNSIGNED_INT, chosen when the model was loaded
+    [[nodiscard]] GLenum get_index_type() const;
+    /// The number of draw calls the model needs, more than 1 if it was split to allow 16 bit indices
+    [[nodiscard]] size_t get_sub_mesh_count() const;
+
+    /// Draw the model at the given level of detail (clamped to the coarsest it has, so 0 is always full detail), with its VAO (see get_vao()) already bound.
+    void draw(uint lod = 0) const;
+    /// Draw only the given ranges of the model's indices, as [(first_index, end_index)] in ascending order (such as from its meshlets).
+    /// Ranges are split where they cross sub-meshes, and drawn with one call. multi_draw is scratch space.
+    void draw(const std::vector<std::pair<uint, uint>>& index_ranges, MultiDraw& multi_draw) const;
     [[nodiscard]] const std::optional<std::string>& get_filename() const;
+    [[nodiscard]] VertexFormat get_vertex_format() const;
+    [[nodiscard]] const VertexDecode& get_vertex_decode() const;
+    [[nodiscard]] size_t get_vertex_count() const;
+    /// A sphere (as (centre, radius), in model space) around the model's vertices, such as for estimating its size on screen
+    [[nodiscard]] const glm::vec4& get_bounding_sphere() const;
+    /// The meshlets the model's indices are split into, or nullptr if it wasn't, see Meshlets
+    [[nodiscard]] const std::shared_ptr<const std::vector<Meshlets::Meshlet>>& get_meshlets() const;
+    /// The levels of detail the model can be drawn at, starting with full detail, or nullptr if it only has that, see MeshSimplifier
+    [[nodiscard]] const std::shared_ptr<const std::vector<MeshSimplifier::Lod>>& get_lods() const;
+    /// The number of levels of detail the model can be drawn at, including full detail
+    [[nodiscard]] uint get_lod_count() const;
+    [[nodiscard]] size_t get_vertex_bytes() const override;
+    [[nodiscard]] size_t get_full_vertex_bytes() const override;
+    [[nodiscard]] size_t get_gpu_bytes() const override;
+    [[nodiscard]] const BaseModelHandle* get_shared_model() const override;
+    /// The handle whose allocation this one shares, or nullptr if it has its own
+    [[nodiscard]] const std::shared_ptr<ModelHandle>& get_shared_with() const;
 
     ~ModelHandle() override;
 };
 
 template<typename VertexData>
-ModelHandle<VertexData>::ModelHandle(uint vertex_vbo, uint index_vbo, uint vao, int index_count, int vertex_offset, std::optional<std::string> filename)
-    : BaseModelHandle(), vertex_vbo(vertex_vbo), index_vbo(index_vbo), vao(vao), index_count(index_count), vertex_offset(vertex_offset), filename(std::move(filename)) {}
+ModelHandle<VertexData>::ModelHandle(std::shared_ptr<GeometryArena> arena, std::shared_ptr<GeometryArena::Allocation> allocation, std::optional<std::string> filename)
+    : BaseModelHandle(), arena(std::move(arena)), allocation(std::move(allocation)), filename(std::move(filename)) {}
+
+template<typename VertexData>
+const ModelHandle<VertexData>& ModelHandle<VertexData>::source() const {
+    // Only handles owning their allocation are shared from, but one may since have been reloaded to share another's, until its sharers reload
+    return shared_with != nullptr ? shared_with->source() : *this;
+}
 
 template<typename VertexData>
 uint ModelHandle<VertexData>::get_vertex_vbo() const {
-    return vertex_vbo;
+    return source().arena->get_vertex_buffer();
 }
 
 template<typename VertexData>
 uint ModelHandle<VertexData>::get_index_vbo() const {
-    return index_vbo;
+    return source().arena->get_index_buffer();
 }
 
 template<typename VertexData>
 uint ModelHandle<VertexData>::get_vao() const {
-    return vao;
+    return source().arena->get_vao();
 }
 
 template<typename VertexData>
-int ModelHandle<VertexData>::get_index_count() const {
-    return index_count;
+int ModelHandle<VertexData>::get_index_count(uint lod) const {
+    const auto& model = source();
+    if (model.lods == nullptr) return (int) model.allocation->index_count;
+    return (int) (*model.lods)[std::min<size_t>(lod, model.lods->size() - 1)].index_count;
 }
 
 template<typename VertexData>
 int ModelHandle<VertexData>::get_vertex_offset() const {
-    return vertex_offset;
+    return (int) source().allocation->first_vertex;
+}
+
+template<typename VertexData>
+size_t ModelHandle<VertexData>::get_gpu_bytes() const {
+    if (!owns_allocation) return 0;
+    return get_vertex_bytes() + allocation->get_index_slots() * GeometryArena::INDEX_SLOT_SIZE;
+}
+
+template<typename VertexData>
+const BaseModelHandle* ModelHandle<VertexData>::get_shared_model() const {
+    return shared_with.get();
+}
+
+template<typename VertexData>
+const std::shared_ptr<ModelHandle<VertexData>>& ModelHandle<VertexData>::get_shared_with() const {
+    return shared_with;
+}
+
+template<typename VertexData>
+GLenum ModelHandle<VertexData>::get_index_type() const {
+    return source().allocation->index_type;
+}
+
+template<typename VertexData>
+size_t ModelHandle<VertexData>::get_sub_mesh_count() const {
+    return source().allocation->sub_meshes.size();
+}
+
+template<typename VertexData>
+void ModelHandle<VertexData>::draw(uint lod) const {
+    const auto& model = source();
+    const auto& allocation = model.allocation;
+    size_t first_index = 0;
+    size_t end_index = allocation->index_count;
+    if (model.lods != nullptr) {
+        const auto& level = (*model.lods)[std::min<size_t>(lod, model.lods->size() - 1)];
+        first_index = level.first_index;
+        end_index = level.first_index + level.index_count;
+    }
+
+    // Each level is drawn from its own range of the indices, clipped to the sub-meshes it overlaps
+    auto index_size = allocation->get_index_size();
+    for (const auto& sub_mesh: allocation->sub_meshes) {
+        auto first = std::max<size_t>(first_index, sub_mesh.first_index);
+        auto end = std::min<size_t>(end_index, sub_mesh.first_index + sub_mesh.index_count);
+        if (first >= end) continue;
+        auto index_offset = allocation->first_index_slot * GeometryArena::INDEX_SLOT_SIZE + first * index_size;
+        glDrawElementsBaseVertex(GL_TRIANGLES, (int) (end - first), allocation->index_type, (const void*) index_offset, (int) (allocation->first_vertex + sub_mesh.base_vertex));
+    }
+}
+
+template<typename VertexData>
+void ModelHandle<VertexData>::draw(const std::vector<std::pair<uint, uint>>& index_ranges, MultiDraw& multi_draw) const {
+    const auto& allocation = source().allocation;
+    auto index_size = allocation->get_index_size();
+    multi_draw.counts.clear();
+    multi_draw.offsets.clear();
+    multi_draw.base_vertices.clear();
+
+    // Both are in index order, so walk them together, clipping each range to the sub-meshes it overlaps
+    auto range = index_ranges.begin();
+    for (const auto& sub_mesh: allocation->sub_meshes) {
+        auto sub_mesh_end = sub_mesh.first_index + sub_mesh.index_count;
+        while (range != index_ranges.end() && range->second <= sub_mesh.first_index) ++range;
+        for (auto overlapping = range; overlapping != index_ranges.end() && overlapping->first < sub_mesh_end; ++overlapping) {
+            auto first = std::max<size_t>(overlapping->first, sub_mesh.first_index);
+            auto end = std::min<size_t>(overlapping->second, sub_mesh_end);
+            multi_draw.counts.push_back((GLsizei) (end - first));
+            multi_draw.offsets.push_back((const void*) (allocation->first_index_slot * GeometryArena::INDEX_SLOT_SIZE + first * index_size));
+            multi_draw.base_vertices.push_back((GLint) (allocation->first_vertex + sub_mesh.base_vertex));
+        }
+    }
+    if (multi_draw.counts.empty()) return;
+
+    glMultiDrawElementsBaseVertex(GL_TRIANGLES, multi_draw.counts.data(), allocation->index_type, multi_draw.offsets.data(),
+                                  (GLsizei) multi_draw.counts.size(), multi_draw.base_vertices.data());
 }
 
 template<typename VertexData>
@@ -70,11 +244,116 @@ const std::optional<std::string>& ModelHandle<VertexData>::get_filename() const
     return filename;
 }
 
+template<typename VertexData>
+VertexFormat ModelHandle<VertexData>::get_vertex_format() const {
+    return source().vertex_format;
+}
+
+template<typename VertexData>
+const VertexDecode& ModelHandle<VertexData>::get_vertex_decode() const {
+    return source().vertex_decode;
+}
+
+template<typename VertexData>
+size_t ModelHandle<VertexData>::get_vertex_count() const {
+    return source().vertex_count;
+}
+
+template<typename VertexData>
+const glm::vec4& ModelHandle<VertexData>::get_bounding_sphere() const {
+    return source().bounding_sphere;
+}
+
+template<typename VertexData>
+const std::shared_ptr<const std::vector<Meshlets::Meshlet>>& ModelHandle<VertexData>::get_meshlets() const {
+    return source().meshlets;
+}
+
+template<typename VertexData>
+const std::shared_ptr<const std::vector<MeshSimplifier::Lod>>& ModelHandle<VertexData>::get_lods() const {
+    return source().lods;
+}
+
+template<typename VertexData>
+uint ModelHandle<VertexData>::get_lod_count() const {
+    const auto& model_lods = source().lods;
+    return model_lods != nullptr ? (uint) model_lods->size() : 1;
+}
+
+template<typename VertexData>
+size_t ModelHandle<VertexData>::get_vertex_bytes() const {
+    auto vertex_size = get_vertex_format() == VertexFormat::Compact ? sizeof(typename VertexData::Compact) : sizeof(VertexData);
+    return get_vertex_count() * vertex_size;
+}
+
+template<typename VertexData>
+size_t ModelHandle<VertexData>::get_full_vertex_bytes() const {
+    return get_vertex_count() * sizeof(VertexData);
+}
+
+template<typename VertexData>
+bool ModelHandle<VertexData>::is_ready() const {
+    return ready;
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelHandle<VertexData>::make_pending(const ModelHandle& placeholder, std::optional<std::string> filename) {
+    auto handle = std::make_shared<ModelHandle>(placeholder.arena, placeholder.allocation, std::move(filename));
+    handle->vertex_format = placeholder.vertex_format;
+    handle->vertex_decode = placeholder.vertex_decode;
+    handle->vertex_count = placeholder.vertex_count;
+    handle->bounding_sphere = placeholder.bounding_sphere;
+    handle->meshlets = placeholder.meshlets;
+    handle->lods = placeholder.lods;
+    handle->owns_allocation = false;
+    handle->ready = false;
+    return handle;
+}
+
+template<typename VertexData>
+void ModelHandle<VertexData>::fulfill(ModelHandle& other) {
+    release_allocation();
+    arena = other.arena;
+    allocation = other.allocation;
+    vertex_format = other.vertex_format;
+    vertex_decode = other.vertex_decode;
+    vertex_count = other.vertex_count;
+    bounding_sphere = other.bounding_sphere;
+    meshlets = other.meshlets;
+    lods = other.lods;
+    owns_allocation = other.owns_allocation;
+    shared_with = other.shared_with;
+    content_key = other.content_key;
+    ready = true;
+    other.owns_allocation = false;
+}
+
+template<typename VertexData>
+void ModelHandle<VertexData>::share(const std::shared_ptr<ModelHandle>& other) {
+    release_allocation();
+    arena = other->arena;
+    allocation = other->allocation;
+    vertex_format = other->vertex_format;
+    vertex_decode = other->vertex_decode;
+    vertex_count = other->vertex_count;
+    bounding_sphere = other->bounding_sphere;
+    meshlets = other->meshlets;
+    lods = other->lods;
+    shared_with = other;
+    content_key = 0;
+    ready = true;
+}
+
+template<typename VertexData>
+void ModelHandle<VertexData>::release_allocation() {
+    if (!owns_allocation) return;
+    arena->free(allocation);
+    owns_allocation = false;
+}
+
 template<typename VertexData>
 ModelHandle<VertexData>::~ModelHandle() {
-    glDeleteVertexArrays(1, &vao);
-    glDeleteBuffers(1, &vertex_vbo);
-    glDeleteBuffers(1, &index_vbo);
+    release_allocation();
 }
 
 #endif //MODEL_HANDLE_H
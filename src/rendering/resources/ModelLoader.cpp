@@ -1,16 +1,374 @@
 #include "ModelLoader.h"
 #include <filesystem>
 
+#include "rendering/renders/EntityRenderer.h"
+
+ModelLoader::ModelLoader(std::string import_path, const std::string& cache_path, ResidencyManager& residency_manager, FileWatcher& file_watcher)
+    : import_path(std::move(import_path)), mesh_cache(cache_path), residency_manager(residency_manager), file_watcher(file_watcher) {
+    mesh_cache.set_processing_flags(get_processing_flags());
+    for (auto i = 0u; i < worker_pool.get_thread_count(); ++i) {
+        worker_importers.push_back(std::make_unique<Assimp::Importer>());
+    }
+
+    file_watcher.subscribe(this->import_path, [this](const FileWatcher::Change& change) { on_file_changed(change); });
+}
+
+uint64_t ModelLoader::get_processing_flags() const {
+    return (optimise_meshes ? PROCESSING_OPTIMISED : 0) | (native_obj ? PROCESSING_NATIVE_OBJ : 0) | (build_meshlets ? PROCESSING_MESHLETS : 0)
+           | (generate_lods ? PROCESSING_LODS : 0);
+}
+
 const std::vector<std::string>& ModelLoader::get_available_models(bool force_refresh) {
-    if (!force_refresh && available_models.has_value()) {
+    // While the file_watcher is live, it keeps the list up to date, so there is never a need to refresh it
+    if (available_models.has_value() && (!force_refresh || file_watcher.is_live())) {
         return available_models.value();
     }
-    available_models = std::vector<std::string>{};
+    available_models = file_watcher.list_files(import_path);
+
+    return available_models.value();
+}
+
+std::filesystem::file_time_type ModelLoader::get_last_write_time(const std::string& file) const {
+    auto last_write_time = file_watcher.get_last_write_time(import_path, file);
+    if (!last_write_time.has_value()) {
+        throw std::runtime_error(Formatter() << "Failed to load model (" << import_path << "/" << file << "): \n\t File does not exist");
+    }
+    return last_write_time.value();
+}
 
-    for (auto const& dir_entry: std::filesystem::recursive_directory_iterator(import_path)) {
-        available_models->push_back(std::filesystem::relative(dir_entry, import_path).string());
+void ModelLoader::on_file_changed(const FileWatcher::Change& change) {
+    if (change.type != FileWatcher::ChangeType::Modified) {
+        available_models.reset();
     }
-    std::sort(available_models.value().begin(), available_models.value().end());
 
-    return available_models.value();
-}
\ No newline at end of file
+    // Hierarchies can change shape, so aren't reloaded in place. Entities keep the old version, new loads pick up the new one.
+    for (auto it = hierarchy_cache.begin(); it != hierarchy_cache.end();) {
+        it = it->first.first == change.file ? hierarchy_cache.erase(it) : std::next(it);
+    }
+
+    if (change.type == FileWatcher::ChangeType::Removed) {
+        // Entities keep the last version, but it can't be loaded again
+        for (auto it = cache.begin(); it != cache.end();) {
+            it = it->first.first == change.file ? cache.erase(it) : std::next(it);
+        }
+        return;
+    }
+
+    auto last_write_time = file_watcher.get_last_write_time(import_path, change.file);
+    if (!last_write_time.has_value()) return;
+
+    // Reload every live model from the file in place, so that everything using it picks up the change
+    std::unordered_set<const BaseModelHandle*> reloading{};
+    for (auto& [key, cached]: cache) {
+        const auto& [file, vertex_type] = key;
+        auto handle = cached.second.lock();
+        if (file != change.file || handle == nullptr) continue;
+
+        // Still the right handle to hand out, it will be updated once the reload finishes
+        cached.first = last_write_time.value();
+        std::cout << "Reloading model: " << file << std::endl;
+        model_reloaders.at(vertex_type)(file, handle);
+        reloading.insert(handle.get());
+    }
+
+    // Models sharing one that is being reloaded no longer have the same contents, so are reloaded from their own files
+    for (auto& [key, cached]: cache) {
+        const auto& [file, vertex_type] = key;
+        auto handle = cached.second.lock();
+        if (file == change.file || handle == nullptr || reloading.count(handle->get_shared_model()) == 0) continue;
+        model_reloaders.at(vertex_type)(file, handle);
+    }
+}
+
+void ModelLoader::update() {
+    // Each poll returns true once it is done with, and is called exactly once per update
+    pending_loads.erase(std::remove_if(pending_loads.begin(), pending_loads.end(), [](const auto& poll) { return poll(); }), pending_loads.end());
+
+    for (const auto& [vertex_type, arena]: arenas) {
+        arena->defragment_if_needed();
+    }
+}
+
+void ModelLoader::clear_memory_cache() {
+    cache.clear();
+    hierarchy_cache.clear();
+    content_index.clear();
+    content_hashes.clear();
+}
+
+std::unique_ptr<ModelLoader> ModelLoader::create_isolated(const std::string& cache_path, ResidencyManager& isolated_residency_manager, FileWatcher& isolated_file_watcher) const {
+    auto isolated = std::make_unique<ModelLoader>(import_path, cache_path, isolated_residency_manager, isolated_file_watcher);
+    isolated->optimise_meshes = optimise_meshes.load();
+    isolated->native_obj = native_obj.load();
+    isolated->build_meshlets = build_meshlets.load();
+    isolated->generate_lods = generate_lods.load();
+    isolated->default_vertex_format = default_vertex_format;
+    isolated->vertex_formats = vertex_formats;
+    isolated->mesh_cache.set_processing_flags(isolated->get_processing_flags());
+    isolated->mesh_cache.set_enabled(mesh_cache.is_enabled());
+    return isolated;
+}
+
+VertexFormat ModelLoader::get_vertex_format(const std::string& file) const {
+    auto vertex_format = vertex_formats.find(file);
+    return vertex_format != vertex_formats.end() ? vertex_format->second : default_vertex_format;
+}
+
+void ModelLoader::set_vertex_format(const std::string& file, VertexFormat vertex_format) {
+    vertex_formats[file] = vertex_format;
+
+    // Entities using the model keep their existing handles, but new loads re-upload it in the new format
+    for (auto it = cache.begin(); it != cache.end();) {
+        it = it->first.first == file ? cache.erase(it) : std::next(it);
+    }
+    for (auto it = hierarchy_cache.begin(); it != hierarchy_cache.end();) {
+        it = it->first.first == file ? hierarchy_cache.erase(it) : std::next(it);
+    }
+}
+
+static bool add_imgui_vertex_format_selector(const std::string& caption, VertexFormat& vertex_format) {
+    bool changed = false;
+    if (ImGui::BeginCombo(caption.c_str(), to_string(vertex_format).c_str(), 0)) {
+        for (auto option: {VertexFormat::Full, VertexFormat::Compact}) {
+            if (ImGui::Selectable(to_string(option).c_str(), option == vertex_format)) {
+                changed = option != vertex_format;
+                vertex_format = option;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    return changed;
+}
+
+void ModelLoader::add_imgui_vertex_memory_report() {
+    size_t vertex_bytes = 0;
+    size_t full_vertex_bytes = 0;
+    // Every entity draws its model once a frame, so the vertex fetch is roughly the vertex bytes times the number of users
+    size_t frame_bytes = 0;
+    size_t full_frame_bytes = 0;
+
+    auto add_model = [&](const BaseModelHandle& model, long users) {
+        // Shared models are already counted by the model they share
+        if (model.get_shared_model() == nullptr) {
+            vertex_bytes += model.get_vertex_bytes();
+            full_vertex_bytes += model.get_full_vertex_bytes();
+        }
+        frame_bytes += model.get_vertex_bytes() * users;
+        full_frame_bytes += model.get_full_vertex_bytes() * users;
+    };
+
+    for (const auto& [key, entry]: cache) {
+        auto users = entry.second.use_count();
+        auto model = entry.second.lock();
+        if (model != nullptr) add_model(*model, users);
+    }
+    for (const auto& [key, entry]: hierarchy_cache) {
+        auto users = entry.second.use_count();
+        auto mesh_hierarchy = entry.second.lock();
+        if (mesh_hierarchy != nullptr) mesh_hierarchy->visit_models([&](const BaseModelHandle& model) { add_model(model, users); });
+    }
+
+    ImGui::Text("Loaded vertices: %.1f KiB (%.1f KiB as Full, %.1f KiB saved)",
+                (double) vertex_bytes / 1024.0, (double) full_vertex_bytes / 1024.0, (double) (full_vertex_bytes - vertex_bytes) / 1024.0);
+    ImGui::Text("Vertex fetch per frame: ~%.1f KiB (%.1f KiB as Full)", (double) frame_bytes / 1024.0, (double) full_frame_bytes / 1024.0);
+}
+
+VertexCollection ModelLoader::placeholder_mesh(std::vector<uint>& indices) {
+    VertexCollection vertex_collection{};
+    // One quad per face of a [-0.5, 0.5] cube, so that each face gets flat normals
+    for (auto axis = 0; axis < 3; ++axis) {
+        for (auto sign: {-1.0f, 1.0f}) {
+            glm::vec3 normal{0.0f};
+            normal[axis] = sign;
+            glm::vec3 u{0.0f};
+            u[(axis + 1) % 3] = 0.5f;
+            glm::vec3 v = glm::cross(normal, u);
+
+            auto base = (uint) vertex_collection.positions.size();
+            for (const auto& corner: {glm::vec2{-1.0f, -1.0f}, glm::vec2{1.0f, -1.0f}, glm::vec2{1.0f, 1.0f}, glm::vec2{-1.0f, 1.0f}}) {
+                vertex_collection.positions.push_back(normal * 0.5f + u * corner.x + v * corner.y);
+                vertex_collection.normals.push_back(normal);
+                vertex_collection.tex_coords.push_back(corner * 0.5f + 0.5f);
+                vertex_collection.bones.emplace_back(glm::vec4{1.0f, 0.0f, 0.0f, 0.0f}, glm::uvec4{0u});
+            }
+            indices.insert(indices.end(), {base, base + 1, base + 2, base, base + 2, base + 3});
+        }
+    }
+    return vertex_collection;
+}
+
+void ModelLoader::record_load(const std::string& file, bool from_cache, std::chrono::steady_clock::time_point start) {
+    auto load_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    if (from_cache) {
+        load_stats.warm_loads++;
+        load_stats.warm_total_ms += load_ms;
+    } else {
+        load_stats.cold_loads++;
+        load_stats.cold_total_ms += load_ms;
+    }
+    load_stats.last_load = {file, from_cache, load_ms};
+}
+
+void ModelLoader::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Model Loader")) {
+        if (load_stats.last_load.has_value()) {
+            const auto& [file, from_cache, load_ms] = load_stats.last_load.value();
+            ImGui::Text("Last load: %s (%s) %.3f ms", file.c_str(), from_cache ? "mesh cache" : "import", load_ms);
+        }
+        ImGui::Text("Imported: %u, average %.3f ms", load_stats.cold_loads, load_stats.cold_loads > 0 ? load_stats.cold_total_ms / load_stats.cold_loads : 0.0);
+        ImGui::Text("From mesh cache: %u, average %.3f ms", load_stats.warm_loads, load_stats.warm_loads > 0 ? load_stats.warm_total_ms / load_stats.warm_loads : 0.0);
+        ImGui::Text("Pending loads: %zu (%u workers)", pending_loads.size(), worker_pool.get_thread_count());
+        ImGui::Text("Index memory saved by 16 bit indices: %.1f KiB", (double) load_stats.index_bytes_saved / 1024.0);
+
+        size_t sharing = 0;
+        for (const auto& [key, cached]: cache) {
+            auto model = cached.second.lock();
+            if (model != nullptr && model->get_shared_model() != nullptr) ++sharing;
+        }
+        ImGui::Text("Sharing identical files: %zu live models, %zu loads in total (%zu files hashed, %zu hashes reused)", sharing, shared_loads,
+                    content_hashes.get_hashed_files(), content_hashes.get_reused_hashes());
+
+        bool cache_enabled = mesh_cache.is_enabled();
+        if (ImGui::Checkbox("Use Mesh Cache", &cache_enabled)) {
+            mesh_cache.set_enabled(cache_enabled);
+        }
+        bool optimise = optimise_meshes;
+        if (ImGui::Checkbox("Optimise Imported Meshes", &optimise)) {
+            optimise_meshes = optimise;
+            // Entries are only reused if they were written with the same setting
+            mesh_cache.set_processing_flags(get_processing_flags());
+        }
+        bool native = native_obj;
+        if (ImGui::Checkbox("Native OBJ Parser", &native)) {
+            native_obj = native;
+            mesh_cache.set_processing_flags(get_processing_flags());
+        }
+        bool meshlets = build_meshlets;
+        if (ImGui::Checkbox("Split Models Into Meshlets", &meshlets)) {
+            build_meshlets = meshlets;
+            mesh_cache.set_processing_flags(get_processing_flags());
+        }
+        bool lods = generate_lods;
+        if (ImGui::Checkbox("Generate Levels of Detail", &lods)) {
+            generate_lods = lods;
+            mesh_cache.set_processing_flags(get_processing_flags());
+        }
+        if (ImGui::Button("Clear Mesh Cache")) {
+            mesh_cache.clear();
+        }
+        ImGui::SameLine();
+        if (ImGui::Button("Benchmark Cold vs Warm (takes a while)")) {
+            run_load_benchmark<EntityRenderer::VertexData>();
+        }
+
+        double total_cold_ms = 0.0;
+        double total_warm_ms = 0.0;
+        for (const auto& [file, cold_ms, warm_ms]: benchmark_results) {
+            ImGui::Text("%s: cold %.3f ms, warm %.3f ms (%.1fx)", file.c_str(), cold_ms, warm_ms, warm_ms > 0.0 ? cold_ms / warm_ms : 0.0);
+            total_cold_ms += cold_ms;
+            total_warm_ms += warm_ms;
+        }
+        if (!benchmark_results.empty()) {
+            ImGui::Text("Total: cold %.3f ms, warm %.3f ms", total_cold_ms, total_warm_ms);
+        }
+
+        if (ImGui::TreeNode("Vertex Formats")) {
+            ImGui::TextDisabled("Applies to models loaded after a change");
+            if (add_imgui_vertex_format_selector("Default", default_vertex_format)) {
+                clear_memory_cache();
+            }
+            for (const auto& model: get_available_models()) {
+                auto vertex_format = get_vertex_format(model);
+                if (add_imgui_vertex_format_selector(model, vertex_format)) {
+                    set_vertex_format(model, vertex_format);
+                }
+            }
+            add_imgui_vertex_memory_report();
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Geometry Arenas")) {
+            for (const auto& [vertex_type, arena]: arenas) {
+                auto stats = arena->get_stats();
+                ImGui::Text("%s: %zu models", arena->get_name().c_str(), stats.allocations);
+                ImGui::Text("    Vertices: %.1f / %.1f KiB, %.0f%% fragmented", (double) stats.vertex_bytes_used / 1024.0, (double) stats.vertex_bytes_capacity / 1024.0, stats.vertex_fragmentation * 100.0f);
+                ImGui::Text("    Indices: %.1f / %.1f KiB, %.0f%% fragmented, %.1f KiB saved by 16 bit", (double) stats.index_bytes_used / 1024.0, (double) stats.index_bytes_capacity / 1024.0, stats.index_fragmentation * 100.0f, (double) stats.index_bytes_saved / 1024.0);
+                ImGui::Text("    Grown %u times, defragmented %u times", stats.grow_count, stats.defragment_count);
+            }
+            if (ImGui::Button("Defragment Now")) {
+                for (const auto& [vertex_type, arena]: arenas) {
+                    arena->defragment();
+                }
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Mesh Optimisation")) {
+            if (ImGui::Button("Benchmark Optimisation")) {
+                run_optimisation_benchmark<EntityRenderer::VertexData>();
+            }
+            ImGui::TextDisabled("ACMR: vertex shader runs per triangle, ATVR: per vertex");
+            for (const auto& [file, report]: optimisation_reports) {
+                ImGui::Text("%s: %u tris, %u -> %u verts", file.c_str(), report.triangles, report.vertices_before, report.vertices_after);
+                ImGui::Text("    ACMR %.3f -> %.3f, ATVR %.3f -> %.3f (%.3f ms)", report.before.acmr, report.after.acmr, report.before.atvr, report.after.atvr, report.optimise_ms);
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Levels of Detail")) {
+            ImGui::TextDisabled("Triangles (and error, in model units) of each level, for models loaded with them");
+            for (const auto& [file, lods]: lod_reports) {
+                ImGui::Text("%s:", file.c_str());
+                for (auto level = 0u; level < lods.size(); ++level) {
+                    ImGui::SameLine();
+                    ImGui::Text("%s%u (%.4f)", level == 0 ? "" : "-> ", lods[level].index_count / 3, lods[level].error);
+                }
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("OBJ Parsing")) {
+            if (ImGui::Button("Benchmark OBJ Parser")) {
+                run_obj_benchmark<EntityRenderer::VertexData>();
+            }
+            ImGui::TextDisabled("Native parser on %u threads, and on one, against Assimp", parse_pool.get_thread_count());
+            for (const auto& [file, mb, parallel_ms, serial_ms, assimp_ms]: obj_benchmark_results) {
+                ImGui::Text("%s (%.2f MB): %.1f MB/s, serial %.1f MB/s, assimp %.1f MB/s (%.1fx)", file.c_str(), mb,
+                            mb / (parallel_ms / 1000.0), mb / (serial_ms / 1000.0), mb / (assimp_ms / 1000.0), parallel_ms > 0.0 ? assimp_ms / parallel_ms : 0.0);
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Skin Weights")) {
+            if (ImGui::Button("Benchmark Skin Weights")) {
+                skin_weight_benchmark = SkinWeights::run_benchmark(parse_pool);
+            }
+            ImGui::TextDisabled("Top %u influences per vertex, on a generated skinned mesh", SkinWeights::MAX_INFLUENCES);
+            if (skin_weight_benchmark.has_value()) {
+                const auto& result = skin_weight_benchmark.value();
+                ImGui::Text("%u meshes, %u vertices, %u influences", result.meshes, result.vertices, result.influences);
+                ImGui::Text("    std::map %.3f ms, flat %.3f ms (%.1fx), parallel %.3f ms (%.1fx)", result.reference_ms,
+                            result.serial_ms, result.serial_ms > 0.0 ? result.reference_ms / result.serial_ms : 0.0,
+                            result.parallel_ms, result.parallel_ms > 0.0 ? result.reference_ms / result.parallel_ms : 0.0);
+                ImGui::Text("    Weights %s", result.identical ? "bit-identical" : "differ");
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Animation Sampling")) {
+            if (ImGui::Button("Benchmark Keyframe Sampling")) {
+                animation_sampling_benchmark = AnimationSampling::run_benchmark();
+            }
+            ImGui::TextDisabled("Generated looping channels, sampled forwards frame by frame");
+            if (animation_sampling_benchmark.has_value()) {
+                const auto& result = animation_sampling_benchmark.value();
+                ImGui::Text("%u channels, %u keys per track, %u frames", result.channels, result.keys_per_track, result.frames);
+                ImGui::Text("    std::map %.3f ms, binary search %.3f ms (%.1fx), cursors %.3f ms (%.1fx)", result.map_ms,
+                            result.search_ms, result.search_ms > 0.0 ? result.map_ms / result.search_ms : 0.0,
+                            result.cursor_ms, result.cursor_ms > 0.0 ? result.map_ms / result.cursor_ms : 0.0);
+                ImGui::Text("    Poses %s", result.identical ? "bit-identical" : "differ");
+            }
+            ImGui::TreePop();
+        }
+    }
+}
@@ -6,6 +6,11 @@
 #include <utility>
 #include <vector>
 #include <memory>
+#include <chrono>
+#include <atomic>
+#include <future>
+#include <limits>
+#include <algorithm>
 #include <iostream>
 #include <string>
 #include <typeindex>
@@ -20,8 +25,19 @@
 
 #include <imgui/imgui.h>
 
+#include "MeshCache.h"
+#include "MeshOptimizer.h"
+#include "ObjParser.h"
+#include "Meshlets.h"
+#include "MeshSimplifier.h"
+#include "SkinWeights.h"
+#include "utility/Hash.h"
+#include "utility/ThreadPool.h"
+#include "utility/FileWatcher.h"
+#include "utility/ContentHashes.h"
 #include "ModelHandle.h"
 #include "MeshHierarchy.h"
+#include "ResidencyManager.h"
 
 struct VertexCollection {
     std::vector<glm::vec3> positions;
@@ -31,33 +47,173 @@ struct VertexCollection {
     std::vector<std::pair<glm::vec4, glm::uvec4>> bones;
 };
 
-/// A loader class intended for the use of loading models from disk. Includes caching functionality.
+/// The CPU side result of loading a model file, produced without touching OpenGL so it can be done on a worker thread.
+template<typename VertexData>
+struct ParsedModel {
+    // Set if the model came from the mesh cache, in which case vertices and indices are empty
+    std::optional<CachedModel<VertexData>> cached_model{};
+    std::vector<VertexData> vertices{};
+    std::vector<uint> indices{};
+    // Empty if the model wasn't split into meshlets
+    std::vector<Meshlets::Meshlet> meshlets{};
+    // Empty if no simplified levels of detail were generated, otherwise starting with the full detail one
+    std::vector<MeshSimplifier::Lod> lods{};
+    // Set if the model was imported and optimised
+    std::optional<MeshOptimizer::Report> optimisation_report{};
+    // Of the file's contents, see ContentHashes
+    uint64_t content_hash = 0;
+    std::chrono::steady_clock::time_point start{};
+};
+
+/// The CPU side result of loading a model file as a hierarchy, the ModelInfo::model handles are only set once uploaded.
+template<typename VertexData>
+struct ParsedHierarchy {
+    std::shared_ptr<MeshHierarchy<VertexData>> mesh_hierarchy{};
+    // [index into mesh_hierarchy->meshes] -> (vertices, indices)
+    std::vector<std::pair<std::vector<VertexData>, std::vector<uint>>> mesh_data{};
+    bool from_cache = false;
+    uint64_t content_hash = 0;
+    std::chrono::steady_clock::time_point start{};
+};
+
+/// A loader class intended for the use of loading models from disk. Includes caching functionality,
+/// both in memory (shared handles) and on disk (processed mesh data, see MeshCache).
+/// Files are identified by the hash of their contents as well as their path, so files with the same contents share one allocation on the GPU.
 class ModelLoader {
     std::string import_path;
     Assimp::Importer importer{};
+    MeshCache mesh_cache;
+    // Hashes of each file's contents, that the mesh_cache and content_index are keyed on.
+    // Mutable since it is only a (thread safe) memo, used by the const parse functions.
+    mutable ContentHashes content_hashes{};
+    // Keeps released models resident up to a budget, shared with the TextureLoader
+    ResidencyManager& residency_manager;
+    // Indexes the files under import_path, and reports when they change so live models can be hot reloaded
+    FileWatcher& file_watcher;
+
+    struct LoadStats {
+        uint cold_loads = 0;
+        double cold_total_ms = 0.0;
+        uint warm_loads = 0;
+        double warm_total_ms = 0.0;
+        // Across every upload, compared to if all indices were 32 bit
+        size_t index_bytes_saved = 0;
+        std::optional<std::tuple<std::string, bool, double>> last_load{};
+    };
+    LoadStats load_stats{};
+    // [(file, cold_ms, warm_ms)]
+    std::vector<std::tuple<std::string, double, double>> benchmark_results{};
+
+    // MeshCache processing flags, set when imported meshes are run through the MeshOptimizer, when .obj files are parsed by the ObjParser,
+    // when models are split into meshlets, and when they have simplified levels of detail generated
+    static constexpr uint64_t PROCESSING_OPTIMISED = 1 << 0;
+    static constexpr uint64_t PROCESSING_NATIVE_OBJ = 1 << 1;
+    static constexpr uint64_t PROCESSING_MESHLETS = 1 << 2;
+    static constexpr uint64_t PROCESSING_LODS = 1 << 3;
+    // Atomic since these are read by loads running on worker threads
+    std::atomic<bool> optimise_meshes = true;
+    std::atomic<bool> native_obj = true;
+    std::atomic<bool> build_meshlets = true;
+    std::atomic<bool> generate_lods = true;
+    // { file } -> { report from when it was last imported }
+    std::map<std::string, MeshOptimizer::Report> optimisation_reports{};
+    // { file } -> [levels of detail it was last loaded with]
+    std::map<std::string, std::vector<MeshSimplifier::Lod>> lod_reports{};
+    // [(file, MB, parallel_ms, serial_ms, assimp_ms)]
+    std::vector<std::tuple<std::string, double, double, double, double>> obj_benchmark_results{};
+    std::optional<SkinWeights::BenchmarkResult> skin_weight_benchmark{};
+    std::optional<AnimationSampling::BenchmarkResult> animation_sampling_benchmark{};
+
+    // The vertex format models are uploaded in, unless overridden for the file in vertex_formats
+    VertexFormat default_vertex_format = VertexFormat::Full;
+    // { file } -> { vertex format }
+    std::unordered_map<std::string, VertexFormat> vertex_formats{};
+
+    // Assimp::Importer is not thread safe, so each worker gets its own
+    std::vector<std::unique_ptr<Assimp::Importer>> worker_importers{};
+    // Map gpu_vertex_type -> arena that every model with that vertex type is sub-allocated from
+    std::unordered_map<std::type_index, std::shared_ptr<GeometryArena>> arenas{};
+    // Map vertex_type -> function to hot reload a live model of that type (with the file name), registered on its first load
+    std::unordered_map<std::type_index, std::function<void(const std::string&, const std::shared_ptr<BaseModelHandle>&)>> model_reloaders{};
+    // Map vertex_type -> placeholder handle, drawn in place of models that are still loading
+    std::unordered_map<std::type_index, std::shared_ptr<BaseModelHandle>> placeholders{};
+    // Polled each update() on the GL thread, returning true once the load has been finalised (or failed)
+    std::vector<std::function<bool()>> pending_loads{};
 
     std::optional<std::vector<std::string>> available_models{};
 
     // Map (relative_path, vertex_type) -> (last_modified, weak_handle)
     std::unordered_map<std::pair<std::string, std::type_index>, std::pair<std::filesystem::file_time_type, std::weak_ptr<BaseModelHandle>>, PairHash> cache{};
     std::unordered_map<std::pair<std::string, std::type_index>, std::pair<std::filesystem::file_time_type, std::weak_ptr<BaseMeshHierarchy>>, PairHash> hierarchy_cache{};
+
+    // { content_key } -> { the model uploaded with that content, vertex type and format }, so that other loads of the same content can share it
+    std::unordered_map<uint64_t, std::weak_ptr<BaseModelHandle>> content_index{};
+    size_t shared_loads = 0;
+
+    // Declared last, so the workers are joined before anything their tasks reference is destroyed.
+    // The ObjParser splits files across parse_pool, which is separate so that loads on worker_pool can wait on it without starving themselves.
+    mutable ThreadPool parse_pool{};
+    ThreadPool worker_pool{};
+
+    [[nodiscard]] uint64_t get_processing_flags() const;
 public:
     /// Construct the loader with a import_path which is prepended to any path you try and load.
     /// It also scans the directory for all files, which is used to populate the list of get_available_models()
-    explicit ModelLoader(std::string import_path) : import_path(std::move(import_path)) {}
+    /// Processed models are cached on disk under cache_path, so later runs can skip importing them.
+    /// Loaded models are tracked by the residency_manager, which keeps them loaded for a while after they are released.
+    /// Files are looked up through the file_watcher (which must be watching import_path to be of any use),
+    /// and live models are reloaded in place when their file is modified.
+    ModelLoader(std::string import_path, const std::string& cache_path, ResidencyManager& residency_manager, FileWatcher& file_watcher);
 
     /// Loads the provided model data into GPU memory
     template<typename VertexData>
-    static std::shared_ptr<ModelHandle<VertexData>> load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename = {});
+    std::shared_ptr<ModelHandle<VertexData>> load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename = {}, VertexFormat vertex_format = VertexFormat::Full);
+
+    /// Loads the provided model data into GPU memory, the data only needs to remain valid for the duration of the call.
+    /// With VertexFormat::Compact, the vertices are converted to VertexData::Compact before uploading.
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> load_from_data(const VertexData* vertices, size_t vertex_count, const uint* indices, size_t index_count, std::optional<std::string> filename = {}, VertexFormat vertex_format = VertexFormat::Full);
 
     /// Loads the file specified from disk into GPU memory
     template<typename VertexData>
     std::shared_ptr<ModelHandle<VertexData>> load_from_file(const std::string& file);
 
+    /// Start loading the file specified on a worker thread, returning a handle straight away.
+    /// Until the load finishes (see update()), the handle draws a placeholder mesh and is_ready() returns false.
+    /// Failures are reported to std::cerr, and leave the placeholder in place (but with is_ready() returning true).
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> load_from_file_async(const std::string& file);
+
+    /// Finalise any asynchronous loads that have finished parsing, by uploading them to the GPU,
+    /// and defragment any geometry arenas that models have been freed from.
+    /// Must be called on the GL thread, once a frame.
+    void update();
+
     /// Load the file specified, as a hierarchy of meshes, for use with animated models.
     template<typename VertexData>
     std::shared_ptr<MeshHierarchy<VertexData>> load_hierarchy_from_file(const std::string& file);
 
+    /// Start loading the file specified as a hierarchy on a worker thread.
+    /// The future is set by update() once the meshes are uploaded, after which load_hierarchy_from_file is served from the in-memory cache
+    /// for as long as the result is kept alive.
+    template<typename VertexData>
+    std::shared_future<std::shared_ptr<MeshHierarchy<VertexData>>> load_hierarchy_from_file_async(const std::string& file);
+
+    /// Forget every model in the in-memory cache (without freeing them), so the next loads go back to disk.
+    void clear_memory_cache();
+
+    /// A new loader over the same import_path, with the same settings, but with its own caches (the disk one under cache_path),
+    /// so that loads can be benchmarked without disturbing this loader's models. The residency_manager and file_watcher must outlive it.
+    [[nodiscard]] std::unique_ptr<ModelLoader> create_isolated(const std::string& cache_path, ResidencyManager& isolated_residency_manager, FileWatcher& isolated_file_watcher) const;
+
+    [[nodiscard]] const std::string& get_import_path() const { return import_path; }
+
+    /// The vertex format the file will be uploaded with
+    VertexFormat get_vertex_format(const std::string& file) const;
+
+    /// Choose the vertex format for a file, which applies from its next load from disk (so it is evicted from the in-memory cache).
+    void set_vertex_format(const std::string& file, VertexFormat vertex_format);
+
     /// Helper method to provide a selector over all the model files in the import_path directory.
     template<typename VertexData>
     bool add_imgui_model_selector(const std::string& caption, std::shared_ptr<ModelHandle<VertexData>>& model_handle);
@@ -67,62 +223,325 @@ public:
     bool add_imgui_hierarchy_selector(const std::string& caption, std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy);
 
     /// Helper method to provide a selector over all the model files in the import_path directory.
-    /// if force_refresh is selected, it will rescan the directory, otherwise it just uses a cached list from the last scan.
+    /// if force_refresh is selected, it will re-list the directory, otherwise it just uses a cached list, which is kept up to date by the file_watcher.
     const std::vector<std::string>& get_available_models(bool force_refresh = false);
 
+    /// Adds the ImGUI controls for the loader (load timings and the mesh cache) to the current ImGUI window
+    void add_imgui_options_section();
+
     /// Free up any resources.
     void cleanup() {}
 
 private:
+    /// The key a model or hierarchy is tracked under by the residency_manager
+    template<typename VertexData>
+    static std::string residency_key(const std::string& kind, const std::string& file);
+
+    /// Find the last write time of a file under import_path, throwing if it doesn't exist
+    std::filesystem::file_time_type get_last_write_time(const std::string& file) const;
+
+    /// Hot reload live models from a file that has changed, or forget them if it was removed
+    void on_file_changed(const FileWatcher::Change& change);
+
+    /// Add a model just loaded from disk to the in-memory cache and the residency_manager
+    template<typename VertexData>
+    void track_model(const std::string& file, std::filesystem::file_time_type last_write_time, const std::shared_ptr<ModelHandle<VertexData>>& model);
+
+    /// Parse the file on a worker thread, and then (from update()) upload it and update model in place.
+    /// If this fails, a model that is still loading is left drawing the placeholder, otherwise the previous version is kept.
+    template<typename VertexData>
+    void start_model_load(const std::string& file, const std::shared_ptr<ModelHandle<VertexData>>& model);
+
+    /// Look up an up-to-date model in the in-memory cache
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> find_cached_model(const std::string& file, std::filesystem::file_time_type last_write_time);
+
+    /// Load a model bypassing the in-memory cache, from model_cache (normally the mesh_cache) if possible, otherwise through Assimp.
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> load_model_from_disk(const std::string& file, const std::string& path, const MeshCache& model_cache);
+
+    /// The OpenGL free part of load_model_from_disk, safe to call from any thread given an importer only it is using.
+    template<typename VertexData>
+    ParsedModel<VertexData> parse_model(const std::string& file, const std::string& path, Assimp::Importer& file_importer, const MeshCache& model_cache) const;
+
+    /// The arena that models with vertices of type GpuVertexData (which may be a Compact type) are allocated in
+    template<typename GpuVertexData>
+    std::shared_ptr<GeometryArena> get_arena();
+
+    /// Show how much memory the loaded models' vertices take, compared to if they were all in VertexFormat::Full
+    void add_imgui_vertex_memory_report();
+
+    /// Upload a parsed model to the GPU, must be called on the GL thread.
+    /// If a live model (other than reloading) has the same contents, the returned handle shares it instead. Either way the handle isn't registered in the content_index yet.
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> upload_parsed_model(const std::string& file, const ParsedModel<VertexData>& parsed_model, const BaseModelHandle* reloading = nullptr);
+
+    /// Identifies the contents of a file (or one mesh of it), combined with the vertex type and format it is uploaded with, to key the content_index
+    template<typename VertexData>
+    static uint64_t content_key(uint64_t content_hash, VertexFormat vertex_format);
+    /// A live model holding the content key, owning its allocation, for another handle (than the given one, if any) to share, or nullptr if there is none
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> find_shared_model(uint64_t content_key, const BaseModelHandle* handle);
+    /// Record the model as holding its content key, unless another live model already does
+    template<typename VertexData>
+    void register_content(const std::shared_ptr<ModelHandle<VertexData>>& model);
+    /// Load the mesh data, unless a live model holds the content key, in which case share it instead
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> load_or_share(uint64_t content_key, const VertexData* vertices, size_t vertex_count, const uint* indices, size_t index_count,
+                                                           std::optional<std::string> filename, VertexFormat vertex_format, const BaseModelHandle* reloading = nullptr);
+
+    /// Get (creating if needed) the placeholder mesh for VertexData
+    template<typename VertexData>
+    std::shared_ptr<ModelHandle<VertexData>> get_placeholder();
+
+    /// A small cube, with every attribute filled in so that any VertexData type can be made from it
+    static VertexCollection placeholder_mesh(std::vector<uint>& indices);
+
+    /// Look up an up-to-date hierarchy in the in-memory cache
+    template<typename VertexData>
+    std::shared_ptr<MeshHierarchy<VertexData>> find_cached_hierarchy(const std::string& file, std::filesystem::file_time_type last_write_time);
+
+    /// Load a hierarchy bypassing the in-memory cache, from the mesh cache if possible, otherwise through Assimp.
+    template<typename VertexData>
+    std::shared_ptr<MeshHierarchy<VertexData>> load_hierarchy_from_disk(const std::string& file, const std::string& path);
+
+    /// The OpenGL free part of load_hierarchy_from_disk, safe to call from any thread given an importer only it is using.
+    template<typename VertexData>
+    ParsedHierarchy<VertexData> parse_hierarchy(const std::string& file, const std::string& path, Assimp::Importer& file_importer) const;
+
+    /// Upload the meshes of a parsed hierarchy to the GPU, must be called on the GL thread.
+    template<typename VertexData>
+    std::shared_ptr<MeshHierarchy<VertexData>> upload_parsed_hierarchy(const std::string& file, const ParsedHierarchy<VertexData>& parsed_hierarchy);
+
+    void record_load(const std::string& file, bool from_cache, std::chrono::steady_clock::time_point start);
+
+    /// Time loading every available model with an empty mesh cache (cold), and then again once it is populated (warm).
+    /// Uses its own cache in the temp directory, so the real one is left as it was.
+    template<typename VertexData>
+    void run_load_benchmark();
+
+    /// Import every available model, bypassing the mesh cache, and run it through the MeshOptimizer, recording the reports.
+    template<typename VertexData>
+    void run_optimisation_benchmark();
+
+    /// Time parsing every available .obj file with the ObjParser (split across parse_pool, and on one thread) against importing it through Assimp,
+    /// bypassing the mesh cache, and report the throughput of each.
+    template<typename VertexData>
+    void run_obj_benchmark();
+
+    /// Import a file through Assimp as a single flattened mesh
+    template<typename VertexData>
+    static void import_model(const std::string& file, const std::string& path, Assimp::Importer& file_importer, std::vector<VertexData>& vertices, std::vector<uint>& indices);
+
     template<typename VertexData>
     static void load_node(const aiScene* scene, const aiNode* node, std::vector<VertexData>& vertices, std::vector<uint>& indices, glm::mat4 parent_transform);
 };
 
 template<typename VertexData>
-std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename) {
-    uint vao;
-    glGenVertexArrays(1, &vao);
-    glBindVertexArray(vao);
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_data(const std::vector<VertexData>& vertices, const std::vector<uint>& indices, std::optional<std::string> filename, VertexFormat vertex_format) {
+    return load_from_data(vertices.data(), vertices.size(), indices.data(), indices.size(), std::move(filename), vertex_format);
+}
 
-    uint vertex_vbo;
-    glGenBuffers(1, &vertex_vbo);
-    glBindBuffer(GL_ARRAY_BUFFER, vertex_vbo);
-    glBufferData(GL_ARRAY_BUFFER, (long) (sizeof(VertexData) * vertices.size()), vertices.data(), GL_STATIC_DRAW);
-    VertexData::setup_attrib_pointers();
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_data(const VertexData* vertices, size_t vertex_count, const uint* indices, size_t index_count, std::optional<std::string> filename, VertexFormat vertex_format) {
+    std::shared_ptr<GeometryArena> arena;
+    std::shared_ptr<GeometryArena::Allocation> allocation;
+
+    // The decode for the bounds is the centre and half extents of the model's box, which the bounding sphere is taken around
+    auto bounds = VertexDecode::for_bounds(vertices, vertex_count);
+    VertexDecode vertex_decode{};
+    if (vertex_format == VertexFormat::Compact) {
+        using CompactVertexData = typename VertexData::Compact;
+        vertex_decode = bounds;
+
+        std::vector<CompactVertexData> compact_vertices{};
+        compact_vertices.reserve(vertex_count);
+        for (auto i = 0u; i < vertex_count; ++i) {
+            compact_vertices.push_back(CompactVertexData::from_vertex(vertices[i], vertex_decode));
+        }
 
-    uint index_vbo;
-    glGenBuffers(1, &index_vbo);
-    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, index_vbo);
-    glBufferData(GL_ELEMENT_ARRAY_BUFFER, (long) (sizeof(uint) * indices.size()), indices.data(), GL_STATIC_DRAW);
+        arena = get_arena<CompactVertexData>();
+        allocation = arena->allocate(compact_vertices.data(), vertex_count, indices, index_count);
+    } else {
+        arena = get_arena<VertexData>();
+        allocation = arena->allocate(vertices, vertex_count, indices, index_count);
+    }
 
-    glBindVertexArray(0);
+    load_stats.index_bytes_saved += index_count * sizeof(uint) - allocation->index_count * allocation->get_index_size();
 
-    return std::make_shared<ModelHandle<VertexData>>(vertex_vbo, index_vbo, vao, (int) indices.size(), 0, std::move(filename));
+    auto model = std::make_shared<ModelHandle<VertexData>>(std::move(arena), std::move(allocation), std::move(filename));
+    model->vertex_format = vertex_format;
+    model->vertex_decode = vertex_decode;
+    model->vertex_count = vertex_count;
+    model->bounding_sphere = glm::vec4(bounds.position_offset, glm::length(bounds.position_scale));
+    return model;
 }
 
-template<typename VertexData>
-std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_file(const std::string& file) {
-    auto path = import_path + "/" + file;
-    if (!std::filesystem::exists(path)) {
-        throw std::runtime_error(Formatter() << "Failed to load model (" << path << "): \n\t File does not exist");
+template<typename GpuVertexData>
+std::shared_ptr<GeometryArena> ModelLoader::get_arena() {
+    auto& arena = arenas[std::type_index(typeid(GpuVertexData))];
+    if (arena == nullptr) {
+        arena = std::make_shared<GeometryArena>(Formatter() << sizeof(GpuVertexData) << " byte vertices", sizeof(GpuVertexData), &GpuVertexData::setup_attrib_pointers);
     }
+    return arena;
+}
 
-    auto last_write_time = std::filesystem::last_write_time(path);
+template<typename VertexData>
+std::string ModelLoader::residency_key(const std::string& kind, const std::string& file) {
+    return Formatter() << kind << ":" << typeid(VertexData).name() << ":" << file;
+}
 
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::find_cached_model(const std::string& file, std::filesystem::file_time_type last_write_time) {
     auto existing = cache.find({file, std::type_index(typeid(VertexData))});
     if (existing != cache.end()) {
         // Cache exist, so try lock
         auto handle = existing->second.second.lock();
         if (handle != nullptr && existing->second.first >= last_write_time) {
             // Lock was successful and the cache is for an up-to-date version of the file, so can use it
+            residency_manager.touch(residency_key<VertexData>("model", file));
             return std::dynamic_pointer_cast<ModelHandle<VertexData>>(handle);
         }
     }
+    return nullptr;
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_file(const std::string& file) {
+    auto last_write_time = get_last_write_time(file);
+
+    auto cached = find_cached_model<VertexData>(file, last_write_time);
+    if (cached != nullptr) {
+        return cached;
+    }
+
+    auto model = load_model_from_disk<VertexData>(file, import_path + "/" + file, mesh_cache);
+    track_model(file, last_write_time, model);
+
+    return model;
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_file_async(const std::string& file) {
+    auto last_write_time = get_last_write_time(file);
+
+    // This also picks up loads that are still in progress, so the same file is never parsed twice at once
+    auto cached = find_cached_model<VertexData>(file, last_write_time);
+    if (cached != nullptr) {
+        return cached;
+    }
+
+    auto model = ModelHandle<VertexData>::make_pending(*get_placeholder<VertexData>(), file);
+    track_model(file, last_write_time, model);
+    start_model_load(file, model);
+
+    return model;
+}
+
+template<typename VertexData>
+void ModelLoader::track_model(const std::string& file, std::filesystem::file_time_type last_write_time, const std::shared_ptr<ModelHandle<VertexData>>& model) {
+    cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, model};
+    residency_manager.track(residency_key<VertexData>("model", file), model);
+
+    model_reloaders.try_emplace(std::type_index(typeid(VertexData)), [this](const std::string& file, const std::shared_ptr<BaseModelHandle>& handle) {
+        start_model_load(file, std::dynamic_pointer_cast<ModelHandle<VertexData>>(handle));
+    });
+}
+
+template<typename VertexData>
+void ModelLoader::start_model_load(const std::string& file, const std::shared_ptr<ModelHandle<VertexData>>& model) {
+    auto parsed_model = worker_pool.submit([this, file, path = import_path + "/" + file]() {
+        return parse_model<VertexData>(file, path, *worker_importers[ThreadPool::get_worker_index().value()], mesh_cache);
+    }).share();
+
+    pending_loads.emplace_back([this, file, parsed_model, weak_model = std::weak_ptr(model)]() {
+        if (parsed_model.wait_for(std::chrono::seconds{0}) != std::future_status::ready) return false;
+
+        auto model = weak_model.lock();
+        // Nothing is using the model anymore, so no need to upload it
+        if (model == nullptr) return true;
+
+        try {
+            auto uploaded_model = upload_parsed_model(file, parsed_model.get(), model.get());
+            model->fulfill(*uploaded_model);
+            register_content(model);
+        } catch (const std::exception& e) {
+            std::cerr << "Error while asynchronously loading model:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            if (!model->is_ready()) {
+                // No longer loading, but keeps drawing the placeholder. Forget it, so that the next request tries again
+                model->ready = true;
+                cache.erase({file, std::type_index(typeid(VertexData))});
+            }
+        }
+        return true;
+    });
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_model_from_disk(const std::string& file, const std::string& path, const MeshCache& model_cache) {
+    auto model = upload_parsed_model(file, parse_model<VertexData>(file, path, importer, model_cache));
+    register_content(model);
+    return model;
+}
+
+template<typename VertexData>
+ParsedModel<VertexData> ModelLoader::parse_model(const std::string& file, const std::string& path, Assimp::Importer& file_importer, const MeshCache& model_cache) const {
+    ParsedModel<VertexData> parsed_model{};
+    parsed_model.start = std::chrono::steady_clock::now();
+
+    // Assimp reads the file itself (along with any files it references), so it is hashed separately, but only once per version of the file
+    parsed_model.content_hash = content_hashes.hash_file(path);
+    parsed_model.cached_model = model_cache.read_model<VertexData>(file, parsed_model.content_hash);
+    if (parsed_model.cached_model.has_value()) {
+        return parsed_model;
+    }
+
+    if (native_obj && ObjParser::can_parse(path)) {
+        auto mesh = ObjParser::parse(path, &parse_pool);
+        VertexData::from_mesh(VertexCollection{std::move(mesh.positions), std::move(mesh.normals), std::move(mesh.tex_coords), {}}, parsed_model.vertices);
+        parsed_model.indices = std::move(mesh.indices);
+    } else {
+        import_model(file, path, file_importer, parsed_model.vertices, parsed_model.indices);
+    }
+
+    if (optimise_meshes) {
+        parsed_model.optimisation_report = MeshOptimizer::optimise(parsed_model.vertices, parsed_model.indices);
+    }
+
+    // Hierarchies are animated, so their bind pose bounds and simplifications wouldn't hold, but flat models are static
+    auto triangles = parsed_model.indices.size() / 3;
+    bool split_meshlets = build_meshlets && triangles >= Meshlets::MIN_MODEL_TRIANGLES;
+    bool simplify = generate_lods && triangles >= 2 * MeshSimplifier::MIN_LOD_TRIANGLES;
+    if (split_meshlets || simplify) {
+        std::vector<glm::vec3> positions{};
+        positions.reserve(parsed_model.vertices.size());
+        for (const auto& vertex: parsed_model.vertices) {
+            positions.push_back(vertex.position);
+        }
+        if (split_meshlets) {
+            parsed_model.meshlets = Meshlets::build(parsed_model.indices, positions);
+        }
+        // The simplified levels are appended after the full detail triangles, which the meshlets' ranges cover
+        if (simplify) {
+            parsed_model.lods = MeshSimplifier::build_lods(parsed_model.indices, positions);
+            if (parsed_model.lods.size() <= 1) parsed_model.lods.clear();
+        }
+        // The triangles have been reordered, so put the vertices back in the order they are first used
+        MeshOptimizer::optimise_vertex_fetch(parsed_model.vertices, parsed_model.indices);
+    }
+
+    model_cache.write_model(file, parsed_model.content_hash, parsed_model.vertices, parsed_model.indices, parsed_model.meshlets, parsed_model.lods);
+
+    return parsed_model;
+}
 
-    const aiScene* scene = importer.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_TransformUVCoords | aiProcess_SortByPType);
+template<typename VertexData>
+void ModelLoader::import_model(const std::string& file, const std::string& path, Assimp::Importer& file_importer, std::vector<VertexData>& vertices, std::vector<uint>& indices) {
+    const aiScene* scene = file_importer.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_TransformUVCoords | aiProcess_SortByPType);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << importer.GetErrorString());
+        throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << file_importer.GetErrorString());
     }
 
     if (scene->mNumMeshes == 0) {
@@ -140,20 +559,103 @@ std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_from_file(const std::
         throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << "No triangle meshes");
     }
 
-    std::vector<VertexData> vertices{};
-    std::vector<uint> indices{};
-
     load_node(scene, scene->mRootNode, vertices, indices, glm::mat4{1.0f});
 
-    auto model = load_from_data(vertices, indices, file);
+    file_importer.FreeScene();
+}
+
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::upload_parsed_model(const std::string& file, const ParsedModel<VertexData>& parsed_model, const BaseModelHandle* reloading) {
+    auto vertex_format = get_vertex_format(file);
+    auto key = content_key<VertexData>(parsed_model.content_hash, vertex_format);
+    std::shared_ptr<ModelHandle<VertexData>> model;
+    if (parsed_model.cached_model.has_value()) {
+        // Upload straight from the mapped file
+        const auto& cached_model = parsed_model.cached_model.value();
+        model = load_or_share(key, cached_model.vertices, cached_model.vertex_count, cached_model.indices, cached_model.index_count, file, vertex_format, reloading);
+        if (model->get_shared_with() == nullptr && cached_model.meshlet_count > 0) {
+            model->meshlets = std::make_shared<const std::vector<Meshlets::Meshlet>>(cached_model.meshlets, cached_model.meshlets + cached_model.meshlet_count);
+        }
+        if (model->get_shared_with() == nullptr && cached_model.lod_count > 0) {
+            model->lods = std::make_shared<const std::vector<MeshSimplifier::Lod>>(cached_model.lods, cached_model.lods + cached_model.lod_count);
+        }
+    } else {
+        model = load_or_share(key, parsed_model.vertices.data(), parsed_model.vertices.size(), parsed_model.indices.data(), parsed_model.indices.size(), file, vertex_format, reloading);
+        // Shared models already have the meshlets and levels of detail of the model they share
+        if (model->get_shared_with() == nullptr && !parsed_model.meshlets.empty()) {
+            model->meshlets = std::make_shared<const std::vector<Meshlets::Meshlet>>(parsed_model.meshlets);
+        }
+        if (model->get_shared_with() == nullptr && !parsed_model.lods.empty()) {
+            model->lods = std::make_shared<const std::vector<MeshSimplifier::Lod>>(parsed_model.lods);
+        }
+    }
+    if (model->get_lods() != nullptr) {
+        lod_reports[file] = *model->get_lods();
+    } else {
+        lod_reports.erase(file);
+    }
+    if (parsed_model.optimisation_report.has_value()) {
+        optimisation_reports[file] = parsed_model.optimisation_report.value();
+    }
+    record_load(file, parsed_model.cached_model.has_value(), parsed_model.start);
+    return model;
+}
+
+template<typename VertexData>
+uint64_t ModelLoader::content_key(uint64_t content_hash, VertexFormat vertex_format) {
+    return Hash::combine(Hash::combine(content_hash, Hash::fnv1a(std::string{typeid(VertexData).name()})), (uint64_t) vertex_format);
+}
 
-    importer.FreeScene();
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::find_shared_model(uint64_t content_key, const BaseModelHandle* handle) {
+    auto entry = content_index.find(content_key);
+    if (entry == content_index.end()) return nullptr;
+
+    auto owner = std::dynamic_pointer_cast<ModelHandle<VertexData>>(entry->second.lock());
+    // Stale if the model has since been reloaded with other contents, or is now sharing another's allocation itself
+    if (owner == nullptr || owner.get() == handle || owner->content_key != content_key || !owner->owns_allocation) return nullptr;
+    return owner;
+}
 
-    cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, model};
+template<typename VertexData>
+void ModelLoader::register_content(const std::shared_ptr<ModelHandle<VertexData>>& model) {
+    if (model->content_key == 0 || find_shared_model<VertexData>(model->content_key, model.get()) != nullptr) return;
+
+    // Forget any models that have since been destroyed while here, so that the index doesn't keep growing
+    for (auto it = content_index.begin(); it != content_index.end();) {
+        it = it->second.expired() ? content_index.erase(it) : std::next(it);
+    }
+    content_index[model->content_key] = model;
+}
 
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::load_or_share(uint64_t content_key, const VertexData* vertices, size_t vertex_count, const uint* indices, size_t index_count,
+                                                                    std::optional<std::string> filename, VertexFormat vertex_format, const BaseModelHandle* reloading) {
+    auto owner = find_shared_model<VertexData>(content_key, reloading);
+    if (owner != nullptr) {
+        auto model = ModelHandle<VertexData>::make_pending(*owner, std::move(filename));
+        model->share(owner);
+        ++shared_loads;
+        return model;
+    }
+
+    auto model = load_from_data(vertices, vertex_count, indices, index_count, std::move(filename), vertex_format);
+    model->content_key = content_key;
     return model;
 }
 
+template<typename VertexData>
+std::shared_ptr<ModelHandle<VertexData>> ModelLoader::get_placeholder() {
+    auto& placeholder = placeholders[std::type_index(typeid(VertexData))];
+    if (placeholder == nullptr) {
+        std::vector<VertexData> vertices{};
+        std::vector<uint> indices{};
+        VertexData::from_mesh(placeholder_mesh(indices), vertices);
+        placeholder = load_from_data(vertices, indices);
+    }
+    return std::dynamic_pointer_cast<ModelHandle<VertexData>>(placeholder);
+}
+
 template<typename VertexData>
 void ModelLoader::load_node(const aiScene* scene, const aiNode* node, std::vector<VertexData>& vertices, std::vector<uint>& indices, glm::mat4 parent_transform) {
     glm::mat4 node_transform;
@@ -213,27 +715,118 @@ void ModelLoader::load_node(const aiScene* scene, const aiNode* node, std::vecto
 }
 
 template<typename VertexData>
-std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file(const std::string& file) {
-    auto path = import_path + "/" + file;
-    if (!std::filesystem::exists(path)) {
-        throw std::runtime_error(Formatter() << "Failed to load model (" << path << "): \n\t File does not exist");
-    }
-    auto last_write_time = std::filesystem::last_write_time(path);
-
+std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::find_cached_hierarchy(const std::string& file, std::filesystem::file_time_type last_write_time) {
     auto existing = hierarchy_cache.find({file, std::type_index(typeid(VertexData))});
     if (existing != hierarchy_cache.end()) {
         // Cache exist, so try lock
         auto handle = existing->second.second.lock();
         if (handle != nullptr && existing->second.first >= last_write_time) {
             // Lock was successful and the cache is for an up-to-date version of the file, so can use it
+            residency_manager.touch(residency_key<VertexData>("hierarchy", file));
             return std::dynamic_pointer_cast<MeshHierarchy<VertexData>>(handle);
         }
     }
+    return nullptr;
+}
+
+template<typename VertexData>
+std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file(const std::string& file) {
+    auto last_write_time = get_last_write_time(file);
+
+    auto cached = find_cached_hierarchy<VertexData>(file, last_write_time);
+    if (cached != nullptr) {
+        return cached;
+    }
+
+    auto mesh_hierarchy = load_hierarchy_from_disk<VertexData>(file, import_path + "/" + file);
+
+    hierarchy_cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, mesh_hierarchy};
+    residency_manager.track(residency_key<VertexData>("hierarchy", file), mesh_hierarchy);
+
+    return mesh_hierarchy;
+}
+
+template<typename VertexData>
+std::shared_future<std::shared_ptr<MeshHierarchy<VertexData>>> ModelLoader::load_hierarchy_from_file_async(const std::string& file) {
+    auto last_write_time = get_last_write_time(file);
+
+    auto promise = std::make_shared<std::promise<std::shared_ptr<MeshHierarchy<VertexData>>>>();
+    auto result = promise->get_future().share();
+
+    auto cached = find_cached_hierarchy<VertexData>(file, last_write_time);
+    if (cached != nullptr) {
+        promise->set_value(cached);
+        return result;
+    }
+
+    auto parsed_hierarchy = worker_pool.submit([this, file, path = import_path + "/" + file]() {
+        return parse_hierarchy<VertexData>(file, path, *worker_importers[ThreadPool::get_worker_index().value()]);
+    }).share();
+
+    pending_loads.emplace_back([this, file, last_write_time, parsed_hierarchy, promise]() {
+        if (parsed_hierarchy.wait_for(std::chrono::seconds{0}) != std::future_status::ready) return false;
+
+        try {
+            // Another load may have finished first while this one was parsing, in which case use that one
+            auto mesh_hierarchy = find_cached_hierarchy<VertexData>(file, last_write_time);
+            if (mesh_hierarchy == nullptr) {
+                mesh_hierarchy = upload_parsed_hierarchy(file, parsed_hierarchy.get());
+                hierarchy_cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, mesh_hierarchy};
+                residency_manager.track(residency_key<VertexData>("hierarchy", file), mesh_hierarchy);
+            }
+            promise->set_value(mesh_hierarchy);
+        } catch (...) {
+            promise->set_exception(std::current_exception());
+        }
+        return true;
+    });
+
+    return result;
+}
+
+template<typename VertexData>
+std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_disk(const std::string& file, const std::string& path) {
+    return upload_parsed_hierarchy(file, parse_hierarchy<VertexData>(file, path, importer));
+}
+
+template<typename VertexData>
+std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::upload_parsed_hierarchy(const std::string& file, const ParsedHierarchy<VertexData>& parsed_hierarchy) {
+    auto& mesh_hierarchy = parsed_hierarchy.mesh_hierarchy;
+    auto vertex_format = get_vertex_format(file);
+    for (auto mesh_i = 0u; mesh_i < mesh_hierarchy->meshes.size(); ++mesh_i) {
+        const auto& [vertices, indices] = parsed_hierarchy.mesh_data[mesh_i];
+        // Each mesh is keyed on its index in the file, so that the meshes of hierarchies from files with the same contents are shared
+        auto key = content_key<VertexData>(Hash::combine(parsed_hierarchy.content_hash, mesh_i), vertex_format);
+        auto model = load_or_share(key, vertices.data(), vertices.size(), indices.data(), indices.size(), std::nullopt, vertex_format);
+        register_content(model);
+        mesh_hierarchy->meshes[mesh_i].model = model;
+    }
+    record_load(file, parsed_hierarchy.from_cache, parsed_hierarchy.start);
+    return mesh_hierarchy;
+}
+
+template<typename VertexData>
+ParsedHierarchy<VertexData> ModelLoader::parse_hierarchy(const std::string& file, const std::string& path, Assimp::Importer& file_importer) const {
+    ParsedHierarchy<VertexData> parsed_hierarchy{};
+    parsed_hierarchy.start = std::chrono::steady_clock::now();
+    auto& mesh_data = parsed_hierarchy.mesh_data;
+
+    parsed_hierarchy.content_hash = content_hashes.hash_file(path);
+    // Copy the meshes out of the mapped file, they are uploaded later on the GL thread
+    parsed_hierarchy.mesh_hierarchy = mesh_cache.read_hierarchy<VertexData>(file, parsed_hierarchy.content_hash, [&mesh_data](const VertexData* vertices, size_t vertex_count, const uint* indices, size_t index_count) {
+        mesh_data.emplace_back(std::vector<VertexData>{vertices, vertices + vertex_count}, std::vector<uint>{indices, indices + index_count});
+        return std::shared_ptr<ModelHandle<VertexData>>{};
+    });
+    if (parsed_hierarchy.mesh_hierarchy != nullptr) {
+        parsed_hierarchy.from_cache = true;
+        return parsed_hierarchy;
+    }
+    mesh_data.clear();
 
-    const aiScene* scene = importer.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_TransformUVCoords | aiProcess_SortByPType);
+    const aiScene* scene = file_importer.ReadFile(path, aiProcessPreset_TargetRealtime_MaxQuality | aiProcess_TransformUVCoords | aiProcess_SortByPType);
 
     if (!scene || scene->mFlags & AI_SCENE_FLAGS_INCOMPLETE || !scene->mRootNode) {
-        throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << importer.GetErrorString());
+        throw std::runtime_error(Formatter() << "Failed to load model (" << file << "): \n\t" << file_importer.GetErrorString());
     }
 
     if (scene->mNumMeshes == 0) {
@@ -241,6 +834,7 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
     }
 
     auto mesh_hierarchy = std::make_shared<MeshHierarchy<VertexData>>(file);
+    parsed_hierarchy.mesh_hierarchy = mesh_hierarchy;
 
     // {index into scene->mMeshes} -> {index into mesh_hierarchy->models}
     std::unordered_map<uint, uint> mesh_index_map{};
@@ -251,69 +845,63 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
             continue;
         }
 
-        const auto v = reinterpret_cast<glm::vec3*>(mesh->mVertices);
-        const auto n = reinterpret_cast<glm::vec3*>(mesh->mNormals);
-        const auto t = reinterpret_cast<glm::vec3*>(mesh->mTextureCoords[0]);
-
         // { bone_name } -> { bone_id }
         std::unordered_map<std::string, uint> bone_names{};
-
-        // [vertex_id] -> (bone_weight -> bone_id)
-        std::vector<std::map<float, std::set<uint>>> bone_weights_total{};
-        bone_weights_total.resize(mesh->mNumVertices, {});
         for (auto bone_i = 0u; bone_i < mesh->mNumBones; ++bone_i) {
             const auto* bone = mesh->mBones[bone_i];
             bone_names[bone->mName.C_Str()] = bone_i;
             auto ai_offset_matrix = bone->mOffsetMatrix;
             mesh_hierarchy->total_bones[bone->mName.C_Str()].push_back({mesh_i, bone_i, reinterpret_cast<glm::mat4&>(ai_offset_matrix.Transpose())});
-
-            for (auto weight_i = 0u; weight_i < bone->mNumWeights; ++weight_i) {
-                const auto* weight = &bone->mWeights[weight_i];
-                bone_weights_total[weight->mVertexId][weight->mWeight].insert(bone_i);
-            }
         }
 
-        // [vertex_id] -> ([bone_id; 4], [bone_weight; 4])
-        std::vector<std::pair<glm::vec4, glm::uvec4>> bone_weights;
-        bone_weights.resize(mesh->mNumVertices, {});
-        for (auto vert_i = 0u; vert_i < mesh->mNumVertices; ++vert_i) {
-            const auto& vert = bone_weights_total[vert_i];
-            auto i = 0;
-            for (auto iter = vert.rbegin(); i < 4 && iter != vert.rend(); ++iter) {
-                for (auto inner_iter = iter->second.begin(); i < 4 && inner_iter != iter->second.end(); ++inner_iter) {
-                    bone_weights[vert_i].first[i] = iter->first;
-                    bone_weights[vert_i].second[i] = *inner_iter;
-                    ++i;
-                }
-            }
-            float weight_sum = glm::compAdd(bone_weights[vert_i].first);
-            if (weight_sum != 0.0f) {
-                // Normalise the sum of the weights
-                bone_weights[vert_i].first /= weight_sum;
-            }
-        }
+        mesh_index_map[mesh_i] = (int) mesh_hierarchy->meshes.size();
+        // The model is uploaded later, by upload_parsed_hierarchy
+        mesh_hierarchy->meshes.push_back(ModelInfo{
+            std::shared_ptr<ModelHandle<VertexData>>{},
+            bone_names
+        });
+    }
+
+    // The meshes are independent of each other, so are converted in parallel across parse_pool (which this never runs on)
+    auto convert_mesh = [this](const aiMesh* mesh) {
+        const auto v = reinterpret_cast<glm::vec3*>(mesh->mVertices);
+        const auto n = reinterpret_cast<glm::vec3*>(mesh->mNormals);
+        const auto t = reinterpret_cast<glm::vec3*>(mesh->mTextureCoords[0]);
 
         VertexCollection vertex_collection{
             v ? std::vector<glm::vec3>{v, v + mesh->mNumVertices} : std::vector<glm::vec3>{},
             n ? std::vector<glm::vec3>{n, n + mesh->mNumVertices} : std::vector<glm::vec3>{},
             t ? std::vector<glm::vec2>{t, t + mesh->mNumVertices} : std::vector<glm::vec2>{},
-            bone_weights
+            SkinWeights::extract(mesh->mNumVertices, mesh->mBones, mesh->mNumBones)
         };
 
         std::vector<VertexData> vertices{};
         VertexData::from_mesh(vertex_collection, vertices);
 
         std::vector<uint> indices{};
+        indices.reserve((size_t) mesh->mNumFaces * 3);
         for (auto face_i = 0u; face_i < mesh->mNumFaces; ++face_i) {
             aiFace face = mesh->mFaces[face_i];
             indices.insert(indices.end(), face.mIndices, face.mIndices + face.mNumIndices);
         }
 
-        mesh_index_map[mesh_i] = (int) mesh_hierarchy->meshes.size();
-        mesh_hierarchy->meshes.push_back(ModelInfo{
-            load_from_data(vertices, indices),
-            bone_names
-        });
+        if (optimise_meshes) {
+            MeshOptimizer::optimise(vertices, indices);
+        }
+        return std::make_pair(std::move(vertices), std::move(indices));
+    };
+
+    std::vector<std::future<std::pair<std::vector<VertexData>, std::vector<uint>>>> converted_meshes{};
+    for (auto mesh_i = 0u; mesh_i < scene->mNumMeshes; ++mesh_i) {
+        if (mesh_index_map.count(mesh_i) == 0) continue;
+        converted_meshes.push_back(parse_pool.submit([&convert_mesh, mesh = scene->mMeshes[mesh_i]]() { return convert_mesh(mesh); }));
+    }
+    // Wait on every mesh before rethrowing any error, since the tasks reference the scene
+    for (auto& converted_mesh: converted_meshes) {
+        converted_mesh.wait();
+    }
+    for (auto& converted_mesh: converted_meshes) {
+        mesh_data.push_back(converted_mesh.get());
     }
 
     if (mesh_hierarchy->meshes.empty()) {
@@ -353,15 +941,15 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
                 auto& animation_data = hierarchy_node.animation_data[animation_id];
                 for (auto i = 0u; i < node_animation->mNumPositionKeys; ++i) {
                     const auto& key = node_animation->mPositionKeys[i];
-                    animation_data.positions[key.mTime] = glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z};
+                    animation_data.positions.add_key(key.mTime, glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z});
                 }
                 for (auto i = 0u; i < node_animation->mNumRotationKeys; ++i) {
                     const auto& key = node_animation->mRotationKeys[i];
-                    animation_data.rotations[key.mTime] = glm::quat{key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z};
+                    animation_data.rotations.add_key(key.mTime, glm::quat{key.mValue.w, key.mValue.x, key.mValue.y, key.mValue.z});
                 }
                 for (auto i = 0u; i < node_animation->mNumScalingKeys; ++i) {
                     const auto& key = node_animation->mScalingKeys[i];
-                    animation_data.scalings[key.mTime] = glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z};
+                    animation_data.scalings.add_key(key.mTime, glm::vec3{key.mValue.x, key.mValue.y, key.mValue.z});
                 }
             }
         }
@@ -373,17 +961,129 @@ std::shared_ptr<MeshHierarchy<VertexData>> ModelLoader::load_hierarchy_from_file
     };
 
     load_hierarchy_node(scene->mRootNode, mesh_hierarchy->root_node);
+    mesh_hierarchy->flatten();
 
-    importer.FreeScene();
+    file_importer.FreeScene();
 
-    hierarchy_cache[{file, std::type_index(typeid(VertexData))}] = {last_write_time, mesh_hierarchy};
+    mesh_cache.write_hierarchy(file, parsed_hierarchy.content_hash, *mesh_hierarchy, mesh_data);
 
-    return mesh_hierarchy;
+    return parsed_hierarchy;
+}
+
+template<typename VertexData>
+void ModelLoader::run_load_benchmark() {
+    benchmark_results.clear();
+
+    // Clearing the real cache for the cold loads would throw away every entry the user has built up
+    std::error_code error;
+    auto temp_path = std::filesystem::temp_directory_path(error);
+    if (error) {
+        std::cerr << "Failed to find a temp directory for the load benchmark: " << error.message() << std::endl;
+        return;
+    }
+    MeshCache benchmark_cache{temp_path / "cits3003_mesh_cache_benchmark"};
+    benchmark_cache.set_processing_flags(get_processing_flags());
+    benchmark_cache.clear();
+
+    for (const auto& model: get_available_models(true)) {
+        auto path = import_path + "/" + model;
+        if (!std::filesystem::is_regular_file(path)) continue;
+
+        try {
+            auto cold_start = std::chrono::steady_clock::now();
+            load_model_from_disk<VertexData>(model, path, benchmark_cache);
+            auto cold_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - cold_start).count();
+
+            auto warm_start = std::chrono::steady_clock::now();
+            load_model_from_disk<VertexData>(model, path, benchmark_cache);
+            auto warm_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - warm_start).count();
+
+            benchmark_results.emplace_back(model, cold_ms, warm_ms);
+            std::cout << "Load benchmark (" << model << "): cold " << cold_ms << " ms, warm " << warm_ms << " ms" << std::endl;
+        } catch (const std::exception&) {
+            // Not a model file that can be loaded, so skip it
+        }
+    }
+
+    benchmark_cache.clear();
+}
+
+template<typename VertexData>
+void ModelLoader::run_optimisation_benchmark() {
+    for (const auto& model: get_available_models(true)) {
+        auto path = import_path + "/" + model;
+        if (!std::filesystem::is_regular_file(path)) continue;
+
+        try {
+            std::vector<VertexData> vertices{};
+            std::vector<uint> indices{};
+            import_model(model, path, importer, vertices, indices);
+            auto report = MeshOptimizer::optimise(vertices, indices);
+            optimisation_reports[model] = report;
+
+            std::cout << "Optimisation benchmark (" << model << "): " << report.triangles << " triangles, "
+                      << "vertices " << report.vertices_before << " -> " << report.vertices_after << ", "
+                      << "ACMR " << report.before.acmr << " -> " << report.after.acmr << ", "
+                      << "ATVR " << report.before.atvr << " -> " << report.after.atvr << ", "
+                      << "in " << report.optimise_ms << " ms" << std::endl;
+        } catch (const std::exception&) {
+            // Not a model file that can be loaded, so skip it
+        }
+    }
+}
+
+template<typename VertexData>
+void ModelLoader::run_obj_benchmark() {
+    obj_benchmark_results.clear();
+
+    // Best of a few runs, so the file is already in the OS's page cache for all but the first
+    constexpr auto RUNS = 3;
+    auto time_ms = [](const auto& run) {
+        auto best_ms = std::numeric_limits<double>::max();
+        for (auto i = 0; i < RUNS; ++i) {
+            auto start = std::chrono::steady_clock::now();
+            run();
+            best_ms = std::min(best_ms, std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best_ms;
+    };
+
+    for (const auto& model: get_available_models(true)) {
+        auto path = import_path + "/" + model;
+        if (!std::filesystem::is_regular_file(path) || !ObjParser::can_parse(path)) continue;
+
+        try {
+            auto parse = [&](ThreadPool* pool) {
+                std::vector<VertexData> vertices{};
+                auto mesh = ObjParser::parse(path, pool);
+                VertexData::from_mesh(VertexCollection{std::move(mesh.positions), std::move(mesh.normals), std::move(mesh.tex_coords), {}}, vertices);
+            };
+            auto parallel_ms = time_ms([&]() { parse(&parse_pool); });
+            auto serial_ms = time_ms([&]() { parse(nullptr); });
+            auto assimp_ms = time_ms([&]() {
+                std::vector<VertexData> vertices{};
+                std::vector<uint> indices{};
+                import_model(model, path, importer, vertices, indices);
+            });
+
+            auto mb = (double) std::filesystem::file_size(path) / (1024.0 * 1024.0);
+            obj_benchmark_results.emplace_back(model, mb, parallel_ms, serial_ms, assimp_ms);
+            std::cout << "OBJ benchmark (" << model << ", " << mb << " MB): "
+                      << "native " << parallel_ms << " ms (" << mb / (parallel_ms / 1000.0) << " MB/s), "
+                      << "native serial " << serial_ms << " ms (" << mb / (serial_ms / 1000.0) << " MB/s), "
+                      << "assimp " << assimp_ms << " ms (" << mb / (assimp_ms / 1000.0) << " MB/s)" << std::endl;
+        } catch (const std::exception& e) {
+            std::cerr << e.what() << std::endl;
+        }
+    }
 }
 
 template<typename VertexData>
 bool ModelLoader::add_imgui_model_selector(const std::string& caption, std::shared_ptr<ModelHandle<VertexData>>& model_handle) {
     std::string current_selection = model_handle->get_filename().value_or("Generated Model");
+    if (!model_handle->is_ready()) {
+        current_selection += " (Loading)";
+    }
 
     bool changed = false;
     static bool just_opened = true;
@@ -392,10 +1092,10 @@ bool ModelLoader::add_imgui_model_selector(const std::string& caption, std::shar
         just_opened = false;
 
         for (const auto& model: models) {
-            const bool is_selected = model_handle->get_filename().has_value() && current_selection == model;
+            const bool is_selected = model_handle->get_filename().has_value() && model_handle->get_filename().value() == model;
             if (ImGui::Selectable(model.c_str(), is_selected)) {
                 try {
-                    model_handle = load_from_file<VertexData>(model);
+                    model_handle = load_from_file_async<VertexData>(model);
                     changed = true;
                 } catch (const std::exception& e) {
                     std::cerr << "Error while trying to update model file:" << std::endl;
@@ -0,0 +1,399 @@
+#include "ObjParser.h"
+
+#include <cmath>
+#include <chrono>
+#include <future>
+#include <cstring>
+#include <climits>
+#include <algorithm>
+
+#include "utility/MappedFile.h"
+
+namespace {
+    constexpr int32_t NO_INDEX = INT32_MIN;
+
+    /// A face corner as written in the file. Positive indices are absolute (and made 0 based),
+    /// negative ones are relative to the end of the chunk's own elements at that point, so are stored relative to the chunk's first element.
+    struct Corner {
+        int32_t index[3];
+        // Bit i is set if index[i] is relative to the chunk, see above
+        uint8_t relative = 0;
+    };
+
+    /// Everything parsed from one range of lines
+    struct Chunk {
+        std::vector<glm::vec3> positions{};
+        std::vector<glm::vec2> tex_coords{};
+        std::vector<glm::vec3> normals{};
+        // 3 per triangle
+        std::vector<Corner> corners{};
+        size_t lines = 0;
+
+        // Set if the chunk failed to parse, at (chunk relative) error_line
+        std::string error{};
+        size_t error_line = 0;
+    };
+
+    constexpr double POWERS_OF_TEN[] = {1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+                                        1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22};
+
+    bool is_digit(char c) { return c >= '0' && c <= '9'; }
+    bool is_space(char c) { return c == ' ' || c == '\t'; }
+    bool is_line_end(char c) { return c == '\n' || c == '\r'; }
+
+    void skip_spaces(const char*& text, const char* end) {
+        while (text < end && is_space(*text)) ++text;
+    }
+
+    const char* skip_line(const char* text, const char* end) {
+        auto* line_end = static_cast<const char*>(std::memchr(text, '\n', (size_t) (end - text)));
+        return line_end != nullptr ? line_end + 1 : end;
+    }
+
+    int32_t parse_int(const char*& text, const char* end) {
+        bool negative = false;
+        if (text < end && (*text == '-' || *text == '+')) negative = *text++ == '-';
+        if (text >= end || !is_digit(*text)) {
+            throw std::runtime_error("Expected an index");
+        }
+        int64_t value = 0;
+        while (text < end && is_digit(*text)) {
+            value = value * 10 + (*text++ - '0');
+            if (value > INT32_MAX) throw std::runtime_error("Index is too large");
+        }
+        return (int32_t) (negative ? -value : value);
+    }
+
+    /// Convert an index as written (1 based, or negative to count back from the last element) into a Corner index
+    void resolve_index(int32_t written, size_t local_count, Corner& corner, int component) {
+        if (written > 0) {
+            corner.index[component] = written - 1;
+        } else if (written < 0) {
+            corner.index[component] = (int32_t) local_count + written;
+            corner.relative |= 1 << component;
+        } else {
+            throw std::runtime_error("Indices start at 1");
+        }
+    }
+
+    void parse_face(const char* text, const char* end, Chunk& chunk) {
+        // Polygons are triangulated as a fan around the first corner
+        Corner first{};
+        Corner previous{};
+        uint corner_count = 0;
+
+        while (true) {
+            skip_spaces(text, end);
+            if (text >= end || is_line_end(*text) || *text == '#') break;
+
+            Corner corner{{NO_INDEX, NO_INDEX, NO_INDEX}};
+            resolve_index(parse_int(text, end), chunk.positions.size(), corner, 0);
+            if (text < end && *text == '/') {
+                ++text;
+                // Texture coordinates can be left out, as in "1//1"
+                if (text < end && *text != '/') resolve_index(parse_int(text, end), chunk.tex_coords.size(), corner, 1);
+                if (text < end && *text == '/') {
+                    ++text;
+                    resolve_index(parse_int(text, end), chunk.normals.size(), corner, 2);
+                }
+            }
+            if (text < end && !is_space(*text) && !is_line_end(*text)) {
+                throw std::runtime_error("Unexpected character in face");
+            }
+
+            if (corner_count == 0) {
+                first = corner;
+            } else if (corner_count >= 2) {
+                chunk.corners.push_back(first);
+                chunk.corners.push_back(previous);
+                chunk.corners.push_back(corner);
+            }
+            previous = corner;
+            ++corner_count;
+        }
+    }
+
+    void parse_chunk(const char* text, const char* end, Chunk& chunk) {
+        try {
+            while (text < end) {
+                ++chunk.lines;
+                skip_spaces(text, end);
+                if (text + 1 < end && text[0] == 'v') {
+                    auto* values = text + 2;
+                    if (is_space(text[1])) {
+                        // Any w, or vertex colours, after the position are ignored
+                        auto x = ObjParser::parse_float(values, end);
+                        auto y = ObjParser::parse_float(values, end);
+                        auto z = ObjParser::parse_float(values, end);
+                        chunk.positions.emplace_back(x, y, z);
+                    } else if (text[1] == 't' && text + 2 < end && is_space(text[2])) {
+                        values = text + 3;
+                        auto u = ObjParser::parse_float(values, end);
+                        skip_spaces(values, end);
+                        // v is optional, as is w (which is ignored)
+                        auto v = values < end && !is_line_end(*values) && *values != '#' ? ObjParser::parse_float(values, end) : 0.0f;
+                        chunk.tex_coords.emplace_back(u, v);
+                    } else if (text[1] == 'n' && text + 2 < end && is_space(text[2])) {
+                        values = text + 3;
+                        auto x = ObjParser::parse_float(values, end);
+                        auto y = ObjParser::parse_float(values, end);
+                        auto z = ObjParser::parse_float(values, end);
+                        chunk.normals.emplace_back(x, y, z);
+                    }
+                } else if (text + 1 < end && text[0] == 'f' && is_space(text[1])) {
+                    auto* line_end = skip_line(text, end);
+                    parse_face(text + 2, line_end, chunk);
+                }
+                // Anything else (comments, objects, groups, materials, smoothing groups, lines and points) is skipped
+                text = skip_line(text, end);
+            }
+        } catch (const std::exception& e) {
+            chunk.error = e.what();
+            chunk.error_line = chunk.lines;
+        }
+    }
+
+    /// Open addressing from (position, tex_coord, normal) to vertex index, for welding the corners into unique vertices
+    class VertexWelder {
+        std::vector<uint> slots;
+        std::vector<glm::ivec3> keys{};
+        size_t mask;
+
+        static size_t hash(const glm::ivec3& key) {
+            auto hash = (uint64_t) (uint32_t) key.x * 0x9E3779B185EBCA87ull ^ (uint64_t) (uint32_t) key.y * 0xC2B2AE3D27D4EB4Full ^ (uint64_t) (uint32_t) key.z * 0x165667B19E3779F9ull;
+            return (size_t) (hash ^ (hash >> 29));
+        }
+    public:
+        explicit VertexWelder(size_t max_vertices) {
+            size_t capacity = 16;
+            // At most half full, so probes stay short
+            while (capacity < max_vertices * 2) capacity *= 2;
+            slots.assign(capacity, UINT_MAX);
+            mask = capacity - 1;
+            keys.reserve(max_vertices);
+        }
+
+        /// The index of the vertex with the key, and whether it was newly added
+        std::pair<uint, bool> weld(const glm::ivec3& key) {
+            for (auto slot = hash(key) & mask;; slot = (slot + 1) & mask) {
+                if (slots[slot] == UINT_MAX) {
+                    slots[slot] = (uint) keys.size();
+                    keys.push_back(key);
+                    return {slots[slot], true};
+                }
+                if (keys[slots[slot]] == key) return {slots[slot], false};
+            }
+        }
+    };
+}
+
+bool ObjParser::can_parse(const std::filesystem::path& path) {
+    auto extension = path.extension().string();
+    std::transform(extension.begin(), extension.end(), extension.begin(), [](char c) { return (char) std::tolower((unsigned char) c); });
+    return extension == ".obj";
+}
+
+float ObjParser::parse_float(const char*& text, const char* end) {
+    skip_spaces(text, end);
+    auto* start = text;
+
+    bool negative = false;
+    if (text < end && (*text == '-' || *text == '+')) negative = *text++ == '-';
+
+    // Up to 19 significant digits fit in the mantissa, more than enough for a float
+    uint64_t mantissa = 0;
+    int digits = 0;
+    int exponent = 0;
+    bool any_digits = false;
+    for (; text < end && is_digit(*text); ++text) {
+        any_digits = true;
+        if (digits < 19) {
+            mantissa = mantissa * 10 + (*text - '0');
+            // Leading zeros aren't significant
+            if (mantissa != 0) ++digits;
+        } else {
+            ++exponent;
+        }
+    }
+    if (text < end && *text == '.') {
+        for (++text; text < end && is_digit(*text); ++text) {
+            any_digits = true;
+            if (digits < 19) {
+                mantissa = mantissa * 10 + (*text - '0');
+                if (mantissa != 0) ++digits;
+                --exponent;
+            }
+        }
+    }
+    if (!any_digits) {
+        text = start;
+        throw std::runtime_error("Expected a number");
+    }
+
+    if (text < end && (*text == 'e' || *text == 'E')) {
+        auto* exponent_start = text++;
+        bool negative_exponent = false;
+        if (text < end && (*text == '-' || *text == '+')) negative_exponent = *text++ == '-';
+        if (text < end && is_digit(*text)) {
+            int written_exponent = 0;
+            for (; text < end && is_digit(*text); ++text) {
+                written_exponent = std::min(written_exponent * 10 + (*text - '0'), 1000);
+            }
+            exponent += negative_exponent ? -written_exponent : written_exponent;
+        } else {
+            // Not an exponent after all
+            text = exponent_start;
+        }
+    }
+
+    // Exact for up to 2^53 with powers of ten that doubles hold exactly (Clinger's fast path), which covers any float written sensibly
+    auto value = (double) mantissa;
+    if (exponent < 0) {
+        value = -exponent <= 22 ? value / POWERS_OF_TEN[-exponent] : value * std::pow(10.0, exponent);
+    } else if (exponent > 0) {
+        value = exponent <= 22 ? value * POWERS_OF_TEN[exponent] : value * std::pow(10.0, exponent);
+    }
+    return (float) (negative ? -value : value);
+}
+
+ObjParser::Mesh ObjParser::parse(const std::string& path, ThreadPool* pool) {
+    MappedFile file{path};
+    return parse(reinterpret_cast<const char*>(file.data()), file.size(), path, pool);
+}
+
+ObjParser::Mesh ObjParser::parse(const char* data, size_t size, const std::string& name, ThreadPool* pool) {
+    auto start = std::chrono::steady_clock::now();
+    Mesh mesh{};
+    mesh.stats.bytes = size;
+
+    // Split into chunks at line boundaries, a few per worker so that uneven chunks still balance out
+    size_t chunk_count = 1;
+    if (pool != nullptr) {
+        chunk_count = std::clamp(size / MIN_CHUNK_SIZE, (size_t) 1, (size_t) pool->get_thread_count() * 4);
+    }
+    auto target_size = size / chunk_count + 1;
+    std::vector<std::pair<const char*, const char*>> ranges{};
+    for (auto* begin = data; begin < data + size;) {
+        auto* end = std::min(begin + target_size, data + size);
+        if (end < data + size) end = skip_line(end, data + size);
+        ranges.emplace_back(begin, end);
+        begin = end;
+    }
+
+    std::vector<Chunk> chunks(ranges.size());
+    if (pool != nullptr && ranges.size() > 1) {
+        std::vector<std::future<void>> parsed{};
+        for (auto i = 0u; i < ranges.size(); ++i) {
+            parsed.push_back(pool->submit([&ranges, &chunks, i]() { parse_chunk(ranges[i].first, ranges[i].second, chunks[i]); }));
+        }
+        // Wait on every chunk before rethrowing any error, since the tasks reference ranges and chunks
+        for (auto& chunk: parsed) chunk.wait();
+        for (auto& chunk: parsed) chunk.get();
+    } else {
+        for (auto i = 0u; i < ranges.size(); ++i) parse_chunk(ranges[i].first, ranges[i].second, chunks[i]);
+    }
+
+    // Each chunk's elements follow on from those of the chunks before it
+    size_t lines = 0;
+    std::vector<glm::ivec3> bases(chunks.size());
+    glm::ivec3 totals{0};
+    size_t corner_count = 0;
+    for (auto i = 0u; i < chunks.size(); ++i) {
+        const auto& chunk = chunks[i];
+        if (!chunk.error.empty()) {
+            throw std::runtime_error(Formatter() << "Failed to parse (" << name << ") at line " << lines + chunk.error_line << ": " << chunk.error);
+        }
+        lines += chunk.lines;
+        bases[i] = totals;
+        totals += glm::ivec3(chunk.positions.size(), chunk.tex_coords.size(), chunk.normals.size());
+        corner_count += chunk.corners.size();
+    }
+    mesh.stats.chunks = (uint) chunks.size();
+    auto parsed = std::chrono::steady_clock::now();
+    mesh.stats.parse_ms = std::chrono::duration<double, std::milli>(parsed - start).count();
+
+    std::vector<glm::vec3> positions{};
+    std::vector<glm::vec2> tex_coords{};
+    std::vector<glm::vec3> normals{};
+    positions.reserve(totals.x);
+    tex_coords.reserve(totals.y);
+    normals.reserve(totals.z);
+    for (const auto& chunk: chunks) {
+        positions.insert(positions.end(), chunk.positions.begin(), chunk.positions.end());
+        tex_coords.insert(tex_coords.end(), chunk.tex_coords.begin(), chunk.tex_coords.end());
+        normals.insert(normals.end(), chunk.normals.begin(), chunk.normals.end());
+    }
+
+    // Weld the corners into unique vertices, (position, tex_coord, normal) with -1 for a missing element
+    VertexWelder welder{corner_count};
+    std::vector<glm::ivec3> vertex_keys{};
+    mesh.indices.reserve(corner_count);
+    for (auto chunk_i = 0u; chunk_i < chunks.size(); ++chunk_i) {
+        const auto& corners = chunks[chunk_i].corners;
+        for (size_t i = 0; i < corners.size(); i += 3) {
+            glm::ivec3 keys[3];
+            for (auto c = 0; c < 3; ++c) {
+                const auto& corner = corners[i + c];
+                for (auto component = 0; component < 3; ++component) {
+                    auto index = corner.index[component];
+                    if (index == NO_INDEX) {
+                        keys[c][component] = -1;
+                        continue;
+                    }
+                    if ((corner.relative & (1 << component)) != 0) index += bases[chunk_i][component];
+                    if (index < 0 || index >= totals[component]) {
+                        throw std::runtime_error(Formatter() << "Failed to parse (" << name << "): face index " << index + 1 << " is out of range");
+                    }
+                    keys[c][component] = index;
+                }
+            }
+
+            // Triangles with repeated positions have no area, so are dropped (as Assimp's FindDegenerates would)
+            if (keys[0].x == keys[1].x || keys[1].x == keys[2].x || keys[0].x == keys[2].x) {
+                mesh.stats.degenerate_triangles++;
+                continue;
+            }
+            for (const auto& key: keys) {
+                auto [vertex, added] = welder.weld(key);
+                if (added) vertex_keys.push_back(key);
+                mesh.indices.push_back(vertex);
+            }
+        }
+    }
+
+    mesh.positions.resize(vertex_keys.size());
+    mesh.tex_coords.resize(vertex_keys.size());
+    mesh.normals.resize(vertex_keys.size());
+    bool missing_normals = false;
+    for (auto i = 0u; i < vertex_keys.size(); ++i) {
+        const auto& key = vertex_keys[i];
+        mesh.positions[i] = positions[key.x];
+        mesh.tex_coords[i] = key.y >= 0 ? tex_coords[key.y] : glm::vec2{0.0f};
+        mesh.normals[i] = key.z >= 0 ? normals[key.z] : glm::vec3{0.0f};
+        missing_normals |= key.z < 0;
+    }
+
+    if (missing_normals) {
+        // Smooth normals for the corners without one, summed over the triangles around each position (weighted by their area)
+        std::vector<glm::vec3> position_normals(positions.size(), glm::vec3{0.0f});
+        for (size_t i = 0; i < mesh.indices.size(); i += 3) {
+            const auto& a = mesh.positions[mesh.indices[i]];
+            const auto& b = mesh.positions[mesh.indices[i + 1]];
+            const auto& c = mesh.positions[mesh.indices[i + 2]];
+            auto face_normal = glm::cross(b - a, c - a);
+            for (auto corner = 0; corner < 3; ++corner) {
+                position_normals[vertex_keys[mesh.indices[i + corner]].x] += face_normal;
+            }
+        }
+        for (auto i = 0u; i < vertex_keys.size(); ++i) {
+            if (vertex_keys[i].z >= 0) continue;
+            const auto& normal = position_normals[vertex_keys[i].x];
+            mesh.normals[i] = glm::length(normal) > 0.0f ? glm::normalize(normal) : glm::vec3{0.0f, 1.0f, 0.0f};
+        }
+    }
+
+    mesh.stats.triangles = (uint) mesh.indices.size() / 3;
+    mesh.stats.vertices = (uint) mesh.positions.size();
+    mesh.stats.weld_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - parsed).count();
+    return mesh;
+}
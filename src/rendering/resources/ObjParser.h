@@ -0,0 +1,60 @@
+#ifndef OBJ_PARSER_H
+#define OBJ_PARSER_H
+
+#include <string>
+#include <vector>
+#include <cstdint>
+#include <filesystem>
+
+#include <glm/glm.hpp>
+
+#include "utility/HelperTypes.h"
+#include "utility/ThreadPool.h"
+
+/// A fast path for loading Wavefront OBJ files, in place of Assimp's generic import and post-processing.
+///
+/// The file is memory-mapped and split into chunks at line boundaries, which are parsed in parallel (with a hand written float parser,
+/// since std::from_chars for floats isn't available on every standard library), then the face corners are resolved and welded into unique vertices.
+/// Like ModelLoader::import_model(), everything is flattened into one triangle mesh: objects, groups, materials and smoothing groups are ignored,
+/// as are points and lines. Polygons are triangulated as fans, degenerate triangles are dropped, and missing normals are generated (smooth, area weighted).
+/// See: https://paulbourke.net/dataformats/obj/
+namespace ObjParser {
+    /// Files smaller than this aren't split up, since it wouldn't be worth the overhead
+    constexpr size_t MIN_CHUNK_SIZE = 64 * 1024;
+
+    struct Stats {
+        size_t bytes = 0;
+        uint chunks = 0;
+        uint triangles = 0;
+        uint vertices = 0;
+        uint degenerate_triangles = 0;
+        double parse_ms = 0.0;
+        double weld_ms = 0.0;
+    };
+
+    /// One vertex per unique (position, texture coordinate, normal) corner, ready for VertexData::from_mesh()
+    struct Mesh {
+        std::vector<glm::vec3> positions{};
+        std::vector<glm::vec3> normals{};
+        // (0, 0) for corners without one
+        std::vector<glm::vec2> tex_coords{};
+        std::vector<uint> indices{};
+        Stats stats{};
+    };
+
+    /// True if the file should be loaded with parse() rather than through Assimp, going by its extension
+    bool can_parse(const std::filesystem::path& path);
+
+    /// Map and parse the file, splitting it across pool's workers if given. Throws if the file can't be read or is malformed.
+    /// The caller waits on the pool, so it must not be one of the pool's own workers.
+    Mesh parse(const std::string& path, ThreadPool* pool = nullptr);
+
+    /// Parse OBJ text already in memory, name is only used to report errors. See parse().
+    Mesh parse(const char* data, size_t size, const std::string& name, ThreadPool* pool = nullptr);
+
+    /// Parse a decimal number (with optional sign, fraction and exponent) starting at text, advancing text past it.
+    /// Throws if there is no number there.
+    float parse_float(const char*& text, const char* end);
+}
+
+#endif //OBJ_PARSER_H
@@ -0,0 +1,88 @@
+#include "ResidencyManager.h"
+
+#include <algorithm>
+
+#include <imgui/imgui.h>
+
+bool ResidencyManager::Entry::is_warm() const {
+    return asset.use_count() == 1;
+}
+
+ResidencyManager::ResidencyManager(size_t budget_mb) : budget_bytes(budget_mb * 1024 * 1024) {}
+
+void ResidencyManager::insert(std::string key, std::shared_ptr<void> asset, std::function<size_t()> get_gpu_bytes) {
+    forget(key);
+    lru.push_front(Entry{key, std::move(asset), std::move(get_gpu_bytes)});
+    entries[std::move(key)] = lru.begin();
+}
+
+void ResidencyManager::touch(const std::string& key) {
+    auto entry = entries.find(key);
+    if (entry == entries.end()) return;
+    hits++;
+    lru.splice(lru.begin(), lru, entry->second);
+}
+
+void ResidencyManager::forget(const std::string& key) {
+    auto entry = entries.find(key);
+    if (entry == entries.end()) return;
+    lru.erase(entry->second);
+    entries.erase(entry);
+}
+
+void ResidencyManager::evict_to(size_t target_bytes) {
+    size_t total_bytes = 0;
+    for (const auto& entry: lru) total_bytes += entry.get_gpu_bytes();
+
+    for (auto it = lru.end(); it != lru.begin() && total_bytes > target_bytes;) {
+        --it;
+        if (!it->is_warm()) continue;
+
+        total_bytes -= it->get_gpu_bytes();
+        entries.erase(it->key);
+        // Dropping the last reference frees the asset
+        it = lru.erase(it);
+        evictions++;
+    }
+}
+
+void ResidencyManager::update() {
+    evict_to(budget_bytes);
+}
+
+ResidencyManager::Stats ResidencyManager::get_stats() const {
+    Stats stats{0, 0, 0, 0, hits, misses, evictions};
+    for (const auto& entry: lru) {
+        auto bytes = entry.get_gpu_bytes();
+        stats.resident_bytes += bytes;
+        stats.resident_count++;
+        if (entry.is_warm()) {
+            stats.warm_bytes += bytes;
+            stats.warm_count++;
+        }
+    }
+    return stats;
+}
+
+void ResidencyManager::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("GPU Residency")) {
+        auto stats = get_stats();
+        int budget_mb = (int) (budget_bytes / (1024 * 1024));
+        if (ImGui::DragInt("Budget (MB)", &budget_mb, 1.0f, 0, 8192)) {
+            budget_bytes = (size_t) std::max(budget_mb, 0) * 1024 * 1024;
+        }
+        ImGui::Text("Resident: %.2f MB in %u assets", (double) stats.resident_bytes / (1024.0 * 1024.0), stats.resident_count);
+        ImGui::Text("Warm (unused): %.2f MB in %u assets", (double) stats.warm_bytes / (1024.0 * 1024.0), stats.warm_count);
+        auto requests = stats.hits + stats.misses;
+        ImGui::Text("Hits: %u, misses: %u (%.0f%% hit rate)", stats.hits, stats.misses, requests > 0 ? 100.0 * stats.hits / requests : 0.0);
+        ImGui::Text("Evictions: %u", stats.evictions);
+        if (ImGui::Button("Evict Unused")) {
+            evict_to(0);
+        }
+    }
+}
+
+void ResidencyManager::cleanup() {
+    entries.clear();
+    lru.clear();
+}
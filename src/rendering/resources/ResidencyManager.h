@@ -0,0 +1,85 @@
+#ifndef RESIDENCY_MANAGER_H
+#define RESIDENCY_MANAGER_H
+
+#include <list>
+#include <memory>
+#include <string>
+#include <functional>
+#include <unordered_map>
+
+#include "utility/HelperTypes.h"
+
+/// Keeps loaded assets (models, hierarchies and textures) resident on the GPU after the last user releases them,
+/// so that picking them again is a cache hit rather than a reload from disk.
+/// Every tracked asset counts towards a memory budget, and once that is exceeded the least recently used assets
+/// that nothing else is holding on to are evicted (freed). Assets that are still in use are never evicted.
+class ResidencyManager : private NonCopyable {
+public:
+    struct Stats {
+        size_t resident_bytes;
+        size_t warm_bytes;
+        uint resident_count;
+        uint warm_count;
+        uint hits;
+        uint misses;
+        uint evictions;
+    };
+
+    static constexpr size_t DEFAULT_BUDGET_MB = 256;
+private:
+    struct Entry {
+        std::string key;
+        // Holding this is what keeps the asset alive once released elsewhere
+        std::shared_ptr<void> asset;
+        std::function<size_t()> get_gpu_bytes;
+
+        /// True if nothing but the ResidencyManager is holding the asset
+        [[nodiscard]] bool is_warm() const;
+    };
+
+    size_t budget_bytes;
+    // Most recently used at the front
+    std::list<Entry> lru{};
+    std::unordered_map<std::string, std::list<Entry>::iterator> entries{};
+
+    uint hits = 0;
+    uint misses = 0;
+    uint evictions = 0;
+
+    void insert(std::string key, std::shared_ptr<void> asset, std::function<size_t()> get_gpu_bytes);
+    /// Evict warm assets, least recently used first, until the total is within target_bytes (or nothing more can be evicted)
+    void evict_to(size_t target_bytes);
+public:
+    explicit ResidencyManager(size_t budget_mb = DEFAULT_BUDGET_MB);
+
+    /// Start tracking an asset that was just loaded from disk, counted as a miss.
+    /// Asset must have a `size_t get_gpu_bytes() const` member.
+    template<typename Asset>
+    void track(const std::string& key, const std::shared_ptr<Asset>& asset);
+
+    /// Mark a tracked asset as just used, counted as a hit.
+    void touch(const std::string& key);
+
+    /// Stop tracking an asset, eg. because it is out of date
+    void forget(const std::string& key);
+
+    /// Evict as needed to get back within budget, should be called once a frame.
+    void update();
+
+    [[nodiscard]] Stats get_stats() const;
+
+    /// Adds the ImGUI controls for the budget, and the residency stats, to the current ImGUI window
+    void add_imgui_options_section();
+
+    /// Release every tracked asset, must be called while the OpenGL context still exists.
+    void cleanup();
+};
+
+template<typename Asset>
+void ResidencyManager::track(const std::string& key, const std::shared_ptr<Asset>& asset) {
+    misses++;
+    auto* raw = asset.get();
+    insert(key, asset, [raw]() { return raw->get_gpu_bytes(); });
+}
+
+#endif //RESIDENCY_MANAGER_H
@@ -0,0 +1,192 @@
+#include "SkinWeights.h"
+
+#include <map>
+#include <set>
+#include <chrono>
+#include <random>
+#include <future>
+#include <memory>
+#include <cstring>
+#include <iostream>
+#include <algorithm>
+
+#include <glm/gtx/component_wise.hpp>
+
+namespace {
+    /// Normalise the sum of the weights, the same way (and so with the same rounding) for both extractions
+    std::pair<glm::vec4, glm::uvec4> normalise(glm::vec4 weights, glm::uvec4 bones) {
+        float weight_sum = glm::compAdd(weights);
+        if (weight_sum != 0.0f) {
+            weights /= weight_sum;
+        }
+        return {weights, bones};
+    }
+
+    /// A generated mesh, which owns its bones (as an aiMesh would)
+    struct GeneratedMesh {
+        uint vertex_count = 0;
+        std::vector<std::unique_ptr<aiBone>> bones{};
+        std::vector<const aiBone*> bone_pointers{};
+    };
+
+    GeneratedMesh generate_mesh(uint seed, uint vertex_count, uint influences_per_vertex) {
+        constexpr uint BONE_COUNT = 64;
+        std::mt19937 random{seed};
+        std::uniform_int_distribution<uint> random_bone{0, BONE_COUNT - 1};
+        // Quantised, so that plenty of influences on a vertex have equal weights and the tie breaking is exercised
+        std::uniform_int_distribution<uint> random_weight{1, 16};
+
+        // [bone] -> [(vertex, weight)]
+        std::vector<std::vector<aiVertexWeight>> bone_weights(BONE_COUNT);
+        for (auto vertex = 0u; vertex < vertex_count; ++vertex) {
+            for (auto i = 0u; i < influences_per_vertex; ++i) {
+                aiVertexWeight weight{};
+                weight.mVertexId = vertex;
+                weight.mWeight = (float) random_weight(random) / 16.0f;
+                bone_weights[random_bone(random)].push_back(weight);
+            }
+        }
+
+        GeneratedMesh mesh{};
+        mesh.vertex_count = vertex_count;
+        for (const auto& weights: bone_weights) {
+            auto bone = std::make_unique<aiBone>();
+            bone->mNumWeights = (uint) weights.size();
+            bone->mWeights = new aiVertexWeight[weights.size()];
+            std::copy(weights.begin(), weights.end(), bone->mWeights);
+            mesh.bone_pointers.push_back(bone.get());
+            mesh.bones.push_back(std::move(bone));
+        }
+        return mesh;
+    }
+
+    bool identical(const std::vector<std::pair<glm::vec4, glm::uvec4>>& a, const std::vector<std::pair<glm::vec4, glm::uvec4>>& b) {
+        if (a.size() != b.size()) return false;
+        for (auto i = 0u; i < a.size(); ++i) {
+            if (std::memcmp(&a[i].first, &b[i].first, sizeof(glm::vec4)) != 0 || a[i].second != b[i].second) return false;
+        }
+        return true;
+    }
+}
+
+void SkinWeights::TopInfluences::insert(float weight, uint bone) {
+    // Find where it belongs in the order
+    auto i = 0u;
+    while (i < count && (weights[i] > weight || (weights[i] == weight && bones[i] < bone))) ++i;
+    if (i >= MAX_INFLUENCES || (i < count && weights[i] == weight && bones[i] == bone)) return;
+
+    // Shift everything after it down, dropping the weakest if already full
+    for (auto j = std::min(count, MAX_INFLUENCES - 1); j > i; --j) {
+        weights[j] = weights[j - 1];
+        bones[j] = bones[j - 1];
+    }
+    weights[i] = weight;
+    bones[i] = bone;
+    count = std::min(count + 1, MAX_INFLUENCES);
+}
+
+std::vector<std::pair<glm::vec4, glm::uvec4>> SkinWeights::extract(uint vertex_count, const aiBone* const* bones, uint bone_count) {
+    std::vector<TopInfluences> influences(vertex_count);
+    for (auto bone_i = 0u; bone_i < bone_count; ++bone_i) {
+        const auto* bone = bones[bone_i];
+        for (auto weight_i = 0u; weight_i < bone->mNumWeights; ++weight_i) {
+            const auto& weight = bone->mWeights[weight_i];
+            influences[weight.mVertexId].insert(weight.mWeight, bone_i);
+        }
+    }
+
+    std::vector<std::pair<glm::vec4, glm::uvec4>> bone_weights(vertex_count);
+    for (auto vert_i = 0u; vert_i < vertex_count; ++vert_i) {
+        const auto& vert = influences[vert_i];
+        glm::vec4 weights{0.0f};
+        glm::uvec4 vert_bones{0u};
+        for (auto i = 0u; i < vert.count; ++i) {
+            weights[i] = vert.weights[i];
+            vert_bones[i] = vert.bones[i];
+        }
+        bone_weights[vert_i] = normalise(weights, vert_bones);
+    }
+    return bone_weights;
+}
+
+std::vector<std::pair<glm::vec4, glm::uvec4>> SkinWeights::extract_reference(uint vertex_count, const aiBone* const* bones, uint bone_count) {
+    // [vertex_id] -> (bone_weight -> bone_id)
+    std::vector<std::map<float, std::set<uint>>> bone_weights_total{};
+    bone_weights_total.resize(vertex_count, {});
+    for (auto bone_i = 0u; bone_i < bone_count; ++bone_i) {
+        const auto* bone = bones[bone_i];
+        for (auto weight_i = 0u; weight_i < bone->mNumWeights; ++weight_i) {
+            const auto* weight = &bone->mWeights[weight_i];
+            bone_weights_total[weight->mVertexId][weight->mWeight].insert(bone_i);
+        }
+    }
+
+    std::vector<std::pair<glm::vec4, glm::uvec4>> bone_weights(vertex_count);
+    for (auto vert_i = 0u; vert_i < vertex_count; ++vert_i) {
+        const auto& vert = bone_weights_total[vert_i];
+        glm::vec4 weights{0.0f};
+        glm::uvec4 vert_bones{0u};
+        auto i = 0;
+        for (auto iter = vert.rbegin(); i < 4 && iter != vert.rend(); ++iter) {
+            for (auto inner_iter = iter->second.begin(); i < 4 && inner_iter != iter->second.end(); ++inner_iter) {
+                weights[i] = iter->first;
+                vert_bones[i] = *inner_iter;
+                ++i;
+            }
+        }
+        bone_weights[vert_i] = normalise(weights, vert_bones);
+    }
+    return bone_weights;
+}
+
+SkinWeights::BenchmarkResult SkinWeights::run_benchmark(ThreadPool& pool, uint mesh_count, uint vertices_per_mesh, uint influences_per_vertex) {
+    BenchmarkResult result{mesh_count, mesh_count * vertices_per_mesh, mesh_count * vertices_per_mesh * influences_per_vertex};
+
+    std::vector<GeneratedMesh> meshes{};
+    for (auto mesh_i = 0u; mesh_i < mesh_count; ++mesh_i) {
+        meshes.push_back(generate_mesh(mesh_i, vertices_per_mesh, influences_per_vertex));
+    }
+
+    using Weights = std::vector<std::pair<glm::vec4, glm::uvec4>>;
+    auto time_ms = [](std::chrono::steady_clock::time_point start) {
+        return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - start).count();
+    };
+
+    auto start = std::chrono::steady_clock::now();
+    std::vector<Weights> reference{};
+    for (const auto& mesh: meshes) {
+        reference.push_back(extract_reference(mesh.vertex_count, mesh.bone_pointers.data(), (uint) mesh.bone_pointers.size()));
+    }
+    result.reference_ms = time_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<Weights> serial{};
+    for (const auto& mesh: meshes) {
+        serial.push_back(extract(mesh.vertex_count, mesh.bone_pointers.data(), (uint) mesh.bone_pointers.size()));
+    }
+    result.serial_ms = time_ms(start);
+
+    start = std::chrono::steady_clock::now();
+    std::vector<std::future<Weights>> parallel_futures{};
+    for (const auto& mesh: meshes) {
+        parallel_futures.push_back(pool.submit([&mesh]() {
+            return extract(mesh.vertex_count, mesh.bone_pointers.data(), (uint) mesh.bone_pointers.size());
+        }));
+    }
+    std::vector<Weights> parallel{};
+    for (auto& future: parallel_futures) {
+        parallel.push_back(future.get());
+    }
+    result.parallel_ms = time_ms(start);
+
+    result.identical = true;
+    for (auto mesh_i = 0u; mesh_i < mesh_count; ++mesh_i) {
+        result.identical &= identical(reference[mesh_i], serial[mesh_i]) && identical(reference[mesh_i], parallel[mesh_i]);
+    }
+
+    std::cout << "Skin weight benchmark (" << result.meshes << " meshes, " << result.vertices << " vertices, " << result.influences << " influences): "
+              << "std::map " << result.reference_ms << " ms, top " << MAX_INFLUENCES << " " << result.serial_ms << " ms, "
+              << "top " << MAX_INFLUENCES << " across " << pool.get_thread_count() << " threads " << result.parallel_ms << " ms, "
+              << (result.identical ? "identical" : "DIFFERENT") << std::endl;
+    return result;
+}
@@ -0,0 +1,53 @@
+#ifndef SKIN_WEIGHTS_H
+#define SKIN_WEIGHTS_H
+
+#include <array>
+#include <vector>
+#include <utility>
+
+#include <glm/glm.hpp>
+#include <assimp/scene.h>
+
+#include "utility/HelperTypes.h"
+#include "utility/ThreadPool.h"
+
+/// Converting Assimp's bone weights (stored per bone, as a list of the vertices it influences) into per vertex skinning data,
+/// keeping only the strongest MAX_INFLUENCES of each vertex.
+namespace SkinWeights {
+    /// The number of bones that can influence each vertex, matching AnimatedEntityRenderer::VertexData
+    constexpr uint MAX_INFLUENCES = 4;
+
+    /// The strongest influences on one vertex, kept sorted by descending weight (and ascending bone for equal weights), in fixed storage.
+    /// Inserting the same (weight, bone) pair twice only keeps it once.
+    struct TopInfluences {
+        std::array<float, MAX_INFLUENCES> weights{};
+        std::array<uint, MAX_INFLUENCES> bones{};
+        uint count = 0;
+
+        void insert(float weight, uint bone);
+    };
+
+    /// [vertex_id] -> (bone_weights, bone_ids), with the weights normalised to sum to 1 (unless they are all 0).
+    /// Unused influences have a weight of 0 and bone 0.
+    std::vector<std::pair<glm::vec4, glm::uvec4>> extract(uint vertex_count, const aiBone* const* bones, uint bone_count);
+
+    /// The std::map based extraction that extract() replaced, which allocates a tree node per influence.
+    /// Kept so run_benchmark() can check that both give bit-identical results.
+    std::vector<std::pair<glm::vec4, glm::uvec4>> extract_reference(uint vertex_count, const aiBone* const* bones, uint bone_count);
+
+    struct BenchmarkResult {
+        uint meshes = 0;
+        uint vertices = 0;
+        uint influences = 0;
+        double reference_ms = 0.0;
+        double serial_ms = 0.0;
+        double parallel_ms = 0.0;
+        bool identical = false;
+    };
+
+    /// Generate mesh_count skinned meshes, each with vertices_per_mesh vertices influenced by influences_per_vertex bones (with some equal weights),
+    /// then time extract_reference() and extract() on one thread, and extract() with the meshes split across pool.
+    BenchmarkResult run_benchmark(ThreadPool& pool, uint mesh_count = 8, uint vertices_per_mesh = 50000, uint influences_per_vertex = 8);
+}
+
+#endif //SKIN_WEIGHTS_H
@@ -0,0 +1,102 @@
+#include "TextureCache.h"
+
+#include <iomanip>
+#include <sstream>
+#include <iostream>
+
+#include "MeshCache.h"
+#include "utility/MappedFile.h"
+
+TextureCache::TextureCache(std::filesystem::path cache_path) : cache_path(std::move(cache_path)) {}
+
+void TextureCache::clear() const {
+    std::error_code error;
+    std::filesystem::remove_all(cache_path, error);
+    if (error) {
+        std::cerr << "Failed to clear texture cache (" << cache_path.string() << "): " << error.message() << std::endl;
+    }
+}
+
+std::filesystem::path TextureCache::entry_path(uint64_t content_hash, TextureCompression requested, TextureChannels requested_channels, MipFilter filter, uint32_t flags) const {
+    std::stringstream name{};
+    name << std::hex << std::setw(16) << std::setfill('0') << content_hash << std::dec
+         << "-" << to_string(requested) << "-" << to_string(requested_channels) << "-" << to_string(filter) << "-" << flags
+         << ".bctex";
+    return cache_path / name.str();
+}
+
+std::optional<MipChain> TextureCache::read(const std::string& file, uint64_t content_hash, TextureCompression requested, TextureChannels requested_channels,
+                                           MipFilter filter, bool srgb, bool flip_vertical) const {
+    if (!enabled) return std::nullopt;
+
+    auto flags = (srgb ? FLAG_SRGB : 0) | (flip_vertical ? FLAG_FLIPPED : 0);
+    auto path = entry_path(content_hash, requested, requested_channels, filter, flags);
+    std::error_code error;
+    if (!std::filesystem::exists(path, error)) return std::nullopt;
+
+    try {
+        MappedFile mapped_file{path.string()};
+        BinaryReader reader{mapped_file.data(), mapped_file.size()};
+        auto header = reader.read<Header>();
+
+        bool valid = std::memcmp(header.magic, "C3TC", sizeof(header.magic)) == 0
+                     && header.version == FORMAT_VERSION
+                     && header.requested == (uint32_t) requested
+                     && (header.flags & ~FLAG_STORED_SRGB) == flags
+                     && header.requested_channels == (uint32_t) requested_channels
+                     && header.mip_filter == (uint32_t) filter
+                     && header.content_hash == content_hash;
+        if (!valid) return std::nullopt;
+
+        MipChain texture{(TextureCompression) header.format, header.width, header.height, header.channels, (header.flags & FLAG_STORED_SRGB) != 0};
+        texture.mips = reader.read_vector<MipChain::Mip>();
+        texture.data = reader.read_vector<unsigned char>();
+        texture.psnr = header.psnr;
+        texture.from_cache = true;
+
+        for (const auto& mip: texture.mips) {
+            if (mip.offset + mip.size > texture.data.size()) {
+                throw std::runtime_error(Formatter() << "Mip " << mip.width << "x" << mip.height << " is out of bounds");
+            }
+        }
+        return texture;
+    } catch (const std::exception& e) {
+        std::cerr << "Ignoring corrupt texture cache entry for (" << file << "): " << e.what() << std::endl;
+        return std::nullopt;
+    }
+}
+
+void TextureCache::write(const std::string& file, uint64_t content_hash, TextureCompression requested, TextureChannels requested_channels,
+                         MipFilter filter, bool srgb, bool flip_vertical, const MipChain& texture) const {
+    if (!enabled) return;
+
+    try {
+        auto flags = (srgb ? FLAG_SRGB : 0) | (flip_vertical ? FLAG_FLIPPED : 0);
+        auto header_flags = flags | (texture.srgb ? FLAG_STORED_SRGB : 0);
+        Header header{
+            {'C', '3', 'T', 'C'},
+            FORMAT_VERSION,
+            (uint32_t) requested,
+            (uint32_t) texture.format,
+            content_hash,
+            texture.width,
+            texture.height,
+            header_flags,
+            texture.psnr,
+            (uint32_t) filter,
+            texture.channels,
+            (uint32_t) requested_channels,
+            {},
+        };
+        static_assert(sizeof(Header) % BinaryWriter::ARRAY_ALIGNMENT == 0, "Header must keep the body aligned");
+
+        BinaryWriter body{};
+        body.write_vector(texture.mips);
+        body.write_vector(texture.data);
+
+        std::filesystem::create_directories(cache_path);
+        body.write_file(entry_path(content_hash, requested, requested_channels, filter, flags), &header, sizeof(Header));
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to write texture cache entry for (" << file << "): " << e.what() << std::endl;
+    }
+}
@@ -0,0 +1,70 @@
+#ifndef TEXTURE_CACHE_H
+#define TEXTURE_CACHE_H
+
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+
+#include "MipGenerator.h"
+#include "TextureCompression.h"
+
+/// A versioned on-disk cache of texture mip chains, so that warm loads skip decoding, building the mips and (if block compressed) encoding.
+///
+/// Each entry is a small DDS-like container: a header recording the format and the hash of the source file's contents,
+/// then the mip table, then the texels (or blocks) of every mip back to back, ready to be uploaded level by level.
+/// Entries are keyed on the content hash (see ContentHashes), the requested compression and channels, the mip filter, and the sRGB and flip flags,
+/// so files with the same contents share entries, and a file that is renamed (or changed and then changed back) still hits the cache.
+class TextureCache {
+    std::filesystem::path cache_path;
+    // Atomic since it is read by loads running on worker threads
+    std::atomic<bool> enabled = true;
+
+public:
+    /// Bump this whenever the layout of the cache files, or how the data in them is produced, changes.
+    static constexpr uint32_t FORMAT_VERSION = 5;
+
+    explicit TextureCache(std::filesystem::path cache_path);
+
+    /// Try to read a mip chain from the cache, returns nullopt if there is no valid entry.
+    /// The file is only used to report errors.
+    [[nodiscard]] std::optional<MipChain> read(const std::string& file, uint64_t content_hash, TextureCompression requested, TextureChannels requested_channels,
+                                               MipFilter filter, bool srgb, bool flip_vertical) const;
+
+    /// Write a mip chain to the cache, failures are reported but otherwise ignored since the cache is only an optimisation.
+    void write(const std::string& file, uint64_t content_hash, TextureCompression requested, TextureChannels requested_channels,
+               MipFilter filter, bool srgb, bool flip_vertical, const MipChain& texture) const;
+
+    /// Delete every entry in the cache
+    void clear() const;
+
+    [[nodiscard]] bool is_enabled() const { return enabled; }
+    void set_enabled(bool set_enabled) { enabled = set_enabled; }
+
+private:
+    struct Header {
+        char magic[4];
+        uint32_t version;
+        uint32_t requested;
+        uint32_t format;
+        uint64_t content_hash;
+        uint32_t width;
+        uint32_t height;
+        uint32_t flags;
+        float psnr;
+        uint32_t mip_filter;
+        uint32_t channels;
+        uint32_t requested_channels;
+        uint32_t reserved[3];
+    };
+
+    static constexpr uint32_t FLAG_SRGB = 1 << 0;
+    static constexpr uint32_t FLAG_FLIPPED = 1 << 1;
+    // Whether the stored texels are sRGB, which they aren't for fewer than 3 channels even when FLAG_SRGB is set
+    static constexpr uint32_t FLAG_STORED_SRGB = 1 << 2;
+
+    [[nodiscard]] std::filesystem::path entry_path(uint64_t content_hash, TextureCompression requested, TextureChannels requested_channels, MipFilter filter, uint32_t flags) const;
+};
+
+#endif //TEXTURE_CACHE_H
@@ -0,0 +1,720 @@
+#include "TextureCompression.h"
+
+#include <cmath>
+#include <chrono>
+#include <cstring>
+#include <limits>
+#include <future>
+#include <algorithm>
+#include <stdexcept>
+
+#include <glm/glm.hpp>
+#include <glad/gl.h>
+
+// Only defined by the loader if the S3TC extension was generated, but the values are fixed
+#ifndef GL_COMPRESSED_RGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_RGB_S3TC_DXT1_EXT 0x83F0
+#endif
+#ifndef GL_COMPRESSED_SRGB_S3TC_DXT1_EXT
+#define GL_COMPRESSED_SRGB_S3TC_DXT1_EXT 0x8C4C
+#endif
+
+std::string to_string(TextureCompression compression) {
+    switch (compression) {
+        case TextureCompression::None:
+            return "None";
+        case TextureCompression::Auto:
+            return "Auto";
+        case TextureCompression::BC1:
+            return "BC1";
+        case TextureCompression::BC4:
+            return "BC4";
+        case TextureCompression::BC5:
+            return "BC5";
+        case TextureCompression::BC7:
+            return "BC7";
+    }
+    return "Unknown";
+}
+
+std::string to_string(TextureChannels channels) {
+    switch (channels) {
+        case TextureChannels::Auto:
+            return "Auto";
+        case TextureChannels::R:
+            return "R";
+        case TextureChannels::RG:
+            return "RG";
+        case TextureChannels::RGB:
+            return "RGB";
+        case TextureChannels::RGBA:
+            return "RGBA";
+    }
+    return "Unknown";
+}
+
+MipChain MipChain::tail(size_t first_level) const {
+    MipChain chain{format, mips[first_level].width, mips[first_level].height, channels, srgb};
+    // Levels are stored largest first, so the tail is one contiguous run of data
+    auto start = mips[first_level].offset;
+    chain.data.assign(data.begin() + (long) start, data.end());
+    for (auto level = first_level; level < mips.size(); ++level) {
+        auto mip = mips[level];
+        mip.offset -= start;
+        chain.mips.push_back(mip);
+    }
+    chain.psnr = psnr;
+    chain.from_cache = from_cache;
+    chain.content_hash = content_hash;
+    return chain;
+}
+
+CompressionSupport CompressionSupport::query() {
+    CompressionSupport support{};
+
+    int major = 0;
+    int minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    // RGTC is core since 3.0, and BPTC since 4.2
+    support.bc4_bc5 = major >= 3;
+    support.bc7 = major > 4 || (major == 4 && minor >= 2);
+
+    int extension_count = 0;
+    glGetIntegerv(GL_NUM_EXTENSIONS, &extension_count);
+    for (auto i = 0; i < extension_count; ++i) {
+        std::string extension = reinterpret_cast<const char*>(glGetStringi(GL_EXTENSIONS, (uint) i));
+        if (extension == "GL_EXT_texture_compression_s3tc") support.bc1 = true;
+        if (extension == "GL_ARB_texture_compression_bptc") support.bc7 = true;
+    }
+
+    return support;
+}
+
+bool CompressionSupport::supports(TextureCompression format) const {
+    switch (format) {
+        case TextureCompression::None:
+            return true;
+        case TextureCompression::BC1:
+            return bc1;
+        case TextureCompression::BC4:
+        case TextureCompression::BC5:
+            return bc4_bc5;
+        case TextureCompression::BC7:
+            return bc7;
+        default:
+            return false;
+    }
+}
+
+namespace BlockCompression {
+    // The weights (out of 64) of the second endpoint, for each of the 16 BC7 index values
+    static constexpr uint BC7_WEIGHTS[16] = {0, 4, 9, 13, 17, 21, 26, 30, 34, 38, 43, 47, 51, 55, 60, 64};
+    // Iterations of least squares endpoint refinement, each re-fits the endpoints to the chosen indices
+    static constexpr uint REFINE_ITERATIONS = 2;
+
+    /// Packs values into a block, least significant bit first
+    class BitWriter {
+        uint8_t* out;
+        uint bit = 0;
+    public:
+        BitWriter(uint8_t* out, size_t size) : out(out) { std::memset(out, 0, size); }
+
+        void write(uint value, uint bits) {
+            for (auto i = 0u; i < bits; ++i, ++bit) {
+                if ((value >> i) & 1u) out[bit >> 3] |= (uint8_t) (1u << (bit & 7u));
+            }
+        }
+    };
+
+    class BitReader {
+        const uint8_t* in;
+        uint bit = 0;
+    public:
+        explicit BitReader(const uint8_t* in) : in(in) {}
+
+        uint read(uint bits) {
+            uint value = 0;
+            for (auto i = 0u; i < bits; ++i, ++bit) {
+                value |= (uint) ((in[bit >> 3] >> (bit & 7u)) & 1u) << i;
+            }
+            return value;
+        }
+    };
+
+    /// The direction the points vary the most in, found by power iteration on their covariance. Zero if they are all equal.
+    static glm::vec4 principal_axis(const glm::vec4* points, uint count, const glm::vec4& mean) {
+        glm::mat4 covariance{0.0f};
+        for (auto i = 0u; i < count; ++i) {
+            auto offset = points[i] - mean;
+            covariance += glm::outerProduct(offset, offset);
+        }
+
+        glm::vec4 axis{1.0f, 1.0f, 1.0f, 1.0f};
+        for (auto iteration = 0; iteration < 8; ++iteration) {
+            axis = covariance * axis;
+            auto largest = std::max({std::abs(axis.x), std::abs(axis.y), std::abs(axis.z), std::abs(axis.w)});
+            if (largest < 1e-6f) return glm::vec4{0.0f};
+            axis /= largest;
+        }
+        return glm::normalize(axis);
+    }
+
+    /// Endpoints through the points along their principal axis, pulled in a little, since the extremes are rarely worth matching exactly.
+    static std::pair<glm::vec4, glm::vec4> fit_endpoints(const glm::vec4* points, uint count, float inset) {
+        glm::vec4 mean{0.0f};
+        for (auto i = 0u; i < count; ++i) mean += points[i];
+        mean /= (float) count;
+
+        auto axis = principal_axis(points, count, mean);
+        auto min_t = 0.0f;
+        auto max_t = 0.0f;
+        for (auto i = 0u; i < count; ++i) {
+            auto t = glm::dot(points[i] - mean, axis);
+            min_t = std::min(min_t, t);
+            max_t = std::max(max_t, t);
+        }
+
+        auto start = mean + axis * max_t;
+        auto end = mean + axis * min_t;
+        auto delta = (start - end) * inset;
+        return {glm::clamp(start - delta, 0.0f, 255.0f), glm::clamp(end + delta, 0.0f, 255.0f)};
+    }
+
+    /// Solve for the endpoints that best fit the points, given each point's weight of the first endpoint.
+    /// Returns false if the system is degenerate (eg. every point uses the same index).
+    static bool least_squares_endpoints(const glm::vec4* points, const float* weights, uint count, glm::vec4& start, glm::vec4& end) {
+        float aa = 0.0f, ab = 0.0f, bb = 0.0f;
+        glm::vec4 ax{0.0f}, bx{0.0f};
+        for (auto i = 0u; i < count; ++i) {
+            auto a = weights[i];
+            auto b = 1.0f - a;
+            aa += a * a;
+            ab += a * b;
+            bb += b * b;
+            ax += a * points[i];
+            bx += b * points[i];
+        }
+
+        auto determinant = aa * bb - ab * ab;
+        if (std::abs(determinant) < 1e-6f) return false;
+
+        start = glm::clamp((bb * ax - ab * bx) / determinant, 0.0f, 255.0f);
+        end = glm::clamp((aa * bx - ab * ax) / determinant, 0.0f, 255.0f);
+        return true;
+    }
+
+    static float squared_distance(const glm::vec4& a, const glm::vec4& b) {
+        auto offset = a - b;
+        return glm::dot(offset, offset);
+    }
+
+    static uint16_t to_565(const glm::vec4& colour) {
+        auto r = (uint) std::lround(colour.r * 31.0f / 255.0f);
+        auto g = (uint) std::lround(colour.g * 63.0f / 255.0f);
+        auto b = (uint) std::lround(colour.b * 31.0f / 255.0f);
+        return (uint16_t) ((std::min(r, 31u) << 11) | (std::min(g, 63u) << 5) | std::min(b, 31u));
+    }
+
+    static glm::vec4 from_565(uint16_t colour) {
+        uint r = (colour >> 11) & 31u;
+        uint g = (colour >> 5) & 63u;
+        uint b = colour & 31u;
+        // Replicate the high bits into the low bits, as the hardware does
+        return glm::vec4{(float) ((r << 3) | (r >> 2)), (float) ((g << 2) | (g >> 4)), (float) ((b << 3) | (b >> 2)), 255.0f};
+    }
+
+    static glm::vec4 to_point(const RGBABlock& block, uint texel, bool alpha) {
+        return glm::vec4{block[texel * 4 + 0], block[texel * 4 + 1], block[texel * 4 + 2], alpha ? block[texel * 4 + 3] : 0.0f};
+    }
+
+    struct BC1Candidate {
+        uint16_t colour0;
+        uint16_t colour1;
+        uint8_t indices[BLOCK_TEXELS];
+        float error;
+    };
+
+    static BC1Candidate evaluate_bc1(const glm::vec4* points, const glm::vec4& start, const glm::vec4& end) {
+        BC1Candidate candidate{to_565(start), to_565(end), {}, 0.0f};
+        if (candidate.colour0 == candidate.colour1) {
+            // Can't be put in 4 colour mode, but index 0 in 3 colour mode is still colour0
+            auto colour = from_565(candidate.colour0);
+            colour.a = 0.0f;
+            for (auto i = 0u; i < BLOCK_TEXELS; ++i) candidate.error += squared_distance(points[i], colour);
+            return candidate;
+        }
+        if (candidate.colour0 < candidate.colour1) std::swap(candidate.colour0, candidate.colour1);
+
+        auto colour0 = from_565(candidate.colour0);
+        auto colour1 = from_565(candidate.colour1);
+        colour0.a = colour1.a = 0.0f;
+        glm::vec4 palette[4] = {colour0, colour1, (2.0f * colour0 + colour1) / 3.0f, (colour0 + 2.0f * colour1) / 3.0f};
+
+        for (auto i = 0u; i < BLOCK_TEXELS; ++i) {
+            auto best = 0u;
+            auto best_error = std::numeric_limits<float>::max();
+            for (auto p = 0u; p < 4; ++p) {
+                auto error = squared_distance(points[i], palette[p]);
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            candidate.indices[i] = (uint8_t) best;
+            candidate.error += best_error;
+        }
+        return candidate;
+    }
+
+    void encode_bc1(const RGBABlock& block, uint8_t* out) {
+        glm::vec4 points[BLOCK_TEXELS];
+        for (auto i = 0u; i < BLOCK_TEXELS; ++i) points[i] = to_point(block, i, false);
+
+        auto [start, end] = fit_endpoints(points, BLOCK_TEXELS, 1.0f / 16.0f);
+        auto best = evaluate_bc1(points, start, end);
+
+        // The weight of colour0 for each 4 colour mode index
+        static constexpr float INDEX_WEIGHTS[4] = {1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f};
+        for (auto iteration = 0u; iteration < REFINE_ITERATIONS && best.colour0 != best.colour1; ++iteration) {
+            float weights[BLOCK_TEXELS];
+            for (auto i = 0u; i < BLOCK_TEXELS; ++i) weights[i] = INDEX_WEIGHTS[best.indices[i]];
+            if (!least_squares_endpoints(points, weights, BLOCK_TEXELS, start, end)) break;
+
+            auto candidate = evaluate_bc1(points, start, end);
+            if (candidate.error >= best.error) break;
+            best = candidate;
+        }
+
+        BitWriter writer{out, block_bytes(TextureCompression::BC1)};
+        writer.write(best.colour0, 16);
+        writer.write(best.colour1, 16);
+        for (auto index: best.indices) writer.write(index, 2);
+    }
+
+    void decode_bc1(const uint8_t* in, RGBABlock& block) {
+        BitReader reader{in};
+        auto colour0 = (uint16_t) reader.read(16);
+        auto colour1 = (uint16_t) reader.read(16);
+
+        auto start = from_565(colour0);
+        auto end = from_565(colour1);
+        glm::vec4 palette[4] = {start, end};
+        if (colour0 > colour1) {
+            palette[2] = (2.0f * start + end) / 3.0f;
+            palette[3] = (start + 2.0f * end) / 3.0f;
+        } else {
+            palette[2] = (start + end) * 0.5f;
+            palette[3] = glm::vec4{0.0f};
+        }
+
+        for (auto i = 0u; i < BLOCK_TEXELS; ++i) {
+            const auto& colour = palette[reader.read(2)];
+            for (auto c = 0; c < 4; ++c) block[i * 4 + c] = (uint8_t) std::lround(colour[c]);
+        }
+    }
+
+    /// The 8 values of an 8 value mode BC4 block (so with start > end)
+    static void bc4_palette(uint start, uint end, float palette[8]) {
+        palette[0] = (float) start;
+        palette[1] = (float) end;
+        for (auto i = 2u; i < 8; ++i) {
+            palette[i] = ((float) (8 - i) * (float) start + (float) (i - 1) * (float) end) / 7.0f;
+        }
+    }
+
+    void encode_bc4(const ChannelBlock& block, uint8_t* out) {
+        auto [min, max] = std::minmax_element(block.begin(), block.end());
+
+        BitWriter writer{out, block_bytes(TextureCompression::BC4)};
+        writer.write(*max, 8);
+        writer.write(*min, 8);
+        // A flat block leaves every index at 0, which is the start value in either mode
+        if (*min == *max) return;
+
+        float palette[8];
+        bc4_palette(*max, *min, palette);
+        for (auto value: block) {
+            auto best = 0u;
+            auto best_error = std::numeric_limits<float>::max();
+            for (auto p = 0u; p < 8; ++p) {
+                auto error = std::abs(palette[p] - (float) value);
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            writer.write(best, 3);
+        }
+    }
+
+    void decode_bc4(const uint8_t* in, ChannelBlock& block) {
+        BitReader reader{in};
+        auto start = reader.read(8);
+        auto end = reader.read(8);
+
+        float palette[8];
+        if (start > end) {
+            bc4_palette(start, end, palette);
+        } else {
+            palette[0] = (float) start;
+            palette[1] = (float) end;
+            for (auto i = 2u; i < 6; ++i) {
+                palette[i] = ((float) (6 - i) * (float) start + (float) (i - 1) * (float) end) / 5.0f;
+            }
+            palette[6] = 0.0f;
+            palette[7] = 255.0f;
+        }
+
+        for (auto& value: block) {
+            value = (uint8_t) std::lround(palette[reader.read(3)]);
+        }
+    }
+
+    void encode_bc5(const ChannelBlock& red, const ChannelBlock& green, uint8_t* out) {
+        encode_bc4(red, out);
+        encode_bc4(green, out + block_bytes(TextureCompression::BC4));
+    }
+
+    struct BC7Candidate {
+        // 7 bit endpoints with their p-bits, making up 8 bit values
+        glm::uvec4 endpoint0;
+        glm::uvec4 endpoint1;
+        uint p0;
+        uint p1;
+        uint8_t indices[BLOCK_TEXELS];
+        float error;
+    };
+
+    /// Quantise an endpoint to 7 bits per channel and a shared p-bit, picking the p-bit that fits it best
+    static std::pair<glm::uvec4, uint> quantise_bc7_endpoint(const glm::vec4& endpoint) {
+        std::pair<glm::uvec4, uint> best{};
+        auto best_error = std::numeric_limits<float>::max();
+        for (auto p = 0u; p < 2; ++p) {
+            glm::uvec4 quantised{};
+            auto error = 0.0f;
+            for (auto c = 0; c < 4; ++c) {
+                quantised[c] = (uint) std::clamp((int) std::lround((endpoint[c] - (float) p) / 2.0f), 0, 127);
+                auto value = (float) (quantised[c] * 2 + p);
+                error += (value - endpoint[c]) * (value - endpoint[c]);
+            }
+            if (error < best_error) {
+                best = {quantised, p};
+                best_error = error;
+            }
+        }
+        return best;
+    }
+
+    static void bc7_palette(const glm::uvec4& endpoint0, uint p0, const glm::uvec4& endpoint1, uint p1, glm::vec4 palette[16]) {
+        auto start = endpoint0 * 2u + p0;
+        auto end = endpoint1 * 2u + p1;
+        for (auto i = 0u; i < 16; ++i) {
+            for (auto c = 0; c < 4; ++c) {
+                palette[i][c] = (float) (((64 - BC7_WEIGHTS[i]) * start[c] + BC7_WEIGHTS[i] * end[c] + 32) >> 6);
+            }
+        }
+    }
+
+    static BC7Candidate evaluate_bc7(const glm::vec4* points, const glm::vec4& start, const glm::vec4& end) {
+        BC7Candidate candidate{};
+        std::tie(candidate.endpoint0, candidate.p0) = quantise_bc7_endpoint(start);
+        std::tie(candidate.endpoint1, candidate.p1) = quantise_bc7_endpoint(end);
+
+        glm::vec4 palette[16];
+        bc7_palette(candidate.endpoint0, candidate.p0, candidate.endpoint1, candidate.p1, palette);
+
+        for (auto i = 0u; i < BLOCK_TEXELS; ++i) {
+            auto best = 0u;
+            auto best_error = std::numeric_limits<float>::max();
+            for (auto p = 0u; p < 16; ++p) {
+                auto error = squared_distance(points[i], palette[p]);
+                if (error < best_error) {
+                    best = p;
+                    best_error = error;
+                }
+            }
+            candidate.indices[i] = (uint8_t) best;
+            candidate.error += best_error;
+        }
+        return candidate;
+    }
+
+    void encode_bc7(const RGBABlock& block, uint8_t* out) {
+        glm::vec4 points[BLOCK_TEXELS];
+        for (auto i = 0u; i < BLOCK_TEXELS; ++i) points[i] = to_point(block, i, true);
+
+        auto [start, end] = fit_endpoints(points, BLOCK_TEXELS, 0.0f);
+        auto best = evaluate_bc7(points, start, end);
+
+        for (auto iteration = 0u; iteration < REFINE_ITERATIONS; ++iteration) {
+            float weights[BLOCK_TEXELS];
+            for (auto i = 0u; i < BLOCK_TEXELS; ++i) weights[i] = 1.0f - (float) BC7_WEIGHTS[best.indices[i]] / 64.0f;
+            if (!least_squares_endpoints(points, weights, BLOCK_TEXELS, start, end)) break;
+
+            auto candidate = evaluate_bc7(points, start, end);
+            if (candidate.error >= best.error) break;
+            best = candidate;
+        }
+
+        // The first index is stored with its top bit implied to be 0, so swap the endpoints if needed to make it so
+        if (best.indices[0] >= 8) {
+            std::swap(best.endpoint0, best.endpoint1);
+            std::swap(best.p0, best.p1);
+            for (auto& index: best.indices) index = (uint8_t) (15 - index);
+        }
+
+        BitWriter writer{out, block_bytes(TextureCompression::BC7)};
+        // Mode 6 is a unary 1 after 6 zeroes
+        writer.write(1u << 6, 7);
+        for (auto c = 0; c < 4; ++c) {
+            writer.write(best.endpoint0[c], 7);
+            writer.write(best.endpoint1[c], 7);
+        }
+        writer.write(best.p0, 1);
+        writer.write(best.p1, 1);
+        writer.write(best.indices[0], 3);
+        for (auto i = 1u; i < BLOCK_TEXELS; ++i) writer.write(best.indices[i], 4);
+    }
+
+    void decode_bc7(const uint8_t* in, RGBABlock& block) {
+        BitReader reader{in};
+        if (reader.read(7) != 1u << 6) {
+            throw std::runtime_error("Only BC7 mode 6 blocks can be decoded");
+        }
+
+        glm::uvec4 endpoint0{};
+        glm::uvec4 endpoint1{};
+        for (auto c = 0; c < 4; ++c) {
+            endpoint0[c] = reader.read(7);
+            endpoint1[c] = reader.read(7);
+        }
+        auto p0 = reader.read(1);
+        auto p1 = reader.read(1);
+
+        glm::vec4 palette[16];
+        bc7_palette(endpoint0, p0, endpoint1, p1, palette);
+
+        for (auto i = 0u; i < BLOCK_TEXELS; ++i) {
+            const auto& colour = palette[reader.read(i == 0 ? 3 : 4)];
+            for (auto c = 0; c < 4; ++c) block[i * 4 + c] = (uint8_t) colour[c];
+        }
+    }
+
+    size_t block_bytes(TextureCompression format) {
+        switch (format) {
+            case TextureCompression::BC1:
+            case TextureCompression::BC4:
+                return 8;
+            case TextureCompression::BC5:
+            case TextureCompression::BC7:
+                return 16;
+            default:
+                throw std::runtime_error(Formatter() << "Texture compression " << to_string(format) << " has no block size");
+        }
+    }
+
+    uint gl_internal_format(TextureCompression format, bool srgb) {
+        switch (format) {
+            case TextureCompression::BC1:
+                return srgb ? GL_COMPRESSED_SRGB_S3TC_DXT1_EXT : GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+            case TextureCompression::BC4:
+                return GL_COMPRESSED_RED_RGTC1;
+            case TextureCompression::BC5:
+                return GL_COMPRESSED_RG_RGTC2;
+            case TextureCompression::BC7:
+                return srgb ? GL_COMPRESSED_SRGB_ALPHA_BPTC_UNORM : GL_COMPRESSED_RGBA_BPTC_UNORM;
+            default:
+                throw std::runtime_error(Formatter() << "Texture compression " << to_string(format) << " has no OpenGL format");
+        }
+    }
+
+    TextureCompression resolve(TextureCompression requested, bool srgb, TextureChannels channels, const CompressionSupport& support) {
+        auto format = requested;
+        if (format == TextureCompression::None) return format;
+        if (format == TextureCompression::Auto) {
+            format = channels == TextureChannels::R ? TextureCompression::BC4 : channels == TextureChannels::RG ? TextureCompression::BC5 : TextureCompression::BC7;
+        }
+
+        // Neither has an sRGB variant
+        if (srgb && (format == TextureCompression::BC4 || format == TextureCompression::BC5)) format = TextureCompression::BC7;
+        // BC1 can only store alpha as a 1 bit cutout, so is no substitute if there is alpha
+        if (format == TextureCompression::BC7 && !support.bc7) format = channels == TextureChannels::RGBA ? TextureCompression::None : TextureCompression::BC1;
+        if (format == TextureCompression::BC1 && !support.bc1) return TextureCompression::None;
+        if ((format == TextureCompression::BC4 || format == TextureCompression::BC5) && !support.bc4_bc5) return TextureCompression::None;
+        return format;
+    }
+
+    static void encode_block_row(const uint8_t* rgba, uint width, uint height, TextureCompression format, uint block_y, uint8_t* out) {
+        auto blocks_x = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        auto bytes = block_bytes(format);
+
+        RGBABlock block{};
+        ChannelBlock red{};
+        ChannelBlock green{};
+        for (auto block_x = 0u; block_x < blocks_x; ++block_x) {
+            for (auto y = 0u; y < BLOCK_SIZE; ++y) {
+                // Partial blocks repeat the edge texels, which are never sampled but keep the endpoints tight
+                auto source_y = std::min(block_y * BLOCK_SIZE + y, height - 1);
+                for (auto x = 0u; x < BLOCK_SIZE; ++x) {
+                    auto source_x = std::min(block_x * BLOCK_SIZE + x, width - 1);
+                    const auto* texel = rgba + ((size_t) source_y * width + source_x) * 4;
+                    std::memcpy(&block[(y * BLOCK_SIZE + x) * 4], texel, 4);
+                    red[y * BLOCK_SIZE + x] = texel[0];
+                    green[y * BLOCK_SIZE + x] = texel[1];
+                }
+            }
+
+            auto* block_out = out + block_x * bytes;
+            switch (format) {
+                case TextureCompression::BC1:
+                    encode_bc1(block, block_out);
+                    break;
+                case TextureCompression::BC4:
+                    encode_bc4(red, block_out);
+                    break;
+                case TextureCompression::BC5:
+                    encode_bc5(red, green, block_out);
+                    break;
+                case TextureCompression::BC7:
+                    encode_bc7(block, block_out);
+                    break;
+                default:
+                    throw std::runtime_error(Formatter() << "Can not encode texture compression " << to_string(format));
+            }
+        }
+    }
+
+    std::vector<uint8_t> encode_image(const uint8_t* rgba, uint width, uint height, TextureCompression format, ThreadPool* pool) {
+        auto blocks_x = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        auto blocks_y = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        auto row_bytes = blocks_x * block_bytes(format);
+        std::vector<uint8_t> blocks(blocks_y * row_bytes);
+
+        // Waiting on the pool from one of its own workers could deadlock, so only split the work up from outside it
+        if (pool == nullptr || ThreadPool::get_worker_index().has_value() || blocks_y < 2) {
+            for (auto block_y = 0u; block_y < blocks_y; ++block_y) {
+                encode_block_row(rgba, width, height, format, block_y, blocks.data() + block_y * row_bytes);
+            }
+            return blocks;
+        }
+
+        // A few bands per worker, so that uneven bands still balance out
+        auto band_count = std::min(blocks_y, pool->get_thread_count() * 4);
+        std::vector<std::future<void>> bands{};
+        for (auto band = 0u; band < band_count; ++band) {
+            auto first_row = blocks_y * band / band_count;
+            auto last_row = blocks_y * (band + 1) / band_count;
+            bands.push_back(pool->submit([=, &blocks]() {
+                for (auto block_y = first_row; block_y < last_row; ++block_y) {
+                    encode_block_row(rgba, width, height, format, block_y, blocks.data() + block_y * row_bytes);
+                }
+            }));
+        }
+        // Wait for every band before rethrowing any error, since they all write into blocks
+        for (auto& band: bands) band.wait();
+        for (auto& band: bands) band.get();
+
+        return blocks;
+    }
+
+    std::vector<uint8_t> decode_image(const uint8_t* blocks, uint width, uint height, TextureCompression format) {
+        auto blocks_x = (width + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        auto blocks_y = (height + BLOCK_SIZE - 1) / BLOCK_SIZE;
+        auto bytes = block_bytes(format);
+        std::vector<uint8_t> rgba((size_t) width * height * 4);
+
+        RGBABlock block{};
+        ChannelBlock red{};
+        ChannelBlock green{};
+        for (auto block_y = 0u; block_y < blocks_y; ++block_y) {
+            for (auto block_x = 0u; block_x < blocks_x; ++block_x) {
+                const auto* block_in = blocks + (block_y * blocks_x + block_x) * bytes;
+                switch (format) {
+                    case TextureCompression::BC1:
+                        decode_bc1(block_in, block);
+                        break;
+                    case TextureCompression::BC4:
+                        decode_bc4(block_in, red);
+                        // Sampled as greyscale, through the texture swizzle
+                        for (auto i = 0u; i < BLOCK_TEXELS; ++i) {
+                            block[i * 4 + 0] = block[i * 4 + 1] = block[i * 4 + 2] = red[i];
+                            block[i * 4 + 3] = 255;
+                        }
+                        break;
+                    case TextureCompression::BC5:
+                        decode_bc4(block_in, red);
+                        decode_bc4(block_in + block_bytes(TextureCompression::BC4), green);
+                        for (auto i = 0u; i < BLOCK_TEXELS; ++i) {
+                            block[i * 4 + 0] = red[i];
+                            block[i * 4 + 1] = green[i];
+                            block[i * 4 + 2] = 0;
+                            block[i * 4 + 3] = 255;
+                        }
+                        break;
+                    case TextureCompression::BC7:
+                        decode_bc7(block_in, block);
+                        break;
+                    default:
+                        throw std::runtime_error(Formatter() << "Can not decode texture compression " << to_string(format));
+                }
+
+                for (auto y = 0u; y < BLOCK_SIZE && block_y * BLOCK_SIZE + y < height; ++y) {
+                    for (auto x = 0u; x < BLOCK_SIZE && block_x * BLOCK_SIZE + x < width; ++x) {
+                        auto target = ((size_t) (block_y * BLOCK_SIZE + y) * width + block_x * BLOCK_SIZE + x) * 4;
+                        std::memcpy(&rgba[target], &block[(y * BLOCK_SIZE + x) * 4], 4);
+                    }
+                }
+            }
+        }
+        return rgba;
+    }
+
+    float psnr(const std::vector<uint8_t>& original, const std::vector<uint8_t>& decoded, TextureCompression format) {
+        uint channels = format == TextureCompression::BC4 ? 1 : format == TextureCompression::BC5 ? 2 : 3;
+
+        double squared_error = 0.0;
+        size_t samples = 0;
+        for (size_t i = 0; i + 3 < original.size(); i += 4) {
+            for (auto c = 0u; c < channels; ++c) {
+                auto difference = (double) original[i + c] - (double) decoded[i + c];
+                squared_error += difference * difference;
+            }
+            samples += channels;
+        }
+
+        if (samples == 0 || squared_error == 0.0) return std::numeric_limits<float>::infinity();
+        auto mean_squared_error = squared_error / (double) samples;
+        return (float) (10.0 * std::log10(255.0 * 255.0 / mean_squared_error));
+    }
+
+    MipChain compress(const MipChain& rgba_mips, TextureCompression format, ThreadPool* pool) {
+        if (rgba_mips.format != TextureCompression::None || rgba_mips.channels != 4) {
+            throw std::runtime_error("Only uncompressed RGBA8 mip chains can be compressed");
+        }
+
+        MipChain compressed{format, rgba_mips.width, rgba_mips.height};
+        compressed.channels = format == TextureCompression::BC4 ? 1 : format == TextureCompression::BC5 ? 2 : format == TextureCompression::BC1 ? 3 : 4;
+        compressed.srgb = rgba_mips.srgb;
+        compressed.mip_ms = rgba_mips.mip_ms;
+
+        std::chrono::steady_clock::duration encode_time{0};
+        for (auto level = 0u; level < rgba_mips.mips.size(); ++level) {
+            const auto& mip = rgba_mips.mips[level];
+            auto encode_start = std::chrono::steady_clock::now();
+            auto blocks = encode_image(rgba_mips.mip_data(level), mip.width, mip.height, format, pool);
+            encode_time += std::chrono::steady_clock::now() - encode_start;
+
+            if (level == 0) {
+                std::vector<uint8_t> original{rgba_mips.mip_data(0), rgba_mips.mip_data(0) + mip.size};
+                compressed.psnr = psnr(original, decode_image(blocks.data(), mip.width, mip.height, format), format);
+            }
+
+            compressed.mips.push_back({mip.width, mip.height, compressed.data.size(), blocks.size()});
+            compressed.data.insert(compressed.data.end(), blocks.begin(), blocks.end());
+        }
+
+        compressed.encode_ms = std::chrono::duration<double, std::milli>(encode_time).count();
+        return compressed;
+    }
+}
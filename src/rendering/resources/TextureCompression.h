@@ -0,0 +1,140 @@
+#ifndef TEXTURE_COMPRESSION_H
+#define TEXTURE_COMPRESSION_H
+
+#include <array>
+#include <string>
+#include <vector>
+#include <cstdint>
+
+#include "utility/HelperTypes.h"
+#include "utility/ThreadPool.h"
+
+/// How a texture is stored on the GPU.
+/// Every block compressed format stores each 4x4 block of texels in a fixed number of bytes, so can be sampled without decompressing first.
+enum class TextureCompression : uint32_t {
+    // Uploaded as plain 8 bit texels
+    None = 0,
+    // Picked per texture from its channels (see TextureChannels): BC4 for R, BC5 for RG, otherwise BC7
+    Auto = 1,
+    // RGB in 8 bytes per block, small and fast to encode, but prone to banding and discolouration
+    BC1 = 2,
+    // A single channel in 8 bytes per block, sampled as greyscale
+    BC4 = 3,
+    // Two channels in 16 bytes per block, intended for tangent space normal maps
+    BC5 = 4,
+    // RGBA in 16 bytes per block, the highest quality but the slowest to encode
+    BC7 = 5,
+};
+
+std::string to_string(TextureCompression compression);
+
+/// The channels a texture is stored with, other than Auto the value is the number of channels.
+/// Fewer channels take less memory, and are swizzled back out when sampled, so shaders can always sample .rgb.
+enum class TextureChannels : uint32_t {
+    // Detected from the image: RGBA if anything is transparent, R if it is greyscale, RG if blue is always 0, otherwise RGB
+    Auto = 0,
+    // Greyscale, such as specular maps, sampled as (r, r, r, 1)
+    R = 1,
+    // Two channels, such as tangent space normal maps, sampled as (r, g, 0, 1)
+    RG = 2,
+    RGB = 3,
+    RGBA = 4,
+};
+
+std::string to_string(TextureChannels channels);
+
+/// The formats the current OpenGL context can sample, which a compression is resolved against.
+struct CompressionSupport {
+    bool bc1 = false;
+    bool bc4_bc5 = false;
+    bool bc7 = false;
+
+    /// Query the current context, so must be called on the GL thread
+    static CompressionSupport query();
+
+    /// True if the format can be sampled (None always can)
+    [[nodiscard]] bool supports(TextureCompression format) const;
+};
+
+/// A texture's whole mip chain, ready to upload level by level.
+/// Either in a block compressed format, or (with format None) tightly packed 8 bit texels with channels per texel.
+struct MipChain {
+    struct Mip {
+        uint width;
+        uint height;
+        // Into data
+        size_t offset;
+        size_t size;
+    };
+
+    // Never Auto
+    TextureCompression format = TextureCompression::None;
+    uint width = 0;
+    uint height = 0;
+    // The number of channels of each texel for uncompressed chains, otherwise the channels the texture is sampled with (see TextureChannels)
+    uint channels = 4;
+    // If the colour channels are sRGB encoded. Never the case for fewer than 3 channels, since there are no such formats.
+    bool srgb = false;
+    std::vector<Mip> mips{};
+    std::vector<unsigned char> data{};
+    // Of the top mip against the source, over the channels the format stores (infinite for uncompressed chains)
+    float psnr = 0.0f;
+    double mip_ms = 0.0;
+    double encode_ms = 0.0;
+    // Read back from the texture cache rather than generated, so mip_ms and encode_ms are 0
+    bool from_cache = false;
+    // Of the contents of the file the chain was built from (see ContentHashes), or 0 if it wasn't built from a file
+    uint64_t content_hash = 0;
+
+    [[nodiscard]] const unsigned char* mip_data(size_t level) const { return data.data() + mips[level].offset; }
+    /// The levels from first_level down, as a chain of their own (copying their data)
+    [[nodiscard]] MipChain tail(size_t first_level) const;
+};
+
+/// CPU encoders (and decoders, for measuring quality) for the BCn block compressed formats.
+/// See: https://learn.microsoft.com/en-us/windows/win32/direct3d11/texture-block-compression-in-direct3d-11
+/// and: https://registry.khronos.org/DataFormat/specs/1.3/dataformat.1.3.html#S3TC
+namespace BlockCompression {
+    constexpr uint BLOCK_SIZE = 4;
+    constexpr uint BLOCK_TEXELS = BLOCK_SIZE * BLOCK_SIZE;
+
+    using RGBABlock = std::array<uint8_t, BLOCK_TEXELS * 4>;
+    using ChannelBlock = std::array<uint8_t, BLOCK_TEXELS>;
+
+    /// The number of bytes each 4x4 block takes in format
+    size_t block_bytes(TextureCompression format);
+
+    /// The OpenGL internal format for format, with the sRGB variant where there is one
+    uint gl_internal_format(TextureCompression format, bool srgb);
+
+    /// Pick the concrete format to encode an image with the (resolved, so not Auto) channels in, given the requested compression.
+    /// Falls back to a supported format (or None) if the requested one can't be sampled, can't store alpha that the image has,
+    /// or has no sRGB variant when srgb is set.
+    TextureCompression resolve(TextureCompression requested, bool srgb, TextureChannels channels, const CompressionSupport& support);
+
+    void encode_bc1(const RGBABlock& block, uint8_t* out);
+    void encode_bc4(const ChannelBlock& block, uint8_t* out);
+    void encode_bc5(const ChannelBlock& red, const ChannelBlock& green, uint8_t* out);
+    /// Encodes with mode 6 (a single subset with 7 bit RGBA endpoints and 4 bit indices), which handles smooth gradients well
+    void encode_bc7(const RGBABlock& block, uint8_t* out);
+
+    void decode_bc1(const uint8_t* in, RGBABlock& block);
+    void decode_bc4(const uint8_t* in, ChannelBlock& block);
+    /// Only decodes mode 6 blocks, as produced by encode_bc7, others throw
+    void decode_bc7(const uint8_t* in, RGBABlock& block);
+
+    /// Encode a whole RGBA8 image (of any size, partial blocks are padded by clamping), returning the blocks in row major order.
+    /// If pool is given and this isn't called from one of its workers, rows of blocks are encoded in parallel across it.
+    std::vector<uint8_t> encode_image(const uint8_t* rgba, uint width, uint height, TextureCompression format, ThreadPool* pool = nullptr);
+
+    /// Decode an image encoded by encode_image back to RGBA8
+    std::vector<uint8_t> decode_image(const uint8_t* blocks, uint width, uint height, TextureCompression format);
+
+    /// The peak signal-to-noise ratio (in dB) of decoded against original, over the channels format stores
+    float psnr(const std::vector<uint8_t>& original, const std::vector<uint8_t>& decoded, TextureCompression format);
+
+    /// Encode every level of an uncompressed RGBA8 mip chain (see MipGenerator) in format, recording the time taken and the quality of the top mip.
+    MipChain compress(const MipChain& rgba_mips, TextureCompression format, ThreadPool* pool = nullptr);
+}
+
+#endif //TEXTURE_COMPRESSION_H
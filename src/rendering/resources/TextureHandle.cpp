@@ -1,29 +1,90 @@
 #include "TextureHandle.h"
 
+#include <algorithm>
+
 #include <glad/gl.h>
 
-TextureHandle::TextureHandle(uint texture_id, uint width, uint height, bool srgb, bool flipped, std::optional<std::string> filename) : texture_id(texture_id), width(width), height(height), srgb(srgb), flipped(flipped), filename(std::move(filename)) {}
+TextureHandle::TextureHandle(uint texture_id, uint width, uint height, bool srgb, bool flipped, std::optional<std::string> filename) : texture_id(texture_id), width(width), height(height), srgb(srgb), flipped(flipped), filename(std::move(filename)) {
+    // Drivers typically pad RGB8 out to 4 bytes per texel, and the mip chain adds another third
+    gpu_bytes = (size_t) width * height * 4 * 4 / 3;
+}
+
+std::shared_ptr<TextureHandle> TextureHandle::make_pending(const TextureHandle& placeholder, bool srgb, bool flipped, std::optional<std::string> filename) {
+    auto handle = std::make_shared<TextureHandle>(placeholder.texture_id, placeholder.width, placeholder.height, srgb, flipped, std::move(filename));
+    handle->owns_texture = false;
+    handle->ready = false;
+    return handle;
+}
+
+void TextureHandle::fulfill(TextureHandle& other) {
+    release_texture();
+    texture_id = other.texture_id;
+    width = other.width;
+    height = other.height;
+    gpu_bytes = other.gpu_bytes;
+    channels = other.channels;
+    compression = other.compression;
+    streamed = other.streamed;
+    resident_level = other.resident_level;
+    owns_texture = other.owns_texture;
+    shared_with = nullptr;
+    content_key = other.content_key;
+    ready = true;
+    ++generation;
+    other.owns_texture = false;
+}
+
+void TextureHandle::share(const std::shared_ptr<TextureHandle>& other) {
+    release_texture();
+    texture_id = other->texture_id;
+    width = other->width;
+    height = other->height;
+    gpu_bytes = 0;
+    channels = other->channels;
+    compression = other->compression;
+    streamed = false;
+    resident_level = 0;
+    shared_with = other;
+    content_key = 0;
+    ready = true;
+    ++generation;
+}
+
+void TextureHandle::release_texture() {
+    if (!owns_texture) return;
+    glDeleteTextures(1, &texture_id);
+    owns_texture = false;
+}
+
+const TextureHandle& TextureHandle::source() const {
+    // Only handles owning their texture are shared from, but one may since have been reloaded to share another's, until its sharers reload
+    return shared_with != nullptr ? shared_with->source() : *this;
+}
 
 uint TextureHandle::get_texture_id() const {
-    return texture_id;
+    return source().texture_id;
 }
 
 glm::uvec2 TextureHandle::get_size() const {
-    return {width, height};
+    return {source().width, source().height};
 }
 
 uint TextureHandle::get_width() const {
-    return width;
+    return source().width;
 }
 
 uint TextureHandle::get_height() const {
-    return height;
+    return source().height;
 }
 
 bool TextureHandle::is_srgb() const {
     return srgb;
 }
 
+bool TextureHandle::is_ready() const {
+    return ready;
+}
+
 bool TextureHandle::is_flipped() const {
     return flipped;
 }
@@ -32,6 +93,42 @@ const std::optional<std::string>& TextureHandle::get_filename() const {
     return filename;
 }
 
+size_t TextureHandle::get_gpu_bytes() const {
+    return owns_texture ? gpu_bytes : 0;
+}
+
+TextureChannels TextureHandle::get_channels() const {
+    return source().channels;
+}
+
+TextureCompression TextureHandle::get_compression() const {
+    return source().compression;
+}
+
+uint TextureHandle::get_generation() const {
+    return generation;
+}
+
+const std::shared_ptr<TextureHandle>& TextureHandle::get_shared_with() const {
+    return shared_with;
+}
+
+bool TextureHandle::is_streamed() const {
+    return source().streamed;
+}
+
+uint TextureHandle::get_resident_level() const {
+    return source().resident_level;
+}
+
+void TextureHandle::request_size(float pixels) {
+    if (shared_with != nullptr) {
+        shared_with->request_size(pixels);
+        return;
+    }
+    requested_size = std::max(requested_size, pixels);
+}
+
 TextureHandle::~TextureHandle() {
-    glDeleteTextures(1, &texture_id);
+    release_texture();
 }
@@ -2,14 +2,20 @@
 #define TEXTURE_HANDLE_H
 
 #include <string>
+#include <memory>
+#include <cstdint>
 #include <optional>
 
 #include <glm/glm.hpp>
+#include "TextureCompression.h"
 #include "utility/HelperTypes.h"
 
 class TextureLoader;
 
 /// A class representing a handle to a loaded texture, also storing some of its configuration data.
+/// A handle returned by an asynchronous load samples a shared placeholder texture (without owning it),
+/// and is updated in place by the TextureLoader once the real texture has finished uploading.
+/// A handle can also share another's texture, when their files have the same contents, in which case the other is kept alive and sampled in its place.
 class TextureHandle : private NonCopyable {
     uint texture_id;
     uint width;
@@ -19,8 +25,39 @@ class TextureHandle : private NonCopyable {
     bool flipped = false;
     std::optional<std::string> filename{};
 
+    // False while this handle is standing in for a texture that is still loading
+    bool ready = true;
+    // False if texture_id belongs to another handle (eg. the placeholder), so must not be deleted by this one
+    bool owns_texture = true;
+    // An estimate of the GPU memory used by the texture, including mipmaps
+    size_t gpu_bytes = 0;
+    // How the texture is stored
+    TextureChannels channels = TextureChannels::RGB;
+    TextureCompression compression = TextureCompression::None;
+    // Bumped each time the texture is replaced in place
+    uint generation = 0;
+    // Set if the TextureLoader is streaming the texture's mips, in which case only the levels from resident_level down are uploaded
+    bool streamed = false;
+    uint resident_level = 0;
+    // The largest size (in pixels) the texture has been drawn at since the TextureLoader last checked, see request_size()
+    float requested_size = 0.0f;
+    // Set if the texture is shared from another handle, which is sampled (and queried) in place of this one's own
+    std::shared_ptr<TextureHandle> shared_with{};
+    // Identifies the contents of the file and the settings the texture was loaded with, so the TextureLoader can find textures to share. 0 if unknown.
+    uint64_t content_key = 0;
+
     friend class TextureLoader;
 
+    /// Create a handle that samples placeholder's texture until it is fulfilled.
+    static std::shared_ptr<TextureHandle> make_pending(const TextureHandle& placeholder, bool srgb, bool flipped, std::optional<std::string> filename);
+    /// Take over the texture of other, marking this handle as ready.
+    void fulfill(TextureHandle& other);
+    /// Release this handle's texture and sample other's (which must own its texture) instead, marking this handle as ready.
+    void share(const std::shared_ptr<TextureHandle>& other);
+    void release_texture();
+    /// The handle whose texture is sampled, so this one unless it is shared
+    [[nodiscard]] const TextureHandle& source() const;
+
 public:
     TextureHandle(uint texture_id, uint width, uint height, bool srgb = true, bool flipped = false, std::optional<std::string> filename = {});
 
@@ -28,13 +65,36 @@ public:
                   std::optional<std::string> filename);
 
     [[nodiscard]] uint get_texture_id() const;
+    /// The size of the whole texture, even if only its smaller mips are resident
     [[nodiscard]] glm::uvec2 get_size() const;
     [[nodiscard]] uint get_width() const;
     [[nodiscard]] uint get_height() const;
 
+    /// Returns false while the texture is still loading, during which time a placeholder texture is used.
+    /// If the load fails, this becomes true with the placeholder texture left in place.
+    [[nodiscard]] bool is_ready() const;
     [[nodiscard]] bool is_flipped() const;
     [[nodiscard]] bool is_srgb() const;
     [[nodiscard]] const std::optional<std::string>& get_filename() const;
+    /// The GPU memory owned by the handle (so 0 while it is using the placeholder, or sharing another's texture)
+    [[nodiscard]] size_t get_gpu_bytes() const;
+    /// The channels the texture is stored with (block compressed formats may pad these out to more)
+    [[nodiscard]] TextureChannels get_channels() const;
+    /// The block compressed format the texture is stored in, or None
+    [[nodiscard]] TextureCompression get_compression() const;
+    /// Incremented whenever the texture is replaced in place (such as when it finishes loading, or is hot reloaded),
+    /// so that anything derived from it (such as a copy in the TexturePool) can tell it is stale.
+    [[nodiscard]] uint get_generation() const;
+    /// The handle whose texture this one shares, since their files have the same contents, or nullptr if it has its own
+    [[nodiscard]] const std::shared_ptr<TextureHandle>& get_shared_with() const;
+
+    /// True if the texture's mips are being streamed in (and out) as needed, see TextureLoader
+    [[nodiscard]] bool is_streamed() const;
+    /// The largest mip that is resident, so 0 unless the texture is streamed
+    [[nodiscard]] uint get_resident_level() const;
+    /// Record that the texture is being drawn about pixels across, from which the TextureLoader picks which of its mips need to be resident.
+    /// Call every frame the texture is drawn, the largest size since the loader last checked is used.
+    void request_size(float pixels);
 
     virtual ~TextureHandle();
 };
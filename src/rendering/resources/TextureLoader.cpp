@@ -1,5 +1,8 @@
 #include "TextureLoader.h"
 
+#include <cmath>
+#include <array>
+#include <cstring>
 #include <iostream>
 #include <filesystem>
 
@@ -8,11 +11,15 @@
 #include <stb/stb_image.h>
 #include <glad/gl.h>
 
+#include "utility/Hash.h"
+
 #define WHITE_TEXTURE_NAME "[WHITE]"
 #define BLACK_TEXTURE_NAME "[BLACK]"
 
-TextureLoader::TextureLoader(std::string import_path) : import_path(std::move(import_path)), special_names({WHITE_TEXTURE_NAME, BLACK_TEXTURE_NAME}) {
+TextureLoader::TextureLoader(std::string import_path, const std::string& cache_path, ResidencyManager& residency_manager, FileWatcher& file_watcher)
+    : import_path(std::move(import_path)), texture_cache(cache_path), residency_manager(residency_manager), file_watcher(file_watcher), special_names({WHITE_TEXTURE_NAME, BLACK_TEXTURE_NAME}) {
     std::fill_n(default_white_texture_data, DEFAULT_TEXTURE_LEN, (unsigned char) 0xFF);
+    file_watcher.subscribe(this->import_path, [this](const FileWatcher::Change& change) { on_file_changed(change); });
 }
 
 float get_max_anisotropy() {
@@ -34,53 +41,1053 @@ std::shared_ptr<TextureHandle> TextureLoader::load_from_file(const std::string&
         return black;
     };
 
-    std::string full_path = import_path + "/" + file;
+    auto last_write_time = get_last_write_time(file);
 
-    if (!std::filesystem::exists(full_path)) {
-        throw std::runtime_error(Formatter() << "Failed to load texture file: " << full_path << "\n\t Reason: File does not exist");
+    auto existing = cache.find({file, srgb, flip_vertical});
+    if (existing != cache.end()) {
+        // Cache exist, so try lock
+        auto handle = existing->second.second.lock();
+        if (handle != nullptr && existing->second.first >= last_write_time) {
+            // Lock was successful and the cache is for an up-to-date version of the file, so can use it
+            residency_manager.touch(residency_key(file, srgb, flip_vertical));
+            return handle;
+        }
     }
 
-    static float max_ani = get_max_anisotropy();
-    auto last_write_time = std::filesystem::last_write_time(full_path);
+    auto compression = get_compression(file);
+    auto channels = get_channels(file);
+    auto key = settings_key(srgb, flip_vertical, compression, channels, mip_filter);
+
+    // The hash is remembered for prepare_mips(), and if a file with the same contents is already loaded there is no need to prepare this one at all
+    auto owner = find_shared_texture(Hash::combine(key, content_hashes.hash_file(import_path + "/" + file)), nullptr);
+    std::shared_ptr<TextureHandle> texture;
+    if (owner != nullptr) {
+        texture = TextureHandle::make_pending(*owner, srgb, flip_vertical, file);
+        texture->share(owner);
+        ++shared_loads;
+    } else {
+        auto mips = prepare_mips(file, srgb, flip_vertical, compression, channels, mip_filter, get_compression_support());
+        texture = upload_mips(file, mips, srgb, flip_vertical);
+        texture->content_key = Hash::combine(key, mips.content_hash);
+        register_content(texture->content_key, texture);
+    }
+
+    cache[{file, srgb, flip_vertical}] = {last_write_time, texture};
+    residency_manager.track(residency_key(file, srgb, flip_vertical), texture);
+
+    return texture;
+}
+
+std::shared_ptr<TextureHandle> TextureLoader::load_from_file_async(const std::string& file, bool srgb, bool flip_vertical) {
+    if (special_names.count(file) != 0) {
+        return load_from_file(file, srgb, flip_vertical);
+    }
 
+    auto last_write_time = get_last_write_time(file);
+
+    // This also picks up loads that are still in progress, so the same file is never decoded twice at once
     auto existing = cache.find({file, srgb, flip_vertical});
     if (existing != cache.end()) {
-        // Cache exist, so try lock
         auto handle = existing->second.second.lock();
         if (handle != nullptr && existing->second.first >= last_write_time) {
-            // Lock was successful and the cache is for an up-to-date version of the file, so can use it
+            residency_manager.touch(residency_key(file, srgb, flip_vertical));
             return handle;
         }
     }
 
-    stbi_set_flip_vertically_on_load(flip_vertical);
+    auto texture = TextureHandle::make_pending(*default_white_texture(), srgb, flip_vertical, file);
+    cache[{file, srgb, flip_vertical}] = {last_write_time, texture};
+    residency_manager.track(residency_key(file, srgb, flip_vertical), texture);
+
+    start_texture_load(file, texture);
+
+    return texture;
+}
+
+void TextureLoader::start_texture_load(const std::string& file, const std::shared_ptr<TextureHandle>& texture) {
+    auto compression = get_compression(file);
+    auto channels = get_channels(file);
+    pending_textures.push_back(std::make_unique<PendingTexture>(PendingTexture{
+        texture,
+        file,
+        texture->is_srgb(),
+        decode_pool.submit([this, file, srgb = texture->is_srgb(), flip_vertical = texture->is_flipped(), compression, channels,
+                            filter = mip_filter, support = get_compression_support()]() {
+            return prepare_mips(file, srgb, flip_vertical, compression, channels, filter, support);
+        }),
+        settings_key(texture->is_srgb(), texture->is_flipped(), compression, channels, mip_filter),
+    }));
+}
+
+void TextureLoader::reload_live_textures(const std::string& file) {
+    for (auto& [key, cached]: cache) {
+        auto handle = cached.second.lock();
+        if (std::get<0>(key) != file || handle == nullptr) continue;
+        start_texture_load(file, handle);
+    }
+    reload_sharers(file);
+}
+
+void TextureLoader::reload_sharers(const std::string& file) {
+    for (auto& [key, cached]: cache) {
+        auto handle = cached.second.lock();
+        if (handle == nullptr || handle->shared_with == nullptr || std::get<0>(key) == file) continue;
+        if (handle->shared_with->get_filename() == file) {
+            start_texture_load(std::get<0>(key), handle);
+        }
+    }
+}
 
-    int width, height;
-    stbi_uc* data = stbi_load(full_path.c_str(), &width, &height, nullptr, STBI_rgb);
-    if (!data) {
-        throw std::runtime_error(Formatter() << "Failed to load texture file: " << full_path << "\n\t Reason: " << stbi_failure_reason());
+uint64_t TextureLoader::settings_key(bool srgb, bool flip_vertical, TextureCompression compression, TextureChannels channels, MipFilter filter) {
+    auto key = Hash::FNV1A_OFFSET_BASIS;
+    for (auto value: {(uint64_t) srgb, (uint64_t) flip_vertical, (uint64_t) compression, (uint64_t) channels, (uint64_t) filter}) {
+        key = Hash::combine(key, value);
     }
+    return key;
+}
+
+std::shared_ptr<TextureHandle> TextureLoader::find_shared_texture(uint64_t content_key, const TextureHandle* handle) {
+    auto entry = content_index.find(content_key);
+    if (entry == content_index.end()) return nullptr;
+
+    auto owner = entry->second.lock();
+    // Stale if the texture has since been reloaded with other contents (or settings), or is now sharing another's texture itself
+    if (owner == nullptr || owner.get() == handle || owner->content_key != content_key || !owner->owns_texture) return nullptr;
+    return owner;
+}
+
+void TextureLoader::register_content(uint64_t content_key, const std::shared_ptr<TextureHandle>& handle) {
+    if (handle == nullptr || find_shared_texture(content_key, handle.get()) != nullptr) return;
+
+    // Forget any textures that have since been destroyed while here, so that the index doesn't keep growing
+    for (auto it = content_index.begin(); it != content_index.end();) {
+        it = it->second.expired() ? content_index.erase(it) : std::next(it);
+    }
+    content_index[content_key] = handle;
+}
+
+const CompressionSupport& TextureLoader::get_compression_support() {
+    if (!compression_support.has_value()) {
+        compression_support = CompressionSupport::query();
+        std::cout << "Texture compression support: BC1 " << compression_support->bc1 << ", BC4/BC5 " << compression_support->bc4_bc5
+                  << ", BC7 " << compression_support->bc7 << std::endl;
+    }
+    return compression_support.value();
+}
+
+TextureCompression TextureLoader::get_compression(const std::string& file) const {
+    auto compression = compressions.find(file);
+    return compression != compressions.end() ? compression->second : default_compression;
+}
+
+void TextureLoader::set_compression(const std::string& file, TextureCompression compression) {
+    compressions[file] = compression;
+    reload_live_textures(file);
+}
+
+TextureChannels TextureLoader::get_channels(const std::string& file) const {
+    auto channels = channel_layouts.find(file);
+    return channels != channel_layouts.end() ? channels->second : default_channels;
+}
+
+void TextureLoader::set_channels(const std::string& file, TextureChannels channels) {
+    channel_layouts[file] = channels;
+    reload_live_textures(file);
+}
+
+MipChain TextureLoader::prepare_mips(const std::string& file, bool srgb, bool flip_vertical, TextureCompression compression, TextureChannels channels, MipFilter filter,
+                                     const CompressionSupport& support) {
+    auto full_path = import_path + "/" + file;
+    // Hashing reads the whole file, so if it had to, the mapping is kept to decode from rather than reading the file again
+    std::optional<MappedFile> source{};
+    auto content_hash = content_hashes.hash_file(full_path, &source);
+
+    auto cached = texture_cache.read(file, content_hash, compression, channels, filter, srgb, flip_vertical);
+    // An entry written on another machine may be in a format this one can't sample
+    if (cached.has_value() && support.supports(cached->format)) {
+        cached->content_hash = content_hash;
+        return std::move(cached.value());
+    }
+
+    // A copy, since it is flipped and converted in place
+    auto image = *get_decoded_image(full_path, content_hash, source);
+    if (flip_vertical) flip_vertically(image);
+    auto resolved_channels = channels == TextureChannels::Auto ? detect_channels(image) : channels;
+    auto channel_count = (uint) resolved_channels;
+
+    // There are no sRGB formats with fewer than 3 channels, so those are stored linear, at the cost of some precision in the darks
+    bool stored_srgb = srgb && channel_count >= 3;
+    if (srgb && !stored_srgb) linearise(image);
+    if (channel_count < 4) {
+        // So that alpha the texture won't keep doesn't affect block compression
+        for (size_t i = 3; i < image.pixels.size(); i += DECODED_BPP) image.pixels[i] = 0xFF;
+    }
+
+    auto format = BlockCompression::resolve(compression, stored_srgb, resolved_channels, support);
+
+    MipChain mips{};
+    if (format == TextureCompression::None) {
+        auto texels = extract_channels(image, channel_count);
+        mips = MipGenerator::generate(texels.data(), (uint) image.width, (uint) image.height, channel_count, stored_srgb, filter);
+    } else {
+        // Already on a worker for async loads, in which case this encodes serially rather than waiting on the pool from inside it
+        mips = BlockCompression::compress(MipGenerator::generate(image.pixels.data(), (uint) image.width, (uint) image.height, DECODED_BPP, stored_srgb, filter), format, &decode_pool);
+        // Sampled with the image's channels, unless the format stores fewer
+        mips.channels = std::min(mips.channels, channel_count);
+    }
+    mips.content_hash = content_hash;
+    texture_cache.write(file, content_hash, compression, channels, filter, srgb, flip_vertical, mips);
+    return mips;
+}
+
+std::shared_ptr<const DecodedImage> TextureLoader::get_decoded_image(const std::string& full_path, uint64_t content_hash, std::optional<MappedFile>& source) {
+    std::promise<std::shared_ptr<const DecodedImage>> promise{};
+    {
+        std::unique_lock lock{decoded_images_mutex};
+        auto existing = decoded_images.find(content_hash);
+        if (existing != decoded_images.end()) {
+            existing->second.last_used = ++decoded_image_clock;
+            ++decoded_image_hits;
+            auto image = existing->second.image;
+            // Waited on outside the lock, since another load may still be decoding it
+            lock.unlock();
+            return image.get();
+        }
+        ++decoded_image_misses;
+        decoded_images[content_hash] = {promise.get_future().share(), 0, ++decoded_image_clock};
+    }
+
+    std::shared_ptr<const DecodedImage> image{};
+    try {
+        if (!source.has_value()) source.emplace(full_path);
+        image = std::make_shared<const DecodedImage>(decode_image(source->data(), source->size(), full_path));
+    } catch (...) {
+        // Any loads waiting on the decode fail the same way, and the entry is dropped so that the next load tries again
+        promise.set_exception(std::current_exception());
+        std::lock_guard lock{decoded_images_mutex};
+        decoded_images.erase(content_hash);
+        throw;
+    }
+    promise.set_value(image);
+
+    std::lock_guard lock{decoded_images_mutex};
+    auto entry = decoded_images.find(content_hash);
+    if (entry != decoded_images.end()) {
+        entry->second.bytes = image->pixels.size();
+        decoded_image_bytes += entry->second.bytes;
+        trim_decoded_images();
+    }
+    return image;
+}
+
+void TextureLoader::trim_decoded_images() {
+    auto budget_bytes = (size_t) decoded_image_budget_mb.load() * 1024 * 1024;
+    while (decoded_image_bytes > budget_bytes) {
+        // Images still being decoded have no size yet, and are left for the loads waiting on them
+        auto oldest = decoded_images.end();
+        for (auto it = decoded_images.begin(); it != decoded_images.end(); ++it) {
+            if (it->second.bytes != 0 && (oldest == decoded_images.end() || it->second.last_used < oldest->second.last_used)) oldest = it;
+        }
+        if (oldest == decoded_images.end()) break;
+        decoded_image_bytes -= oldest->second.bytes;
+        decoded_images.erase(oldest);
+    }
+}
 
+uint TextureLoader::create_texture(const MipChain& mips) {
     uint texture_id;
     glGenTextures(1, &texture_id);
     glBindTexture(GL_TEXTURE_2D, texture_id);
+    setup_texture_parameters();
+    // Every level is supplied, rather than generated
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_BASE_LEVEL, 0);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, (int) mips.mips.size() - 1);
+    if (mips.channels == 1) {
+        // Only red is stored (whether uncompressed or BC4), but the shaders sample textures such as specular maps as rgb
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_G, GL_RED);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
+    }
+
+    if (mips.format == TextureCompression::None) {
+        int internal_formats[] = {GL_R8, GL_RG8, mips.srgb ? GL_SRGB8 : GL_RGB8, mips.srgb ? GL_SRGB8_ALPHA8 : GL_RGBA8};
+        for (auto level = 0u; level < mips.mips.size(); ++level) {
+            const auto& mip = mips.mips[level];
+            glTexImage2D(GL_TEXTURE_2D, (int) level, internal_formats[mips.channels - 1], (int) mip.width, (int) mip.height, 0, pixel_format(mips.channels), GL_UNSIGNED_BYTE, nullptr);
+        }
+    }
+    return texture_id;
+}
+
+void TextureLoader::set_storage(TextureHandle& texture, const MipChain& mips) {
+    texture.channels = (TextureChannels) mips.channels;
+    texture.compression = mips.format;
+    texture.gpu_bytes = level_bytes(mips, 0, (uint) mips.mips.size());
+}
+
+size_t TextureLoader::level_bytes(const MipChain& mips, uint first_level, uint last_level) {
+    size_t bytes = 0;
+    for (auto level = first_level; level < last_level; ++level) {
+        const auto& mip = mips.mips[level];
+        // Drivers typically pad RGB8 out to 4 bytes per texel
+        bytes += mips.format != TextureCompression::None ? mip.size : (size_t) mip.width * mip.height * (mips.channels == 3 ? 4 : mips.channels);
+    }
+    return bytes;
+}
+
+GLenum TextureLoader::pixel_format(uint channels) {
+    switch (channels) {
+        case 1:
+            return GL_RED;
+        case 2:
+            return GL_RG;
+        case 3:
+            return GL_RGB;
+        default:
+            return GL_RGBA;
+    }
+}
+
+std::shared_ptr<TextureHandle> TextureLoader::upload_mips(const std::string& file, const MipChain& mips, bool srgb, bool flip_vertical) {
+    auto texture_id = create_texture(mips);
+
+    if (mips.format == TextureCompression::None) {
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        for (auto level = 0u; level < mips.mips.size(); ++level) {
+            const auto& mip = mips.mips[level];
+            glTexSubImage2D(GL_TEXTURE_2D, (int) level, 0, 0, (int) mip.width, (int) mip.height, pixel_format(mips.channels), GL_UNSIGNED_BYTE, mips.mip_data(level));
+        }
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    } else {
+        auto internal_format = BlockCompression::gl_internal_format(mips.format, mips.srgb);
+        for (auto level = 0u; level < mips.mips.size(); ++level) {
+            const auto& mip = mips.mips[level];
+            glCompressedTexImage2D(GL_TEXTURE_2D, (int) level, internal_format, (int) mip.width, (int) mip.height, 0, (int) mip.size, mips.mip_data(level));
+        }
+    }
+
+    auto texture = std::make_shared<TextureHandle>(texture_id, mips.width, mips.height, srgb, flip_vertical, file);
+    set_storage(*texture, mips);
+    record_upload(file, mips);
+
+    return texture;
+}
+
+void TextureLoader::record_upload(const std::string& file, const MipChain& mips) {
+    size_t texel_count = 0;
+    for (const auto& mip: mips.mips) texel_count += (size_t) mip.width * mip.height;
+    recent_uploads.push_front({file, mips.mips.front(), mips.format, mips.channels, mips.data.size(), texel_count, mips.psnr, mips.mip_ms, mips.encode_ms, mips.from_cache});
+    if (recent_uploads.size() > RECENT_UPLOADS) recent_uploads.pop_back();
+}
+
+std::filesystem::file_time_type TextureLoader::get_last_write_time(const std::string& file) const {
+    auto last_write_time = file_watcher.get_last_write_time(import_path, file);
+    if (!last_write_time.has_value()) {
+        throw std::runtime_error(Formatter() << "Failed to load texture file: " << import_path << "/" << file << "\n\t Reason: File does not exist");
+    }
+    return last_write_time.value();
+}
+
+void TextureLoader::on_file_changed(const FileWatcher::Change& change) {
+    if (change.type != FileWatcher::ChangeType::Modified) {
+        available_textures.reset();
+    }
+
+    if (change.type == FileWatcher::ChangeType::Removed) {
+        // Materials keep the last version, but it can't be loaded again
+        for (auto it = cache.begin(); it != cache.end();) {
+            it = std::get<0>(it->first) == change.file ? cache.erase(it) : std::next(it);
+        }
+        return;
+    }
+
+    auto last_write_time = file_watcher.get_last_write_time(import_path, change.file);
+    if (!last_write_time.has_value()) return;
+
+    // Reload every live texture from the file in place, the previous version is sampled until the new one has uploaded
+    for (auto& [key, cached]: cache) {
+        auto handle = cached.second.lock();
+        if (std::get<0>(key) != change.file || handle == nullptr) continue;
+
+        // Still the right handle to hand out, it will be updated once the reload finishes
+        cached.first = last_write_time.value();
+        std::cout << "Reloading texture: " << change.file << std::endl;
+        start_texture_load(change.file, handle);
+    }
+    reload_sharers(change.file);
+}
+
+std::string TextureLoader::residency_key(const std::string& file, bool srgb, bool flip_vertical) {
+    return Formatter() << "texture:" << file << ":" << srgb << ":" << flip_vertical;
+}
+
+DecodedImage TextureLoader::decode_image(const std::string& full_path, bool flip_vertical) {
+    MappedFile source{full_path};
+    auto image = decode_image(source.data(), source.size(), full_path);
+    if (flip_vertical) flip_vertically(image);
+    return image;
+}
+
+DecodedImage TextureLoader::decode_image(const std::byte* data, size_t size, const std::string& name) {
+    int width, height, source_channels;
+    stbi_uc* pixels = stbi_load_from_memory(reinterpret_cast<const stbi_uc*>(data), (int) size, &width, &height, &source_channels, STBI_rgb_alpha);
+    if (!pixels) {
+        throw std::runtime_error(Formatter() << "Failed to load texture file: " << name << "\n\t Reason: " << stbi_failure_reason());
+    }
+
+    DecodedImage image{std::vector<unsigned char>(pixels, pixels + (size_t) width * height * DECODED_BPP), width, height, source_channels};
+    stbi_image_free(pixels);
+    return image;
+}
+
+void TextureLoader::flip_vertically(DecodedImage& image) {
+    // Flipped here rather than with stbi_set_flip_vertically_on_load, since that is shared by every thread (and the decoded image is shared by both orientations)
+    auto row_size = (size_t) image.width * DECODED_BPP;
+    for (auto row = 0; row < image.height / 2; ++row) {
+        std::swap_ranges(image.pixels.begin() + (long) (row * row_size),
+                         image.pixels.begin() + (long) ((row + 1) * row_size),
+                         image.pixels.begin() + (long) ((image.height - 1 - row) * row_size));
+    }
+}
+
+TextureChannels TextureLoader::detect_channels(const DecodedImage& image) {
+    bool opaque = true;
+    bool greyscale = true;
+    bool empty_blue = true;
+    for (size_t i = 0; i < image.pixels.size(); i += DECODED_BPP) {
+        const auto* pixel = &image.pixels[i];
+        opaque &= pixel[3] == 0xFF;
+        // Allowing a little difference, for lossy sources
+        greyscale &= std::abs(pixel[0] - pixel[1]) <= 2 && std::abs(pixel[0] - pixel[2]) <= 2;
+        empty_blue &= pixel[2] == 0;
+    }
+
+    if (!opaque) return TextureChannels::RGBA;
+    if (greyscale) return TextureChannels::R;
+    if (empty_blue) return TextureChannels::RG;
+    return TextureChannels::RGB;
+}
+
+std::vector<uint8_t> TextureLoader::extract_channels(const DecodedImage& image, uint channels) {
+    auto texel_count = (size_t) image.width * image.height;
+    std::vector<uint8_t> texels(texel_count * channels);
+    for (size_t i = 0; i < texel_count; ++i) {
+        std::memcpy(&texels[i * channels], &image.pixels[i * DECODED_BPP], channels);
+    }
+    return texels;
+}
+
+void TextureLoader::linearise(DecodedImage& image) {
+    static const auto table = []() {
+        std::array<uint8_t, 256> table{};
+        for (auto i = 0u; i < table.size(); ++i) {
+            auto value = (float) i / 255.0f;
+            auto linear = value <= 0.04045f ? value / 12.92f : std::pow((value + 0.055f) / 1.055f, 2.4f);
+            table[i] = (uint8_t) std::lround(linear * 255.0f);
+        }
+        return table;
+    }();
+
+    for (size_t i = 0; i < image.pixels.size(); i += DECODED_BPP) {
+        for (auto c = 0; c < 3; ++c) image.pixels[i + c] = table[image.pixels[i + c]];
+    }
+}
+
+void TextureLoader::setup_texture_parameters() {
+    static float max_ani = get_max_anisotropy();
 
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_REPEAT);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
     glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
     glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY, max_ani);
+}
 
-    glTexImage2D(GL_TEXTURE_2D, 0, srgb ? GL_SRGB : GL_RGB, width, height, 0, GL_RGB, GL_UNSIGNED_BYTE, data);
-    glGenerateMipmap(GL_TEXTURE_2D);
+void TextureLoader::update() {
+    auto update_start = std::chrono::steady_clock::now();
+    size_t bytes_uploaded = 0;
 
-    stbi_image_free(data);
+    update_streaming();
 
-    auto texture = std::make_shared<TextureHandle>(texture_id, width, height, srgb, flip_vertical, file);
+    pending_textures.erase(std::remove_if(pending_textures.begin(), pending_textures.end(), [&](const auto& pending) {
+        return update_pending_texture(*pending, bytes_uploaded, update_start);
+    }), pending_textures.end());
 
-    cache[{file, srgb, flip_vertical}] = {last_write_time, texture};
+    last_update_bytes = bytes_uploaded;
+    last_update_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - update_start).count();
+}
 
-    return texture;
+bool TextureLoader::update_pending_texture(PendingTexture& pending, size_t& bytes_uploaded, std::chrono::steady_clock::time_point update_start) {
+    auto handle = pending.handle.lock();
+    if (handle == nullptr) {
+        // Nothing is using the texture anymore, so abandon it (the decode still has to finish, since it can't be cancelled)
+        if (pending.mips.has_value() || pending.prepared_mips.wait_for(std::chrono::seconds{0}) == std::future_status::ready) {
+            release_pending_texture(pending);
+            return true;
+        }
+        return false;
+    }
+
+    if (!pending.mips.has_value()) {
+        if (pending.prepared_mips.wait_for(std::chrono::seconds{0}) != std::future_status::ready) return false;
+        try {
+            pending.mips = pending.prepared_mips.get();
+        } catch (const std::exception& e) {
+            std::cerr << "Error while asynchronously loading texture:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            auto stream = streamed_textures.find(handle.get());
+            if (pending.stream_source != nullptr && stream != streamed_textures.end()) {
+                stream->second.uploading = false;
+            }
+            // A failed reload keeps sampling the previous version
+            if (!handle->is_ready()) {
+                // No longer loading, but keeps sampling the placeholder. Forget it, so that the next request tries again
+                handle->ready = true;
+                cache.erase({pending.file, pending.srgb, handle->is_flipped()});
+            }
+            return true;
+        }
+
+        // A (re)load of the whole chain, rather than a streaming reupload of part of one
+        if (pending.stream_source == nullptr) {
+            pending.content_key = Hash::combine(pending.settings_key, pending.mips->content_hash);
+            // Another file with the same contents is already loaded the same way, so share its texture rather than uploading another copy
+            auto owner = find_shared_texture(pending.content_key, handle.get());
+            if (owner != nullptr) {
+                streamed_textures.erase(handle.get());
+                handle->share(owner);
+                ++shared_loads;
+                release_pending_texture(pending);
+                return true;
+            }
+            start_streaming(pending, handle);
+        }
+    }
+
+    if (pending.stream_source != nullptr) {
+        // Stale if the texture has since been reloaded (or stopped streaming), in which case the reload replaces it
+        auto stream = streamed_textures.find(handle.get());
+        if (stream == streamed_textures.end() || stream->second.mips != pending.stream_source) {
+            release_pending_texture(pending);
+            return true;
+        }
+    }
+
+    if (pending.upload_fence != nullptr) {
+        // Flush, so that the fence is guaranteed to eventually signal even if nothing else is submitted
+        auto status = glClientWaitSync(pending.upload_fence, GL_SYNC_FLUSH_COMMANDS_BIT, 0);
+        if (status != GL_ALREADY_SIGNALED && status != GL_CONDITION_SATISFIED) return false;
+
+        // The GPU is done with the pixel buffer, so the texture can be handed over
+        const auto& mips = pending.mips.value();
+        TextureHandle uploaded{pending.texture_id, mips.width, mips.height, pending.srgb, handle->is_flipped(), pending.file};
+        set_storage(uploaded, mips);
+        hand_over(pending, *handle, uploaded);
+        pending.texture_id = 0;
+        release_pending_texture(pending);
+        return true;
+    }
+
+    auto elapsed_ms = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - update_start).count();
+    auto budget_bytes = (size_t) upload_budget_kb * 1024;
+    if (bytes_uploaded >= budget_bytes || elapsed_ms >= upload_budget_ms) return false;
+
+    const auto& mips = pending.mips.value();
+    if (mips.format != TextureCompression::None) {
+        // Already a fraction of the size with the mip chain included, so it is uploaded in one go, without a pixel buffer
+        auto uploaded = upload_mips(pending.file, mips, pending.srgb, handle->is_flipped());
+        bytes_uploaded += mips.data.size();
+        hand_over(pending, *handle, *uploaded);
+        release_pending_texture(pending);
+        return true;
+    }
+
+    if (pending.texture_id == 0) {
+        pending.texture_id = create_texture(mips);
+
+        // Every level goes through the one buffer, laid out as in mips.data
+        glGenBuffers(1, &pending.pixel_buffer);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pending.pixel_buffer);
+        glBufferData(GL_PIXEL_UNPACK_BUFFER, (long) mips.data.size(), nullptr, GL_STREAM_DRAW);
+    } else {
+        glBindTexture(GL_TEXTURE_2D, pending.texture_id);
+        glBindBuffer(GL_PIXEL_UNPACK_BUFFER, pending.pixel_buffer);
+    }
+
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+    // Carry on into the next level while there is budget left, so the small levels at the end of the chain don't take a frame each
+    do {
+        const auto& mip = mips.mips[pending.level];
+        auto row_size = (size_t) mip.width * mips.channels;
+
+        // Always upload at least one row, so that progress is made even with a tiny budget
+        auto remaining_budget = budget_bytes > bytes_uploaded ? budget_bytes - bytes_uploaded : 0;
+        auto rows = (uint) std::clamp(remaining_budget / row_size, (size_t) 1, (size_t) (mip.height - pending.rows_uploaded));
+        auto offset = mip.offset + pending.rows_uploaded * row_size;
+        auto size = rows * row_size;
+
+        // Each band of rows is only written once, so there is no need to synchronise with earlier uploads from the buffer
+        void* mapped = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, (long) offset, (long) size, GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT);
+        if (mapped != nullptr) {
+            std::memcpy(mapped, mips.data.data() + offset, size);
+            glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+        } else {
+            glBufferSubData(GL_PIXEL_UNPACK_BUFFER, (long) offset, (long) size, mips.data.data() + offset);
+        }
+
+        glTexSubImage2D(GL_TEXTURE_2D, (int) pending.level, 0, (int) pending.rows_uploaded, (int) mip.width, (int) rows, pixel_format(mips.channels), GL_UNSIGNED_BYTE, reinterpret_cast<const void*>(offset));
+
+        pending.rows_uploaded += rows;
+        bytes_uploaded += size;
+        if (pending.rows_uploaded == mip.height) {
+            pending.level++;
+            pending.rows_uploaded = 0;
+        }
+    } while (pending.level < mips.mips.size() && bytes_uploaded < budget_bytes);
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+    glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+
+    if (pending.level == mips.mips.size()) {
+        pending.upload_fence = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+        record_upload(pending.file, mips);
+        // Everything is in the pixel buffer now, so only the dimensions are still needed
+        pending.mips->data = {};
+    }
+
+    return false;
+}
+
+void TextureLoader::hand_over(PendingTexture& pending, TextureHandle& handle, TextureHandle& uploaded) {
+    if (pending.stream_source != nullptr) {
+        // Sized as the whole texture, rather than the levels that were uploaded
+        uploaded.width = pending.stream_source->width;
+        uploaded.height = pending.stream_source->height;
+        uploaded.streamed = true;
+        uploaded.resident_level = pending.base_level;
+
+        auto& stream = streamed_textures.at(&handle);
+        stream.resident_level = pending.base_level;
+        stream.uploading = false;
+    }
+    // Streaming reuploads hold the same contents as before
+    uploaded.content_key = pending.content_key != 0 ? pending.content_key : handle.content_key;
+    handle.fulfill(uploaded);
+    if (pending.content_key != 0) {
+        register_content(pending.content_key, pending.handle.lock());
+    }
+}
+
+void TextureLoader::start_streaming(PendingTexture& pending, const std::shared_ptr<TextureHandle>& handle) {
+    const auto& mips = pending.mips.value();
+    uint tail_level = 0;
+    while (tail_level + 1 < mips.mips.size() && std::max(mips.mips[tail_level].width, mips.mips[tail_level].height) > (uint) stream_tail_size) {
+        ++tail_level;
+    }
+
+    if (!streaming_enabled || std::max(mips.width, mips.height) < (uint) stream_min_size || tail_level == 0) {
+        // A reload may have changed the settings, or the file, so that a texture that was streamed no longer is
+        streamed_textures.erase(handle.get());
+        return;
+    }
+
+    auto source = std::make_shared<const MipChain>(std::move(pending.mips.value()));
+    pending.mips = source->tail(tail_level);
+    pending.stream_source = source;
+    pending.base_level = tail_level;
+
+    StreamedTexture stream{handle, source, tail_level, tail_level, tail_level};
+    stream.last_needed_frame = stream_frame;
+    stream.uploading = true;
+    streamed_textures[handle.get()] = stream;
+}
+
+void TextureLoader::update_streaming() {
+    ++stream_frame;
+
+    size_t wanted_bytes = 0;
+    for (auto it = streamed_textures.begin(); it != streamed_textures.end();) {
+        auto handle = it->second.handle.lock();
+        if (handle == nullptr) {
+            it = streamed_textures.erase(it);
+            continue;
+        }
+
+        auto& stream = it->second;
+        stream.last_requested_size = handle->requested_size;
+        handle->requested_size = 0.0f;
+
+        auto needed = needed_level(stream, stream.last_requested_size);
+        if (needed <= stream.resident_level) {
+            stream.last_needed_frame = stream_frame;
+        } else if (stream_frame - stream.last_needed_frame < (uint64_t) stream_keep_frames) {
+            // Keep levels for a while after they stop being needed, in case they are needed again
+            needed = stream.resident_level;
+        }
+        stream.wanted_level = needed;
+        wanted_bytes += level_bytes(*stream.mips, stream.wanted_level, stream.tail_level);
+        ++it;
+    }
+
+    // Over budget, so drop levels from the textures drawn smallest, since they lose the least detail on screen
+    auto budget_bytes = (size_t) stream_budget_mb * 1024 * 1024;
+    while (wanted_bytes > budget_bytes) {
+        StreamedTexture* smallest = nullptr;
+        for (auto& [_, stream]: streamed_textures) {
+            if (stream.wanted_level < stream.tail_level && (smallest == nullptr || stream.last_requested_size < smallest->last_requested_size)) {
+                smallest = &stream;
+            }
+        }
+        if (smallest == nullptr) break;
+        wanted_bytes -= level_bytes(*smallest->mips, smallest->wanted_level, smallest->wanted_level + 1);
+        ++smallest->wanted_level;
+    }
+
+    std::vector<StreamedTexture*> changed{};
+    size_t uploading = 0;
+    last_stream_bytes = 0;
+    for (auto& [_, stream]: streamed_textures) {
+        last_stream_bytes += level_bytes(*stream.mips, stream.resident_level, stream.tail_level);
+        if (stream.uploading) {
+            ++uploading;
+        } else if (stream.wanted_level != stream.resident_level) {
+            changed.push_back(&stream);
+        }
+    }
+
+    // Dropping levels first, since that frees memory (and uploads little), then adding them to the textures drawn largest
+    std::sort(changed.begin(), changed.end(), [](const StreamedTexture* a, const StreamedTexture* b) {
+        bool a_drops = a->wanted_level > a->resident_level;
+        bool b_drops = b->wanted_level > b->resident_level;
+        if (a_drops != b_drops) return a_drops;
+        return a->last_requested_size > b->last_requested_size;
+    });
+
+    for (auto* stream: changed) {
+        if (uploading >= MAX_STREAM_UPLOADS) break;
+        auto handle = stream->handle.lock();
+
+        // The whole texture is replaced with one holding the wanted levels, through the same path as any other load.
+        // The levels are copied out on a worker, since the largest can be tens of megabytes.
+        auto pending = std::make_unique<PendingTexture>();
+        pending->handle = handle;
+        pending->file = handle->get_filename().value();
+        pending->srgb = handle->is_srgb();
+        pending->prepared_mips = decode_pool.submit([mips = stream->mips, level = stream->wanted_level]() {
+            return mips->tail(level);
+        });
+        pending->stream_source = stream->mips;
+        pending->base_level = stream->wanted_level;
+        pending_textures.push_back(std::move(pending));
+
+        stream->uploading = true;
+        ++uploading;
+    }
+}
+
+uint TextureLoader::needed_level(const StreamedTexture& stream, float size) const {
+    if (size <= 0.0f) return stream.tail_level;
+    // Each level halves the size, so this is how many times the texture can be halved while still having a texel per pixel
+    auto largest_size = (float) std::max(stream.mips->width, stream.mips->height);
+    auto level = std::floor(std::log2(largest_size / size) + stream_bias);
+    return (uint) std::clamp(level, 0.0f, (float) stream.tail_level);
+}
+
+void TextureLoader::release_pending_texture(PendingTexture& pending) {
+    if (pending.upload_fence != nullptr) {
+        glDeleteSync(pending.upload_fence);
+        pending.upload_fence = nullptr;
+    }
+    if (pending.pixel_buffer != 0) {
+        glDeleteBuffers(1, &pending.pixel_buffer);
+        pending.pixel_buffer = 0;
+    }
+    if (pending.texture_id != 0) {
+        glDeleteTextures(1, &pending.texture_id);
+        pending.texture_id = 0;
+    }
+    pending.mips.reset();
+}
+
+std::unique_ptr<TextureLoader> TextureLoader::create_isolated(const std::string& cache_path, ResidencyManager& isolated_residency_manager, FileWatcher& isolated_file_watcher) const {
+    auto isolated = std::make_unique<TextureLoader>(import_path, cache_path, isolated_residency_manager, isolated_file_watcher);
+    isolated->streaming_enabled = streaming_enabled;
+    isolated->stream_bias = stream_bias;
+    isolated->decoded_image_budget_mb = decoded_image_budget_mb.load();
+    isolated->upload_budget_ms = upload_budget_ms;
+    isolated->upload_budget_kb = upload_budget_kb;
+    isolated->default_compression = default_compression;
+    isolated->compressions = compressions;
+    isolated->default_channels = default_channels;
+    isolated->channel_layouts = channel_layouts;
+    isolated->mip_filter = mip_filter;
+    isolated->texture_cache.set_enabled(texture_cache.is_enabled());
+    return isolated;
+}
+
+bool TextureLoader::has_pending_loads() const {
+    return !pending_textures.empty();
+}
+
+static bool add_imgui_compression_selector(const std::string& caption, TextureCompression& compression) {
+    bool changed = false;
+    if (ImGui::BeginCombo(caption.c_str(), to_string(compression).c_str(), 0)) {
+        for (auto option: {TextureCompression::None, TextureCompression::Auto, TextureCompression::BC1, TextureCompression::BC4, TextureCompression::BC5, TextureCompression::BC7}) {
+            if (ImGui::Selectable(to_string(option).c_str(), option == compression)) {
+                changed = option != compression;
+                compression = option;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    return changed;
+}
+
+static bool add_imgui_channels_selector(const std::string& caption, TextureChannels& channels) {
+    bool changed = false;
+    if (ImGui::BeginCombo(caption.c_str(), to_string(channels).c_str(), 0)) {
+        for (auto option: {TextureChannels::Auto, TextureChannels::R, TextureChannels::RG, TextureChannels::RGB, TextureChannels::RGBA}) {
+            if (ImGui::Selectable(to_string(option).c_str(), option == channels)) {
+                changed = option != channels;
+                channels = option;
+            }
+        }
+        ImGui::EndCombo();
+    }
+    return changed;
+}
+
+void TextureLoader::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Texture Loader")) {
+        ImGui::Text("Pending loads: %zu (%u workers)", pending_textures.size(), decode_pool.get_thread_count());
+        ImGui::Text("Last update: %.1f KB in %.3f ms", (float) last_update_bytes / 1024.0f, last_update_ms);
+        ImGui::SliderFloat("Upload Budget (ms)", &upload_budget_ms, 0.1f, 16.0f);
+        ImGui::SliderInt("Upload Budget (KB)", &upload_budget_kb, 64, 65536);
+
+        if (ImGui::TreeNode("Texture Compression")) {
+            const auto& support = get_compression_support();
+            ImGui::Text("Supported: BC1 %s, BC4/BC5 %s, BC7 %s", support.bc1 ? "yes" : "no", support.bc4_bc5 ? "yes" : "no", support.bc7 ? "yes" : "no");
+
+            bool cache_enabled = texture_cache.is_enabled();
+            if (ImGui::Checkbox("Use Texture Cache", &cache_enabled)) {
+                texture_cache.set_enabled(cache_enabled);
+            }
+            ImGui::SameLine();
+            if (ImGui::Button("Clear Texture Cache")) {
+                texture_cache.clear();
+            }
+
+            ImGui::TextDisabled("Applies to textures loaded after a change, live textures are reloaded");
+            if (add_imgui_compression_selector("Default", default_compression)) {
+                for (const auto& texture: get_available_textures()) {
+                    if (special_names.count(texture) == 0 && compressions.count(texture) == 0) reload_live_textures(texture);
+                }
+            }
+            for (const auto& texture: get_available_textures()) {
+                if (special_names.count(texture) != 0) continue;
+                auto compression = get_compression(texture);
+                if (add_imgui_compression_selector(texture, compression)) {
+                    set_compression(texture, compression);
+                }
+            }
+
+            ImGui::Text("Recent uploads:");
+            for (const auto& record: recent_uploads) {
+                auto channels = to_string((TextureChannels) record.channels);
+                if (record.format == TextureCompression::None) {
+                    ImGui::Text("%s: %ux%u %s uncompressed, %.1f KiB", record.file.c_str(), record.top_mip.width, record.top_mip.height, channels.c_str(), (double) record.bytes / 1024.0);
+                } else {
+                    auto uncompressed_bytes = record.texel_count * 4;
+                    ImGui::Text("%s: %ux%u %s %s, %.1f KiB (%.1fx smaller), PSNR %.2f dB", record.file.c_str(), record.top_mip.width, record.top_mip.height, channels.c_str(),
+                                to_string(record.format).c_str(), (double) record.bytes / 1024.0, (double) uncompressed_bytes / (double) record.bytes, record.psnr);
+                }
+                if (record.from_cache) {
+                    ImGui::Text("    From texture cache");
+                } else if (record.format == TextureCompression::None) {
+                    ImGui::Text("    Mips built in %.2f ms", record.mip_ms);
+                } else {
+                    ImGui::Text("    Mips built in %.2f ms, encoded in %.2f ms, %.2f MPixels/s", record.mip_ms, record.encode_ms,
+                                record.encode_ms > 0.0 ? (double) record.texel_count / (record.encode_ms * 1000.0) : 0.0);
+                }
+            }
+
+            if (ImGui::Button("Run Compression Benchmark")) {
+                run_compression_benchmark();
+            }
+            for (const auto& [file, format, psnr, encode_ms, mpixels_per_second, compressed_bytes, uncompressed_bytes]: benchmark_results) {
+                ImGui::Text("%s %s: PSNR %.2f dB, %.2f ms (%.2f MPixels/s), %.1fx smaller", file.c_str(), to_string(format).c_str(), psnr, encode_ms, mpixels_per_second,
+                            (double) uncompressed_bytes / (double) compressed_bytes);
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Texture Channels")) {
+            ImGui::TextDisabled("Fewer channels take less memory, Auto detects the fewest each texture needs");
+            if (add_imgui_channels_selector("Default##Channels", default_channels)) {
+                for (const auto& texture: get_available_textures()) {
+                    if (special_names.count(texture) == 0 && channel_layouts.count(texture) == 0) reload_live_textures(texture);
+                }
+            }
+            for (const auto& texture: get_available_textures()) {
+                if (special_names.count(texture) != 0) continue;
+                auto channels = get_channels(texture);
+                if (add_imgui_channels_selector(texture + "##Channels", channels)) {
+                    set_channels(texture, channels);
+                }
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Texture Streaming")) {
+            ImGui::Checkbox("Stream Large Textures", &streaming_enabled);
+            ImGui::TextDisabled("Applies to textures loaded after a change");
+            ImGui::SliderInt("Stream From Size", &stream_min_size, 256, 8192);
+            ImGui::SliderInt("Resident Tail Size", &stream_tail_size, 16, 1024);
+            ImGui::SliderInt("Streaming Budget (MB)", &stream_budget_mb, 16, 4096);
+            ImGui::SliderFloat("Streaming Mip Bias", &stream_bias, -2.0f, 4.0f);
+            ImGui::SliderInt("Keep Unneeded Mips (frames)", &stream_keep_frames, 0, 600);
+
+            size_t cpu_bytes = 0;
+            for (const auto& [_, stream]: streamed_textures) cpu_bytes += stream.mips->data.size();
+            ImGui::Text("%zu streamed textures, %.1f of %d MiB resident above their tails, %.1f MiB kept on the CPU", streamed_textures.size(),
+                        (double) last_stream_bytes / (1024.0 * 1024.0), stream_budget_mb, (double) cpu_bytes / (1024.0 * 1024.0));
+
+            for (const auto& [_, stream]: streamed_textures) {
+                auto handle = stream.handle.lock();
+                if (handle == nullptr) continue;
+                const auto& resident = stream.mips->mips[stream.resident_level];
+                const auto& wanted = stream.mips->mips[stream.wanted_level];
+                ImGui::Text("%s: %ux%u of %ux%u resident, wants %ux%u (drawn %.0f px)%s", handle->get_filename().value_or("").c_str(), resident.width, resident.height,
+                            stream.mips->width, stream.mips->height, wanted.width, wanted.height, stream.last_requested_size, stream.uploading ? ", uploading" : "");
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Content Deduplication")) {
+            ImGui::Text("Hashed %zu files (%.1f MiB), reused %zu hashes", content_hashes.get_hashed_files(),
+                        (double) content_hashes.get_hashed_bytes() / (1024.0 * 1024.0), content_hashes.get_reused_hashes());
+
+            int budget_mb = decoded_image_budget_mb;
+            if (ImGui::SliderInt("Decoded Image Budget (MB)", &budget_mb, 0, 2048)) {
+                decoded_image_budget_mb = budget_mb;
+                std::lock_guard lock{decoded_images_mutex};
+                trim_decoded_images();
+            }
+            {
+                std::lock_guard lock{decoded_images_mutex};
+                ImGui::Text("%zu decoded images, %.1f MiB, %zu hits, %zu misses", decoded_images.size(), (double) decoded_image_bytes / (1024.0 * 1024.0),
+                            decoded_image_hits, decoded_image_misses);
+            }
+
+            size_t sharing = 0;
+            size_t saved_bytes = 0;
+            for (const auto& [key, cached]: cache) {
+                auto handle = cached.second.lock();
+                if (handle == nullptr || handle->get_shared_with() == nullptr) continue;
+                ++sharing;
+                saved_bytes += handle->source().get_gpu_bytes();
+            }
+            ImGui::Text("%zu live textures sharing another's (saving %.1f MiB), %zu loads shared in total", sharing, (double) saved_bytes / (1024.0 * 1024.0), shared_loads);
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Mip Generation")) {
+            ImGui::Text("Built on the CPU in linear space, using %s", MipGenerator::simd_level().c_str());
+            if (ImGui::BeginCombo("Mip Filter", to_string(mip_filter).c_str(), 0)) {
+                for (auto option: {MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos}) {
+                    if (ImGui::Selectable(to_string(option).c_str(), option == mip_filter) && option != mip_filter) {
+                        mip_filter = option;
+                        for (const auto& texture: get_available_textures()) {
+                            if (special_names.count(texture) == 0) reload_live_textures(texture);
+                        }
+                    }
+                }
+                ImGui::EndCombo();
+            }
+
+            if (ImGui::Button("Run Mip Benchmark")) {
+                run_mip_benchmark();
+            }
+            for (const auto& [file, method, ms]: mip_benchmark_results) {
+                ImGui::Text("%s %s: %.3f ms", file.c_str(), method.c_str(), ms);
+            }
+            ImGui::TreePop();
+        }
+    }
+}
+
+void TextureLoader::run_mip_benchmark() {
+    mip_benchmark_results.clear();
+    std::cout << "Mip generation benchmark (" << MipGenerator::simd_level() << ", driver: " << reinterpret_cast<const char*>(glGetString(GL_RENDERER)) << ")" << std::endl;
+
+    auto add_result = [this](const std::string& file, const std::string& method, double ms) {
+        mip_benchmark_results.emplace_back(file, method, ms);
+        std::cout << "\t" << file << " " << method << ": " << ms << " ms" << std::endl;
+    };
+
+    for (const auto& file: get_available_textures()) {
+        if (special_names.count(file) != 0) continue;
+
+        DecodedImage image{};
+        try {
+            image = decode_image(import_path + "/" + file, false);
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping texture in mip benchmark:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            continue;
+        }
+
+        for (auto filter: {MipFilter::Box, MipFilter::Kaiser, MipFilter::Lanczos}) {
+            for (auto simd: {false, true}) {
+                auto mips = MipGenerator::generate(image.pixels.data(), (uint) image.width, (uint) image.height, DECODED_BPP, true, filter, simd);
+                add_result(file, Formatter() << to_string(filter) << (simd ? " (" + MipGenerator::simd_level() + ")" : " (Scalar)"), mips.mip_ms);
+            }
+        }
+
+        // The driver path this replaced, timed until the GPU has finished so that deferred work is included
+        uint texture_id;
+        glGenTextures(1, &texture_id);
+        glBindTexture(GL_TEXTURE_2D, texture_id);
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, image.width, image.height, 0, GL_RGBA, GL_UNSIGNED_BYTE, image.pixels.data());
+        glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+        glFinish();
+        auto driver_start = std::chrono::steady_clock::now();
+        glGenerateMipmap(GL_TEXTURE_2D);
+        glFinish();
+        add_result(file, "glGenerateMipmap", std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - driver_start).count());
+        glDeleteTextures(1, &texture_id);
+    }
+}
+
+void TextureLoader::run_compression_benchmark() {
+    benchmark_results.clear();
+    std::cout << "Texture compression benchmark (" << decode_pool.get_thread_count() << " workers)" << std::endl;
+
+    for (const auto& file: get_available_textures()) {
+        if (special_names.count(file) != 0) continue;
+
+        DecodedImage image{};
+        try {
+            image = decode_image(import_path + "/" + file, false);
+        } catch (const std::exception& e) {
+            std::cerr << "Skipping texture in compression benchmark:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            continue;
+        }
+
+        auto rgba_mips = MipGenerator::generate(image.pixels.data(), (uint) image.width, (uint) image.height, DECODED_BPP, false, mip_filter);
+        for (auto format: {TextureCompression::BC1, TextureCompression::BC4, TextureCompression::BC5, TextureCompression::BC7}) {
+            // Each format is timed on its own, and always encoded rather than read from the texture cache
+            auto compressed = BlockCompression::compress(rgba_mips, format, &decode_pool);
+
+            size_t texel_count = 0;
+            for (const auto& mip: compressed.mips) texel_count += (size_t) mip.width * mip.height;
+            auto mpixels_per_second = compressed.encode_ms > 0.0 ? (double) texel_count / (compressed.encode_ms * 1000.0) : 0.0;
+
+            benchmark_results.emplace_back(file, format, compressed.psnr, compressed.encode_ms, mpixels_per_second, compressed.data.size(), texel_count * 4);
+            std::cout << "\t" << file << " " << to_string(format) << ": PSNR " << compressed.psnr << " dB, " << compressed.encode_ms << " ms ("
+                      << mpixels_per_second << " MPixels/s), " << compressed.data.size() << " of " << texel_count * 4 << " bytes" << std::endl;
+        }
+    }
 }
 
 std::shared_ptr<TextureHandle> TextureLoader::default_white_texture() {
@@ -120,12 +1127,21 @@ std::shared_ptr<TextureHandle> TextureLoader::default_black_texture() {
 }
 
 void TextureLoader::cleanup() {
+    for (auto& pending: pending_textures) {
+        release_pending_texture(*pending);
+    }
+    pending_textures.clear();
+    streamed_textures.clear();
+    content_index.clear();
     default_black_texture_cache = nullptr;
     default_white_texture_cache = nullptr;
 }
 
 void TextureLoader::add_imgui_texture_selector(const std::string& caption, std::shared_ptr<TextureHandle>& texture_handle, bool prefer_srgb) {
     std::string current_selection = texture_handle->get_filename().value_or("Generated Texture");
+    if (!texture_handle->is_ready()) {
+        current_selection += " (Loading)";
+    }
 
     bool is_file = texture_handle->get_filename().has_value() && special_names.count(texture_handle->get_filename().value()) == 0;
 
@@ -144,7 +1160,7 @@ void TextureLoader::add_imgui_texture_selector(const std::string& caption, std::
 
     if (update_param && is_file) {
         try {
-            texture_handle = load_from_file(texture_handle->get_filename().value(), is_rgb, is_flipped);
+            texture_handle = load_from_file_async(texture_handle->get_filename().value(), is_rgb, is_flipped);
         } catch (const std::exception& e) {
             std::cerr << "Error while trying to update texture parameters:" << std::endl;
             std::cerr << e.what() << std::endl;
@@ -163,13 +1179,13 @@ void TextureLoader::add_imgui_texture_selector(const std::string& caption, std::
         just_opened = false;
 
         for (const auto& texture: textures) {
-            const bool is_selected = texture_handle->get_filename().has_value() && current_selection == texture;
+            const bool is_selected = texture_handle->get_filename().has_value() && texture_handle->get_filename().value() == texture;
             if (ImGui::Selectable(texture.c_str(), is_selected)) {
                 bool was_srgb = texture_handle->is_srgb();
                 bool was_flipped = texture_handle->is_flipped();
                 bool was_special = texture_handle->filename.has_value() && special_names.count(texture_handle->filename.value()) != 0;
                 try {
-                    texture_handle = load_from_file(texture, was_srgb || (prefer_srgb && was_special), was_flipped);
+                    texture_handle = load_from_file_async(texture, was_srgb || (prefer_srgb && was_special), was_flipped);
                 } catch (const std::exception& e) {
                     std::cerr << "Error while trying to update texture file:" << std::endl;
                     std::cerr << e.what() << std::endl;
@@ -187,20 +1203,26 @@ void TextureLoader::add_imgui_texture_selector(const std::string& caption, std::
 
     ImGui::PopItemWidth();
 
+    if (texture_handle->is_ready()) {
+        auto compression = texture_handle->get_compression();
+        ImGui::TextDisabled("%ux%u %s%s, %.1f KiB", texture_handle->get_width(), texture_handle->get_height(), to_string(texture_handle->get_channels()).c_str(),
+                            compression != TextureCompression::None ? (" " + to_string(compression)).c_str() : "", (double) texture_handle->get_gpu_bytes() / 1024.0);
+        if (texture_handle->get_shared_with() != nullptr) {
+            ImGui::SameLine();
+            ImGui::TextDisabled("(shared with %s)", texture_handle->get_shared_with()->get_filename().value_or("").c_str());
+        }
+    }
 }
 
 const std::vector<std::string>& TextureLoader::get_available_textures(bool force_refresh) {
-    if (!force_refresh && available_textures.has_value()) {
+    // While the file_watcher is live, it keeps the list up to date, so there is never a need to refresh it
+    if (available_textures.has_value() && (!force_refresh || file_watcher.is_live())) {
         return available_textures.value();
     }
-    available_textures = std::vector<std::string>{};
-    available_textures->push_back(WHITE_TEXTURE_NAME);
-    available_textures->push_back(BLACK_TEXTURE_NAME);
+    available_textures = std::vector<std::string>{WHITE_TEXTURE_NAME, BLACK_TEXTURE_NAME};
 
-    for (auto const& dir_entry: std::filesystem::recursive_directory_iterator(import_path)) {
-        available_textures->push_back(std::filesystem::relative(dir_entry, import_path).string());
-    }
-    std::sort(available_textures.value().begin() + 2, available_textures.value().end());
+    auto files = file_watcher.list_files(import_path);
+    available_textures->insert(available_textures->end(), files.begin(), files.end());
 
     return available_textures.value();
 }
@@ -4,17 +4,143 @@
 #include <string>
 #include <vector>
 #include <memory>
+#include <future>
+#include <chrono>
 #include <optional>
+#include <deque>
+#include <mutex>
+#include <atomic>
 #include <algorithm>
 #include <filesystem>
 #include <unordered_set>
 #include <unordered_map>
 
+#include <glad/gl.h>
+
+#include "TextureCache.h"
+#include "MipGenerator.h"
 #include "TextureHandle.h"
+#include "ResidencyManager.h"
+#include "TextureCompression.h"
+#include "utility/ThreadPool.h"
+#include "utility/FileWatcher.h"
+#include "utility/ContentHashes.h"
+
+/// Tightly packed RGBA8 pixel data, decoded from an image file (with opaque alpha if the file had none)
+struct DecodedImage {
+    std::vector<unsigned char> pixels{};
+    int width = 0;
+    int height = 0;
+    // The number of channels in the file, before being expanded to RGBA
+    int source_channels = 0;
+};
 
 /// A loader class intended for the use of loading textures from disk. Includes caching functionality.
+///
+/// Files are identified by the hash of their contents as well as their path: files with the same contents share one texture on the GPU,
+/// and each file is decoded once, with its flipped and sRGB variants built from the same decoded image.
 class TextureLoader {
     std::string import_path;
+    TextureCache texture_cache;
+    // Hashes of each file's contents, that the texture_cache, decoded_images and content_index are keyed on
+    ContentHashes content_hashes{};
+    // Keeps released textures resident up to a budget, shared with the ModelLoader
+    ResidencyManager& residency_manager;
+    // Indexes the files under import_path, and reports when they change so live textures can be hot reloaded
+    FileWatcher& file_watcher;
+
+    static constexpr int DECODED_BPP = 4;
+
+    /// An asynchronous load, first decoding and building the mip chain on a worker,
+    /// then uploading through a PBO a band of rows at a time (or all at once, if block compressed).
+    struct PendingTexture {
+        std::weak_ptr<TextureHandle> handle;
+        std::string file;
+        bool srgb;
+        std::future<MipChain> prepared_mips;
+        // The settings the load was started with, combined with the file's content hash to find a texture to share (see content_index)
+        uint64_t settings_key = 0;
+        // Set once the mips are ready, for loads of a whole chain (rather than streaming reuploads)
+        uint64_t content_key = 0;
+
+        // Upload state, filled in once the mip chain is ready
+        std::optional<MipChain> mips{};
+        uint texture_id = 0;
+        uint pixel_buffer = 0;
+        // Of the level currently being uploaded
+        uint level = 0;
+        uint rows_uploaded = 0;
+        // Set once every row has been submitted, the texture is only handed over once the GPU has passed it
+        GLsync upload_fence = nullptr;
+
+        // Set for streamed textures, the whole chain that mips is the tail of, starting from base_level
+        std::shared_ptr<const MipChain> stream_source{};
+        uint base_level = 0;
+    };
+    std::vector<std::unique_ptr<PendingTexture>> pending_textures{};
+
+    /// A texture whose mips are streamed: it is handed over with only its small mips uploaded,
+    /// then reuploaded with more (or fewer) levels as the size it is drawn at changes.
+    struct StreamedTexture {
+        std::weak_ptr<TextureHandle> handle;
+        // The whole chain, kept so that levels can be uploaded again after being dropped
+        std::shared_ptr<const MipChain> mips;
+        // Levels from here down are always resident
+        uint tail_level;
+        // The largest level resident (or being uploaded, for the first upload), and the largest it was last wanted with
+        uint resident_level;
+        uint wanted_level;
+        // The last frame all the resident levels were needed
+        uint64_t last_needed_frame = 0;
+        float last_requested_size = 0.0f;
+        // Set while a reupload is pending, only one is made at a time
+        bool uploading = false;
+    };
+    // Keyed by the handle's address, the weak handle tells if it has since been destroyed
+    std::unordered_map<const TextureHandle*, StreamedTexture> streamed_textures{};
+    uint64_t stream_frame = 0;
+
+    // Async loads of textures at least stream_min_size (on their larger side) are streamed, with the levels up to stream_tail_size always resident
+    bool streaming_enabled = true;
+    int stream_min_size = 1024;
+    int stream_tail_size = 128;
+    // The most GPU memory the levels above the tails of streamed textures can take between them
+    int stream_budget_mb = 256;
+    // Added to the level the on screen size asks for, positive values stream in less detail
+    float stream_bias = 0.0f;
+    // How long levels that are no longer needed are kept before being dropped, so that they don't thrash
+    int stream_keep_frames = 120;
+    // Each reupload holds a copy of the levels it uploads until it is done, so only a few are made at once
+    static constexpr size_t MAX_STREAM_UPLOADS = 4;
+    size_t last_stream_bytes = 0;
+
+    /// A decoded image, shared by every load of a file (or of files with the same contents) while it stays in decoded_images.
+    /// Loads waiting on the image's decode, started by another, wait for its future rather than decoding it again.
+    struct DecodedEntry {
+        std::shared_future<std::shared_ptr<const DecodedImage>> image;
+        // 0 until the decode is done
+        size_t bytes = 0;
+        uint64_t last_used = 0;
+    };
+    // Guards the decoded_images and their stats, which are shared with the workers
+    std::mutex decoded_images_mutex{};
+    // { content_hash } -> { decoded image }, evicting the least recently used past decoded_image_budget_mb
+    std::unordered_map<uint64_t, DecodedEntry> decoded_images{};
+    uint64_t decoded_image_clock = 0;
+    size_t decoded_image_bytes = 0;
+    size_t decoded_image_hits = 0;
+    size_t decoded_image_misses = 0;
+    std::atomic<int> decoded_image_budget_mb = 256;
+
+    // { content_key } -> { the texture loaded with that content and settings }, so that other loads of the same content can share it
+    std::unordered_map<uint64_t, std::weak_ptr<TextureHandle>> content_index{};
+    size_t shared_loads = 0;
+
+    // Limits on how much uploading is done each update(), so that loading never causes frame hitches
+    float upload_budget_ms = 2.0f;
+    int upload_budget_kb = 4096;
+    size_t last_update_bytes = 0;
+    float last_update_ms = 0.0f;
 
     static constexpr int DEFAULT_TEXTURE_SIZE = 16;
     static constexpr int DEFAULT_TEXTURE_BPP = 3;
@@ -28,16 +154,74 @@ class TextureLoader {
 
     std::optional<std::vector<std::string>> available_textures{};
 
+    // The compression textures are uploaded with, unless overridden for the file in compressions
+    TextureCompression default_compression = TextureCompression::Auto;
+    // { file } -> { compression }
+    std::unordered_map<std::string, TextureCompression> compressions{};
+    // Queried on the first load, since it needs the GL context
+    std::optional<CompressionSupport> compression_support{};
+    // The channels textures are stored with, unless overridden for the file in channel_layouts
+    TextureChannels default_channels = TextureChannels::Auto;
+    // { file } -> { channels }
+    std::unordered_map<std::string, TextureChannels> channel_layouts{};
+    // Mip chains are built on the CPU with this filter, rather than by the driver
+    MipFilter mip_filter = MipFilter::Kaiser;
+
+    struct UploadRecord {
+        std::string file;
+        MipChain::Mip top_mip;
+        TextureCompression format;
+        uint channels;
+        size_t bytes;
+        size_t texel_count;
+        float psnr;
+        double mip_ms;
+        double encode_ms;
+        bool from_cache;
+    };
+    static constexpr size_t RECENT_UPLOADS = 8;
+    std::deque<UploadRecord> recent_uploads{};
+    // (file, format, psnr, encode ms, MPixels/s, compressed bytes, uncompressed bytes)
+    std::vector<std::tuple<std::string, TextureCompression, float, double, double, size_t, size_t>> benchmark_results{};
+    // (file, method, ms)
+    std::vector<std::tuple<std::string, std::string, double>> mip_benchmark_results{};
+
     // Map (relative_path, srgb, is_flipped) -> (last_modified, weak_handle)
     std::unordered_map<std::tuple<std::string, bool, bool>, std::pair<std::filesystem::file_time_type, std::weak_ptr<TextureHandle>>, TripleHash> cache{};
+
+    // Declared last, so the workers are joined before anything their tasks reference is destroyed
+    ThreadPool decode_pool{};
 public:
     /// Construct the loader with a import_path which is prepended to any path you try and load.
     /// It also scans the directory for all files, which is used to populate the list of get_available_textures()
-    explicit TextureLoader(std::string import_path);
+    /// Loaded textures are tracked by the residency_manager, which keeps them loaded for a while after they are released.
+    /// Files are looked up through the file_watcher (which must be watching import_path to be of any use),
+    /// and live textures are reloaded in place when their file is modified.
+    /// Mip chains (block compressed or not) are cached under cache_path, so later loads can upload them directly.
+    TextureLoader(std::string import_path, const std::string& cache_path, ResidencyManager& residency_manager, FileWatcher& file_watcher);
 
     /// Loads the file at the specified path into GPU memory, with flags for if the texture is sRGB and to flip it vertically.
     std::shared_ptr<TextureHandle> load_from_file(const std::string& file, bool srgb = true, bool flip_vertical = false);
 
+    /// Start loading the file on a worker thread, returning a handle straight away.
+    /// Until the upload has completed (see update()), the handle samples the default white texture and is_ready() returns false.
+    /// Large textures are streamed, becoming ready once their smaller mips have uploaded, with the larger mips following as they are needed.
+    std::shared_ptr<TextureHandle> load_from_file_async(const std::string& file, bool srgb = true, bool flip_vertical = false);
+
+    /// Progress asynchronous loads, uploading as much as the per-frame budget allows,
+    /// and stream the mips of large textures in or out, based on the sizes they were drawn at last frame (see TextureHandle::request_size()).
+    /// Must be called on the GL thread, once a frame.
+    void update();
+
+    /// A new loader over the same import_path, with the same settings, but with its own caches (the disk one under cache_path),
+    /// so that loads can be benchmarked without disturbing this loader's textures. The residency_manager and file_watcher must outlive it.
+    [[nodiscard]] std::unique_ptr<TextureLoader> create_isolated(const std::string& cache_path, ResidencyManager& isolated_residency_manager, FileWatcher& isolated_file_watcher) const;
+
+    [[nodiscard]] const std::string& get_import_path() const { return import_path; }
+
+    /// Returns true while any asynchronous loads are still in progress
+    [[nodiscard]] bool has_pending_loads() const;
+
     /// Provides a pure white (0xFFFFFF) texture
     std::shared_ptr<TextureHandle> default_white_texture();
     /// Provides a pure black (0x000000) texture
@@ -47,11 +231,107 @@ public:
     /// If the prefer_srgb flag is selected, then when going from no texture to a valid texture it will default to enabling srgb.
     void add_imgui_texture_selector(const std::string& caption, std::shared_ptr<TextureHandle>& texture_handle, bool prefer_srgb = true);
     /// Helper method to provide a selector over all the texture files in the import_path directory.
-    /// if force_refresh is selected, it will rescan the directory, otherwise it just uses a cached list from the last scan.
+    /// if force_refresh is selected, it will re-list the directory, otherwise it just uses a cached list, which is kept up to date by the file_watcher.
     const std::vector<std::string>& get_available_textures(bool force_refresh = false);
 
+    /// The compression the file is uploaded with, either its override or the default
+    [[nodiscard]] TextureCompression get_compression(const std::string& file) const;
+    /// Override the compression for a file, reloading any live textures from it in place
+    void set_compression(const std::string& file, TextureCompression compression);
+
+    /// The channels the file is stored with, either its override or the default
+    [[nodiscard]] TextureChannels get_channels(const std::string& file) const;
+    /// Override the channels for a file, reloading any live textures from it in place
+    void set_channels(const std::string& file, TextureChannels channels);
+
+    /// Compress every available texture in each of the formats, reporting the quality and speed of each (to stdout and the UI)
+    void run_compression_benchmark();
+
+    /// Time building the mip chain of every available texture with each filter (with and without SIMD) against glGenerateMipmap,
+    /// reporting the results to stdout and the UI. Must be called on the GL thread.
+    void run_mip_benchmark();
+
+    /// Adds the ImGUI controls for the loader (the upload budget, pending loads, and compression) to the current ImGUI window
+    void add_imgui_options_section();
+
     /// Free up any resources.
     void cleanup();
+
+private:
+    /// Find the last write time of a file under import_path, throwing if it doesn't exist
+    std::filesystem::file_time_type get_last_write_time(const std::string& file) const;
+
+    /// Hot reload live textures from a file that has changed, or forget them if it was removed
+    void on_file_changed(const FileWatcher::Change& change);
+
+    /// Decode the file on a worker thread, and then (from update()) upload it and update texture in place.
+    void start_texture_load(const std::string& file, const std::shared_ptr<TextureHandle>& texture);
+
+    /// Reload every live texture from the file in place, such as after its compression has changed
+    void reload_live_textures(const std::string& file);
+
+    const CompressionSupport& get_compression_support();
+
+    /// Decode the file and build its mip chain with the channels (detecting them if Auto), block compressing it if requested,
+    /// or read it straight from the texture_cache. The file's content hash is recorded in the chain. Thread safe.
+    MipChain prepare_mips(const std::string& file, bool srgb, bool flip_vertical, TextureCompression compression, TextureChannels channels, MipFilter filter,
+                          const CompressionSupport& support);
+
+    /// Create a texture for the mip chain, with its storage allocated (and parameters set) but nothing uploaded yet.
+    /// Textures with fewer than 3 channels are swizzled so that they can still be sampled as rgb.
+    static uint create_texture(const MipChain& mips);
+    /// Record how the mip chain is stored, and the memory it takes, on a texture uploaded from it
+    static void set_storage(TextureHandle& texture, const MipChain& mips);
+    static GLenum pixel_format(uint channels);
+    /// Upload every level of the mip chain into a new texture, recording its stats
+    std::shared_ptr<TextureHandle> upload_mips(const std::string& file, const MipChain& mips, bool srgb, bool flip_vertical);
+    void record_upload(const std::string& file, const MipChain& mips);
+
+    /// The key a texture is tracked under by the residency_manager
+    static std::string residency_key(const std::string& file, bool srgb, bool flip_vertical);
+
+    /// Decode the image, flipping it if requested. Thread safe, since it doesn't rely on stb_image's global flip state.
+    static DecodedImage decode_image(const std::string& full_path, bool flip_vertical);
+    /// Decode an image from the (mapped) contents of its file, name is only used to report errors. Thread safe.
+    static DecodedImage decode_image(const std::byte* data, size_t size, const std::string& name);
+    static void flip_vertically(DecodedImage& image);
+    /// The decoded (unflipped) image with the content hash, from decoded_images if it is there, otherwise decoding it from source (mapping the file if it is unset). Thread safe.
+    std::shared_ptr<const DecodedImage> get_decoded_image(const std::string& full_path, uint64_t content_hash, std::optional<MappedFile>& source);
+    /// Drop the least recently used decoded images until they fit the budget, decoded_images_mutex must be held
+    void trim_decoded_images();
+
+    /// Identifies the settings a texture is loaded with, combined with a content hash to key the content_index
+    static uint64_t settings_key(bool srgb, bool flip_vertical, TextureCompression compression, TextureChannels channels, MipFilter filter);
+    /// A live texture holding the content key, owning its texture, for another handle (than the given one, if any) to share, or nullptr if there is none
+    std::shared_ptr<TextureHandle> find_shared_texture(uint64_t content_key, const TextureHandle* handle);
+    /// Record the handle as holding the content key, unless another live texture already does
+    void register_content(uint64_t content_key, const std::shared_ptr<TextureHandle>& handle);
+    /// Reload the live textures sharing one of the file's textures, since it has changed and so they no longer hold the same content
+    void reload_sharers(const std::string& file);
+
+    /// Pick the fewest channels that hold the image, see TextureChannels::Auto
+    static TextureChannels detect_channels(const DecodedImage& image);
+    /// Pack the first channels of each pixel tightly
+    static std::vector<uint8_t> extract_channels(const DecodedImage& image, uint channels);
+    /// Convert the colour channels of the image from sRGB to linear, for formats with no sRGB variant
+    static void linearise(DecodedImage& image);
+
+    static void setup_texture_parameters();
+
+    /// Try to advance a pending load, returns true once it is finished with (successfully or not)
+    bool update_pending_texture(PendingTexture& pending, size_t& bytes_uploaded, std::chrono::steady_clock::time_point update_start);
+    static void release_pending_texture(PendingTexture& pending);
+    /// Replace the handle's texture with the one the pending load has uploaded
+    void hand_over(PendingTexture& pending, TextureHandle& handle, TextureHandle& uploaded);
+
+    /// If the newly prepared chain is large enough to stream, keep it for streaming, and cut the pending load down to its tail
+    void start_streaming(PendingTexture& pending, const std::shared_ptr<TextureHandle>& handle);
+    /// Pick the levels each streamed texture needs, within the streaming budget, and start reuploading those that have changed
+    void update_streaming();
+    /// The level (of the whole chain) a texture drawn size pixels across needs, no smaller than the tail
+    [[nodiscard]] uint needed_level(const StreamedTexture& stream, float size) const;
+    /// The GPU memory the levels of the chain take, from first_level down to (but not including) last_level
+    static size_t level_bytes(const MipChain& mips, uint first_level, uint last_level);
 };
 
 
@@ -0,0 +1,380 @@
+#include "TexturePool.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+#include <imgui/imgui.h>
+
+static constexpr uint log2_uint(uint value) {
+    uint result = 0;
+    while (value > 1) {
+        value >>= 1;
+        ++result;
+    }
+    return result;
+}
+
+static uint next_power_of_two(uint value) {
+    uint result = 1;
+    while (result < value) result <<= 1;
+    return result;
+}
+
+uint TexturePool::ArrayTexture::used_layer_count() const {
+    return (uint) std::count(used_layers.begin(), used_layers.end(), true);
+}
+
+TexturePool::TexturePool() {
+    int major = 0;
+    int minor = 0;
+    glGetIntegerv(GL_MAJOR_VERSION, &major);
+    glGetIntegerv(GL_MINOR_VERSION, &minor);
+    // glCopyImageSubData is core since 4.3 (and glTexStorage3D since 4.2)
+    supported = major > 4 || (major == 4 && minor >= 3);
+    enabled = supported;
+
+    int gl_max_layers = 0;
+    glGetIntegerv(GL_MAX_ARRAY_TEXTURE_LAYERS, &gl_max_layers);
+    max_layers = std::clamp((uint) gl_max_layers, 1u, MAX_LAYERS);
+    glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY, &max_anisotropy);
+}
+
+TexturePool::Slot TexturePool::resolve(const std::shared_ptr<TextureHandle>& texture) {
+    if (!enabled) {
+        return {GL_TEXTURE_2D, texture->get_texture_id(), 0.0f, {1.0f, 1.0f, 0.0f, 0.0f}};
+    }
+    // Handles sharing another's texture use its copy, rather than each making their own
+    if (texture->get_shared_with() != nullptr) {
+        return resolve(texture->get_shared_with());
+    }
+
+    auto existing = allocations.find(texture.get());
+    if (existing != allocations.end()) {
+        const auto& allocation = existing->second;
+        // If the handle has expired, then this is a new handle that happens to have the same address
+        if (!allocation.handle.expired() && allocation.generation == texture->get_generation()) {
+            return {GL_TEXTURE_2D_ARRAY, allocation.array->texture_id, (float) allocation.layer, allocation.rect};
+        }
+        release(allocation);
+        allocations.erase(existing);
+    }
+
+    auto allocation = allocate(texture);
+    allocations.emplace(texture.get(), allocation);
+    return {GL_TEXTURE_2D_ARRAY, allocation.array->texture_id, (float) allocation.layer, allocation.rect};
+}
+
+void TexturePool::reset_bindings() {
+    std::fill_n(bound_textures, BIND_UNITS, 0u);
+}
+
+void TexturePool::bind(uint unit, const Slot& slot) {
+    if (unit < BIND_UNITS) {
+        if (bound_textures[unit] == slot.texture_id) return;
+        bound_textures[unit] = slot.texture_id;
+    }
+    glActiveTexture(GL_TEXTURE0 + unit);
+    glBindTexture(slot.target, slot.texture_id);
+    ++binds;
+}
+
+void TexturePool::update() {
+    for (auto it = allocations.begin(); it != allocations.end();) {
+        if (it->second.handle.expired()) {
+            release(it->second);
+            it = allocations.erase(it);
+        } else {
+            ++it;
+        }
+    }
+
+    arrays.erase(std::remove_if(arrays.begin(), arrays.end(), [this](const auto& array) {
+        if (array->used_layer_count() != 0) return false;
+        delete_array_texture(array->texture_id);
+        return true;
+    }), arrays.end());
+
+    last_frame_binds = binds;
+    binds = 0;
+    last_frame_copies = copies;
+    copies = 0;
+}
+
+bool TexturePool::is_enabled() const {
+    return enabled;
+}
+
+void TexturePool::set_enabled(bool set_enabled) {
+    if (!supported || set_enabled == enabled) return;
+    enabled = set_enabled;
+    if (!enabled) release_all();
+}
+
+TexturePool::Allocation TexturePool::allocate(const std::shared_ptr<TextureHandle>& texture) {
+    glActiveTexture(GL_TEXTURE0 + SCRATCH_UNIT);
+    glBindTexture(GL_TEXTURE_2D, texture->get_texture_id());
+
+    int internal_format = 0;
+    int compressed = 0;
+    int width = 0;
+    int height = 0;
+    int max_level = 0;
+    std::array<int, 4> swizzle{};
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_INTERNAL_FORMAT, &internal_format);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_COMPRESSED, &compressed);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+    glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, &max_level);
+    glGetTexParameteriv(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_RGBA, swizzle.data());
+    if (width <= 0 || height <= 0) {
+        throw std::runtime_error(Formatter() << "Can't pool texture " << texture->get_texture_id() << ", since it has no storage");
+    }
+
+    // Array storage has to be sized, where textures may have been given an unsized format
+    switch (internal_format) {
+        case GL_RGB: internal_format = GL_RGB8; break;
+        case GL_RGBA: internal_format = GL_RGBA8; break;
+        case GL_SRGB: internal_format = GL_SRGB8; break;
+        case GL_SRGB_ALPHA: internal_format = GL_SRGB8_ALPHA8; break;
+        default: break;
+    }
+
+    // Only the levels that have been specified can be copied, which for textures without mips is just the first
+    uint levels = 0;
+    uint max_levels = std::min((uint) max_level + 1, full_mip_count((uint) width, (uint) height));
+    while (levels < max_levels) {
+        int level_width = 0;
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, (int) levels, GL_TEXTURE_WIDTH, &level_width);
+        if (level_width == 0) break;
+        ++levels;
+    }
+
+    Allocation allocation{texture, texture->get_generation(), nullptr, 0, {0, 0}, 0, {1.0f, 1.0f, 0.0f, 0.0f}};
+
+    auto tile = std::max(ATLAS_MIN_TILE, next_power_of_two((uint) std::max(width, height)));
+    if (tile <= ATLAS_MAX_TILE) {
+        // The atlas can only have as many levels as its smallest tiles do, which for block compressed formats stop at a whole block
+        auto block = compressed ? 4u : 1u;
+        auto atlas_levels = std::min(levels, log2_uint(ATLAS_MIN_TILE / block) + 1);
+        allocation.size_class = log2_uint(ATLAS_SIZE / tile);
+
+        for (const auto& array: arrays) {
+            if (array->atlas && array->internal_format == (GLenum) internal_format && array->levels == atlas_levels && array->swizzle == swizzle
+                && allocate_tile(*array, allocation.size_class, allocation.layer, allocation.tile_origin)) {
+                allocation.array = array.get();
+                break;
+            }
+        }
+        if (allocation.array == nullptr) {
+            // Every atlas is full, so open up a new layer
+            auto& array = find_array((GLenum) internal_format, ATLAS_SIZE, ATLAS_SIZE, atlas_levels, swizzle, true, compressed);
+            auto layer = (uint) std::distance(array.used_layers.begin(), std::find(array.used_layers.begin(), array.used_layers.end(), false));
+            array.used_layers[layer] = true;
+            array.free_tiles[layer][0].emplace_back(0, 0);
+            allocate_tile(array, allocation.size_class, allocation.layer, allocation.tile_origin);
+            allocation.array = &array;
+        }
+
+        allocation.rect = glm::vec4((float) width, (float) height, (float) allocation.tile_origin.x, (float) allocation.tile_origin.y) / (float) ATLAS_SIZE;
+    } else {
+        auto& array = find_array((GLenum) internal_format, (uint) width, (uint) height, levels, swizzle, false, compressed);
+        allocation.layer = (uint) std::distance(array.used_layers.begin(), std::find(array.used_layers.begin(), array.used_layers.end(), false));
+        array.used_layers[allocation.layer] = true;
+        allocation.array = &array;
+    }
+
+    for (uint level = 0; level < allocation.array->levels; ++level) {
+        glCopyImageSubData(texture->get_texture_id(), GL_TEXTURE_2D, (int) level, 0, 0, 0,
+                           allocation.array->texture_id, GL_TEXTURE_2D_ARRAY, (int) level,
+                           (int) (allocation.tile_origin.x >> level), (int) (allocation.tile_origin.y >> level), (int) allocation.layer,
+                           std::max(1, width >> level), std::max(1, height >> level), 1);
+    }
+    ++copies;
+
+    return allocation;
+}
+
+void TexturePool::release(const Allocation& allocation) {
+    if (allocation.array->atlas) {
+        free_tile(*allocation.array, allocation.layer, allocation.tile_origin, allocation.size_class);
+    } else {
+        allocation.array->used_layers[allocation.layer] = false;
+    }
+}
+
+void TexturePool::release_all() {
+    for (const auto& array: arrays) {
+        glDeleteTextures(1, &array->texture_id);
+    }
+    arrays.clear();
+    allocations.clear();
+    reset_bindings();
+}
+
+TexturePool::ArrayTexture& TexturePool::find_array(GLenum internal_format, uint width, uint height, uint levels, const std::array<int, 4>& swizzle, bool atlas, bool compressed) {
+    ArrayTexture* growable = nullptr;
+    for (const auto& array: arrays) {
+        if (array->atlas != atlas || array->internal_format != internal_format || array->width != width || array->height != height || array->levels != levels
+            || array->swizzle != swizzle) continue;
+        if (array->used_layer_count() < array->capacity) return *array;
+        if (array->capacity < max_layers) growable = array.get();
+    }
+
+    if (growable != nullptr) {
+        grow_array(*growable, std::min(growable->capacity * 2, max_layers));
+        return *growable;
+    }
+    return create_array(internal_format, width, height, levels, swizzle, atlas, compressed);
+}
+
+bool TexturePool::allocate_tile(ArrayTexture& atlas, uint size_class, uint& layer, glm::uvec2& origin) {
+    for (uint l = 0; l < atlas.capacity; ++l) {
+        if (!atlas.used_layers[l]) continue;
+        auto& classes = atlas.free_tiles[l];
+
+        // Take the smallest free tile that fits, splitting it down to size, leaving the other quarters free
+        for (int c = (int) size_class; c >= 0; --c) {
+            if (classes[c].empty()) continue;
+
+            auto tile = classes[c].back();
+            classes[c].pop_back();
+            for (auto split = (uint) c + 1; split <= size_class; ++split) {
+                auto half = ATLAS_SIZE >> split;
+                classes[split].emplace_back(tile.x + half, tile.y);
+                classes[split].emplace_back(tile.x, tile.y + half);
+                classes[split].emplace_back(tile.x + half, tile.y + half);
+            }
+
+            layer = l;
+            origin = tile;
+            return true;
+        }
+    }
+    return false;
+}
+
+void TexturePool::free_tile(ArrayTexture& atlas, uint layer, glm::uvec2 origin, uint size_class) {
+    auto& classes = atlas.free_tiles[layer];
+
+    // Merge with the other quarters of the parent tile while they are all free
+    while (size_class > 0) {
+        auto size = ATLAS_SIZE >> size_class;
+        glm::uvec2 parent{origin.x & ~(2 * size - 1), origin.y & ~(2 * size - 1)};
+        glm::uvec2 quarters[4] = {parent, {parent.x + size, parent.y}, {parent.x, parent.y + size}, {parent.x + size, parent.y + size}};
+
+        auto& free = classes[size_class];
+        bool all_free = std::all_of(std::begin(quarters), std::end(quarters), [&](const glm::uvec2& quarter) {
+            return quarter == origin || std::find(free.begin(), free.end(), quarter) != free.end();
+        });
+        if (!all_free) break;
+
+        free.erase(std::remove_if(free.begin(), free.end(), [&](const glm::uvec2& tile) {
+            return std::find(std::begin(quarters), std::end(quarters), tile) != std::end(quarters);
+        }), free.end());
+        origin = parent;
+        --size_class;
+    }
+
+    if (size_class == 0) {
+        // The whole layer is free again
+        atlas.used_layers[layer] = false;
+    } else {
+        classes[size_class].push_back(origin);
+    }
+}
+
+TexturePool::ArrayTexture& TexturePool::create_array(GLenum internal_format, uint width, uint height, uint levels, const std::array<int, 4>& swizzle, bool atlas, bool compressed) {
+    auto array = std::make_unique<ArrayTexture>();
+    array->internal_format = internal_format;
+    array->width = width;
+    array->height = height;
+    array->levels = levels;
+    array->swizzle = swizzle;
+    array->atlas = atlas;
+    array->compressed = compressed;
+    array->capacity = std::min(INITIAL_LAYERS, max_layers);
+    allocate_storage(*array);
+
+    array->used_layers.assign(array->capacity, false);
+    if (atlas) {
+        array->free_tiles.assign(array->capacity, std::vector<std::vector<glm::uvec2>>(log2_uint(ATLAS_SIZE / ATLAS_MIN_TILE) + 1));
+    }
+
+    arrays.push_back(std::move(array));
+    return *arrays.back();
+}
+
+void TexturePool::grow_array(ArrayTexture& array, uint capacity) {
+    auto old_texture_id = array.texture_id;
+    auto old_capacity = array.capacity;
+
+    array.capacity = capacity;
+    allocate_storage(array);
+    for (uint level = 0; level < array.levels; ++level) {
+        glCopyImageSubData(old_texture_id, GL_TEXTURE_2D_ARRAY, (int) level, 0, 0, 0,
+                           array.texture_id, GL_TEXTURE_2D_ARRAY, (int) level, 0, 0, 0,
+                           (int) std::max(1u, array.width >> level), (int) std::max(1u, array.height >> level), (int) old_capacity);
+    }
+    delete_array_texture(old_texture_id);
+
+    array.used_layers.resize(capacity, false);
+    if (array.atlas) {
+        array.free_tiles.resize(capacity, std::vector<std::vector<glm::uvec2>>(log2_uint(ATLAS_SIZE / ATLAS_MIN_TILE) + 1));
+    }
+}
+
+void TexturePool::delete_array_texture(uint texture_id) {
+    glDeleteTextures(1, &texture_id);
+    std::replace(bound_textures, bound_textures + BIND_UNITS, texture_id, 0u);
+}
+
+void TexturePool::allocate_storage(ArrayTexture& array) const {
+    glGenTextures(1, &array.texture_id);
+    glActiveTexture(GL_TEXTURE0 + SCRATCH_UNIT);
+    glBindTexture(GL_TEXTURE_2D_ARRAY, array.texture_id);
+    glTexStorage3D(GL_TEXTURE_2D_ARRAY, (int) array.levels, array.internal_format, (int) array.width, (int) array.height, (int) array.capacity);
+
+    // Atlases are wrapped by the shader, within each tile, and clamping stops the tiles on one edge of the layer from blending with the other
+    auto wrap = array.atlas ? GL_CLAMP_TO_EDGE : GL_REPEAT;
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_S, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_WRAP_T, wrap);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MIN_FILTER, GL_LINEAR_MIPMAP_LINEAR);
+    glTexParameterf(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_ANISOTROPY, max_anisotropy);
+    glTexParameteri(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_MAX_LEVEL, (int) array.levels - 1);
+    glTexParameteriv(GL_TEXTURE_2D_ARRAY, GL_TEXTURE_SWIZZLE_RGBA, array.swizzle.data());
+}
+
+uint TexturePool::full_mip_count(uint width, uint height) {
+    return log2_uint(std::max(width, height)) + 1;
+}
+
+void TexturePool::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("Texture Pool")) {
+        if (supported) {
+            bool pool_enabled = enabled;
+            if (ImGui::Checkbox("Pool Textures", &pool_enabled)) {
+                set_enabled(pool_enabled);
+            }
+        } else {
+            ImGui::TextWrapped("Pooling needs OpenGL 4.3 (for glCopyImageSubData), so every texture is bound on its own.");
+        }
+
+        ImGui::Text("Texture binds last frame: %zu", last_frame_binds);
+        ImGui::Text("Textures copied last frame: %zu", last_frame_copies);
+        ImGui::Text("Pooled textures: %zu in %zu arrays", allocations.size(), arrays.size());
+
+        if (!arrays.empty() && ImGui::TreeNode("Arrays")) {
+            for (const auto& array: arrays) {
+                ImGui::Text("%s %ux%u, %u levels, format 0x%04X: %u/%u layers used",
+                            array->atlas ? "Atlas" : "Array", array->width, array->height, array->levels,
+                            array->internal_format, array->used_layer_count(), array->capacity);
+            }
+            ImGui::TreePop();
+        }
+    }
+}
+
+TexturePool::~TexturePool() {
+    release_all();
+}
@@ -0,0 +1,142 @@
+#ifndef TEXTURE_POOL_H
+#define TEXTURE_POOL_H
+
+#include <array>
+#include <memory>
+#include <vector>
+#include <unordered_map>
+
+#include <glad/gl.h>
+#include <glm/glm.hpp>
+
+#include "TextureHandle.h"
+#include "utility/HelperTypes.h"
+
+/// Packs textures into shared GL_TEXTURE_2D_ARRAYs, so that entities using different textures can be drawn without rebinding between them.
+///
+/// Textures with the same size, format and mip count are copied into layers of the same array, growing it as needed.
+/// Small textures are instead packed into atlas layers, in power of two tiles (so that each of their mips stays aligned to whole texels),
+/// and sampled through a rect within the layer, with the shader doing the wrapping the sampler can no longer do (see common/textures.glsl).
+///
+/// Copies are made on the GPU with glCopyImageSubData, so the pool needs OpenGL 4.3. Without it (such as on macOS) the pool is disabled,
+/// and every texture is bound on its own, as a plain GL_TEXTURE_2D.
+/// Handles are copied in the first time they are resolved, and again whenever they are reloaded in place (see TextureHandle::get_generation()),
+/// and the copy is released once the handle is destroyed. The handle keeps its own texture, for the UI and for when the pool is disabled.
+/// Handles sharing another's texture (see TextureHandle::get_shared_with()) resolve to that handle's copy.
+class TexturePool : private NonCopyable {
+public:
+    /// Where to sample a texture from
+    struct Slot {
+        GLenum target;
+        uint texture_id;
+        float layer;
+        // (x, y) scales and (z, w) offsets texture coordinates into the texture's rect of the layer
+        glm::vec4 rect;
+    };
+
+private:
+    // Atlas layers are ATLAS_SIZE square, taking textures up to ATLAS_MAX_TILE on their larger side,
+    // each rounded up to a power of two tile of at least ATLAS_MIN_TILE.
+    static constexpr uint ATLAS_SIZE = 1024;
+    static constexpr uint ATLAS_MAX_TILE = 128;
+    static constexpr uint ATLAS_MIN_TILE = 16;
+    static constexpr uint INITIAL_LAYERS = 4;
+    // Arrays grow (by doubling) up to this many layers, after which another array is started
+    static constexpr uint MAX_LAYERS = 64;
+    // The pool creates and queries textures on this unit, so that it never disturbs the bindings the renderers have made
+    static constexpr uint SCRATCH_UNIT = 15;
+    // Units tracked by bind()
+    static constexpr uint BIND_UNITS = 4;
+
+    struct ArrayTexture {
+        uint texture_id = 0;
+        GLenum internal_format;
+        uint width;
+        uint height;
+        uint levels;
+        // Taken from the textures, since textures with fewer channels are swizzled to still sample as rgb
+        std::array<int, 4> swizzle;
+        bool atlas;
+        bool compressed;
+        uint capacity = 0;
+        std::vector<bool> used_layers{};
+        // Only for atlases, the free tiles of each layer, by size class (where class c is ATLAS_SIZE >> c square)
+        std::vector<std::vector<std::vector<glm::uvec2>>> free_tiles{};
+
+        [[nodiscard]] uint used_layer_count() const;
+    };
+    std::vector<std::unique_ptr<ArrayTexture>> arrays{};
+
+    struct Allocation {
+        std::weak_ptr<TextureHandle> handle;
+        uint generation;
+        ArrayTexture* array;
+        uint layer;
+        // Only for atlases
+        glm::uvec2 tile_origin;
+        uint size_class;
+        glm::vec4 rect;
+    };
+    // Keyed by the handle's address, the weak handle tells if it has since been destroyed
+    std::unordered_map<const TextureHandle*, Allocation> allocations{};
+
+    bool supported = false;
+    bool enabled = false;
+    uint max_layers = MAX_LAYERS;
+    float max_anisotropy = 1.0f;
+
+    uint bound_textures[BIND_UNITS]{};
+    size_t binds = 0;
+    size_t last_frame_binds = 0;
+    size_t copies = 0;
+    size_t last_frame_copies = 0;
+
+public:
+    /// Queries for support, so must be constructed with a current GL context
+    TexturePool();
+
+    /// Find where to sample the texture from, copying it into the pool first if it isn't already (or has been reloaded since).
+    /// If the pool is disabled this is simply the texture itself.
+    Slot resolve(const std::shared_ptr<TextureHandle>& texture);
+
+    /// Forget which textures are bound, call before the first bind() of each pass, since anything else may have changed them.
+    void reset_bindings();
+    /// Bind the slot's texture to the unit, unless it is already bound there
+    void bind(uint unit, const Slot& slot);
+
+    /// Release the copies of any destroyed textures, and any arrays left empty. Call once a frame.
+    void update();
+
+    /// True if textures are pooled, in which case shaders should sample them as arrays (see BaseEntityShader::set_texture_arrays())
+    [[nodiscard]] bool is_enabled() const;
+    /// Enable or disable pooling, releasing everything in the pool when disabling. Ignored if the pool isn't supported.
+    void set_enabled(bool set_enabled);
+
+    /// Adds the ImGUI controls for the pool, and stats on its arrays and the binds made last frame, to the current ImGUI window
+    void add_imgui_options_section();
+
+    ~TexturePool();
+
+private:
+    Allocation allocate(const std::shared_ptr<TextureHandle>& texture);
+    void release(const Allocation& allocation);
+    void release_all();
+
+    /// Find (or make) an array with space for a layer of the given format, growing or creating arrays as needed
+    ArrayTexture& find_array(GLenum internal_format, uint width, uint height, uint levels, const std::array<int, 4>& swizzle, bool atlas, bool compressed);
+    /// Allocate a tile of the size class from the atlas, returning the layer and origin, or false if it is full
+    static bool allocate_tile(ArrayTexture& atlas, uint size_class, uint& layer, glm::uvec2& origin);
+    static void free_tile(ArrayTexture& atlas, uint layer, glm::uvec2 origin, uint size_class);
+
+    ArrayTexture& create_array(GLenum internal_format, uint width, uint height, uint levels, const std::array<int, 4>& swizzle, bool atlas, bool compressed);
+    /// Reallocate the array with more layers, copying the existing layers across
+    void grow_array(ArrayTexture& array, uint capacity);
+    /// Delete an array's texture, forgetting any binds of it, since GL can hand the name straight out again to the next texture created
+    void delete_array_texture(uint texture_id);
+    void allocate_storage(ArrayTexture& array) const;
+
+    /// The number of levels of a texture of the size that has a full mip chain
+    static uint full_mip_count(uint width, uint height);
+};
+
+#endif //TEXTURE_POOL_H
@@ -0,0 +1,79 @@
+#include "VertexFormat.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdexcept>
+
+#include <glm/gtc/packing.hpp>
+
+#include "utility/HelperTypes.h"
+
+std::string to_string(VertexFormat vertex_format) {
+    switch (vertex_format) {
+        case VertexFormat::Full:
+            return "Full";
+        case VertexFormat::Compact:
+            return "Compact";
+    }
+    return "Unknown";
+}
+
+static int16_t to_snorm16(float value) {
+    return (int16_t) std::lround(std::clamp(value, -1.0f, 1.0f) * 32767.0f);
+}
+
+glm::i16vec4 VertexPacking::quantise_position(const glm::vec3& position, const VertexDecode& decode) {
+    glm::i16vec4 result{0};
+    for (auto i = 0; i < 3; ++i) {
+        // A flat axis has a scale of 0, in which case every position is at the offset
+        auto normalised = decode.position_scale[i] == 0.0f ? 0.0f : (position[i] - decode.position_offset[i]) / decode.position_scale[i];
+        result[i] = to_snorm16(normalised);
+    }
+    return result;
+}
+
+glm::i16vec2 VertexPacking::encode_octahedral(const glm::vec3& normal) {
+    auto length = std::abs(normal.x) + std::abs(normal.y) + std::abs(normal.z);
+    if (length == 0.0f) return glm::i16vec2{0, 0};
+
+    float x = normal.x / length;
+    float y = normal.y / length;
+    if (normal.z < 0.0f) {
+        // Fold the lower hemisphere over the diagonals
+        auto folded_x = (1.0f - std::abs(y)) * (x >= 0.0f ? 1.0f : -1.0f);
+        auto folded_y = (1.0f - std::abs(x)) * (y >= 0.0f ? 1.0f : -1.0f);
+        x = folded_x;
+        y = folded_y;
+    }
+    return glm::i16vec2{to_snorm16(x), to_snorm16(y)};
+}
+
+glm::u16vec2 VertexPacking::to_half(const glm::vec2& value) {
+    return glm::u16vec2{glm::packHalf1x16(value.x), glm::packHalf1x16(value.y)};
+}
+
+glm::u8vec4 VertexPacking::quantise_weights(const glm::vec4& weights) {
+    int quantised[4];
+    int total = 0;
+    for (auto i = 0; i < 4; ++i) {
+        quantised[i] = (int) std::lround(std::clamp(weights[i], 0.0f, 1.0f) * 255.0f);
+        total += quantised[i];
+    }
+
+    // The shader gives any weight missing from the sum to the identity transform,
+    // so put the rounding error onto the largest weight rather than leave it there.
+    auto target = (int) std::lround(std::clamp(weights[0] + weights[1] + weights[2] + weights[3], 0.0f, 1.0f) * 255.0f);
+    auto largest = (int) (std::max_element(quantised, quantised + 4) - quantised);
+    quantised[largest] = std::clamp(quantised[largest] + target - total, 0, 255);
+
+    return glm::u8vec4{(uint8_t) quantised[0], (uint8_t) quantised[1], (uint8_t) quantised[2], (uint8_t) quantised[3]};
+}
+
+glm::u8vec4 VertexPacking::narrow_indices(const glm::uvec4& indices) {
+    for (auto i = 0; i < 4; ++i) {
+        if (indices[i] > UINT8_MAX) {
+            throw std::runtime_error(Formatter() << "Bone index " << indices[i] << " does not fit in a compact vertex");
+        }
+    }
+    return glm::u8vec4{(uint8_t) indices[0], (uint8_t) indices[1], (uint8_t) indices[2], (uint8_t) indices[3]};
+}
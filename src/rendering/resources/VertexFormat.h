@@ -0,0 +1,67 @@
+#ifndef VERTEX_FORMAT_H
+#define VERTEX_FORMAT_H
+
+#include <cstdint>
+#include <string>
+#include <vector>
+
+#include <glm/glm.hpp>
+
+/// How a model's vertices are stored on the GPU.
+enum class VertexFormat {
+    // The VertexData type as is, with full floats for every attribute
+    Full,
+    // The VertexData type's Compact counterpart, with quantised attributes decoded in the vertex shader
+    Compact,
+};
+
+std::string to_string(VertexFormat vertex_format);
+
+/// The parameters the vertex shaders need to decode a model's vertices, which are set per draw.
+/// The defaults decode Full vertices unchanged.
+struct VertexDecode {
+    // position = position_offset + position_scale * stored_position
+    glm::vec3 position_offset{0.0f};
+    glm::vec3 position_scale{1.0f};
+    // If set, the normal is a 2 component octahedral encoding, rather than a 3 component vector
+    bool octahedral_normals = false;
+
+    /// The decode for positions normalised against the bounds of the given positions.
+    template<typename VertexData>
+    static VertexDecode for_bounds(const VertexData* vertices, size_t vertex_count);
+};
+
+/// Helpers for encoding vertex attributes into the compact formats.
+namespace VertexPacking {
+    /// Map a position into [-1, 1] against the decode's bounds, as normalised signed 16 bit integers
+    glm::i16vec4 quantise_position(const glm::vec3& position, const VertexDecode& decode);
+
+    /// Encode a unit vector into 2 normalised signed 16 bit integers with an octahedral mapping
+    /// See: https://knarkowicz.wordpress.com/2014/04/16/octahedron-normal-vector-encoding/
+    glm::i16vec2 encode_octahedral(const glm::vec3& normal);
+
+    /// Convert to half precision floats, which unlike a normalised format still allows tiling texture coordinates
+    glm::u16vec2 to_half(const glm::vec2& value);
+
+    /// Convert weights to normalised unsigned bytes, distributing the rounding error so that their sum is preserved as closely as possible
+    glm::u8vec4 quantise_weights(const glm::vec4& weights);
+
+    /// Narrow indices to bytes, throwing if any do not fit
+    glm::u8vec4 narrow_indices(const glm::uvec4& indices);
+}
+
+template<typename VertexData>
+VertexDecode VertexDecode::for_bounds(const VertexData* vertices, size_t vertex_count) {
+    if (vertex_count == 0) return VertexDecode{{0.0f, 0.0f, 0.0f}, {1.0f, 1.0f, 1.0f}, true};
+
+    glm::vec3 min = vertices[0].position;
+    glm::vec3 max = vertices[0].position;
+    for (auto i = 1u; i < vertex_count; ++i) {
+        min = glm::min(min, vertices[i].position);
+        max = glm::max(max, vertices[i].position);
+    }
+
+    return VertexDecode{(min + max) * 0.5f, (max - min) * 0.5f, true};
+}
+
+#endif //VERTEX_FORMAT_H
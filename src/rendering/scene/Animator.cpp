@@ -1,25 +1,187 @@
 #include "Animator.h"
 
-void Animator::animate(double dt) {
-    std::vector<std::shared_ptr<AnimatedEntityInterface>> to_remove{};
-
-    for (auto& item: animated_entities) {
-        if (item.second.paused) continue;
-
-        auto& time = item.first->get_animation_time_seconds();
-        auto dur = item.first->get_animation_duration_seconds();
-        time += dt * item.second.speed;
-        if (time > dur) {
-            if (item.second.loop && dur > 0) {
-                time = std::fmod(time, dur);
-            } else {
-                time = dur;
-                to_remove.push_back(item.first);
+#include <cmath>
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define ANIMATOR_SSE2
+#include <emmintrin.h>
+#endif
+
+std::optional<uint> Animator::find(const std::shared_ptr<AnimatedEntityInterface>& animated_entity) const {
+    const auto& handle = animated_entity->animation_handle;
+    if (handle.index >= slot_indices.size() || slot_generations[handle.index] != handle.generation) return std::nullopt;
+
+    // The handle could be from another Animator, with a slot that happens to match
+    auto index = slot_indices[handle.index];
+    if (entities[index] != animated_entity) return std::nullopt;
+    return index;
+}
+
+void Animator::add(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters) {
+    uint slot;
+    if (!free_slots.empty()) {
+        slot = free_slots.back();
+        free_slots.pop_back();
+    } else {
+        slot = (uint) slot_indices.size();
+        slot_indices.push_back(0);
+        slot_generations.push_back(0);
+    }
+
+    auto index = (uint) times.size();
+    slot_indices[slot] = index;
+    animated_entity->animation_handle = {slot, slot_generations[slot]};
+
+    auto& time = animated_entity->get_animation_time_seconds();
+    times.push_back(time);
+    speeds.push_back(0.0);
+    durations.push_back(0.0);
+    flags.push_back(0);
+    animation_ids.push_back(NONE_ANIMATION);
+    slots.push_back(slot);
+    entities.push_back(animated_entity);
+    time_outputs.push_back(&time);
+
+    // Only done when the entity starts animating, as it always was, see the class comment
+    animated_entity->get_animation_id() = animation_parameters.animation_id;
+    set_parameters(index, animation_parameters);
+}
+
+void Animator::set_parameters(uint index, const AnimationParameters& animation_parameters) {
+    const auto& entity = *entities[index];
+    animation_ids[index] = animation_parameters.animation_id;
+    speeds[index] = animation_parameters.speed;
+    // Fixed for as long as the animation is, so only looked up here, rather than each frame
+    durations[index] = entity.get_animation_duration_seconds();
+    flags[index] = (animation_parameters.loop ? LOOP : 0) | (animation_parameters.paused ? PAUSED : 0);
+}
+
+void Animator::remove(uint index) {
+    auto slot = slots[index];
+    slot_generations[slot]++;
+    free_slots.push_back(slot);
+    entities[index]->animation_handle = {};
+
+    auto last = (uint) times.size() - 1;
+    if (index != last) {
+        times[index] = times[last];
+        speeds[index] = speeds[last];
+        durations[index] = durations[last];
+        flags[index] = flags[last];
+        animation_ids[index] = animation_ids[last];
+        slots[index] = slots[last];
+        entities[index] = std::move(entities[last]);
+        time_outputs[index] = time_outputs[last];
+        slot_indices[slots[index]] = index;
+    }
+
+    times.pop_back();
+    speeds.pop_back();
+    durations.pop_back();
+    flags.pop_back();
+    animation_ids.pop_back();
+    slots.pop_back();
+    entities.pop_back();
+    time_outputs.pop_back();
+}
+
+void Animator::animate(double dt, JobSystem& job_system) {
+    // Only a few operations per animation, so each job needs plenty to be worth splitting off
+    job_system.parallel_for(times.size(), 4096, [this, dt](size_t begin, size_t end) {
+        auto i = begin;
+#ifdef ANIMATOR_SSE2
+        // Two animations at a time, with every branch of the scalar version below done as a select between masks
+        auto select = [](__m128d mask, __m128d a, __m128d b) { return _mm_or_pd(_mm_and_pd(mask, a), _mm_andnot_pd(mask, b)); };
+        auto flag_mask = [this](size_t i, uint8_t flag) {
+            return _mm_castsi128_pd(_mm_set_epi64x((flags[i + 1] & flag) != 0 ? -1 : 0, (flags[i] & flag) != 0 ? -1 : 0));
+        };
+        auto step = _mm_set1_pd(dt);
+        for (; i + 2 <= end; i += 2) {
+            auto time = _mm_loadu_pd(&times[i]);
+            auto speed = _mm_andnot_pd(flag_mask(i, PAUSED), _mm_loadu_pd(&speeds[i]));
+            auto duration = _mm_loadu_pd(&durations[i]);
+            auto loops = _mm_and_pd(flag_mask(i, LOOP), _mm_cmpgt_pd(duration, _mm_setzero_pd()));
+
+            auto advanced = _mm_add_pd(time, _mm_mul_pd(step, speed));
+            // Truncating is flooring, since times are never negative
+            auto wraps = _mm_cvtepi32_pd(_mm_cvttpd_epi32(_mm_div_pd(advanced, duration)));
+            auto wrapped = _mm_sub_pd(advanced, _mm_mul_pd(duration, wraps));
+            auto past_end = _mm_cmpgt_pd(advanced, duration);
+            _mm_storeu_pd(&times[i], select(past_end, select(loops, wrapped, duration), advanced));
+        }
+#endif
+        for (; i < end; ++i) {
+            auto time = times[i] + dt * ((flags[i] & PAUSED) != 0 ? 0.0 : speeds[i]);
+            if (time > durations[i]) {
+                // As fmod would, but matching the SSE2 version
+                time = (flags[i] & LOOP) != 0 && durations[i] > 0.0 ? time - durations[i] * std::floor(time / durations[i]) : durations[i];
             }
+            times[i] = time;
+        }
+
+        for (i = begin; i < end; ++i) {
+            *time_outputs[i] = times[i];
+        }
+    });
+
+    // Backwards, so that each state moved into a removed one's place has already been checked
+    for (auto i = (uint) times.size(); i-- > 0;) {
+        bool loops = (flags[i] & LOOP) != 0 && durations[i] > 0.0;
+        if ((flags[i] & PAUSED) == 0 && !loops && times[i] >= durations[i]) {
+            remove(i);
         }
     }
+}
+
+void Animator::start(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters) {
+    stop(animated_entity);
+    animated_entity->get_animation_time_seconds() = 0.0;
+    add(animated_entity, animation_parameters);
+}
+
+void Animator::update_param(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters) {
+    if (auto index = find(animated_entity)) {
+        set_parameters(*index, animation_parameters);
+    }
+}
+
+void Animator::pause(const std::shared_ptr<AnimatedEntityInterface>& animated_entity) {
+    if (auto index = find(animated_entity)) {
+        flags[*index] |= PAUSED;
+    }
+}
 
-    for (const auto& item: to_remove) {
-        animated_entities.erase(item);
+void Animator::resume(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters) {
+    auto resumed = animation_parameters;
+    resumed.paused = false;
+    if (auto index = find(animated_entity)) {
+        set_parameters(*index, resumed);
+    } else {
+        add(animated_entity, resumed);
     }
 }
+
+void Animator::seek(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, double time_seconds) {
+    animated_entity->get_animation_time_seconds() = time_seconds;
+    if (auto index = find(animated_entity)) {
+        times[*index] = time_seconds;
+    }
+}
+
+std::optional<AnimationParameters> Animator::is_animating(const std::shared_ptr<AnimatedEntityInterface>& animated_entity) const {
+    auto index = find(animated_entity);
+    if (!index.has_value()) return std::nullopt;
+    return AnimationParameters{animation_ids[*index], (flags[*index] & LOOP) != 0, (flags[*index] & PAUSED) != 0, speeds[*index]};
+}
+
+void Animator::stop(const std::shared_ptr<AnimatedEntityInterface>& animated_entity) {
+    animated_entity->get_animation_id() = NONE_ANIMATION;
+    animated_entity->get_animation_time_seconds() = 0.0;
+    if (auto index = find(animated_entity)) {
+        remove(*index);
+    }
+}
+
+size_t Animator::size() const {
+    return times.size();
+}
@@ -1,9 +1,13 @@
 #ifndef ANIMATOR_H
 #define ANIMATOR_H
 
-#include <unordered_map>
+#include <vector>
+#include <memory>
+#include <cstdint>
+#include <optional>
 
 #include "rendering/scene/RenderedEntity.h"
+#include "utility/JobSystem.h"
 
 struct AnimationParameters {
     uint animation_id = NONE_ANIMATION;
@@ -13,96 +17,74 @@ struct AnimationParameters {
 };
 
 /// A class for controlling the animation for a set of animatable entities
+///
+/// The state of each animation is kept in packed arrays, one per field, so that advancing every clock each frame is a single loop over contiguous memory
+/// (done two at a time with SSE2, where available) with no lookups or virtual calls. The states are found through AnimationHandles (kept by each entity) in a slot map,
+/// so that stopping an animation can move the last state into its place (swap and pop) while every other handle stays valid.
+///
+/// The entity's animation_id belongs to whoever owns the entity (e.g. the SceneElement), the Animator only sets it when it starts animating the entity
+/// (start, or resume when not already animating) and clears it on stop. The duration of the entity's current animation is read from the entity
+/// whenever the parameters are set (start, update_param and resume), not each frame, so after changing the entity's model or animation_id
+/// the owner must call update_param, or stop it.
 class Animator {
-    std::unordered_map<std::shared_ptr<AnimatedEntityInterface>, AnimationParameters> animated_entities{};
+    enum Flags : uint8_t {
+        LOOP = 1 << 0,
+        PAUSED = 1 << 1,
+    };
+
+    // [slot] -> index into the packed arrays, for the handle with the slot's generation
+    std::vector<uint> slot_indices{};
+    // [slot] -> incremented each time the slot is freed, so old handles to it no longer match
+    std::vector<uint> slot_generations{};
+    std::vector<uint> free_slots{};
+
+    // Packed arrays, all the same length, [index] -> state of the animation
+    std::vector<double> times{};
+    std::vector<double> speeds{};
+    std::vector<double> durations{};
+    std::vector<uint8_t> flags{};
+    std::vector<uint> animation_ids{};
+    std::vector<uint> slots{};
+    std::vector<std::shared_ptr<AnimatedEntityInterface>> entities{};
+    // The entity's get_animation_time_seconds(), which the times are copied out to
+    std::vector<double*> time_outputs{};
+
+    /// The index of the entity's state, or nullopt if this isn't animating it
+    [[nodiscard]] std::optional<uint> find(const std::shared_ptr<AnimatedEntityInterface>& animated_entity) const;
+    /// Add a state for the entity, which must not already have one, at time 0
+    void add(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters);
+    void set_parameters(uint index, const AnimationParameters& animation_parameters);
+    /// Remove the state at index, moving the last state into its place
+    void remove(uint index);
 public:
-    /// Animated each playing entity, incrementing time by dt.
-    void animate(double dt);
+    /// Animated each playing entity, incrementing time by dt, with the entities split across the job_system's threads.
+    void animate(double dt, JobSystem& job_system);
 
     /// Start animating an entity with the given parameters. If it was already present then reset to t=0 and use new parameters.
-    template<class AnimatedEntity>
-    void start(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters);
+    void start(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters);
 
-    /// Update the parameters on an animating entity with the given parameters.
-    /// If it was not already present then nothing happens.
-    template<class AnimatedEntity>
-    void update_param(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters);
+    /// Update the parameters on an animating entity with the given parameters, re-reading the duration of the entity's current animation.
+    /// This doesn't change the entity's animation_id. If it was not already present then nothing happens.
+    void update_param(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters);
 
     /// Pause an animating entity if it's currently play
-    template<class AnimatedEntity>
-    void pause(std::shared_ptr<AnimatedEntity> animated_entity);
+    void pause(const std::shared_ptr<AnimatedEntityInterface>& animated_entity);
 
     /// Resumes a paused entity, also updating the animation parameters.
-    /// If the entity is not currently present, then start animating it with these parameters at t=0
-    template<class AnimatedEntity>
-    void resume(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters);
+    /// If the entity is not currently present, then start animating it with these parameters from its current time
+    void resume(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, const AnimationParameters& animation_parameters);
+
+    /// Move an entity to the given time, whether or not it is animating
+    void seek(const std::shared_ptr<AnimatedEntityInterface>& animated_entity, double time_seconds);
 
     /// Checks if an entity is currently animating, if so returns it's current parameters.
-    template<class AnimatedEntity>
-    std::optional<AnimationParameters> is_animating(const std::shared_ptr<AnimatedEntity>& animated_entity);
+    [[nodiscard]] std::optional<AnimationParameters> is_animating(const std::shared_ptr<AnimatedEntityInterface>& animated_entity) const;
 
     /// Stop an entity from animationg, does nothing it it was already stopped.
-    template<class AnimatedEntity>
-    void stop(const std::shared_ptr<AnimatedEntity>& animated_entity);
-};
+    void stop(const std::shared_ptr<AnimatedEntityInterface>& animated_entity);
 
-template<class AnimatedEntity>
-void Animator::start(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters) {
-    stop(animated_entity);
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    aei->get_animation_id() = animation_parameters.animation_id;
-    aei->get_animation_time_seconds() = 0.0;
-    animated_entities[aei] = animation_parameters;
-}
-
-template<class AnimatedEntity>
-void Animator::update_param(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        param->second = animation_parameters;
-    }
-}
-
-template<class AnimatedEntity>
-void Animator::pause(std::shared_ptr<AnimatedEntity> animated_entity) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        param->second.paused = true;
-    }
-}
-
-template<class AnimatedEntity>
-void Animator::resume(std::shared_ptr<AnimatedEntity> animated_entity, AnimationParameters animation_parameters) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        param->second = animation_parameters;
-        param->second.paused = false;
-    } else {
-        aei->get_animation_id() = animation_parameters.animation_id;
-        animated_entities[aei] = animation_parameters;
-    }
-}
-
-template<class AnimatedEntity>
-std::optional<AnimationParameters> Animator::is_animating(const std::shared_ptr<AnimatedEntity>& animated_entity) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    auto param = animated_entities.find(aei);
-    if (param != animated_entities.end()) {
-        return param->second;
-    } else {
-        return std::nullopt;
-    }
-}
-
-template<class AnimatedEntity>
-void Animator::stop(const std::shared_ptr<AnimatedEntity>& animated_entity) {
-    auto aei = std::dynamic_pointer_cast<AnimatedEntityInterface>(animated_entity);
-    aei->get_animation_id() = NONE_ANIMATION;
-    aei->get_animation_time_seconds() = 0.0;
-    animated_entities.erase(aei);
-}
+    /// The number of entities animating, paused or not
+    [[nodiscard]] size_t size() const;
+};
 
 #endif //ANIMATOR_H
@@ -12,6 +12,8 @@ struct RenderedEntity {
     std::shared_ptr<ModelHandle<VertexData>> model;
     InstanceData instance_data;
     RenderData render_data;
+    // The level of detail the entity was last drawn at, so it can be kept there until clearly past a threshold, see LodSelector
+    uint lod = 0;
 
     RenderedEntity(const std::shared_ptr<ModelHandle<VertexData>>& model, InstanceData instance_data, RenderData render_data);
 
@@ -26,8 +28,18 @@ std::shared_ptr<RenderedEntity<VertexData, InstanceData, RenderData>> RenderedEn
     return std::make_shared<RenderedEntity<VertexData, InstanceData, RenderData>>(model_handle, instance_data, render_data);
 }
 
+/// Refers to an entity's animation state within an Animator, staying valid (and referring to the same state) until the animation stops,
+/// however the Animator moves its states around, see Animator
+struct AnimationHandle {
+    uint index = UINT_MAX;
+    uint generation = 0;
+};
+
 /// A base class for type-erased AnimatedEntity stuff.
 struct AnimatedEntityInterface {
+    // Where the entity's animation state is, in the Animator playing it
+    AnimationHandle animation_handle{};
+
     // [animation_id] -> (animation_name, ticks_per_second, duration_ticks)
     [[nodiscard]] virtual const std::vector<std::tuple<std::string, double, double>>& get_animations() const = 0;
     [[nodiscard]] virtual uint& get_animation_id() = 0;
@@ -46,6 +58,12 @@ struct AnimatedRenderedEntity : public AnimatedEntityInterface {
     // Animation Data
     uint animation_id = NONE_ANIMATION; // NONE_ANIMATION means disabled
     double animation_time_seconds = 0.0;
+    // Where each of the hierarchy's animation channels last found its keys, so playing forwards doesn't search them again
+    std::vector<AnimationData::Cursor> animation_cursors{};
+    // This entity's own pose, only evaluated when no other entity already has the same one, see PoseEvaluator
+    Pose pose{};
+    // The pose to draw the entity with, either its own or an identical one belonging to another entity
+    const Pose* drawn_pose = nullptr;
 
     AnimatedRenderedEntity(const std::shared_ptr<MeshHierarchy<VertexData>>& mesh_hierarchy, InstanceData instance_data, RenderData render_data);
 
@@ -0,0 +1,206 @@
+#include "AssetPreloader.h"
+
+#include <thread>
+#include <chrono>
+#include <iostream>
+#include <filesystem>
+
+#include "rendering/renders/EntityRenderer.h"
+#include "rendering/renders/AnimatedEntityRenderer.h"
+#include "rendering/renders/EmissiveEntityRenderer.h"
+#include "scene/editor_scene/EntityElement.h"
+#include "scene/editor_scene/AnimatedEntityElement.h"
+#include "scene/editor_scene/EmissiveEntityElement.h"
+#include "scene/editor_scene/PointLightElement.h"
+#include "scene/editor_scene/DirectionalLightElement.h"
+
+AssetPreloader::AssetPreloader(ModelLoader& model_loader, TextureLoader& texture_loader) : model_loader(model_loader), texture_loader(texture_loader) {}
+
+void AssetPreloader::add_texture(const std::string& file, bool srgb, bool flip_vertical) {
+    if (!requested.insert(Formatter() << "texture:" << srgb << flip_vertical << ":" << file).second) return;
+
+    requests.push_back({
+        [file, srgb, flip_vertical](ModelLoader&, TextureLoader& textures) -> std::function<bool()> {
+            auto texture = textures.load_from_file_async(file, srgb, flip_vertical);
+            return [texture]() { return texture->is_ready(); };
+        },
+        [file, srgb, flip_vertical](ModelLoader&, TextureLoader& textures) -> std::shared_ptr<const void> {
+            return textures.load_from_file(file, srgb, flip_vertical);
+        }
+    });
+}
+
+void AssetPreloader::add_from_scene_json(const json& scene) {
+    for (const auto& element: scene) {
+        add_element_json(element);
+    }
+}
+
+void AssetPreloader::add_element_json(const json& element) {
+    if (element.contains("error")) return;
+
+    // Mirrors the models and textures that each element's new_default() and from_json() load
+    std::string label = element["label"];
+    if (label == EditorScene::EntityElement::ELEMENT_TYPE_NAME) {
+        add_model<EntityRenderer::VertexData>("cube.obj");
+        add_model<EntityRenderer::VertexData>(element["model"]);
+        add_texture_json(element["diffuse_texture"]);
+        add_texture_json(element["specular_map_texture"]);
+    } else if (label == EditorScene::AnimatedEntityElement::ELEMENT_TYPE_NAME) {
+        add_hierarchy<AnimatedEntityRenderer::VertexData>("cube.obj");
+        add_hierarchy<AnimatedEntityRenderer::VertexData>(element["model"]);
+        add_texture_json(element["diffuse_texture"]);
+        add_texture_json(element["specular_map_texture"]);
+    } else if (label == EditorScene::EmissiveEntityElement::ELEMENT_TYPE_NAME) {
+        add_model<EmissiveEntityRenderer::VertexData>("cube.obj");
+        add_model<EmissiveEntityRenderer::VertexData>(element["model"]);
+        add_texture_json(element["emission_texture"]);
+    } else if (label == EditorScene::PointLightElement::ELEMENT_TYPE_NAME) {
+        add_model<EmissiveEntityRenderer::VertexData>("sphere.obj");
+    } else if (label == EditorScene::DirectionalLightElement::ELEMENT_TYPE_NAME) {
+        add_model<EmissiveEntityRenderer::VertexData>("arrow.obj");
+        add_model<EmissiveEntityRenderer::VertexData>("sphere.obj");
+    }
+
+    if (element.contains("children")) {
+        for (const auto& child: element["children"]) {
+            add_element_json(child);
+        }
+    }
+}
+
+void AssetPreloader::add_texture_json(const json& texture) {
+    if (texture.contains("error")) return;
+    add_texture(texture["filename"], texture["is_srgb"], texture["is_flipped"]);
+}
+
+void AssetPreloader::add_from_manifest(const json& manifest) {
+    if (manifest.contains("models")) {
+        for (const auto& file: manifest["models"]) add_model<EntityRenderer::VertexData>(file);
+    }
+    if (manifest.contains("emissive_models")) {
+        for (const auto& file: manifest["emissive_models"]) add_model<EmissiveEntityRenderer::VertexData>(file);
+    }
+    if (manifest.contains("animated_models")) {
+        for (const auto& file: manifest["animated_models"]) add_hierarchy<AnimatedEntityRenderer::VertexData>(file);
+    }
+    if (manifest.contains("textures")) {
+        for (const auto& texture: manifest["textures"]) add_texture_json(texture);
+    }
+}
+
+void AssetPreloader::start() {
+    start(model_loader, texture_loader);
+}
+
+void AssetPreloader::start(ModelLoader& models, TextureLoader& textures) {
+    polls.clear();
+    completed = 0;
+    for (const auto& request: requests) {
+        try {
+            polls.push_back(request.start_async(models, textures));
+        } catch (const std::exception& e) {
+            // Most likely a missing file, leave it for the scene to report when it is built
+            std::cerr << "Failed to preload asset:" << std::endl;
+            std::cerr << e.what() << std::endl;
+            polls.emplace_back();
+            completed++;
+        }
+    }
+}
+
+bool AssetPreloader::poll() {
+    for (auto& poll: polls) {
+        if (poll && poll()) {
+            // Keep the poll (and so the asset it references) alive, just stop checking it
+            loaded.push_back(std::make_shared<std::function<bool()>>(std::move(poll)));
+            poll = nullptr;
+            completed++;
+        }
+    }
+    return completed == polls.size();
+}
+
+void AssetPreloader::load_parallel() {
+    load_parallel(model_loader, texture_loader);
+}
+
+void AssetPreloader::load_parallel(ModelLoader& models, TextureLoader& textures) {
+    start(models, textures);
+    while (!poll()) {
+        models.update();
+        textures.update();
+        std::this_thread::yield();
+    }
+}
+
+void AssetPreloader::load_serial() {
+    load_serial(model_loader, texture_loader);
+}
+
+void AssetPreloader::load_serial(ModelLoader& models, TextureLoader& textures) {
+    polls.clear();
+    completed = 0;
+    for (const auto& request: requests) {
+        try {
+            loaded.push_back(request.load_sync(models, textures));
+        } catch (const std::exception& e) {
+            std::cerr << "Failed to preload asset:" << std::endl;
+            std::cerr << e.what() << std::endl;
+        }
+        polls.emplace_back();
+        completed++;
+    }
+}
+
+size_t AssetPreloader::get_total() const {
+    return requests.size();
+}
+
+size_t AssetPreloader::get_completed() const {
+    return completed;
+}
+
+float AssetPreloader::get_progress() const {
+    return requests.empty() ? 1.0f : (float) completed / (float) requests.size();
+}
+
+std::pair<double, double> AssetPreloader::benchmark() {
+    auto cache_path = std::filesystem::temp_directory_path() / "cits3003_open_benchmark";
+
+    auto time_pass = [this, &cache_path](bool parallel) {
+        // A fresh disk cache for each pass, rather than the second reading what the first wrote
+        std::filesystem::remove_all(cache_path);
+
+        double pass_ms;
+        {
+            // The scene's loaders are subscribed to the scene's file watcher for good, so the isolated ones get their own,
+            // along with their own residency, and are all destroyed (in reverse order) once the pass is done
+            FileWatcher file_watcher{{model_loader.get_import_path(), texture_loader.get_import_path()}};
+            ResidencyManager residency_manager{};
+            auto models = model_loader.create_isolated((cache_path / "models").string(), residency_manager, file_watcher);
+            auto textures = texture_loader.create_isolated((cache_path / "textures").string(), residency_manager, file_watcher);
+
+            auto pass_start = std::chrono::steady_clock::now();
+            if (parallel) {
+                load_parallel(*models, *textures);
+            } else {
+                load_serial(*models, *textures);
+            }
+            pass_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pass_start).count();
+
+            loaded.clear();
+            polls.clear();
+            residency_manager.cleanup();
+            textures->cleanup();
+            models->cleanup();
+        }
+
+        std::filesystem::remove_all(cache_path);
+        return pass_ms;
+    };
+
+    auto serial_ms = time_pass(false);
+    auto parallel_ms = time_pass(true);
+    return {serial_ms, parallel_ms};
+}
@@ -0,0 +1,112 @@
+#ifndef ASSET_PRELOADER_H
+#define ASSET_PRELOADER_H
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <functional>
+#include <unordered_set>
+
+#include "utility/JsonHelper.h"
+#include "rendering/resources/ModelLoader.h"
+#include "rendering/resources/TextureLoader.h"
+
+/// Collects the models and textures a scene needs, so that they can all be loaded in parallel up front
+/// (on the loaders' worker pools), after which the scene can be built from the warm in-memory caches.
+/// The preloader holds a reference to everything it loads, so it must be kept alive until the scene has been built.
+class AssetPreloader {
+    // Each given the loaders to load through, so that the same requests can be benchmarked on isolated ones
+    struct Request {
+        // Starts an asynchronous load, returning a poll which returns true once the load is finished with
+        std::function<std::function<bool()>(ModelLoader&, TextureLoader&)> start_async;
+        // Loads synchronously on the calling thread, returning the loaded asset
+        std::function<std::shared_ptr<const void>(ModelLoader&, TextureLoader&)> load_sync;
+    };
+
+    ModelLoader& model_loader;
+    TextureLoader& texture_loader;
+
+    std::vector<Request> requests{};
+    // Keys of everything requested so far, so nothing is loaded twice
+    std::unordered_set<std::string> requested{};
+
+    // [request_index] -> poll, reset once the load has finished
+    std::vector<std::function<bool()>> polls{};
+    std::vector<std::shared_ptr<const void>> loaded{};
+    size_t completed = 0;
+
+public:
+    AssetPreloader(ModelLoader& model_loader, TextureLoader& texture_loader);
+
+    template<typename VertexData>
+    void add_model(const std::string& file);
+    template<typename VertexData>
+    void add_hierarchy(const std::string& file);
+    void add_texture(const std::string& file, bool srgb, bool flip_vertical);
+
+    /// Add every asset referenced by an EditorScene json file (the top level array of labelled elements)
+    void add_from_scene_json(const json& scene);
+
+    /// Add every asset listed in a manifest of the form:
+    /// {"models": [file], "emissive_models": [file], "animated_models": [file], "textures": [{"filename", "is_srgb", "is_flipped"}]}
+    void add_from_manifest(const json& manifest);
+
+    /// Start loading every requested asset in parallel.
+    void start();
+    /// Check on the loads started by start(), returning true once all of them are finished.
+    /// The loaders must be updated each frame (as main does) for the loads to progress.
+    bool poll();
+    /// start(), then block until everything has loaded, updating the loaders while waiting.
+    void load_parallel();
+    /// Load every requested asset one after another on the calling thread, for comparison with load_parallel().
+    void load_serial();
+
+    [[nodiscard]] size_t get_total() const;
+    [[nodiscard]] size_t get_completed() const;
+    [[nodiscard]] float get_progress() const;
+
+    /// Time load_serial() against load_parallel() over the same assets, each on loaders isolated from the scene's (see ModelLoader::create_isolated)
+    /// with their own empty disk caches, so both are equally cold and the scene's loaders are left as they were.
+    /// Returns (serial_ms, parallel_ms).
+    std::pair<double, double> benchmark();
+
+private:
+    void start(ModelLoader& models, TextureLoader& textures);
+    void load_parallel(ModelLoader& models, TextureLoader& textures);
+    void load_serial(ModelLoader& models, TextureLoader& textures);
+
+    void add_element_json(const json& element);
+    void add_texture_json(const json& texture);
+};
+
+template<typename VertexData>
+void AssetPreloader::add_model(const std::string& file) {
+    if (!requested.insert(Formatter() << "model:" << typeid(VertexData).name() << ":" << file).second) return;
+
+    requests.push_back({
+        [file](ModelLoader& models, TextureLoader&) -> std::function<bool()> {
+            auto model = models.load_from_file_async<VertexData>(file);
+            return [model]() { return model->is_ready(); };
+        },
+        [file](ModelLoader& models, TextureLoader&) -> std::shared_ptr<const void> {
+            return models.load_from_file<VertexData>(file);
+        }
+    });
+}
+
+template<typename VertexData>
+void AssetPreloader::add_hierarchy(const std::string& file) {
+    if (!requested.insert(Formatter() << "hierarchy:" << typeid(VertexData).name() << ":" << file).second) return;
+
+    requests.push_back({
+        [file](ModelLoader& models, TextureLoader&) -> std::function<bool()> {
+            auto mesh_hierarchy = models.load_hierarchy_from_file_async<VertexData>(file);
+            return [mesh_hierarchy]() { return mesh_hierarchy.wait_for(std::chrono::seconds{0}) == std::future_status::ready; };
+        },
+        [file](ModelLoader& models, TextureLoader&) -> std::shared_ptr<const void> {
+            return models.load_hierarchy_from_file<VertexData>(file);
+        }
+    });
+}
+
+#endif //ASSET_PRELOADER_H
@@ -6,12 +6,25 @@
 #include "rendering/cameras/PanningCamera.h"
 #include "rendering/cameras/FlyingCamera.h"
 #include "scene/SceneContext.h"
+#include "scene/AssetPreloader.h"
 
 /// Nothing to do in the constructor
 BasicStaticScene::BasicStaticScene() = default;
 
 void BasicStaticScene::open(const SceneContext& scene_context) {
-    /// Load all the needed models and textures
+    /// Load all the needed models and textures in parallel, so the loads below are served from the in-memory caches
+    AssetPreloader preloader{scene_context.model_loader, scene_context.texture_loader};
+    preloader.add_model<EntityRenderer::VertexData>("double_plane.obj");
+    preloader.add_model<EntityRenderer::VertexData>("crate.obj");
+    preloader.add_model<EntityRenderer::VertexData>("sphere.obj");
+    preloader.add_model<EntityRenderer::VertexData>("cone.obj");
+    preloader.add_texture("crate.png", true, false);
+    preloader.add_texture("crate_specular.png", false, false);
+    preloader.add_texture("cone_diffuse.png", true, true);
+    preloader.add_texture("cone_specular.png", false, true);
+    preloader.add_texture("cone_retro_map.png", false, true);
+    preloader.load_parallel();
+
     auto plane = scene_context.model_loader.load_from_file<EntityRenderer::VertexData>("double_plane.obj");
     auto default_black_texture = scene_context.texture_loader.default_black_texture();
 
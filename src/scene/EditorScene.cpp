@@ -174,6 +174,15 @@ std::pair<TickResponseType, std::shared_ptr<SceneInterface>> EditorScene::Editor
         }
     }
 
+    /// If a scene file is being opened, then build it once all its assets have been loaded
+    if (pending_open.has_value() && pending_open->preloader->poll()) {
+        auto pending = std::move(pending_open.value());
+        pending_open.reset();
+        finish_load_from_json(scene_context, pending.path, pending.data);
+        last_open_ms = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - pending.start).count();
+        std::cout << "Opened scene [" << pending.path << "] with " << pending.preloader->get_total() << " assets in " << last_open_ms.value() << " ms" << std::endl;
+    }
+
     /// If ImGUI should be enabled, then add the two windows
     if (scene_context.imgui_enabled) {
         add_imgui_selection_editor(scene_context);
@@ -211,6 +220,7 @@ CameraInterface& EditorScene::EditorScene::get_camera() {
 
 void EditorScene::EditorScene::close(const SceneContext& /*scene_context*/) {
     // Free up memory by dropping handles
+    pending_open.reset();
     render_scene = {};
     scene_root->clear();
 }
@@ -457,9 +467,11 @@ void EditorScene::EditorScene::add_imgui_scene_hierarchy(const SceneContext& sce
         bool ctrl_is_pressed = scene_context.window.is_key_pressed(GLFW_KEY_LEFT_CONTROL) || scene_context.window.is_key_pressed(GLFW_KEY_RIGHT_CONTROL);
         bool shift_is_pressed = scene_context.window.is_key_pressed(GLFW_KEY_LEFT_SHIFT) || scene_context.window.is_key_pressed(GLFW_KEY_RIGHT_SHIFT);
 
-        if (ImGui::Button("Open (Ctrl + O)") || (scene_context.window.was_key_pressed(GLFW_KEY_O) && ctrl_is_pressed && !shift_is_pressed)) {
+        if (pending_open.has_value()) ImGui::BeginDisabled();
+        if (ImGui::Button("Open (Ctrl + O)") || (!pending_open.has_value() && scene_context.window.was_key_pressed(GLFW_KEY_O) && ctrl_is_pressed && !shift_is_pressed)) {
             load_from_json_file(scene_context);
         }
+        if (pending_open.has_value()) ImGui::EndDisabled();
 
         ImGui::SameLine();
 
@@ -479,6 +491,24 @@ void EditorScene::EditorScene::add_imgui_scene_hierarchy(const SceneContext& sce
             }
         }
 
+        if (pending_open.has_value()) {
+            const auto& preloader = *pending_open->preloader;
+            std::string progress_label = Formatter() << "Loading assets (" << preloader.get_completed() << "/" << preloader.get_total() << ")";
+            ImGui::ProgressBar(preloader.get_progress(), ImVec2(-1.0f, 0.0f), progress_label.c_str());
+        } else if (last_open_ms.has_value()) {
+            ImGui::Text("Last open: %.3f ms", last_open_ms.value());
+        }
+
+        if (!save_path.has_value() || pending_open.has_value()) ImGui::BeginDisabled();
+        if (ImGui::Button("Benchmark Open (Serial vs Parallel)")) {
+            benchmark_open(scene_context);
+        }
+        if (!save_path.has_value() || pending_open.has_value()) ImGui::EndDisabled();
+        if (open_benchmark_ms.has_value()) {
+            const auto& [serial_ms, parallel_ms] = open_benchmark_ms.value();
+            ImGui::Text("Serial: %.3f ms, Parallel: %.3f ms (%.2fx)", serial_ms, parallel_ms, parallel_ms > 0.0 ? serial_ms / parallel_ms : 0.0);
+        }
+
         if (save_path.has_value()) {
             ImGui::InputText("File Path", &save_path.value(), ImGuiInputTextFlags_ReadOnly);
             scene_context.window.set_title_suffix(Formatter() << "Open File: [" << save_path.value() << "]");
@@ -642,6 +672,26 @@ void EditorScene::EditorScene::load_from_json_file(const SceneContext& scene_con
 #endif
 
     if (path == nullptr) return;
+
+    try {
+        std::ifstream f(path);
+        json data = json::parse(f);
+
+        // Start loading every asset the scene uses in parallel, the scene is then built in tick() once they are all ready
+        auto preloader = std::make_unique<AssetPreloader>(scene_context.model_loader, scene_context.texture_loader);
+        preloader->add_from_scene_json(data);
+        preloader->start();
+        pending_open = PendingOpen{path, std::move(data), std::move(preloader), std::chrono::steady_clock::now()};
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to open file: [" << path << "]" << std::endl;
+        std::cerr << "Error:" << std::endl;
+        std::cerr << e.what() << std::endl;
+
+        tinyfd_messageBox("Failed to open File", "See Console For Error", "ok", "error", 1);
+    }
+}
+
+void EditorScene::EditorScene::finish_load_from_json(const SceneContext& scene_context, const std::string& path, const json& data) {
     auto old_path = save_path;
     save_path = path;
 
@@ -653,9 +703,6 @@ void EditorScene::EditorScene::load_from_json_file(const SceneContext& scene_con
     try {
         selected_element = NullElementRef;
 
-        std::ifstream f(save_path.value());
-        json data = json::parse(f);
-
         for (const auto& item: data) {
             add_labelled_json_element(scene_context, NullElementRef, scene_root, item);
         }
@@ -669,10 +716,28 @@ void EditorScene::EditorScene::load_from_json_file(const SceneContext& scene_con
         scene_root = old_scene_root;
         selected_element = old_selected_element;
 
-        std::cerr << "Failed to open file: [" << old_path.value() << "]" << std::endl;
+        std::cerr << "Failed to open file: [" << path << "]" << std::endl;
         std::cerr << "Error:" << std::endl;
         std::cerr << e.what() << std::endl;
 
         tinyfd_messageBox("Failed to open File", "See Console For Error", "ok", "error", 1);
     }
 }
+
+void EditorScene::EditorScene::benchmark_open(const SceneContext& scene_context) {
+    try {
+        std::ifstream f(save_path.value());
+        json data = json::parse(f);
+
+        AssetPreloader preloader{scene_context.model_loader, scene_context.texture_loader};
+        preloader.add_from_scene_json(data);
+        open_benchmark_ms = preloader.benchmark();
+
+        const auto& [serial_ms, parallel_ms] = open_benchmark_ms.value();
+        std::cout << "Open benchmark [" << save_path.value() << "] (" << preloader.get_total() << " assets): "
+                  << "serial " << serial_ms << " ms, parallel " << parallel_ms << " ms" << std::endl;
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to benchmark opening file: [" << save_path.value() << "]" << std::endl;
+        std::cerr << e.what() << std::endl;
+    }
+}
@@ -4,11 +4,13 @@
 #include "SceneInterface.h"
 
 #include <list>
+#include <chrono>
 #include <memory>
 #include <utility>
 
 #include "editor_scene/SceneElement.h"
 #include "scene/SceneContext.h"
+#include "scene/AssetPreloader.h"
 
 /// A namespace for all the things related to the EditorScene, since it's rather complicated
 namespace EditorScene {
@@ -46,6 +48,18 @@ namespace EditorScene {
         /// The current save path
         std::optional<std::string> save_path{};
 
+        /// A scene file that is being opened, which is waiting on its assets to preload before its elements are built
+        struct PendingOpen {
+            std::string path;
+            json data;
+            std::unique_ptr<AssetPreloader> preloader;
+            std::chrono::steady_clock::time_point start;
+        };
+        std::optional<PendingOpen> pending_open{};
+        /// Timings of the last open, and the last serial vs parallel open comparison
+        std::optional<double> last_open_ms{};
+        std::optional<std::pair<double, double>> open_benchmark_ms{};
+
         // The RenderScene of the Scene
         MasterRenderScene render_scene{};
     public:
@@ -80,6 +94,10 @@ namespace EditorScene {
         /// Main save/load calls, which use the current save_path or pop-up a native file dialog
         void save_to_json_file();
         void load_from_json_file(const SceneContext& scene_context);
+        /// Build the scene from json, once its assets have been preloaded
+        void finish_load_from_json(const SceneContext& scene_context, const std::string& path, const json& data);
+        /// Time opening the current save_path's assets serially vs in parallel
+        void benchmark_open(const SceneContext& scene_context);
     };
 }
 
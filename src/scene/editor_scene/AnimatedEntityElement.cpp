@@ -88,8 +88,9 @@ void EditorScene::AnimatedEntityElement::add_imgui_edit_section(MasterRenderScen
 
     ImGui::Text("Model & Textures");
     if (scene_context.model_loader.add_imgui_hierarchy_selector("Model Selection", rendered_entity->mesh_hierarchy)) {
+        // The new model's animations differ, and the Animator only reads the clip's duration when its parameters are set, so the old one can't keep playing
+        render_scene.animator.stop(rendered_entity);
         animation_parameters.animation_id = NONE_ANIMATION;
-        rendered_entity->animation_time_seconds = 0.0;
     }
     scene_context.texture_loader.add_imgui_texture_selector("Diffuse Texture", rendered_entity->render_data.diffuse_texture);
     scene_context.texture_loader.add_imgui_texture_selector("Specular Map", rendered_entity->render_data.specular_map_texture, false);
@@ -38,7 +38,7 @@ std::unique_ptr<EditorScene::EmissiveEntityElement> EditorScene::EmissiveEntityE
     new_entity->update_local_transform_from_json(j);
     new_entity->update_emissive_material_from_json(j);
 
-    new_entity->rendered_entity->model = scene_context.model_loader.load_from_file<EmissiveEntityRenderer::VertexData>(j["model"]);
+    new_entity->rendered_entity->model = scene_context.model_loader.load_from_file_async<EmissiveEntityRenderer::VertexData>(j["model"]);
     new_entity->rendered_entity->render_data.emission_texture = texture_from_json(scene_context, j["emission_texture"]);
 
     new_entity->update_instance_data();
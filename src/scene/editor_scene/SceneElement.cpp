@@ -35,7 +35,7 @@ std::shared_ptr<TextureHandle> EditorScene::SceneElement::texture_from_json(cons
         return scene_context.texture_loader.default_white_texture();
     }
 
-    return scene_context.texture_loader.load_from_file(json["filename"], json["is_srgb"], json["is_flipped"]);
+    return scene_context.texture_loader.load_from_file_async(json["filename"], json["is_srgb"], json["is_flipped"]);
 }
 
 void EditorScene::LocalTransformComponent::add_local_transform_imgui_edit_section(MasterRenderScene& /*render_scene*/, const SceneContext& scene_context) {
@@ -265,7 +265,8 @@ void EditorScene::AnimationComponent::add_animation_imgui_edit_section(MasterRen
         auto float_time = (float) entity->get_animation_time_seconds();
         auto float_duration = (float) (duration_ticks / ticks_per_second);
         if (ImGui::SliderFloat("Animation Time (sec)", &float_time, 0.0f, float_duration, "%.3f", ImGuiSliderFlags_NoRoundToFormat)) {
-            entity->get_animation_time_seconds() = float_time;
+            // Through the animator, which keeps its own copy of the time of the entities it is animating
+            render_scene.animator.seek(entity, float_time);
         }
 
         bool is_playing = render_scene.animator.is_animating(entity).has_value();
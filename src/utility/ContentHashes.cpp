@@ -0,0 +1,40 @@
+#include "ContentHashes.h"
+
+#include "utility/Hash.h"
+
+uint64_t ContentHashes::hash_file(const std::filesystem::path& path, std::optional<MappedFile>* mapped) {
+    auto key = path.string();
+    auto size = std::filesystem::file_size(path);
+    auto last_write_time = std::filesystem::last_write_time(path);
+
+    {
+        std::lock_guard lock{mutex};
+        auto entry = entries.find(key);
+        if (entry != entries.end() && entry->second.size == size && entry->second.last_write_time == last_write_time) {
+            ++reused_hashes;
+            return entry->second.hash;
+        }
+    }
+
+    // Hashed outside the lock, so that other files can be hashed at the same time.
+    // Two threads may both hash the same new file, which is harmless since they agree on the result.
+    MappedFile file{key};
+    auto hash = Hash::xxh64(file.data(), file.size());
+    ++hashed_files;
+    hashed_bytes += file.size();
+
+    {
+        std::lock_guard lock{mutex};
+        entries[key] = {size, last_write_time, hash};
+    }
+
+    if (mapped != nullptr) {
+        *mapped = std::move(file);
+    }
+    return hash;
+}
+
+void ContentHashes::clear() {
+    std::lock_guard lock{mutex};
+    entries.clear();
+}
@@ -0,0 +1,47 @@
+#ifndef CONTENT_HASHES_H
+#define CONTENT_HASHES_H
+
+#include <mutex>
+#include <atomic>
+#include <string>
+#include <cstdint>
+#include <optional>
+#include <filesystem>
+#include <unordered_map>
+
+#include "utility/MappedFile.h"
+#include "utility/HelperTypes.h"
+
+/// Hashes of the contents of files (see Hash::xxh64), so that assets can be keyed on what they hold rather than where they are.
+///
+/// Each file's hash is remembered along with its size and last write time, so a file is only read again once it has changed.
+/// Thread safe, since it is used by loads running on worker threads.
+class ContentHashes : private NonCopyable {
+    struct Entry {
+        uintmax_t size;
+        std::filesystem::file_time_type last_write_time;
+        uint64_t hash;
+    };
+    std::mutex mutex{};
+    // { path } -> { size, last_write_time, hash }
+    std::unordered_map<std::string, Entry> entries{};
+
+    std::atomic<size_t> hashed_files = 0;
+    std::atomic<size_t> hashed_bytes = 0;
+    std::atomic<size_t> reused_hashes = 0;
+
+public:
+    /// The hash of the file's contents, throws if it can't be read.
+    /// If the file had to be read, and mapped is given, the mapping is handed back through it, so the caller can use the contents without reading them again.
+    uint64_t hash_file(const std::filesystem::path& path, std::optional<MappedFile>* mapped = nullptr);
+
+    /// Forget every hash, so that every file is read again
+    void clear();
+
+    /// The files (and bytes) read to hash them, and the times a remembered hash was used instead
+    [[nodiscard]] size_t get_hashed_files() const { return hashed_files; }
+    [[nodiscard]] size_t get_hashed_bytes() const { return hashed_bytes; }
+    [[nodiscard]] size_t get_reused_hashes() const { return reused_hashes; }
+};
+
+#endif //CONTENT_HASHES_H
@@ -0,0 +1,351 @@
+#include "FileWatcher.h"
+
+#include <algorithm>
+#include <iostream>
+
+#include <imgui/imgui.h>
+
+#ifdef __linux__
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+
+std::string to_string(FileWatcher::ChangeType change_type) {
+    switch (change_type) {
+        case FileWatcher::ChangeType::Created:
+            return "Created";
+        case FileWatcher::ChangeType::Modified:
+            return "Modified";
+        case FileWatcher::ChangeType::Removed:
+            return "Removed";
+    }
+    return "Unknown";
+}
+
+FileWatcher::FileWatcher(const std::vector<std::string>& watched_directories) {
+    for (const auto& directory: watched_directories) {
+        directories[directory];
+    }
+
+#ifdef __linux__
+    inotify_fd = inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+    wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (inotify_fd < 0 || wake_fd < 0) {
+        std::cerr << "Failed to start the file watcher, file changes will only be picked up on the next load" << std::endl;
+        if (inotify_fd >= 0) close(inotify_fd);
+        if (wake_fd >= 0) close(wake_fd);
+        inotify_fd = -1;
+        wake_fd = -1;
+        return;
+    }
+
+    {
+        std::lock_guard lock{mutex};
+        for (const auto& directory: watched_directories) {
+            add_watch(directory, "", false);
+        }
+    }
+    watch_thread = std::thread(&FileWatcher::watch_loop, this);
+#endif
+}
+
+bool FileWatcher::is_live() const {
+#ifdef __linux__
+    return inotify_fd >= 0;
+#else
+    return false;
+#endif
+}
+
+void FileWatcher::subscribe(const std::string& directory, Listener listener) {
+    std::lock_guard lock{mutex};
+    auto watched = directories.find(directory);
+    if (watched == directories.end()) {
+        throw std::runtime_error(Formatter() << "Can not subscribe to changes in " << directory << ", since it is not being watched");
+    }
+    watched->second.listeners.push_back(std::move(listener));
+}
+
+void FileWatcher::update() {
+    std::vector<std::pair<std::string, Change>> changes{};
+    {
+        std::lock_guard lock{mutex};
+        changes.swap(pending_changes);
+    }
+    if (changes.empty()) return;
+
+    // Editors often write a file in several steps, so merge every change to a file into one, in order of the first
+    std::vector<std::pair<std::string, Change>> merged{};
+    std::unordered_map<std::pair<std::string, std::string>, size_t, PairHash> merged_indices{};
+    for (auto& [directory, change]: changes) {
+        auto existing = merged_indices.find({directory, change.file});
+        if (existing == merged_indices.end()) {
+            merged_indices[{directory, change.file}] = merged.size();
+            merged.emplace_back(std::move(directory), std::move(change));
+            continue;
+        }
+
+        auto& merged_type = merged[existing->second].second.type;
+        if (merged_type == ChangeType::Created && change.type == ChangeType::Modified) {
+            // Still new to the listeners
+            continue;
+        }
+        // Removed then created again is just a modification, as far as the listeners are concerned
+        merged_type = merged_type == ChangeType::Removed && change.type == ChangeType::Created ? ChangeType::Modified : change.type;
+    }
+
+    for (const auto& [directory, change]: merged) {
+        std::vector<Listener> listeners{};
+        {
+            std::lock_guard lock{mutex};
+            listeners = directories.at(directory).listeners;
+        }
+        for (const auto& listener: listeners) {
+            listener(change);
+        }
+
+        dispatched_changes++;
+        recent_changes.emplace_front(directory, change);
+        if (recent_changes.size() > RECENT_CHANGES) recent_changes.pop_back();
+    }
+}
+
+std::optional<std::filesystem::file_time_type> FileWatcher::get_last_write_time(const std::string& directory, const std::string& file) const {
+    if (is_live()) {
+        std::lock_guard lock{mutex};
+        auto watched = directories.find(directory);
+        if (watched != directories.end()) {
+            auto indexed = watched->second.files.find(file);
+            if (indexed != watched->second.files.end()) return indexed->second;
+        }
+    }
+    // Not indexed (or its creation hasn't been seen yet), so ask the filesystem
+    return query_last_write_time(directory + "/" + file);
+}
+
+std::vector<std::string> FileWatcher::list_files(const std::string& directory) const {
+    std::vector<std::string> files{};
+
+    bool indexed = false;
+    if (is_live()) {
+        std::lock_guard lock{mutex};
+        auto watched = directories.find(directory);
+        if (watched != directories.end()) {
+            indexed = true;
+            files.reserve(watched->second.files.size());
+            for (const auto& [file, last_write_time]: watched->second.files) {
+                files.push_back(file);
+            }
+        }
+    }
+
+    if (!indexed) {
+        std::error_code error;
+        for (const auto& entry: std::filesystem::recursive_directory_iterator(directory, error)) {
+            if (entry.is_regular_file(error)) {
+                files.push_back(std::filesystem::relative(entry.path(), directory).string());
+            }
+        }
+    }
+
+    std::sort(files.begin(), files.end());
+    return files;
+}
+
+std::optional<std::filesystem::file_time_type> FileWatcher::query_last_write_time(const std::string& path) {
+    std::error_code error;
+    auto last_write_time = std::filesystem::last_write_time(path, error);
+    if (error || !std::filesystem::is_regular_file(path, error)) return std::nullopt;
+    return last_write_time;
+}
+
+void FileWatcher::add_imgui_options_section() {
+    if (ImGui::CollapsingHeader("File Watcher")) {
+        if (is_live()) {
+            ImGui::Text("Watching for changes");
+        } else {
+            ImGui::Text("Not watching, changes are picked up on the next load");
+        }
+
+        {
+            std::lock_guard lock{mutex};
+            for (const auto& [directory, watched]: directories) {
+                ImGui::Text("%s: %u files indexed", directory.c_str(), (uint) watched.files.size());
+            }
+        }
+
+        ImGui::Text("Changes dispatched: %u", dispatched_changes);
+        if (!recent_changes.empty() && ImGui::TreeNode("Recent Changes")) {
+            for (const auto& [directory, change]: recent_changes) {
+                ImGui::Text("%s: %s/%s", to_string(change.type).c_str(), directory.c_str(), change.file.c_str());
+            }
+            ImGui::TreePop();
+        }
+    }
+}
+
+#ifdef __linux__
+void FileWatcher::watch_loop() {
+    // Large enough for many events at once, aligned as the kernel writes inotify_event structs into it
+    alignas(inotify_event) char buffer[64 * 1024];
+
+    pollfd fds[2] = {{inotify_fd, POLLIN, 0}, {wake_fd, POLLIN, 0}};
+    while (true) {
+        if (poll(fds, 2, -1) < 0) {
+            if (errno == EINTR) continue;
+            std::cerr << "File watcher stopped, failed to poll for changes" << std::endl;
+            return;
+        }
+        if (fds[1].revents & POLLIN) return;
+        if (!(fds[0].revents & POLLIN)) continue;
+
+        auto length = read(inotify_fd, buffer, sizeof(buffer));
+        if (length <= 0) continue;
+
+        std::lock_guard lock{mutex};
+        for (auto offset = 0l; offset < length;) {
+            const auto* event = reinterpret_cast<const inotify_event*>(buffer + offset);
+            handle_event(event->wd, event->mask, event->len > 0 ? std::string{event->name} : std::string{});
+            offset += (long) (sizeof(inotify_event) + event->len);
+        }
+    }
+}
+
+void FileWatcher::add_watch(const std::string& directory, const std::string& sub_directory, bool report) {
+    auto path = sub_directory.empty() ? directory : directory + "/" + sub_directory;
+
+    // Watch before listing, so that nothing created in between is missed
+    auto watch_descriptor = inotify_add_watch(inotify_fd, path.c_str(), IN_CREATE | IN_CLOSE_WRITE | IN_ATTRIB | IN_DELETE | IN_MOVED_FROM | IN_MOVED_TO | IN_ONLYDIR);
+    if (watch_descriptor < 0) {
+        std::cerr << "Failed to watch directory for changes: " << path << std::endl;
+        return;
+    }
+    watches[watch_descriptor] = {directory, sub_directory};
+
+    auto& files = directories.at(directory).files;
+    std::error_code error;
+    for (const auto& entry: std::filesystem::directory_iterator(path, error)) {
+        auto name = entry.path().filename().string();
+        auto file = sub_directory.empty() ? name : sub_directory + "/" + name;
+
+        if (entry.is_directory(error)) {
+            add_watch(directory, file, report);
+        } else if (entry.is_regular_file(error)) {
+            auto last_write_time = entry.last_write_time(error);
+            if (error) continue;
+            auto created = files.count(file) == 0;
+            files[file] = last_write_time;
+            if (report && created) pending_changes.emplace_back(directory, Change{ChangeType::Created, file});
+        }
+    }
+}
+
+void FileWatcher::handle_event(int watch_descriptor, uint32_t mask, const std::string& name) {
+    if (mask & IN_Q_OVERFLOW) {
+        // Events were dropped, so re-index everything and report the differences
+        std::cerr << "File watcher event queue overflowed, re-indexing" << std::endl;
+        for (const auto& [descriptor, watch]: watches) {
+            inotify_rm_watch(inotify_fd, descriptor);
+        }
+        watches.clear();
+
+        for (auto& [directory, watched]: directories) {
+            auto previous_files = std::move(watched.files);
+            watched.files.clear();
+            add_watch(directory, "", false);
+
+            for (const auto& [file, last_write_time]: watched.files) {
+                auto previous = previous_files.find(file);
+                if (previous == previous_files.end()) {
+                    pending_changes.emplace_back(directory, Change{ChangeType::Created, file});
+                } else if (previous->second != last_write_time) {
+                    pending_changes.emplace_back(directory, Change{ChangeType::Modified, file});
+                }
+            }
+            for (const auto& [file, last_write_time]: previous_files) {
+                if (watched.files.count(file) == 0) pending_changes.emplace_back(directory, Change{ChangeType::Removed, file});
+            }
+        }
+        return;
+    }
+
+    auto watch = watches.find(watch_descriptor);
+    if (watch == watches.end()) return;
+    if (mask & IN_IGNORED) {
+        // The directory was removed (or moved away), so the watch is gone
+        watches.erase(watch);
+        return;
+    }
+    if (name.empty()) return;
+
+    // Copied, since adding or removing watches below can invalidate watch
+    auto [directory, sub_directory] = watch->second;
+    auto file = sub_directory.empty() ? name : sub_directory + "/" + name;
+    auto& files = directories.at(directory).files;
+
+    if (mask & IN_ISDIR) {
+        if (mask & (IN_CREATE | IN_MOVED_TO)) {
+            add_watch(directory, file, true);
+        } else if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+            auto prefix = file + "/";
+            for (auto it = files.begin(); it != files.end();) {
+                if (it->first.compare(0, prefix.size(), prefix) == 0) {
+                    pending_changes.emplace_back(directory, Change{ChangeType::Removed, it->first});
+                    it = files.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+            // A moved directory keeps its watches, which would report changes under the old name
+            for (auto it = watches.begin(); it != watches.end();) {
+                const auto& [watch_directory, watch_sub_directory] = it->second;
+                if (watch_directory == directory && (watch_sub_directory == file || watch_sub_directory.compare(0, prefix.size(), prefix) == 0)) {
+                    inotify_rm_watch(inotify_fd, it->first);
+                    it = watches.erase(it);
+                } else {
+                    ++it;
+                }
+            }
+        }
+        return;
+    }
+
+    if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+        if (files.erase(file) != 0) pending_changes.emplace_back(directory, Change{ChangeType::Removed, file});
+        return;
+    }
+
+    // IN_CREATE, IN_CLOSE_WRITE, IN_MOVED_TO or IN_ATTRIB
+    auto last_write_time = query_last_write_time(directory + "/" + file);
+    // Already gone again, its removal will follow
+    if (!last_write_time.has_value()) return;
+
+    auto existing = files.find(file);
+    if (existing == files.end()) {
+        files[file] = last_write_time.value();
+        pending_changes.emplace_back(directory, Change{ChangeType::Created, file});
+        return;
+    }
+    // Only the metadata changed (eg. permissions), not the contents
+    if ((mask & IN_ATTRIB) && existing->second == last_write_time.value()) return;
+
+    existing->second = last_write_time.value();
+    pending_changes.emplace_back(directory, Change{ChangeType::Modified, file});
+}
+#endif
+
+FileWatcher::~FileWatcher() {
+#ifdef __linux__
+    if (watch_thread.joinable()) {
+        uint64_t wake = 1;
+        if (write(wake_fd, &wake, sizeof(wake)) < 0) {
+            std::cerr << "Failed to wake the file watcher thread" << std::endl;
+        }
+        watch_thread.join();
+    }
+    if (inotify_fd >= 0) close(inotify_fd);
+    if (wake_fd >= 0) close(wake_fd);
+#endif
+}
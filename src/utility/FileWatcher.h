@@ -0,0 +1,104 @@
+#ifndef FILE_WATCHER_H
+#define FILE_WATCHER_H
+
+#include <map>
+#include <mutex>
+#include <deque>
+#include <string>
+#include <thread>
+#include <vector>
+#include <optional>
+#include <filesystem>
+#include <functional>
+#include <unordered_map>
+
+#include "utility/HelperTypes.h"
+
+/// Watches directories of asset files (recursively) on a background thread, keeping an in-memory index of every file and its last write time.
+/// Loaders look files up in the index rather than asking the filesystem on every load,
+/// and subscribe to be told when files are created, modified or removed, so they can hot reload them.
+/// Watching uses inotify, so is only live on Linux. Elsewhere lookups fall back to the filesystem and no changes are reported.
+class FileWatcher : private NonCopyable {
+public:
+    enum class ChangeType {
+        Created,
+        Modified,
+        Removed,
+    };
+
+    struct Change {
+        ChangeType type;
+        // Relative to the watched directory, in the same form as the file names passed to the loaders
+        std::string file;
+    };
+
+    using Listener = std::function<void(const Change&)>;
+
+    static constexpr size_t RECENT_CHANGES = 8;
+private:
+    struct WatchedDirectory {
+        // { file } -> { last write time }
+        std::unordered_map<std::string, std::filesystem::file_time_type> files{};
+        std::vector<Listener> listeners{};
+    };
+
+    // Guards directories and pending_changes, which the watch thread updates
+    mutable std::mutex mutex{};
+    // { directory } -> { index and listeners }
+    std::map<std::string, WatchedDirectory> directories{};
+    // (directory, change), waiting to be dispatched by update()
+    std::vector<std::pair<std::string, Change>> pending_changes{};
+
+    // Only touched by the main thread
+    uint dispatched_changes = 0;
+    std::deque<std::pair<std::string, Change>> recent_changes{};
+
+#ifdef __linux__
+    int inotify_fd = -1;
+    // Written to by the destructor to wake the watch thread so it can exit
+    int wake_fd = -1;
+    // { watch descriptor } -> (directory, sub-directory relative to it)
+    std::unordered_map<int, std::pair<std::string, std::string>> watches{};
+    std::thread watch_thread{};
+
+    void watch_loop();
+    /// Watch a sub-directory and everything under it, indexing the files found. Must be called with the mutex held.
+    /// If report is set, each of the files is reported as created.
+    void add_watch(const std::string& directory, const std::string& sub_directory, bool report);
+    /// Handle a single inotify event, must be called with the mutex held.
+    void handle_event(int watch_descriptor, uint32_t mask, const std::string& name);
+#endif
+
+    static std::optional<std::filesystem::file_time_type> query_last_write_time(const std::string& path);
+public:
+    /// Index and start watching each of the directories.
+    explicit FileWatcher(const std::vector<std::string>& watched_directories);
+
+    /// True if changes are being watched for, otherwise lookups go to the filesystem.
+    [[nodiscard]] bool is_live() const;
+
+    /// Call listener (from update()) for every change to a file under directory, which must be one of the watched directories.
+    /// Anything the listener references must outlive every later call to update().
+    void subscribe(const std::string& directory, Listener listener);
+
+    /// Dispatch any changes seen since the last update to the listeners, with repeated changes to a file merged into one.
+    /// Should be called once a frame, on the main thread.
+    void update();
+
+    /// The last write time of directory/file, or nullopt if the file doesn't exist.
+    /// For a watched directory, this is a lookup in the index.
+    [[nodiscard]] std::optional<std::filesystem::file_time_type> get_last_write_time(const std::string& directory, const std::string& file) const;
+
+    /// Every file under directory, relative to it and sorted.
+    /// For a watched directory, this comes from the index, otherwise it scans the directory.
+    [[nodiscard]] std::vector<std::string> list_files(const std::string& directory) const;
+
+    /// Adds the state of the watcher, and the most recent changes, to the current ImGUI window
+    void add_imgui_options_section();
+
+    ~FileWatcher();
+};
+
+std::string to_string(FileWatcher::ChangeType change_type);
+
+#endif //FILE_WATCHER_H
@@ -0,0 +1,109 @@
+#ifndef HASH_H
+#define HASH_H
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+#include <cstring>
+
+/// Small, stable (across runs and platforms) hash functions, for use in things like on-disk cache keys.
+/// Unlike std::hash, the values these produce are safe to persist.
+namespace Hash {
+    constexpr uint64_t FNV1A_OFFSET_BASIS = 0xcbf29ce484222325ull;
+    constexpr uint64_t FNV1A_PRIME = 0x100000001b3ull;
+
+    /// 64-bit FNV-1a, fine for short keys like file paths and type names.
+    inline uint64_t fnv1a(const void* data, size_t size, uint64_t hash = FNV1A_OFFSET_BASIS) {
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        for (size_t i = 0; i < size; ++i) {
+            hash ^= bytes[i];
+            hash *= FNV1A_PRIME;
+        }
+        return hash;
+    }
+
+    inline uint64_t fnv1a(const std::string& string, uint64_t hash = FNV1A_OFFSET_BASIS) {
+        return fnv1a(string.data(), string.size(), hash);
+    }
+
+    namespace detail {
+        constexpr uint64_t XXH_PRIME_1 = 0x9E3779B185EBCA87ull;
+        constexpr uint64_t XXH_PRIME_2 = 0xC2B2AE3D27D4EB4Full;
+        constexpr uint64_t XXH_PRIME_3 = 0x165667B19E3779F9ull;
+        constexpr uint64_t XXH_PRIME_4 = 0x85EBCA77C2B2CA63ull;
+        constexpr uint64_t XXH_PRIME_5 = 0x27D4EB2F165667C5ull;
+
+        inline uint64_t rotl(uint64_t value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+        // Assumes a little-endian host, as does the rest of the on-disk caching
+        template<typename T>
+        inline T read(const unsigned char* bytes) {
+            T value;
+            std::memcpy(&value, bytes, sizeof(T));
+            return value;
+        }
+
+        inline uint64_t xxh64_round(uint64_t accumulator, uint64_t input) {
+            return rotl(accumulator + input * XXH_PRIME_2, 31) * XXH_PRIME_1;
+        }
+
+        inline uint64_t xxh64_merge(uint64_t hash, uint64_t accumulator) {
+            return (hash ^ xxh64_round(0, accumulator)) * XXH_PRIME_1 + XXH_PRIME_4;
+        }
+    }
+
+    /// 64-bit xxHash (XXH64), for hashing whole files. Runs at several GB/s, so it is cheap next to reading the file in the first place.
+    inline uint64_t xxh64(const void* data, size_t size, uint64_t seed = 0) {
+        using namespace detail;
+        const auto* bytes = static_cast<const unsigned char*>(data);
+        const auto* end = bytes + size;
+
+        uint64_t hash;
+        if (size >= 32) {
+            // Four independent lanes over 32 byte stripes
+            uint64_t v1 = seed + XXH_PRIME_1 + XXH_PRIME_2;
+            uint64_t v2 = seed + XXH_PRIME_2;
+            uint64_t v3 = seed;
+            uint64_t v4 = seed - XXH_PRIME_1;
+            for (; end - bytes >= 32; bytes += 32) {
+                v1 = xxh64_round(v1, read<uint64_t>(bytes));
+                v2 = xxh64_round(v2, read<uint64_t>(bytes + 8));
+                v3 = xxh64_round(v3, read<uint64_t>(bytes + 16));
+                v4 = xxh64_round(v4, read<uint64_t>(bytes + 24));
+            }
+            hash = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+            hash = xxh64_merge(hash, v1);
+            hash = xxh64_merge(hash, v2);
+            hash = xxh64_merge(hash, v3);
+            hash = xxh64_merge(hash, v4);
+        } else {
+            hash = seed + XXH_PRIME_5;
+        }
+        hash += (uint64_t) size;
+
+        for (; end - bytes >= 8; bytes += 8) {
+            hash = rotl(hash ^ xxh64_round(0, read<uint64_t>(bytes)), 27) * XXH_PRIME_1 + XXH_PRIME_4;
+        }
+        if (end - bytes >= 4) {
+            hash = rotl(hash ^ (read<uint32_t>(bytes) * XXH_PRIME_1), 23) * XXH_PRIME_2 + XXH_PRIME_3;
+            bytes += 4;
+        }
+        for (; bytes < end; ++bytes) {
+            hash = rotl(hash ^ (*bytes * XXH_PRIME_5), 11) * XXH_PRIME_1;
+        }
+
+        hash ^= hash >> 33;
+        hash *= XXH_PRIME_2;
+        hash ^= hash >> 29;
+        hash *= XXH_PRIME_3;
+        hash ^= hash >> 32;
+        return hash;
+    }
+
+    /// Mix another value into a hash, for building keys out of several (already hashed) parts
+    inline uint64_t combine(uint64_t hash, uint64_t value) {
+        return fnv1a(&value, sizeof(value), hash);
+    }
+}
+
+#endif //HASH_H
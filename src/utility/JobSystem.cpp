@@ -0,0 +1,148 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+JobSystem::JobSystem(uint thread_count) {
+    thread_count = std::max(thread_count, 1u);
+    thread_limit = thread_count;
+    for (auto i = 0u; i < thread_count; ++i) {
+        queues.push_back(std::make_unique<JobQueue>());
+    }
+    workers.reserve(thread_count - 1);
+    for (auto i = 0u; i + 1 < thread_count; ++i) {
+        workers.emplace_back(&JobSystem::worker_loop, this, i);
+    }
+}
+
+uint JobSystem::default_thread_count() {
+    return std::max(std::thread::hardware_concurrency(), 1u);
+}
+
+void JobSystem::worker_loop(uint index) {
+    auto queue_index = index + 1;
+    uint64_t last_batch = 0;
+    while (true) {
+        {
+            std::unique_lock lock{mutex};
+            // Workers past the limit sit out the batch
+            work_condition.wait(lock, [this, queue_index, last_batch]() { return stopping || (batch != last_batch && queue_index < batch_threads); });
+            if (stopping) return;
+            last_batch = batch;
+        }
+        run_jobs(queue_index);
+    }
+}
+
+bool JobSystem::take_job(uint queue_index, Job& job) {
+    // So that a worker left over from a batch with a higher limit can't steal this one's jobs
+    auto threads = batch_threads.load();
+    if (queue_index >= threads) return false;
+
+    {
+        auto& own = *queues[queue_index];
+        std::lock_guard lock{own.mutex};
+        if (!own.jobs.empty()) {
+            job = own.jobs.front();
+            own.jobs.pop_front();
+            return true;
+        }
+    }
+
+    // Steal from the far end, which the owner reaches last
+    for (auto offset = 1u; offset < threads; ++offset) {
+        auto& other = *queues[(queue_index + offset) % threads];
+        std::lock_guard lock{other.mutex};
+        // Checked again under the queue's lock, since the limit is always set before the jobs it applies to are pushed
+        if (queue_index >= batch_threads) return false;
+        if (!other.jobs.empty()) {
+            job = other.jobs.back();
+            other.jobs.pop_back();
+            return true;
+        }
+    }
+    return false;
+}
+
+void JobSystem::run_jobs(uint queue_index) {
+    Job job{};
+    while (take_job(queue_index, job)) {
+        try {
+            (*job.function)(job.begin, job.end);
+        } catch (...) {
+            std::lock_guard lock{mutex};
+            if (!batch_error) batch_error = std::current_exception();
+        }
+
+        if (jobs_remaining.fetch_sub(1) == 1) {
+            // Under the lock, so the wakeup can't be missed between parallel_for checking and waiting
+            std::lock_guard lock{mutex};
+            done_condition.notify_all();
+        }
+    }
+}
+
+void JobSystem::parallel_for(size_t count, size_t min_per_job, const JobFunction& function) {
+    if (count == 0) return;
+
+    min_per_job = std::max<size_t>(min_per_job, 1);
+    auto threads = (uint) std::min<size_t>(thread_limit, (count + min_per_job - 1) / min_per_job);
+    if (threads <= 1) {
+        function(0, count);
+        return;
+    }
+    // A few jobs per thread, so that uneven jobs still balance out
+    auto job_count = std::min<size_t>(count, (size_t) threads * 4);
+
+    // Set before any job can be taken, since a worker still looking for jobs from the last batch may take them straight away,
+    // and so could throw before the batch even starts
+    {
+        std::lock_guard lock{mutex};
+        batch_threads = threads;
+        batch_error = nullptr;
+    }
+    jobs_remaining = job_count;
+    for (size_t job = 0; job < job_count; ++job) {
+        auto& queue = *queues[job % threads];
+        std::lock_guard lock{queue.mutex};
+        queue.jobs.push_back({count * job / job_count, count * (job + 1) / job_count, &function});
+    }
+
+    {
+        std::lock_guard lock{mutex};
+        ++batch;
+    }
+    work_condition.notify_all();
+
+    run_jobs(0);
+
+    std::exception_ptr error{};
+    {
+        std::unique_lock lock{mutex};
+        done_condition.wait(lock, [this]() { return jobs_remaining == 0; });
+        std::swap(error, batch_error);
+    }
+    if (error) std::rethrow_exception(error);
+}
+
+uint JobSystem::get_thread_count() const {
+    return (uint) queues.size();
+}
+
+void JobSystem::set_thread_limit(uint limit) {
+    thread_limit = std::clamp(limit, 1u, get_thread_count());
+}
+
+uint JobSystem::get_thread_limit() const {
+    return thread_limit;
+}
+
+JobSystem::~JobSystem() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    work_condition.notify_all();
+    for (auto& worker: workers) {
+        worker.join();
+    }
+}
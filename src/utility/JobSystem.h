@@ -0,0 +1,83 @@
+#ifndef JOB_SYSTEM_H
+#define JOB_SYSTEM_H
+
+#include <deque>
+#include <mutex>
+#include <atomic>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <cstdint>
+#include <exception>
+#include <functional>
+#include <condition_variable>
+
+#include "utility/HelperTypes.h"
+
+/// A pool of worker threads for splitting short, per-frame work (like animating entities) across every core, see parallel_for().
+/// Unlike ThreadPool, which queues long running blocking tasks, the calling thread works on the jobs too, and returns once they are all done.
+///
+/// Each thread has its own queue of jobs, working from the front of it, then stealing from the back of the others' once it is empty,
+/// so the threads stay busy even when some jobs take much longer than others.
+/// Note that no OpenGL calls can be made from the jobs, since the context is only current on the main thread.
+class JobSystem : private NonCopyable {
+    using JobFunction = std::function<void(size_t begin, size_t end)>;
+
+    struct Job {
+        size_t begin;
+        size_t end;
+        // Owned by the parallel_for call, which outlives its jobs
+        const JobFunction* function;
+    };
+
+    struct JobQueue {
+        std::mutex mutex{};
+        std::deque<Job> jobs{};
+    };
+
+    std::vector<std::thread> workers{};
+    // [0] is the calling thread's, [i + 1] is workers[i]'s
+    std::vector<std::unique_ptr<JobQueue>> queues{};
+
+    std::mutex mutex{};
+    std::condition_variable work_condition{};
+    std::condition_variable done_condition{};
+    bool stopping = false;
+    // Incremented for each parallel_for, so that the workers know there are new jobs
+    uint64_t batch = 0;
+    // How many of the queues (and so threads) the current batch uses, atomic since a worker still finishing the last batch checks it without the lock
+    std::atomic<uint> batch_threads{0};
+    std::atomic<size_t> jobs_remaining{0};
+    // The first exception a job of the current batch threw, rethrown by parallel_for
+    std::exception_ptr batch_error{};
+
+    uint thread_limit;
+
+    void worker_loop(uint index);
+    /// Run jobs, from the queue's own jobs then by stealing, until there are none left to take
+    void run_jobs(uint queue_index);
+    /// Take a job from the queue, or steal one from the others the batch uses. Threads past the batch's limit take none.
+    bool take_job(uint queue_index, Job& job);
+public:
+    /// Creates the system with thread_count threads, including the calling thread, by default one for each hardware thread
+    explicit JobSystem(uint thread_count = default_thread_count());
+
+    static uint default_thread_count();
+
+    /// Call function over [0, count), split into ranges of at least min_per_job, across up to get_thread_limit() threads.
+    /// Blocks until every range has been run, rethrowing the first exception any of them threw.
+    /// Must not be called from within a job.
+    void parallel_for(size_t count, size_t min_per_job, const JobFunction& function);
+
+    /// Including the calling thread
+    [[nodiscard]] uint get_thread_count() const;
+
+    /// Limit how many threads parallel_for uses, in [1, get_thread_count()], so that how the work scales can be measured
+    void set_thread_limit(uint limit);
+    [[nodiscard]] uint get_thread_limit() const;
+
+    /// Joins the workers, which must not have any jobs
+    ~JobSystem();
+};
+
+#endif //JOB_SYSTEM_H
@@ -0,0 +1,114 @@
+#include "MappedFile.h"
+
+#include <utility>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#endif
+
+MappedFile::MappedFile(const std::string& path) {
+#ifdef _WIN32
+    file_handle = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file_handle == INVALID_HANDLE_VALUE) {
+        file_handle = nullptr;
+        throw std::runtime_error(Formatter() << "Failed to open file for mapping: " << path);
+    }
+
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file_handle, &file_size)) {
+        close();
+        throw std::runtime_error(Formatter() << "Failed to get size of file: " << path);
+    }
+    mapped_size = (size_t) file_size.QuadPart;
+    // Zero sized files can not be mapped, but are still valid (and empty)
+    if (mapped_size == 0) return;
+
+    mapping_handle = CreateFileMappingA(file_handle, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (mapping_handle == nullptr) {
+        close();
+        throw std::runtime_error(Formatter() << "Failed to create file mapping: " << path);
+    }
+
+    mapped_data = static_cast<const std::byte*>(MapViewOfFile(mapping_handle, FILE_MAP_READ, 0, 0, 0));
+    if (mapped_data == nullptr) {
+        close();
+        throw std::runtime_error(Formatter() << "Failed to map view of file: " << path);
+    }
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) {
+        throw std::runtime_error(Formatter() << "Failed to open file for mapping: " << path);
+    }
+
+    struct stat file_stat{};
+    if (fstat(fd, &file_stat) != 0) {
+        ::close(fd);
+        throw std::runtime_error(Formatter() << "Failed to get size of file: " << path);
+    }
+    mapped_size = (size_t) file_stat.st_size;
+    // Zero sized files can not be mapped, but are still valid (and empty)
+    if (mapped_size == 0) {
+        ::close(fd);
+        return;
+    }
+
+    void* mapping = mmap(nullptr, mapped_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    // The mapping holds its own reference to the file, so the descriptor is no longer needed
+    ::close(fd);
+    if (mapping == MAP_FAILED) {
+        mapped_size = 0;
+        throw std::runtime_error(Formatter() << "Failed to map file: " << path);
+    }
+    mapped_data = static_cast<const std::byte*>(mapping);
+#endif
+}
+
+MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+}
+
+MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+        close();
+        std::swap(mapped_data, other.mapped_data);
+        std::swap(mapped_size, other.mapped_size);
+#ifdef _WIN32
+        std::swap(file_handle, other.file_handle);
+        std::swap(mapping_handle, other.mapping_handle);
+#endif
+    }
+    return *this;
+}
+
+const std::byte* MappedFile::data() const {
+    return mapped_data;
+}
+
+size_t MappedFile::size() const {
+    return mapped_size;
+}
+
+void MappedFile::close() {
+#ifdef _WIN32
+    if (mapped_data != nullptr) UnmapViewOfFile(mapped_data);
+    if (mapping_handle != nullptr) CloseHandle(mapping_handle);
+    if (file_handle != nullptr) CloseHandle(file_handle);
+    file_handle = nullptr;
+    mapping_handle = nullptr;
+#else
+    if (mapped_data != nullptr) munmap(const_cast<std::byte*>(mapped_data), mapped_size);
+#endif
+    mapped_data = nullptr;
+    mapped_size = 0;
+}
+
+MappedFile::~MappedFile() {
+    close();
+}
@@ -0,0 +1,36 @@
+#ifndef MAPPED_FILE_H
+#define MAPPED_FILE_H
+
+#include <string>
+#include <cstddef>
+
+#include "utility/HelperTypes.h"
+
+/// A read-only memory mapping of a whole file.
+/// The mapping is released when the MappedFile is destroyed, so any pointers into data() must not outlive it.
+class MappedFile : private NonCopyable {
+    const std::byte* mapped_data = nullptr;
+    size_t mapped_size = 0;
+#ifdef _WIN32
+    void* file_handle = nullptr;
+    void* mapping_handle = nullptr;
+#endif
+
+public:
+    MappedFile() = default;
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /// Map the file at path into memory, throws if the file can not be opened or mapped.
+    explicit MappedFile(const std::string& path);
+
+    [[nodiscard]] const std::byte* data() const;
+    [[nodiscard]] size_t size() const;
+
+    ~MappedFile();
+
+private:
+    void close();
+};
+
+#endif //MAPPED_FILE_H
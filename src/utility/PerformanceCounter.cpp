@@ -2,6 +2,7 @@
 
 #include "rendering/imgui/ImGuiManager.h"
 
+#include <chrono>
 #include <algorithm>
 
 PerformanceCounter::PerformanceCounter() {
@@ -18,6 +19,40 @@ float PerformanceCounter::values_getter(void* data, int idx) {
     return self->frame_times[(self->start_index + display_offset + idx) % self->FRAME_COUNT] * 1.0e3f;
 }
 
+void PerformanceCounter::time_stage(const std::string& name, const std::function<void()>& fn) {
+    auto start = std::chrono::steady_clock::now();
+    fn();
+    auto seconds = std::chrono::duration<float>(std::chrono::steady_clock::now() - start).count();
+
+    auto stage = std::find_if(stages.begin(), stages.end(), [&name](const Stage& stage) { return stage.name == name; });
+    if (stage == stages.end()) {
+        stages.push_back({name});
+        stage = stages.end() - 1;
+        stage->times.reserve(FRAME_COUNT);
+    }
+    if (stage->times.size() == FRAME_COUNT) {
+        stage->times[stage->start_index] = seconds;
+        stage->start_index = (stage->start_index + 1) % FRAME_COUNT;
+    } else {
+        stage->times.push_back(seconds);
+    }
+}
+
+void PerformanceCounter::set_thread_scaling(const std::string& name, std::vector<float> times) {
+    auto scaling = std::find_if(thread_scalings.begin(), thread_scalings.end(), [&name](const ThreadScaling& scaling) { return scaling.name == name; });
+    if (scaling == thread_scalings.end()) {
+        thread_scalings.push_back({name, std::move(times)});
+    } else {
+        scaling->times = std::move(times);
+    }
+}
+
+bool PerformanceCounter::take_thread_scaling_request() {
+    auto requested = thread_scaling_requested;
+    thread_scaling_requested = false;
+    return requested;
+}
+
 void PerformanceCounter::add_imgui_options_section(float frame_delta) {
     if (frame_times.size() == FRAME_COUNT) {
         frame_times[start_index] = frame_delta;
@@ -49,5 +84,35 @@ void PerformanceCounter::add_imgui_options_section(float frame_delta) {
         ImGui::Text("Average Effective FPS: %.3f", 1.0f / averageTime);
         ImGui::Text("Min Frame time: %.3f ms", minTime * 1000.0f);
         ImGui::Text("Max Frame time: %.3f ms", maxTime * 1000.0f);
+
+        if (!stages.empty() && ImGui::TreeNode("Frame Stages")) {
+            for (const auto& stage: stages) {
+                float average = 0.0f;
+                float max = 0.0f;
+                for (float time: stage.times) {
+                    average += time;
+                    max = std::max(max, time);
+                }
+                average /= (float) std::max<size_t>(stage.times.size(), 1);
+                ImGui::Text("%s: %.3f ms average, %.3f ms max", stage.name.c_str(), average * 1000.0f, max * 1000.0f);
+            }
+            ImGui::TreePop();
+        }
+
+        if (ImGui::TreeNode("Thread Scaling")) {
+            if (ImGui::Button("Measure Thread Scaling")) {
+                thread_scaling_requested = true;
+            }
+            for (const auto& scaling: thread_scalings) {
+                if (scaling.times.empty()) continue;
+                std::vector<float> times_ms{};
+                for (float time: scaling.times) times_ms.push_back(time * 1000.0f);
+                ImGui::PlotHistogram(scaling.name.c_str(), times_ms.data(), (int) times_ms.size(), 0, "ms with 1 to N threads", 0.0f, FLT_MAX, ImVec2(0, 60));
+                auto fastest = std::min_element(scaling.times.begin(), scaling.times.end());
+                ImGui::Text("Fastest with %d threads, %.2fx the speed of 1", (int) (fastest - scaling.times.begin()) + 1,
+                            *fastest > 0.0f ? scaling.times.front() / *fastest : 1.0f);
+            }
+            ImGui::TreePop();
+        }
     }
 }
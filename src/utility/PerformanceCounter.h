@@ -1,11 +1,13 @@
 #ifndef PERFORMANCE_COUNTER_H
 #define PERFORMANCE_COUNTER_H
 
+#include <string>
 #include <vector>
 #include <cstddef>
+#include <functional>
 
 /// A performance counter class,
-/// It is used to measure the FPS and plot it with ImGUI
+/// It is used to measure the FPS and plot it with ImGUI, along with how long each stage of the frame takes
 class PerformanceCounter {
     std::vector<float> frame_times{};
     size_t start_index{};
@@ -13,10 +15,35 @@ class PerformanceCounter {
     const size_t FRAME_COUNT = 200;
     const size_t FRAME_DISPLAY_COUNT = 200;
 
+    struct Stage {
+        std::string name;
+        // Seconds, the last FRAME_COUNT times, as a ring buffer
+        std::vector<float> times{};
+        size_t start_index = 0;
+    };
+    // In the order they were first timed, which is the order they run in
+    std::vector<Stage> stages{};
+
+    struct ThreadScaling {
+        std::string name;
+        // [thread_count - 1] -> seconds
+        std::vector<float> times{};
+    };
+    std::vector<ThreadScaling> thread_scalings{};
+    bool thread_scaling_requested = false;
+
     static float values_getter(void* data, int idx);
 public:
     PerformanceCounter();
 
+    /// Run fn, recording how long it took as this frame's time for the named stage
+    void time_stage(const std::string& name, const std::function<void()>& fn);
+
+    /// Set how long the named stage took with 1, 2, ... threads, shown as a chart
+    void set_thread_scaling(const std::string& name, std::vector<float> times);
+    /// Whether the thread scaling has been asked to be measured since this was last called
+    bool take_thread_scaling_request();
+
     /// Adds the ImGUI control to the current ImGUI window
     void add_imgui_options_section(float frame_delta);
 };
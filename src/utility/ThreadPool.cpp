@@ -0,0 +1,52 @@
+#include "ThreadPool.h"
+
+#include <algorithm>
+
+thread_local std::optional<uint> ThreadPool::current_worker_index{};
+
+ThreadPool::ThreadPool(uint thread_count) {
+    thread_count = std::max(thread_count, 1u);
+    workers.reserve(thread_count);
+    for (auto i = 0u; i < thread_count; ++i) {
+        workers.emplace_back(&ThreadPool::worker_loop, this, i);
+    }
+}
+
+uint ThreadPool::default_thread_count() {
+    auto hardware_threads = std::thread::hardware_concurrency();
+    return hardware_threads > 1 ? hardware_threads - 1 : 1;
+}
+
+void ThreadPool::worker_loop(uint index) {
+    current_worker_index = index;
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock lock{mutex};
+            condition.wait(lock, [this]() { return stopping || !tasks.empty(); });
+            if (tasks.empty()) return;
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+uint ThreadPool::get_thread_count() const {
+    return (uint) workers.size();
+}
+
+std::optional<uint> ThreadPool::get_worker_index() {
+    return current_worker_index;
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard lock{mutex};
+        stopping = true;
+    }
+    condition.notify_all();
+    for (auto& worker: workers) {
+        worker.join();
+    }
+}
@@ -0,0 +1,63 @@
+#ifndef THREAD_POOL_H
+#define THREAD_POOL_H
+
+#include <deque>
+#include <mutex>
+#include <future>
+#include <memory>
+#include <thread>
+#include <vector>
+#include <optional>
+#include <functional>
+#include <type_traits>
+#include <condition_variable>
+
+#include "utility/HelperTypes.h"
+
+/// A simple fixed size pool of worker threads, for running blocking work (like file IO and parsing) off the main thread.
+/// Note that no OpenGL calls can be made from the workers, since the context is only current on the main thread.
+class ThreadPool : private NonCopyable {
+    std::vector<std::thread> workers{};
+    std::deque<std::function<void()>> tasks{};
+    std::mutex mutex{};
+    std::condition_variable condition{};
+    bool stopping = false;
+
+    static thread_local std::optional<uint> current_worker_index;
+
+    void worker_loop(uint index);
+public:
+    /// Creates the pool with thread_count workers, by default leaving one hardware thread for the main thread.
+    explicit ThreadPool(uint thread_count = default_thread_count());
+
+    static uint default_thread_count();
+
+    /// Queue a task to be run on one of the workers, the result (or exception) is available through the returned future.
+    template<typename Task>
+    std::future<std::invoke_result_t<std::decay_t<Task>>> submit(Task&& task);
+
+    [[nodiscard]] uint get_thread_count() const;
+
+    /// The index (in [0, get_thread_count())) of the worker the calling thread is, or nullopt if it is not a worker.
+    /// Useful for indexing per-worker resources that are not thread safe.
+    static std::optional<uint> get_worker_index();
+
+    /// Finishes any queued tasks, then joins the workers.
+    ~ThreadPool();
+};
+
+template<typename Task>
+std::future<std::invoke_result_t<std::decay_t<Task>>> ThreadPool::submit(Task&& task) {
+    using Result = std::invoke_result_t<std::decay_t<Task>>;
+    // std::function requires a copyable callable, so the packaged_task is held by a shared_ptr
+    auto packaged_task = std::make_shared<std::packaged_task<Result()>>(std::forward<Task>(task));
+    auto future = packaged_task->get_future();
+    {
+        std::lock_guard lock{mutex};
+        tasks.emplace_back([packaged_task]() { (*packaged_task)(); });
+    }
+    condition.notify_one();
+    return future;
+}
+
+#endif //THREAD_POOL_H
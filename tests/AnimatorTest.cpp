@@ -0,0 +1,111 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+
+#include "rendering/scene/Animator.h"
+
+/// Stands in for an AnimatedRenderedEntity, with animations that can be swapped out as a model change would
+struct TestEntity : public AnimatedEntityInterface {
+    std::vector<std::tuple<std::string, double, double>> animations{};
+    uint animation_id = NONE_ANIMATION;
+    double animation_time_seconds = 0.0;
+
+    [[nodiscard]] const std::vector<std::tuple<std::string, double, double>>& get_animations() const override { return animations; }
+    [[nodiscard]] uint& get_animation_id() override { return animation_id; }
+    [[nodiscard]] double& get_animation_time_seconds() override { return animation_time_seconds; }
+    [[nodiscard]] double get_animation_duration_seconds() const override {
+        if (animation_id >= animations.size()) return 0.0;
+        const auto& [name, ticks_per_second, duration_ticks] = animations[animation_id];
+        return duration_ticks / ticks_per_second;
+    }
+};
+
+static int failures = 0;
+
+static void check(bool condition, const char* description) {
+    if (!condition) {
+        std::printf("FAILED: %s\n", description);
+        failures++;
+    }
+}
+
+static void animate_for(Animator& animator, JobSystem& job_system, double seconds) {
+    for (auto i = 0; i < (int) (seconds * 60.0); ++i) {
+        animator.animate(1.0 / 60.0, job_system);
+    }
+}
+
+/// Switching the model mid-animation, then stopping it as AnimatedEntityElement does, must not leave the old clip playing
+static void test_model_switch_stops_animation(JobSystem& job_system) {
+    Animator animator{};
+    auto entity = std::make_shared<TestEntity>();
+    entity->animations = {{"walk", 1.0, 10.0}};
+
+    animator.start(entity, {0, true, false, 1.0});
+    animate_for(animator, job_system, 2.0);
+    check(animator.is_animating(entity).has_value(), "looping animation plays before the model switch");
+
+    entity->animations = {{"wave", 1.0, 0.5}};
+    animator.stop(entity);
+    check(!animator.is_animating(entity).has_value(), "animation stops on model switch");
+    check(entity->animation_id == NONE_ANIMATION, "animation_id cleared on model switch");
+    check(entity->animation_time_seconds == 0.0, "time reset on model switch");
+
+    animate_for(animator, job_system, 1.0);
+    check(entity->animation_time_seconds == 0.0, "time stays reset after the model switch");
+
+    entity->animation_id = 0;
+    animator.start(entity, {0, false, false, 1.0});
+    animate_for(animator, job_system, 1.0);
+    check(!animator.is_animating(entity).has_value(), "new model's clip ends at its own duration");
+    check(entity->animation_time_seconds == 0.5, "new model's clip is clamped to its own duration");
+}
+
+/// Switching the model mid-animation, then updating the parameters, must play with the new clip's duration
+static void test_model_switch_updates_duration(JobSystem& job_system) {
+    Animator animator{};
+    auto entity = std::make_shared<TestEntity>();
+    entity->animations = {{"walk", 1.0, 10.0}};
+
+    entity->animation_id = 0;
+    animator.start(entity, {0, false, false, 1.0});
+    animate_for(animator, job_system, 1.0);
+
+    entity->animations = {{"wave", 2.0, 3.0}};
+    animator.update_param(entity, {0, false, false, 1.0});
+    animate_for(animator, job_system, 1.0);
+    check(!animator.is_animating(entity).has_value(), "updated clip ends at its new duration");
+    check(entity->animation_time_seconds == 1.5, "updated clip is clamped to its new duration");
+}
+
+/// The entity's animation_id belongs to its owner, so only starting and stopping an animation change it
+static void test_update_param_keeps_animation_id(JobSystem& job_system) {
+    Animator animator{};
+    auto entity = std::make_shared<TestEntity>();
+    entity->animations = {{"walk", 1.0, 10.0}, {"wave", 1.0, 0.5}};
+
+    animator.start(entity, {0, true, false, 1.0});
+    check(entity->animation_id == 0, "start sets animation_id");
+
+    animator.update_param(entity, {1, true, false, 1.0});
+    check(entity->animation_id == 0, "update_param leaves animation_id");
+    animate_for(animator, job_system, 1.0);
+    check(std::abs(entity->animation_time_seconds - 1.0) < 1e-9, "update_param keeps the entity's animation's duration");
+
+    animator.stop(entity);
+    check(entity->animation_id == NONE_ANIMATION, "stop clears animation_id");
+    animator.resume(entity, {1, false, false, 1.0});
+    check(entity->animation_id == 1, "resume sets animation_id when not animating");
+}
+
+int main() {
+    JobSystem job_system{4};
+
+    test_model_switch_stops_animation(job_system);
+    test_model_switch_updates_duration(job_system);
+    test_update_param_keeps_animation_id(job_system);
+
+    if (failures > 0) return EXIT_FAILURE;
+    std::printf("All Animator tests passed\n");
+    return EXIT_SUCCESS;
+}